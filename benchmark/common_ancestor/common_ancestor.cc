@@ -0,0 +1,222 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/common_ancestor/common_ancestor.h"
+
+#include <iostream>
+#include <vector>
+
+#include "apps/ledger/src/app/merging/common_ancestor.h"
+#include "apps/ledger/src/storage/impl/commit_impl.h"
+#include "apps/ledger/src/storage/public/constants.h"
+#include "apps/ledger/src/storage/public/data_source.h"
+#include "apps/ledger/src/storage/public/journal.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace {
+
+constexpr ftl::StringView kStoragePath =
+    "/data/benchmark/ledger/common_ancestor";
+constexpr ftl::StringView kCommitCountFlag = "commit-count";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kCommitCountFlag
+            << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         int* value) {
+  std::string value_str;
+  int found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+// Logs an error and posts a quit task on the current message loop if the given
+// storage status is not storage::Status::OK. Returns true if the quit task was
+// posted.
+bool QuitOnStorageError(storage::Status status, ftl::StringView description) {
+  if (status != storage::Status::OK) {
+    FTL_LOG(ERROR) << description << " failed with status " << status;
+    mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+using CommitPtr = std::unique_ptr<const storage::Commit>;
+
+CommonAncestorBenchmark::CommonAncestorBenchmark(int commit_count)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      commit_count_(commit_count),
+      repository_db_(storage::GetRepositoryDbPath(tmp_dir_.path())) {
+  FTL_DCHECK(commit_count > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_common_ancestor"});
+  io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+}
+
+CommonAncestorBenchmark::~CommonAncestorBenchmark() {
+  io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread_.join();
+}
+
+void CommonAncestorBenchmark::Run() {
+  if (QuitOnStorageError(repository_db_.Init(), "RepositoryDb::Init")) {
+    return;
+  }
+  ledger_storage_ = std::make_unique<storage::LedgerStorageImpl>(
+      mtl::MessageLoop::GetCurrent()->task_runner(), io_runner_,
+      &coroutine_service_, &repository_db_, tmp_dir_.path(), "common_ancestor",
+      &tree_node_cache_);
+  ledger_storage_->CreatePageStorage(
+      "page_id", [this](storage::Status status,
+                        std::unique_ptr<storage::PageStorage> page_storage) {
+        if (QuitOnStorageError(status, "LedgerStorage::CreatePageStorage")) {
+          return;
+        }
+        page_storage_ = std::move(page_storage);
+        CreateBranch("left", [this](CommitPtr left) {
+          left_head_ = std::move(left);
+          CreateBranch("right", [this](CommitPtr right) {
+            right_head_ = std::move(right);
+            RunCommonAncestor();
+          });
+        });
+      });
+}
+
+void CommonAncestorBenchmark::CreateBranch(
+    std::string name,
+    std::function<void(std::unique_ptr<const storage::Commit>)> on_done) {
+  StartBranch(std::move(name),
+              [ this, on_done = std::move(on_done) ](CommitPtr first) {
+                AddCommits(commit_count_ - 1, std::move(first), on_done);
+              });
+}
+
+void CommonAncestorBenchmark::StartBranch(
+    std::string name,
+    std::function<void(std::unique_ptr<const storage::Commit>)> on_done) {
+  page_storage_->AddObjectFromLocal(
+      storage::DataSource::Create(name), [
+        this, on_done = std::move(on_done)
+      ](storage::Status status, storage::ObjectId object_id) {
+        if (QuitOnStorageError(status, "PageStorage::AddObjectFromLocal")) {
+          return;
+        }
+        std::unique_ptr<storage::Journal> journal;
+        status = page_storage_->StartCommit(
+            storage::kFirstPageCommitId.ToString(),
+            storage::JournalType::EXPLICIT, &journal);
+        if (QuitOnStorageError(status, "PageStorage::StartCommit")) {
+          return;
+        }
+        status = journal->Put("branch", object_id, storage::KeyPriority::EAGER);
+        if (QuitOnStorageError(status, "Journal::Put")) {
+          return;
+        }
+        storage::Journal* journal_ptr = journal.get();
+        journal_ptr->Commit(ftl::MakeCopyable([
+          journal = std::move(journal), on_done
+        ](storage::Status status,
+          std::unique_ptr<const storage::Commit> commit) {
+          if (QuitOnStorageError(status, "Journal::Commit")) {
+            return;
+          }
+          on_done(std::move(commit));
+        }));
+      });
+}
+
+void CommonAncestorBenchmark::AddCommits(
+    int remaining,
+    std::unique_ptr<const storage::Commit> head,
+    std::function<void(std::unique_ptr<const storage::Commit>)> on_done) {
+  if (remaining == 0) {
+    on_done(std::move(head));
+    return;
+  }
+
+  storage::ObjectId root_id = head->GetRootId().ToString();
+  std::vector<std::unique_ptr<const storage::Commit>> parents;
+  parents.push_back(std::move(head));
+  std::unique_ptr<storage::Commit> commit =
+      storage::CommitImpl::FromContentAndParents(
+          page_storage_.get(), root_id, std::move(parents));
+  // Commits can only be added directly through the sync interface of the page
+  // storage.
+  std::vector<storage::PageStorage::CommitIdAndBytes> commits;
+  commits.emplace_back(commit->GetId(), commit->GetStorageBytes().ToString());
+  std::unique_ptr<const storage::Commit> new_head = std::move(commit);
+  page_storage_->AddCommitsFromSync(
+      std::move(commits), ftl::MakeCopyable([
+        this, remaining, new_head = std::move(new_head),
+        on_done = std::move(on_done)
+      ](storage::Status status) mutable {
+        if (QuitOnStorageError(status, "PageStorage::AddCommitsFromSync")) {
+          return;
+        }
+        AddCommits(remaining - 1, std::move(new_head), std::move(on_done));
+      }));
+}
+
+void CommonAncestorBenchmark::RunCommonAncestor() {
+  TRACE_ASYNC_BEGIN("benchmark", "common_ancestor", 0);
+  ledger::FindCommonAncestor(
+      mtl::MessageLoop::GetCurrent()->task_runner(), page_storage_.get(),
+      std::move(left_head_), std::move(right_head_),
+      [this](ledger::Status status,
+             std::unique_ptr<const storage::Commit> ancestor) {
+        if (status != ledger::Status::OK) {
+          FTL_LOG(ERROR) << "FindCommonAncestor failed";
+        } else if (ancestor->GetId() != storage::kFirstPageCommitId) {
+          FTL_LOG(ERROR) << "FindCommonAncestor found an unexpected ancestor";
+        }
+        TRACE_ASYNC_END("benchmark", "common_ancestor", 0);
+        ShutDown();
+      });
+}
+
+void CommonAncestorBenchmark::ShutDown() {
+  page_storage_.reset();
+  ledger_storage_.reset();
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int commit_count;
+  if (!GetPositiveIntValue(command_line, kCommitCountFlag, &commit_count)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::CommonAncestorBenchmark app(commit_count);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_COMMON_ANCESTOR_COMMON_ANCESTOR_H_
+#define APPS_LEDGER_BENCHMARK_COMMON_ANCESTOR_COMMON_ANCESTOR_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/impl/ledger_storage_impl.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace benchmark {
+
+// Microbenchmark that finds the lowest common ancestor of the heads of two
+// branches of a local page storage that diverged a long time ago, as done when
+// merging them. The search is traced as "common_ancestor".
+//
+// Parameters:
+//   --commit-count=<int> the number of commits in each branch since they
+//     diverged
+class CommonAncestorBenchmark {
+ public:
+  explicit CommonAncestorBenchmark(int commit_count);
+  ~CommonAncestorBenchmark();
+
+  void Run();
+
+ private:
+  // Creates a branch of |commit_count_| commits starting from the first commit
+  // of the page.
+  void CreateBranch(
+      std::string name,
+      std::function<void(std::unique_ptr<const storage::Commit>)> on_done);
+  // Adds a commit changing the value of a single key on top of the first
+  // commit of the page, so that the two branches have distinct contents.
+  void StartBranch(
+      std::string name,
+      std::function<void(std::unique_ptr<const storage::Commit>)> on_done);
+  // Recursively adds |remaining| commits on top of |head|, all with the same
+  // contents.
+  void AddCommits(
+      int remaining,
+      std::unique_ptr<const storage::Commit> head,
+      std::function<void(std::unique_ptr<const storage::Commit>)> on_done);
+
+  void RunCommonAncestor();
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int commit_count_;
+
+  std::thread io_thread_;
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  storage::TreeNodeCache tree_node_cache_;
+  storage::RepositoryDb repository_db_;
+  std::unique_ptr<storage::LedgerStorageImpl> ledger_storage_;
+  std::unique_ptr<storage::PageStorage> page_storage_;
+  std::unique_ptr<const storage::Commit> left_head_;
+  std::unique_ptr<const storage::Commit> right_head_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CommonAncestorBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_COMMON_ANCESTOR_COMMON_ANCESTOR_H_
@@ -0,0 +1,234 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/lookup/lookup.h"
+
+#include <iostream>
+
+#include "apps/ledger/benchmark/lib/data.h"
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/impl/btree/iterator.h"
+#include "apps/ledger/src/storage/impl/btree/lookup.h"
+#include "apps/ledger/src/storage/public/data_source.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace {
+
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/lookup";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kKeySizeFlag = "key-size";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kKeySizeFlag << "=<int> --" << kValueSizeFlag
+            << "=<int>" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         int* value) {
+  std::string value_str;
+  int found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+// Logs an error and posts a quit task on the current message loop if the given
+// storage status is not storage::Status::OK. Returns true if the quit task was
+// posted.
+bool QuitOnStorageError(storage::Status status, ftl::StringView description) {
+  if (status != storage::Status::OK) {
+    FTL_LOG(ERROR) << description << " failed with status " << status;
+    mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+LookupBenchmark::LookupBenchmark(int entry_count,
+                                 int key_size,
+                                 int value_size)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      entry_count_(entry_count),
+      key_size_(key_size),
+      value_size_(value_size),
+      repository_db_(storage::GetRepositoryDbPath(tmp_dir_.path())) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(key_size > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_lookup"});
+  io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+}
+
+LookupBenchmark::~LookupBenchmark() {
+  io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread_.join();
+}
+
+void LookupBenchmark::Run() {
+  for (int i = 0; i < entry_count_; ++i) {
+    keys_.push_back(convert::ToString(benchmark::MakeKey(i, key_size_)));
+  }
+  if (QuitOnStorageError(repository_db_.Init(), "RepositoryDb::Init")) {
+    return;
+  }
+  ledger_storage_ = std::make_unique<storage::LedgerStorageImpl>(
+      mtl::MessageLoop::GetCurrent()->task_runner(), io_runner_,
+      &coroutine_service_, &repository_db_, tmp_dir_.path(), "lookup",
+      &tree_node_cache_);
+  ledger_storage_->CreatePageStorage(
+      "page_id", [this](storage::Status status,
+                        std::unique_ptr<storage::PageStorage> page_storage) {
+        if (QuitOnStorageError(status, "LedgerStorage::CreatePageStorage")) {
+          return;
+        }
+        page_storage_ = std::move(page_storage);
+        std::vector<storage::CommitId> heads;
+        status = page_storage_->GetHeadCommitIds(&heads);
+        if (QuitOnStorageError(status, "PageStorage::GetHeadCommitIds")) {
+          return;
+        }
+        std::unique_ptr<storage::Journal> journal;
+        status = page_storage_->StartCommit(
+            heads[0], storage::JournalType::EXPLICIT, &journal);
+        if (QuitOnStorageError(status, "PageStorage::StartCommit")) {
+          return;
+        }
+        AddEntries(0, std::move(journal));
+      });
+}
+
+void LookupBenchmark::AddEntries(int i,
+                                 std::unique_ptr<storage::Journal> journal) {
+  if (i == entry_count_) {
+    storage::Journal* journal_ptr = journal.get();
+    journal_ptr->Commit(ftl::MakeCopyable([
+      this, journal = std::move(journal)
+    ](storage::Status status, std::unique_ptr<const storage::Commit> commit) {
+      if (QuitOnStorageError(status, "Journal::Commit")) {
+        return;
+      }
+      commit_ = std::move(commit);
+      RunLookup(0);
+    }));
+    return;
+  }
+
+  page_storage_->AddObjectFromLocal(
+      storage::DataSource::Create(
+          convert::ToString(benchmark::MakeValue(value_size_))),
+      ftl::MakeCopyable([ this, i, journal = std::move(journal) ](
+          storage::Status status, storage::ObjectId object_id) mutable {
+        if (QuitOnStorageError(status, "PageStorage::AddObjectFromLocal")) {
+          return;
+        }
+        status =
+            journal->Put(keys_[i], object_id, storage::KeyPriority::EAGER);
+        if (QuitOnStorageError(status, "Journal::Put")) {
+          return;
+        }
+        AddEntries(i + 1, std::move(journal));
+      }));
+}
+
+void LookupBenchmark::RunLookup(int i) {
+  if (i == entry_count_) {
+    RunForEachEntryLookup(0);
+    return;
+  }
+
+  TRACE_ASYNC_BEGIN("benchmark", "lookup", i);
+  storage::btree::GetEntry(
+      page_storage_.get(), commit_->GetRootId(), keys_[i],
+      [this, i](storage::Status status, storage::Entry entry) {
+        if (QuitOnStorageError(status, "btree::GetEntry")) {
+          return;
+        }
+        TRACE_ASYNC_END("benchmark", "lookup", i);
+        // Start the next lookup from the message loop, as this one might have
+        // completed synchronously.
+        mtl::MessageLoop::GetCurrent()->task_runner()->PostTask(
+            [this, i] { RunLookup(i + 1); });
+      });
+}
+
+void LookupBenchmark::RunForEachEntryLookup(int i) {
+  if (i == entry_count_) {
+    ShutDown();
+    return;
+  }
+
+  // This is how single entries were retrieved before |btree::GetEntry()|.
+  auto entry = std::make_shared<storage::Entry>();
+  auto on_next = [this, i, entry](storage::btree::EntryAndNodeId next) {
+    if (next.entry.key == keys_[i]) {
+      *entry = storage::ToEntry(next.entry);
+    }
+    return false;
+  };
+  auto on_done = [this, i, entry](storage::Status status) {
+    if (QuitOnStorageError(status, "btree::ForEachEntry")) {
+      return;
+    }
+    if (entry->key != keys_[i]) {
+      QuitOnStorageError(storage::Status::NOT_FOUND, "btree::ForEachEntry");
+      return;
+    }
+    TRACE_ASYNC_END("benchmark", "for_each_entry_lookup", i);
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostTask(
+        [this, i] { RunForEachEntryLookup(i + 1); });
+  };
+  TRACE_ASYNC_BEGIN("benchmark", "for_each_entry_lookup", i);
+  storage::btree::ForEachEntry(&coroutine_service_, page_storage_.get(),
+                               commit_->GetRootId(), keys_[i],
+                               std::move(on_next), std::move(on_done));
+}
+
+void LookupBenchmark::ShutDown() {
+  commit_.reset();
+  page_storage_.reset();
+  ledger_storage_.reset();
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int entry_count;
+  int key_size;
+  int value_size;
+  if (!GetPositiveIntValue(command_line, kEntryCountFlag, &entry_count) ||
+      !GetPositiveIntValue(command_line, kKeySizeFlag, &key_size) ||
+      !GetPositiveIntValue(command_line, kValueSizeFlag, &value_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::LookupBenchmark app(entry_count, key_size, value_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
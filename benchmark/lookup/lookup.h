@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_LOOKUP_LOOKUP_H_
+#define APPS_LEDGER_BENCHMARK_LOOKUP_LOOKUP_H_
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/impl/ledger_storage_impl.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/journal.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace benchmark {
+
+// Microbenchmark that compares the two ways of looking up a single key in a
+// commit of a local page storage: the direct descent of the tree done by
+// |btree::GetEntry()|, traced as "lookup", and an iteration started at the key
+// with |btree::ForEachEntry()|, traced as "for_each_entry_lookup".
+//
+// Parameters:
+//   --entry-count=<int> the number of entries in the commit, each of them
+//     being looked up once with each method
+//   --key-size=<int> the size of a single key in bytes
+//   --value-size=<int> the size of a single value in bytes
+class LookupBenchmark {
+ public:
+  LookupBenchmark(int entry_count, int key_size, int value_size);
+  ~LookupBenchmark();
+
+  void Run();
+
+ private:
+  // Recursively adds the entries to |journal|, and commits it.
+  void AddEntries(int i, std::unique_ptr<storage::Journal> journal);
+
+  void RunLookup(int i);
+  void RunForEachEntryLookup(int i);
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int entry_count_;
+  const int key_size_;
+  const int value_size_;
+
+  std::thread io_thread_;
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  storage::TreeNodeCache tree_node_cache_;
+  storage::RepositoryDb repository_db_;
+  std::unique_ptr<storage::LedgerStorageImpl> ledger_storage_;
+  std::unique_ptr<storage::PageStorage> page_storage_;
+  std::unique_ptr<const storage::Commit> commit_;
+  std::vector<std::string> keys_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LookupBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_LOOKUP_LOOKUP_H_
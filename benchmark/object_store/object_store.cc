@@ -0,0 +1,229 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/object_store/object_store.h"
+
+#include <sys/stat.h>
+
+#include <iostream>
+#include <random>
+
+#include "apps/ledger/src/storage/impl/directory_reader.h"
+#include "apps/ledger/src/storage/public/data_source.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace {
+
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/object_store";
+constexpr ftl::StringView kObjectCountFlag = "object-count";
+constexpr ftl::StringView kObjectSizeFlag = "object-size";
+constexpr ftl::StringView kNoCompressionFlag = "no-compression";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kObjectCountFlag
+            << "=<int> --" << kObjectSizeFlag << "=<int> [--"
+            << kNoCompressionFlag << "]" << std::endl;
+}
+
+bool GetPositiveIntValue(const ftl::CommandLine& command_line,
+                         ftl::StringView flag,
+                         int* value) {
+  std::string value_str;
+  int found_value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value_str) ||
+      !ftl::StringToNumberWithError(value_str, &found_value) ||
+      found_value <= 0) {
+    return false;
+  }
+  *value = found_value;
+  return true;
+}
+
+// Logs an error and posts a quit task on the current message loop if the given
+// storage status is not storage::Status::OK. Returns true if the quit task was
+// posted.
+bool QuitOnStorageError(storage::Status status, ftl::StringView description) {
+  if (status != storage::Status::OK) {
+    FTL_LOG(ERROR) << description << " failed with status " << status;
+    mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    return true;
+  }
+  return false;
+}
+
+// Builds a JSON-like object of the given size, made of records with the same
+// fields and values drawn from a small vocabulary, as typical values of
+// applications are.
+std::string MakeJsonObject(int i, size_t size) {
+  static const char* const kWords[] = {
+      "ledger", "page", "entry", "value", "commit", "sync", "merge", "story",
+      "module", "agent", "device", "user", "link", "context", "suggestion"};
+  std::minstd_rand generator(i);
+  std::uniform_int_distribution<size_t> distribution(
+      0, sizeof(kWords) / sizeof(kWords[0]) - 1);
+
+  std::string object = "[";
+  for (int record = 0; object.size() < size; ++record) {
+    object.append(ftl::Concatenate(
+        {"{\"id\": ", ftl::NumberToString(record), ", \"name\": \"",
+         kWords[distribution(generator)], "\", \"tags\": [\"",
+         kWords[distribution(generator)], "\", \"",
+         kWords[distribution(generator)], "\"], \"timestamp\": ",
+         ftl::NumberToString(static_cast<uint32_t>(generator())), "},"}));
+  }
+  object.resize(size - 1);
+  object.append("]");
+  return object;
+}
+
+// Returns the total size of the files under |path|.
+uint64_t GetDiskUsage(const std::string& path) {
+  struct stat stat_buffer;
+  if (stat(path.c_str(), &stat_buffer) != 0) {
+    return 0;
+  }
+  if (!S_ISDIR(stat_buffer.st_mode)) {
+    return stat_buffer.st_size;
+  }
+  uint64_t size = 0;
+  storage::DirectoryReader::GetDirectoryEntries(
+      path, [&path, &size](ftl::StringView entry) {
+        size += GetDiskUsage(ftl::Concatenate({path, "/", entry}));
+        return true;
+      });
+  return size;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+ObjectStoreBenchmark::ObjectStoreBenchmark(int object_count,
+                                           int object_size,
+                                           bool compress)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      object_count_(object_count),
+      object_size_(object_size),
+      compress_(compress) {
+  FTL_DCHECK(object_count > 0);
+  FTL_DCHECK(object_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_object_store"});
+  io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+}
+
+ObjectStoreBenchmark::~ObjectStoreBenchmark() {
+  io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread_.join();
+}
+
+void ObjectStoreBenchmark::Run() {
+  OpenPageStorage([this] { AddObjects(0); });
+}
+
+void ObjectStoreBenchmark::OpenPageStorage(std::function<void()> on_done) {
+  page_storage_ = std::make_unique<storage::PageStorageImpl>(
+      mtl::MessageLoop::GetCurrent()->task_runner(), io_runner_,
+      &coroutine_service_, tmp_dir_.path(), "page_id",
+      storage::PackSyncOptions(), storage::kDefaultMaxDbObjectSize, nullptr,
+      nullptr, nullptr, "", storage::GarbageCollectorOptions(), compress_);
+  page_storage_->Init([on_done = std::move(on_done)](storage::Status status) {
+    if (QuitOnStorageError(status, "PageStorage::Init")) {
+      return;
+    }
+    on_done();
+  });
+}
+
+void ObjectStoreBenchmark::AddObjects(int i) {
+  if (i == object_count_) {
+    ReopenPageStorage();
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "add_object", i);
+  page_storage_->AddObjectFromLocal(
+      storage::DataSource::Create(MakeJsonObject(i, object_size_)),
+      [this, i](storage::Status status, storage::ObjectId object_id) {
+        TRACE_ASYNC_END("benchmark", "add_object", i);
+        if (QuitOnStorageError(status, "PageStorage::AddObjectFromLocal")) {
+          return;
+        }
+        object_ids_.push_back(std::move(object_id));
+        AddObjects(i + 1);
+      });
+}
+
+void ObjectStoreBenchmark::ReopenPageStorage() {
+  // The database writes the rows added so far in its tables when reopened, so
+  // that the space used on disk no longer includes its log.
+  page_storage_.reset();
+  OpenPageStorage([this] {
+    uint64_t disk_usage = GetDiskUsage(tmp_dir_.path());
+    bool in_db =
+        static_cast<size_t>(object_size_) < storage::kDefaultMaxDbObjectSize;
+    std::cout << object_count_ << " objects of " << object_size_
+              << " bytes stored in the "
+              << (in_db ? "page database" : "pack segments") << " use "
+              << disk_usage << " bytes on disk"
+              << (compress_ ? "" : " without compression") << "." << std::endl;
+    GetObjects(0);
+  });
+}
+
+void ObjectStoreBenchmark::GetObjects(int i) {
+  if (i == object_count_) {
+    ShutDown();
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "get_object", i);
+  page_storage_->GetObject(
+      object_ids_[i], storage::PageStorage::Location::LOCAL,
+      [this, i](storage::Status status,
+                std::unique_ptr<const storage::Object> object) {
+        if (QuitOnStorageError(status, "PageStorage::GetObject")) {
+          return;
+        }
+        ftl::StringView data;
+        status = object->GetData(&data);
+        TRACE_ASYNC_END("benchmark", "get_object", i);
+        if (QuitOnStorageError(status, "Object::GetData")) {
+          return;
+        }
+        GetObjects(i + 1);
+      });
+}
+
+void ObjectStoreBenchmark::ShutDown() {
+  page_storage_.reset();
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int object_count;
+  int object_size;
+  if (!GetPositiveIntValue(command_line, kObjectCountFlag, &object_count) ||
+      !GetPositiveIntValue(command_line, kObjectSizeFlag, &object_size)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+  bool compress = !command_line.HasOption(kNoCompressionFlag.ToString());
+
+  mtl::MessageLoop loop;
+  benchmark::ObjectStoreBenchmark app(object_count, object_size, compress);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_OBJECT_STORE_OBJECT_STORE_H_
+#define APPS_LEDGER_BENCHMARK_OBJECT_STORE_OBJECT_STORE_H_
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace benchmark {
+
+// Microbenchmark of the local object store of a page storage: it adds JSON-like
+// objects, reopens the page and reads all the objects back. Objects smaller
+// than |storage::kDefaultMaxDbObjectSize| are stored in the page database,
+// bigger ones in the pack segments. Each addition is traced as "add_object",
+// and each read, including the access to the content of the object, as
+// "get_object". The space used on disk by the page once reopened is printed.
+//
+// Parameters:
+//   --object-count=<int> the number of objects added
+//   --object-size=<int> the size of a single object in bytes
+//   --no-compression disables the compression of the objects, to compare with
+//     the default behavior
+class ObjectStoreBenchmark {
+ public:
+  ObjectStoreBenchmark(int object_count, int object_size, bool compress);
+  ~ObjectStoreBenchmark();
+
+  void Run();
+
+ private:
+  // Creates |page_storage_| on top of the page directory, and initializes it.
+  void OpenPageStorage(std::function<void()> on_done);
+
+  void AddObjects(int i);
+  void ReopenPageStorage();
+  void GetObjects(int i);
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int object_count_;
+  const int object_size_;
+  const bool compress_;
+
+  std::thread io_thread_;
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  std::unique_ptr<storage::PageStorageImpl> page_storage_;
+  std::vector<storage::ObjectId> object_ids_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectStoreBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_OBJECT_STORE_OBJECT_STORE_H_
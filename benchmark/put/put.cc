@@ -83,6 +83,8 @@ void PutBenchmark::Run() {
         ftl::MakeCopyable([ this, keys = std::move(keys) ](ledger::PagePtr page,
                                                            auto id) mutable {
           page_ = std::move(page);
+          // Spans all the puts and commits, to measure the overall throughput.
+          TRACE_ASYNC_BEGIN("benchmark", "all_puts", 0);
           if (transaction_size_ > 1) {
             page_->StartTransaction(ftl::MakeCopyable([
               this, keys = std::move(keys)
@@ -197,6 +199,7 @@ void PutBenchmark::CommitAndShutDown() {
 }
 
 void PutBenchmark::ShutDown() {
+  TRACE_ASYNC_END("benchmark", "all_puts", 0);
   // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
   ledger_controller_->Kill();
   ledger_controller_.WaitForIncomingResponseWithTimeout(
@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/cursor_pool.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ledger {
+
+CursorPool::CursorPool(size_t max_cursors, ftl::TimeDelta ttl)
+    : max_cursors_(max_cursors), ttl_(ttl) {
+  FTL_DCHECK(max_cursors_ > 0);
+}
+
+CursorPool::~CursorPool() {}
+
+void CursorPool::Put(
+    std::string token,
+    std::unique_ptr<storage::PageStorage::ContentsCursor> cursor) {
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  RemoveExpired(now);
+  Take(token);
+  if (cursors_.size() == max_cursors_) {
+    cursors_.pop_front();
+  }
+  cursors_.push_back(
+      CachedCursor{std::move(token), std::move(cursor), now + ttl_});
+}
+
+std::unique_ptr<storage::PageStorage::ContentsCursor> CursorPool::Take(
+    const std::string& token) {
+  RemoveExpired(ftl::TimePoint::Now());
+  for (auto it = cursors_.begin(); it != cursors_.end(); ++it) {
+    if (it->token == token) {
+      std::unique_ptr<storage::PageStorage::ContentsCursor> cursor =
+          std::move(it->cursor);
+      cursors_.erase(it);
+      return cursor;
+    }
+  }
+  return nullptr;
+}
+
+void CursorPool::RemoveExpired(ftl::TimePoint now) {
+  // Cursors expire in insertion order.
+  while (!cursors_.empty() && cursors_.front().expiration <= now) {
+    cursors_.pop_front();
+  }
+}
+
+}  // namespace ledger
@@ -0,0 +1,62 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_CURSOR_POOL_H_
+#define APPS_LEDGER_SRC_APP_CURSOR_POOL_H_
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ledger {
+
+// Keeps the cursors of interrupted iterations over a snapshot, keyed by the
+// continuation token returned to the client, so that the next page of results
+// resumes where the previous one stopped. Each cursor holds the nodes on the
+// path to its position in the tree: to bound memory, at most |max_cursors| are
+// kept, the oldest being evicted first, and cursors expire after |ttl|.
+class CursorPool {
+ public:
+  CursorPool(size_t max_cursors = 4,
+             ftl::TimeDelta ttl = ftl::TimeDelta::FromSeconds(30));
+  ~CursorPool();
+
+  // Adds a cursor for the given continuation |token|, replacing any previous
+  // cursor for the same token.
+  void Put(std::string token,
+           std::unique_ptr<storage::PageStorage::ContentsCursor> cursor);
+
+  // Removes and returns the cursor for the given |token|, or nullptr if there
+  // is none, e.g. because it was evicted or has expired.
+  std::unique_ptr<storage::PageStorage::ContentsCursor> Take(
+      const std::string& token);
+
+  size_t size() const { return cursors_.size(); }
+
+ private:
+  struct CachedCursor {
+    std::string token;
+    std::unique_ptr<storage::PageStorage::ContentsCursor> cursor;
+    ftl::TimePoint expiration;
+  };
+
+  // Removes the expired cursors.
+  void RemoveExpired(ftl::TimePoint now);
+
+  const size_t max_cursors_;
+  const ftl::TimeDelta ttl_;
+  // Ordered by insertion time, oldest first.
+  std::list<CachedCursor> cursors_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CursorPool);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_CURSOR_POOL_H_
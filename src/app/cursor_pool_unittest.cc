@@ -0,0 +1,48 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/cursor_pool.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+namespace ledger {
+namespace {
+
+std::unique_ptr<storage::PageStorage::ContentsCursor> NewCursor() {
+  return std::make_unique<storage::PageStorage::ContentsCursor>();
+}
+
+TEST(CursorPoolTest, PutTake) {
+  CursorPool pool;
+  auto cursor = NewCursor();
+  storage::PageStorage::ContentsCursor* cursor_ptr = cursor.get();
+  pool.Put("token", std::move(cursor));
+  EXPECT_EQ(nullptr, pool.Take("other token"));
+  EXPECT_EQ(cursor_ptr, pool.Take("token").get());
+  // A cursor can only be taken once.
+  EXPECT_EQ(nullptr, pool.Take("token"));
+}
+
+TEST(CursorPoolTest, EvictOldest) {
+  CursorPool pool(2);
+  pool.Put("token1", NewCursor());
+  pool.Put("token2", NewCursor());
+  pool.Put("token3", NewCursor());
+  EXPECT_EQ(2u, pool.size());
+  EXPECT_EQ(nullptr, pool.Take("token1"));
+  EXPECT_NE(nullptr, pool.Take("token2"));
+  EXPECT_NE(nullptr, pool.Take("token3"));
+}
+
+TEST(CursorPoolTest, Expire) {
+  CursorPool pool(2, ftl::TimeDelta::Zero());
+  pool.Put("token", NewCursor());
+  EXPECT_EQ(nullptr, pool.Take("token"));
+  EXPECT_EQ(0u, pool.size());
+}
+
+}  // namespace
+}  // namespace ledger
@@ -0,0 +1,97 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/fidl/entries_buffer.h"
+
+#include <string.h>
+
+#include "lib/mtl/vmo/strings.h"
+
+namespace ledger {
+namespace {
+
+// The header only holds the number of entries.
+constexpr size_t kHeaderSize = sizeof(uint64_t);
+constexpr size_t kRecordSize = sizeof(EntriesBufferRecord);
+
+}  // namespace
+
+size_t GetEntriesBufferEntrySize(size_t key_size, size_t value_size) {
+  return kRecordSize + key_size + value_size;
+}
+
+EntriesBufferWriter::EntriesBufferWriter() {}
+
+EntriesBufferWriter::~EntriesBufferWriter() {}
+
+void EntriesBufferWriter::AddEntry(ftl::StringView key,
+                                   Priority priority,
+                                   Status value_status,
+                                   ftl::StringView value) {
+  EntriesBufferRecord record;
+  record.key_offset = data_.size();
+  record.key_size = key.size();
+  data_.append(key.data(), key.size());
+  record.value_offset = data_.size();
+  record.value_size = value.size();
+  data_.append(value.data(), value.size());
+  record.priority = static_cast<int32_t>(priority);
+  record.value_status = static_cast<int32_t>(value_status);
+  records_.push_back(record);
+}
+
+size_t EntriesBufferWriter::size() const {
+  return kHeaderSize + records_.size() * kRecordSize + data_.size();
+}
+
+bool EntriesBufferWriter::ToVmo(mx::vmo* vmo) const {
+  uint64_t data_start = kHeaderSize + records_.size() * kRecordSize;
+  std::string buffer;
+  buffer.reserve(data_start + data_.size());
+
+  uint64_t entry_count = records_.size();
+  buffer.append(reinterpret_cast<const char*>(&entry_count), kHeaderSize);
+  for (EntriesBufferRecord record : records_) {
+    record.key_offset += data_start;
+    record.value_offset += data_start;
+    buffer.append(reinterpret_cast<const char*>(&record), kRecordSize);
+  }
+  buffer.append(data_);
+  return mtl::VmoFromString(buffer, vmo);
+}
+
+bool ReadEntriesBuffer(ftl::StringView buffer,
+                       std::vector<EntriesBufferEntry>* entries) {
+  if (buffer.size() < kHeaderSize) {
+    return false;
+  }
+  uint64_t entry_count;
+  memcpy(&entry_count, buffer.data(), kHeaderSize);
+  if (entry_count > (buffer.size() - kHeaderSize) / kRecordSize) {
+    return false;
+  }
+
+  std::vector<EntriesBufferEntry> result;
+  result.reserve(entry_count);
+  for (uint64_t i = 0; i < entry_count; ++i) {
+    EntriesBufferRecord record;
+    memcpy(&record, buffer.data() + kHeaderSize + i * kRecordSize,
+           kRecordSize);
+    if (record.key_offset > buffer.size() ||
+        record.key_size > buffer.size() - record.key_offset ||
+        record.value_offset > buffer.size() ||
+        record.value_size > buffer.size() - record.value_offset) {
+      return false;
+    }
+    result.push_back(EntriesBufferEntry{
+        buffer.substr(record.key_offset, record.key_size),
+        static_cast<Priority>(record.priority),
+        static_cast<Status>(record.value_status),
+        buffer.substr(record.value_offset, record.value_size)});
+  }
+  entries->swap(result);
+  return true;
+}
+
+}  // namespace ledger
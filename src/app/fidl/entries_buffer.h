@@ -0,0 +1,94 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_FIDL_ENTRIES_BUFFER_H_
+#define APPS_LEDGER_SRC_APP_FIDL_ENTRIES_BUFFER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "mx/vmo.h"
+
+namespace ledger {
+
+// An index record of the buffers returned by PageSnapshot.GetEntriesInBuffer()
+// and PageSnapshot.GetKeysInBuffer(). Offsets are from the start of the
+// buffer.
+struct EntriesBufferRecord {
+  uint64_t key_offset;
+  uint64_t key_size;
+  uint64_t value_offset;
+  uint64_t value_size;
+  int32_t priority;
+  int32_t value_status;
+};
+
+static_assert(sizeof(EntriesBufferRecord) == 40,
+              "Unexpected EntriesBufferRecord size");
+
+// Maximum number of entries, and maximum size in bytes, of a buffer returned
+// by PageSnapshot.GetEntriesInBuffer() or PageSnapshot.GetKeysInBuffer().
+// Larger results are split in several buffers. A buffer always holds at least
+// one entry, even if that entry alone is larger than |kMaxEntriesBufferSize|.
+constexpr size_t kMaxEntriesBufferCount = 1024;
+constexpr size_t kMaxEntriesBufferSize = 16 * 1024 * 1024;
+
+// Returns the number of bytes used in a buffer by an entry with a key of
+// |key_size| bytes and a value of |value_size| bytes.
+size_t GetEntriesBufferEntrySize(size_t key_size, size_t value_size);
+
+// Writes the buffers returned by PageSnapshot.GetEntriesInBuffer() and
+// PageSnapshot.GetKeysInBuffer(). The layout of the buffer is described in
+// ledger.fidl: a header with the number of entries, followed by one index
+// record per entry, followed by the keys and values the records point to.
+class EntriesBufferWriter {
+ public:
+  EntriesBufferWriter();
+  ~EntriesBufferWriter();
+
+  // Adds an entry to the buffer. |value_status| is |OK| if |value| holds the
+  // value of the entry and |NEEDS_FETCH| if the value is not available
+  // locally. Buffers holding only keys use |OK| and an empty value.
+  void AddEntry(ftl::StringView key,
+                Priority priority,
+                Status value_status,
+                ftl::StringView value);
+
+  // Returns the size of the buffer holding the entries added so far.
+  size_t size() const;
+
+  // Creates a vmo with the content of the buffer.
+  bool ToVmo(mx::vmo* vmo) const;
+
+ private:
+  // Offsets in |records_| are relative to the start of |data_|.
+  std::vector<EntriesBufferRecord> records_;
+  // The keys and values of all entries.
+  std::string data_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EntriesBufferWriter);
+};
+
+// An entry read from a buffer written by |EntriesBufferWriter|. The key and
+// the value are views on the buffer.
+struct EntriesBufferEntry {
+  ftl::StringView key;
+  Priority priority;
+  Status value_status;
+  ftl::StringView value;
+};
+
+// Parses a buffer written by |EntriesBufferWriter|. Returns false if the
+// buffer is malformed.
+bool ReadEntriesBuffer(ftl::StringView buffer,
+                       std::vector<EntriesBufferEntry>* entries);
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_FIDL_ENTRIES_BUFFER_H_
@@ -16,7 +16,8 @@ LedgerRepositoryImpl::LedgerRepositoryImpl(const std::string& base_storage_dir,
                                            cloud_sync::UserConfig user_config)
     : base_storage_dir_(base_storage_dir),
       environment_(environment),
-      user_config_(std::move(user_config)) {
+      user_config_(std::move(user_config)),
+      repository_db_(storage::GetRepositoryDbPath(base_storage_dir)) {
   bindings_.set_on_empty_set_handler([this] { CheckEmpty(); });
   ledger_managers_.set_on_empty([this] { CheckEmpty(); });
 }
@@ -41,12 +42,19 @@ void LedgerRepositoryImpl::GetLedger(
 
   auto it = ledger_managers_.find(ledger_name);
   if (it == ledger_managers_.end()) {
+    // The database of the repository is opened with its first ledger.
+    if (!repository_db_.db() &&
+        repository_db_.Init() != storage::Status::OK) {
+      callback(Status::IO_ERROR);
+      return;
+    }
     std::string name_as_string = convert::ToString(ledger_name);
     std::unique_ptr<storage::LedgerStorage> ledger_storage =
         std::make_unique<storage::LedgerStorageImpl>(
             environment_->main_runner(), environment_->GetIORunner(),
-            environment_->coroutine_service(), base_storage_dir_,
-            name_as_string);
+            environment_->coroutine_service(), &repository_db_,
+            base_storage_dir_, name_as_string, &tree_node_cache_,
+            environment_->GetWorkerPool());
     std::unique_ptr<cloud_sync::LedgerSync> ledger_sync;
     if (user_config_.use_sync) {
       ledger_sync = std::make_unique<cloud_sync::LedgerSyncImpl>(
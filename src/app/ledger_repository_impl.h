@@ -12,6 +12,8 @@
 #include "apps/ledger/src/cloud_sync/public/user_config.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
 #include "lib/fidl/cpp/bindings/binding_set.h"
 #include "lib/ftl/macros.h"
 
@@ -44,6 +46,10 @@ class LedgerRepositoryImpl : public LedgerRepository {
   const std::string base_storage_dir_;
   Environment* const environment_;
   const cloud_sync::UserConfig user_config_;
+  // Shared by the pages of all the ledgers of this repository. These must be
+  // declared before |ledger_managers_|, so that they outlive them.
+  storage::TreeNodeCache tree_node_cache_;
+  storage::RepositoryDb repository_db_;
   callback::AutoCleanableMap<std::string,
                              LedgerManager,
                              convert::StringViewComparator>
@@ -4,7 +4,10 @@
 
 #include "apps/ledger/src/app/merging/common_ancestor.h"
 
+#include <algorithm>
+#include <set>
 #include <utility>
+#include <vector>
 
 #include "apps/ledger/src/app/page_utils.h"
 #include "apps/ledger/src/callback/waiter.h"
@@ -27,24 +30,72 @@ struct GenerationComparator {
   }
 };
 
-// Recursively retrieves the parents of the most recent commits in the given
-// set, i.e. the commits with the highest generation. The recursion stops when
-// only one commit is left in the set, which is the lowest common ancestor.
+using CommitSet =
+    std::set<std::unique_ptr<const storage::Commit>, GenerationComparator>;
+
 void FindCommonAncestorInGeneration(
     const ftl::RefPtr<ftl::TaskRunner> task_runner,
     storage::PageStorage* storage,
-    std::set<std::unique_ptr<const storage::Commit>, GenerationComparator>*
-        commits,
+    CommitSet* commits,
     std::function<void(Status, std::unique_ptr<const storage::Commit>)>
-        callback) {
-  FTL_DCHECK(!commits->empty());
-  // If there is only one commit in the set it is the lowest common ancestor.
-  if (commits->size() == 1) {
-    callback(Status::OK,
-             std::move(const_cast<std::unique_ptr<const storage::Commit>&>(
-                 *commits->rbegin())));
-    return;
+        callback);
+
+// Returns whether all the most recent commits in the given set have a single
+// parent. If so, sets |max_distance| to the number of generations separating
+// them from the next commits of the set.
+bool HasLinearHistory(const CommitSet& commits, uint64_t* max_distance) {
+  uint64_t newest_generation = (*commits.rbegin())->GetGeneration();
+  for (auto it = commits.rbegin(); it != commits.rend(); ++it) {
+    if ((*it)->GetGeneration() != newest_generation) {
+      *max_distance = newest_generation - (*it)->GetGeneration();
+      return true;
+    }
+    if ((*it)->GetParentIds().size() != 1) {
+      return false;
+    }
   }
+  *max_distance = newest_generation;
+  return true;
+}
+
+// Returns the highest level k such that the ancestors at 2^k generations of
+// distance of all the most recent commits are known, are all distinct, and are
+// not further than |max_distance|, or -1 if there is none. Distinct ancestors
+// at 2^k generations of distance in a linear history did not meet before.
+int GetSkipLevel(const std::vector<std::vector<storage::CommitId>>& skip_ids,
+                 uint64_t max_distance) {
+  size_t level_count = skip_ids[0].size();
+  for (const auto& ids : skip_ids) {
+    level_count = std::min(level_count, ids.size());
+  }
+  for (int level = static_cast<int>(level_count) - 1; level >= 0; --level) {
+    if ((1ull << level) > max_distance) {
+      continue;
+    }
+    std::set<storage::CommitId> ancestors;
+    bool distinct = true;
+    for (const auto& ids : skip_ids) {
+      if (!ancestors.insert(ids[level]).second) {
+        distinct = false;
+        break;
+      }
+    }
+    if (distinct) {
+      return level;
+    }
+  }
+  return -1;
+}
+
+// Retrieves the parents of the most recent commits in the given set, i.e. the
+// commits with the highest generation, and continues the recursion once they
+// are added to the set.
+void RetrieveParentsInGeneration(
+    const ftl::RefPtr<ftl::TaskRunner> task_runner,
+    storage::PageStorage* storage,
+    CommitSet* commits,
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
   // Pop the newest commits and retrieve their parents.
   uint64_t expected_generation = (*commits->rbegin())->GetGeneration();
   auto waiter = callback::
@@ -86,6 +137,98 @@ void FindCommonAncestorInGeneration(
   });
 }
 
+// Replaces the most recent commits in the given set, which all have a single
+// parent, by their ancestors at the highest power of two generations of
+// distance found by |GetSkipLevel|. Walking the linear history one generation
+// at a time would lead to the same set. Falls back to retrieving their parents
+// if no such ancestor is in the ancestry index.
+void SkipLinearHistory(
+    const ftl::RefPtr<ftl::TaskRunner> task_runner,
+    storage::PageStorage* storage,
+    CommitSet* commits,
+    uint64_t max_distance,
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
+  uint64_t newest_generation = (*commits->rbegin())->GetGeneration();
+  auto waiter = callback::
+      Waiter<storage::Status, std::vector<storage::CommitId>>::Create(
+          storage::Status::OK);
+  for (auto it = commits->rbegin();
+       it != commits->rend() && (*it)->GetGeneration() == newest_generation;
+       ++it) {
+    storage->GetSkipAncestorIds((*it)->GetId(), waiter->NewCallback());
+  }
+  waiter->Finalize([
+    task_runner, storage, commits, max_distance, callback = std::move(callback)
+  ](storage::Status status,
+    std::vector<std::vector<storage::CommitId>> skip_ids) mutable {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status), nullptr);
+      return;
+    }
+    int level = GetSkipLevel(skip_ids, max_distance);
+    if (level < 0) {
+      RetrieveParentsInGeneration(task_runner, storage, commits,
+                                  std::move(callback));
+      return;
+    }
+    // Pop the newest commits and retrieve their ancestors.
+    auto ancestor_waiter = callback::
+        Waiter<storage::Status, std::unique_ptr<const storage::Commit>>::Create(
+            storage::Status::OK);
+    for (const auto& ids : skip_ids) {
+      auto it = commits->end();
+      --it;
+      commits->erase(it);
+      storage->GetCommit(ids[level], ancestor_waiter->NewCallback());
+    }
+    ancestor_waiter->Finalize([
+      task_runner, storage, commits, callback = std::move(callback)
+    ](storage::Status status,
+      std::vector<std::unique_ptr<const storage::Commit>> ancestors) mutable {
+      if (status != storage::Status::OK) {
+        callback(PageUtils::ConvertStatus(status), nullptr);
+        return;
+      }
+      for (auto& ancestor : ancestors) {
+        commits->insert(std::move(ancestor));
+      }
+      task_runner->PostTask(
+          [ task_runner, storage, commits, callback = std::move(callback) ] {
+            FindCommonAncestorInGeneration(task_runner, storage, commits,
+                                           std::move(callback));
+          });
+    });
+  });
+}
+
+// Recursively replaces the most recent commits in the given set, i.e. the
+// commits with the highest generation, by their ancestors. The recursion stops
+// when only one commit is left in the set, which is the lowest common ancestor.
+void FindCommonAncestorInGeneration(
+    const ftl::RefPtr<ftl::TaskRunner> task_runner,
+    storage::PageStorage* storage,
+    CommitSet* commits,
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
+  FTL_DCHECK(!commits->empty());
+  // If there is only one commit in the set it is the lowest common ancestor.
+  if (commits->size() == 1) {
+    callback(Status::OK,
+             std::move(const_cast<std::unique_ptr<const storage::Commit>&>(
+                 *commits->rbegin())));
+    return;
+  }
+  uint64_t max_distance;
+  if (HasLinearHistory(*commits, &max_distance)) {
+    SkipLinearHistory(task_runner, storage, commits, max_distance,
+                      std::move(callback));
+    return;
+  }
+  RetrieveParentsInGeneration(task_runner, storage, commits,
+                              std::move(callback));
+}
+
 }  // namespace
 
 void FindCommonAncestor(
@@ -101,11 +244,12 @@ void FindCommonAncestor(
   // and replace it by its parent. If we seed the initial set with two commits,
   // we get their unique lowest common ancestor.
   // At each step of the recursion (FindCommonAncestorInGeneration) we request
-  // the parent commits of all commits with the same generation.
+  // the parent commits of all commits with the same generation. When all these
+  // commits have a single parent, we use the ancestry index of the storage to
+  // skip whole ranges of generations at once.
 
   // commits set should not be deleted before the callback is executed.
-  auto commits = std::make_unique<
-      std::set<std::unique_ptr<const storage::Commit>, GenerationComparator>>();
+  auto commits = std::make_unique<CommitSet>();
 
   commits->emplace(std::move(head1));
   commits->emplace(std::move(head2));
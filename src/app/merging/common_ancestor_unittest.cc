@@ -216,5 +216,85 @@ TEST_F(CommonAncestorTest, LongChain) {
   EXPECT_EQ(storage::kFirstPageCommitId, result->GetId());
 }
 
+// In this test the commits have the following structure:
+//            (root)
+//              |
+//             (C)
+//            /   \
+//          (A)   (B)
+//           |     |
+//          ...   ...
+//           |     |
+//         (A50)  (B30)
+// The common ancestor is found by skipping through the linear histories of the
+// two branches.
+TEST_F(CommonAncestorTest, DivergedLinearBranches) {
+  std::unique_ptr<const storage::Commit> commit_c = CreateCommit(
+      storage::kFirstPageCommitId, AddKeyValueToJournal("key", "c"));
+  storage::CommitId commit_c_id = commit_c->GetId();
+
+  std::unique_ptr<const storage::Commit> last_a = commit_c->Clone();
+  for (int i = 0; i < 50; i++) {
+    last_a = CreateCommit(last_a->GetId(),
+                          AddKeyValueToJournal(std::to_string(i), "a"));
+  }
+  std::unique_ptr<const storage::Commit> last_b = std::move(commit_c);
+  for (int i = 0; i < 30; i++) {
+    last_b = CreateCommit(last_b->GetId(),
+                          AddKeyValueToJournal(std::to_string(i), "b"));
+  }
+
+  Status status;
+  std::unique_ptr<const storage::Commit> result;
+  FindCommonAncestor(message_loop_.task_runner(), storage_.get(),
+                     std::move(last_a), std::move(last_b),
+                     callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                       &status, &result));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(commit_c_id, result->GetId());
+}
+
+// In this test the commits have the following structure:
+//            (root)
+//              /  \
+//            (A)  (B)
+//             |  /  |
+//           (merge) |
+//             |     |
+//            ...   ...
+//             |     |
+//           (M20) (B20)
+// The linear histories end at (merge), whose parents are (A) and (B).
+TEST_F(CommonAncestorTest, LinearBranchesAfterMerge) {
+  std::unique_ptr<const storage::Commit> commit_a = CreateCommit(
+      storage::kFirstPageCommitId, AddKeyValueToJournal("key", "a"));
+  std::unique_ptr<const storage::Commit> commit_b = CreateCommit(
+      storage::kFirstPageCommitId, AddKeyValueToJournal("key", "b"));
+  storage::CommitId commit_b_id = commit_b->GetId();
+
+  std::unique_ptr<const storage::Commit> last_merge = CreateMergeCommit(
+      commit_a->GetId(), commit_b->GetId(), AddKeyValueToJournal("key", "m"));
+  for (int i = 0; i < 20; i++) {
+    last_merge = CreateCommit(last_merge->GetId(),
+                              AddKeyValueToJournal(std::to_string(i), "m"));
+  }
+  std::unique_ptr<const storage::Commit> last_b = std::move(commit_b);
+  for (int i = 0; i < 20; i++) {
+    last_b = CreateCommit(last_b->GetId(),
+                          AddKeyValueToJournal(std::to_string(i), "b"));
+  }
+
+  Status status;
+  std::unique_ptr<const storage::Commit> result;
+  FindCommonAncestor(message_loop_.task_runner(), storage_.get(),
+                     std::move(last_merge), std::move(last_b),
+                     callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                       &status, &result));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(commit_b_id, result->GetId());
+}
+
 }  // namespace
 }  // namespace ledger
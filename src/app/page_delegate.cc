@@ -22,13 +22,22 @@ namespace ledger {
 PageDelegate::PageDelegate(coroutine::CoroutineService* coroutine_service,
                            PageManager* manager,
                            storage::PageStorage* storage,
-                           fidl::InterfaceRequest<Page> request)
+                           fidl::InterfaceRequest<Page> request,
+                           ftl::RefPtr<ftl::TaskRunner> task_runner,
+                           ImplicitCommitOptions implicit_commit_options)
     : manager_(manager),
       storage_(storage),
       interface_(std::move(request), this),
-      branch_tracker_(coroutine_service, manager, storage) {
+      branch_tracker_(coroutine_service, manager, storage),
+      task_runner_(std::move(task_runner)),
+      implicit_commit_options_(implicit_commit_options),
+      weak_factory_(this) {
   interface_.set_on_empty([this] {
-    branch_tracker_.StopTransaction(nullptr);
+    // A pending implicit journal still stops the transaction of the branch
+    // tracker once committed.
+    if (!implicit_journal_) {
+      branch_tracker_.StopTransaction(nullptr);
+    }
     CheckEmpty();
   });
   branch_tracker_.set_on_empty([this] { CheckEmpty(); });
@@ -175,16 +184,21 @@ void PageDelegate::StartTransaction(
           callback(Status::TRANSACTION_ALREADY_IN_PROGRESS);
           return;
         }
-        storage::CommitId commit_id = branch_tracker_.GetBranchHeadId();
-        storage::Status status = storage_->StartCommit(
-            commit_id, storage::JournalType::EXPLICIT, &journal_);
-        if (status != storage::Status::OK) {
-          callback(PageUtils::ConvertStatus(status));
-          return;
-        }
-        journal_parent_commit_ = commit_id;
-        branch_tracker_.StartTransaction([callback = std::move(callback)]() {
-          callback(Status::OK);
+        // The changes made before the transaction are committed first, so that
+        // the transaction is based on them. Their own callbacks report the
+        // result of this commit.
+        CommitImplicitJournal([ this, callback = std::move(callback) ](
+            Status implicit_commit_status) {
+          storage::CommitId commit_id = branch_tracker_.GetBranchHeadId();
+          storage::Status status = storage_->StartCommit(
+              commit_id, storage::JournalType::EXPLICIT, &journal_);
+          if (status != storage::Status::OK) {
+            callback(PageUtils::ConvertStatus(status));
+            return;
+          }
+          journal_parent_commit_ = commit_id;
+          branch_tracker_.StartTransaction(
+              [callback = std::move(callback)]() { callback(Status::OK); });
         });
       });
 }
@@ -249,48 +263,106 @@ void PageDelegate::PutInCommit(fidl::Array<uint8_t> key,
 void PageDelegate::RunInTransaction(
     std::function<Status(storage::Journal* journal)> runnable,
     std::function<void(Status)> callback) {
+  // |callback| is called by the operation itself: changes made outside of a
+  // transaction must not block the following operations until they are
+  // committed.
   operation_serializer_.Serialize(
-      std::move(callback),
-      [ this, runnable = std::move(runnable) ](StatusCallback callback) {
+      [](Status status) {},
+      [ this, runnable = std::move(runnable),
+        callback = std::move(callback) ](StatusCallback serializer_callback) {
         if (journal_) {
           // A transaction is in progress; add this change to it.
-          callback(runnable(journal_.get()));
+          Status status = runnable(journal_.get());
+          callback(status);
+          serializer_callback(status);
           return;
         }
-        // No transaction is in progress; create one just for this change.
-        // TODO(etiennej): Add a change batching strategy for operations outside
-        // transactions. Currently, we create a commit for every change; we
-        // would like to group changes that happen "close enough" together in
-        // one commit.
-        branch_tracker_.StartTransaction([] {});
-        storage::CommitId commit_id = branch_tracker_.GetBranchHeadId();
-        std::unique_ptr<storage::Journal> journal;
-        storage::Status status = storage_->StartCommit(
-            commit_id, storage::JournalType::IMPLICIT, &journal);
-        if (status != storage::Status::OK) {
-          callback(PageUtils::ConvertStatus(status));
-          journal->Rollback();
-          branch_tracker_.StopTransaction(nullptr);
-          return;
+        // No transaction is in progress; add this change to the implicit
+        // journal grouping the changes made outside of transactions, creating
+        // it if needed.
+        if (!implicit_journal_) {
+          branch_tracker_.StartTransaction([] {});
+          storage::CommitId commit_id = branch_tracker_.GetBranchHeadId();
+          storage::Status status = storage_->StartCommit(
+              commit_id, storage::JournalType::IMPLICIT, &implicit_journal_);
+          if (status != storage::Status::OK) {
+            implicit_journal_.reset();
+            branch_tracker_.StopTransaction(nullptr);
+            callback(PageUtils::ConvertStatus(status));
+            serializer_callback(PageUtils::ConvertStatus(status));
+            return;
+          }
+          ScheduleImplicitCommit();
         }
-        Status ledger_status = runnable(journal.get());
+        Status ledger_status = runnable(implicit_journal_.get());
         if (ledger_status != Status::OK) {
+          if (implicit_journal_callbacks_.empty()) {
+            implicit_journal_->Rollback();
+            implicit_journal_.reset();
+            branch_tracker_.StopTransaction(nullptr);
+          }
           callback(ledger_status);
-          journal->Rollback();
-          branch_tracker_.StopTransaction(nullptr);
+          serializer_callback(ledger_status);
           return;
         }
 
-        CommitJournal(std::move(journal), [
-          this, callback = std::move(callback)
-        ](Status status, std::unique_ptr<const storage::Commit> commit) {
-          branch_tracker_.StopTransaction(
-              status == Status::OK ? std::move(commit) : nullptr);
-          callback(status);
-        });
+        implicit_journal_callbacks_.push_back(callback);
+        if (implicit_journal_callbacks_.size() >=
+            implicit_commit_options_.max_pending_changes) {
+          CommitImplicitJournal(std::move(serializer_callback));
+          return;
+        }
+        serializer_callback(Status::OK);
       });
 }
 
+void PageDelegate::CommitImplicitJournal(StatusCallback callback) {
+  if (!implicit_journal_) {
+    callback(Status::OK);
+    return;
+  }
+  std::vector<StatusCallback> change_callbacks;
+  change_callbacks.swap(implicit_journal_callbacks_);
+  CommitJournal(std::move(implicit_journal_), [
+    this, change_callbacks = std::move(change_callbacks),
+    callback = std::move(callback)
+  ](Status status, std::unique_ptr<const storage::Commit> commit) {
+    branch_tracker_.StopTransaction(status == Status::OK ? std::move(commit)
+                                                         : nullptr);
+    for (const auto& change_callback : change_callbacks) {
+      change_callback(status);
+    }
+    callback(status);
+  });
+}
+
+void PageDelegate::ScheduleImplicitCommit() {
+  if (implicit_commit_scheduled_) {
+    return;
+  }
+  // A scheduled commit is not cancelled by an early one: changes never wait
+  // more than |max_delay|.
+  implicit_commit_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      [ this, weak_this = weak_factory_.GetWeakPtr() ] {
+        if (!weak_this) {
+          return;
+        }
+        implicit_commit_scheduled_ = false;
+        operation_serializer_.Serialize(
+            [](Status status) {}, [this](StatusCallback callback) {
+              CommitImplicitJournal([ this, callback = std::move(callback) ](
+                  Status status) {
+                callback(status);
+                // The page might have been waiting for this commit to be
+                // empty.
+                CheckEmpty();
+              });
+            });
+      },
+      implicit_commit_options_.max_delay);
+}
+
 void PageDelegate::CommitJournal(
     std::unique_ptr<storage::Journal> journal,
     std::function<void(Status, std::unique_ptr<const storage::Commit>)>
@@ -325,7 +397,7 @@ std::function<void(Status)> PageDelegate::TrackCallback(
 void PageDelegate::CheckEmpty() {
   if (on_empty_callback_ && !interface_.is_bound() &&
       branch_tracker_.IsEmpty() && operation_serializer_.empty() &&
-      !in_progress_storage_operations_) {
+      !implicit_journal_ && !in_progress_storage_operations_) {
     on_empty_callback_();
   }
 }
@@ -19,10 +19,23 @@
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace ledger {
 class PageManager;
 
+// Controls how the changes made outside of a transaction are grouped in
+// implicit commits. A group of changes is committed as soon as any of the
+// limits below is reached.
+struct ImplicitCommitOptions {
+  // Maximal time a change waits for other changes before being committed.
+  ftl::TimeDelta max_delay = ftl::TimeDelta::FromMilliseconds(5);
+  // Maximal number of changes grouped in a single commit.
+  size_t max_pending_changes = 64;
+};
+
 // A delegate for the implementation of the |Page| interface.
 //
 // PageDelegate owns PageImpl and BranchTracker. It makes sure that all
@@ -30,12 +43,19 @@ class PageManager;
 // connected. When the page connection is closed and BranchTracker is also
 // empty, the client is notified through |on_empty_callback| (registered by
 // |set_on_empty()|).
+//
+// Changes made outside of a transaction are not committed one by one: the
+// consecutive ones are grouped in a single implicit commit, following
+// |ImplicitCommitOptions|. The callback of each change is only called once the
+// commit containing it is done.
 class PageDelegate {
  public:
   PageDelegate(coroutine::CoroutineService* coroutine_service,
                PageManager* manager,
                storage::PageStorage* storage,
-               fidl::InterfaceRequest<Page> request);
+               fidl::InterfaceRequest<Page> request,
+               ftl::RefPtr<ftl::TaskRunner> task_runner,
+               ImplicitCommitOptions implicit_commit_options);
   ~PageDelegate();
 
   void set_on_empty(ftl::Closure on_empty_callback) {
@@ -87,8 +107,9 @@ class PageDelegate {
                    StatusCallback callback);
 
   // Run |runnable| in a transaction, and notifies |callback| of the result. If
-  // a transaction is currently in progress, reuses it, otherwise creates a new
-  // one and commit it before calling |callback|.
+  // a transaction is currently in progress, reuses it, otherwise adds the
+  // change to the pending implicit journal and calls |callback| once this
+  // journal is committed.
   void RunInTransaction(
       std::function<Status(storage::Journal* journal)> runnable,
       StatusCallback callback);
@@ -98,6 +119,14 @@ class PageDelegate {
       std::function<void(Status, std::unique_ptr<const storage::Commit>)>
           callback);
 
+  // Commits the pending implicit journal, if any, and calls the callbacks of
+  // the changes it contains before calling |callback|.
+  void CommitImplicitJournal(StatusCallback callback);
+
+  // Schedules the commit of the pending implicit journal, at most
+  // |implicit_commit_options_.max_delay| from now.
+  void ScheduleImplicitCommit();
+
   // Queue operations such that they are serialized: an operation is run only
   // when all previous operations registered through this method have terminated
   // by calling their callbacks. When |operation| terminates, |callback| is
@@ -132,6 +161,17 @@ class PageDelegate {
   // none in progress.
   int in_progress_storage_operations_ = 0;
 
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  const ImplicitCommitOptions implicit_commit_options_;
+  // Journal grouping the changes made outside of a transaction that are not
+  // yet committed, and the callbacks of these changes.
+  std::unique_ptr<storage::Journal> implicit_journal_;
+  std::vector<StatusCallback> implicit_journal_callbacks_;
+  bool implicit_commit_scheduled_ = false;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<PageDelegate> weak_factory_;
+
   FTL_DISALLOW_COPY_AND_ASSIGN(PageDelegate);
 };
 
@@ -8,6 +8,7 @@
 #include <memory>
 
 #include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/app/fidl/entries_buffer.h"
 #include "apps/ledger/src/app/fidl/serialization_size.h"
 #include "apps/ledger/src/app/merging/merge_resolver.h"
 #include "apps/ledger/src/app/page_manager.h"
@@ -47,6 +48,15 @@ class PageImplTest : public test::TestWithMessageLoop {
   // ApplicationTestBase:
   void SetUp() override {
     ::testing::Test::SetUp();
+    ResetPageManager(ImplicitCommitOptions());
+  }
+
+  // Replaces |manager_| and its storage by new ones, grouping the changes made
+  // outside of transactions following |options|, and binds |page_ptr_| to it.
+  void ResetPageManager(ImplicitCommitOptions options) {
+    page_ptr_ = PagePtr();
+    manager_.reset();
+
     page_id1_ = storage::PageId(kPageIdSize, 'a');
     auto fake_storage =
         std::make_unique<storage::fake::FakePageStorage>(page_id1_);
@@ -55,7 +65,8 @@ class PageImplTest : public test::TestWithMessageLoop {
         std::make_unique<MergeResolver>([] {}, &environment_, fake_storage_);
 
     manager_ = std::make_unique<PageManager>(
-        &environment_, std::move(fake_storage), nullptr, std::move(resolver));
+        &environment_, std::move(fake_storage), nullptr, std::move(resolver),
+        ftl::TimeDelta::FromSeconds(5), options);
     manager_->BindPage(page_ptr_.NewRequest());
   }
 
@@ -550,6 +561,262 @@ TEST_F(PageImplTest, PutGetSnapshotGetEntriesWithToken) {
   }
 }
 
+TEST_F(PageImplTest, PutGetSnapshotGetEntriesInBuffer) {
+  // More entries than fit in a single GetEntries() result.
+  int entry_count = 65;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  Status status;
+  mx::vmo buffer;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetEntriesInBuffer(
+      nullptr, nullptr,
+      ::callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                          &buffer, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(next_token.is_null());
+
+  std::string content = ToString(buffer);
+  std::vector<EntriesBufferEntry> entries;
+  ASSERT_TRUE(ReadEntriesBuffer(content, &entries));
+  ASSERT_EQ(static_cast<size_t>(entry_count), entries.size());
+  for (int i = 0; i < entry_count; ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04d", i), entries[i].key.ToString());
+    EXPECT_EQ(Priority::EAGER, entries[i].priority);
+    EXPECT_EQ(Status::OK, entries[i].value_status);
+    EXPECT_EQ(ftl::StringPrintf("val %04d", i), entries[i].value.ToString());
+  }
+}
+
+TEST_F(PageImplTest, PutGetSnapshotGetEntriesInRange) {
+  int entry_count = 20;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  Status status;
+  fidl::Array<EntryPtr> entries;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetEntriesInRange(
+      convert::ToArray("key 0005"), convert::ToArray("key 0010"), false,
+      nullptr, ::callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &entries, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(next_token.is_null());
+  ASSERT_EQ(5u, entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", i + 5),
+              convert::ToString(entries[i]->key));
+    EXPECT_EQ(ftl::StringPrintf("val %04zu", i + 5),
+              ToString(entries[i]->value));
+  }
+}
+
+TEST_F(PageImplTest, SnapshotCount) {
+  int entry_count = 20;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  Status status;
+  uint64_t count;
+  snapshot->Count(nullptr, nullptr,
+                  ::callback::Capture(postquit_callback, &status, &count));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(20u, count);
+
+  snapshot->Count(convert::ToArray("key 0005"), convert::ToArray("key 0012"),
+                  ::callback::Capture(postquit_callback, &status, &count));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(7u, count);
+}
+
+TEST_F(PageImplTest, SnapshotGetEntriesAtOffset) {
+  int entry_count = 20;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  Status status;
+  fidl::Array<EntryPtr> entries;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetEntriesAtOffset(
+      convert::ToArray("key 0005"), 10,
+      ::callback::Capture(postquit_callback, &status, &entries, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(next_token.is_null());
+  ASSERT_EQ(5u, entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", i + 15),
+              convert::ToString(entries[i]->key));
+    EXPECT_EQ(ftl::StringPrintf("val %04zu", i + 15),
+              ToString(entries[i]->value));
+  }
+
+  // An offset past the last entry returns no entries.
+  snapshot->GetEntriesAtOffset(
+      nullptr, 20,
+      ::callback::Capture(postquit_callback, &status, &entries, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(0u, entries.size());
+}
+
+TEST_F(PageImplTest, PutGetSnapshotGetKeysInRangeReverse) {
+  // More keys than fit in a single result.
+  int entry_count = 500;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  Status status;
+  fidl::Array<fidl::Array<uint8_t>> keys;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetKeysInRange(
+      nullptr, convert::ToArray("key 0450"), true, nullptr,
+      ::callback::Capture(postquit_callback, &status, &keys, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::PARTIAL_RESULT, status);
+  ASSERT_FALSE(next_token.is_null());
+
+  std::vector<std::string> all_keys;
+  for (const auto& key : keys) {
+    all_keys.push_back(convert::ToString(key));
+  }
+  while (status == Status::PARTIAL_RESULT) {
+    snapshot->GetKeysInRange(
+        nullptr, convert::ToArray("key 0450"), true, std::move(next_token),
+        ::callback::Capture(postquit_callback, &status, &keys, &next_token));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    for (const auto& key : keys) {
+      all_keys.push_back(convert::ToString(key));
+    }
+  }
+  EXPECT_EQ(Status::OK, status);
+
+  // Keys are returned from the end of the range to its start.
+  ASSERT_EQ(450u, all_keys.size());
+  for (size_t i = 0; i < all_keys.size(); ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", 449 - i), all_keys[i]);
+  }
+}
+
+TEST_F(PageImplTest, PutGetSnapshotGetKeysInBuffer) {
+  int entry_count = 65;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  Status status;
+  mx::vmo buffer;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetKeysInBuffer(
+      convert::ToArray("key 0010"), nullptr,
+      ::callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                          &buffer, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(next_token.is_null());
+
+  std::string content = ToString(buffer);
+  std::vector<EntriesBufferEntry> entries;
+  ASSERT_TRUE(ReadEntriesBuffer(content, &entries));
+  ASSERT_EQ(static_cast<size_t>(entry_count - 10), entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", i + 10),
+              entries[i].key.ToString());
+    EXPECT_TRUE(entries[i].value.empty());
+  }
+}
+
+TEST_F(PageImplTest, PutGetSnapshotGetKeysInBufferPartialResult) {
+  // More entries than fit in a single buffer.
+  int entry_count = kMaxEntriesBufferCount + 10;
+  AddEntries(entry_count);
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  Status status;
+  mx::vmo buffer;
+  fidl::Array<uint8_t> next_token;
+  snapshot->GetKeysInBuffer(
+      nullptr, nullptr,
+      ::callback::Capture(postquit_callback, &status, &buffer, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::PARTIAL_RESULT, status);
+  ASSERT_FALSE(next_token.is_null());
+
+  std::string content = ToString(buffer);
+  std::vector<EntriesBufferEntry> entries;
+  ASSERT_TRUE(ReadEntriesBuffer(content, &entries));
+  EXPECT_EQ(kMaxEntriesBufferCount, entries.size());
+
+  snapshot->GetKeysInBuffer(
+      nullptr, std::move(next_token),
+      ::callback::Capture(postquit_callback, &status, &buffer, &next_token));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(next_token.is_null());
+
+  content = ToString(buffer);
+  ASSERT_TRUE(ReadEntriesBuffer(content, &entries));
+  ASSERT_EQ(10u, entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", i + kMaxEntriesBufferCount),
+              entries[i].key.ToString());
+  }
+}
+
+TEST_F(PageImplTest, PutGetSnapshotGetEntriesInBufferBoundedSize) {
+  // Each value takes more than half of a buffer.
+  std::vector<std::string> values;
+  for (char c : {'a', 'b', 'c'}) {
+    values.push_back(std::string(kMaxEntriesBufferSize / 2 + 1, c));
+  }
+  auto callback_statusok = [this](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    message_loop_.PostQuitTask();
+  };
+  for (size_t i = 0; i < values.size(); ++i) {
+    ReferencePtr reference = Reference::New();
+    reference->opaque_id = convert::ToArray(AddObjectToStorage(values[i]));
+    page_ptr_->PutReference(
+        convert::ToArray(ftl::StringPrintf("key %04zu", i)),
+        std::move(reference), Priority::EAGER, callback_statusok);
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  // Each buffer holds a single entry.
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  Status status = Status::PARTIAL_RESULT;
+  fidl::Array<uint8_t> next_token;
+  size_t buffer_count = 0;
+  while (status == Status::PARTIAL_RESULT) {
+    mx::vmo buffer;
+    snapshot->GetEntriesInBuffer(
+        nullptr, std::move(next_token),
+        ::callback::Capture(postquit_callback, &status, &buffer, &next_token));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    ASSERT_LT(buffer_count, values.size());
+
+    std::string content = ToString(buffer);
+    std::vector<EntriesBufferEntry> entries;
+    ASSERT_TRUE(ReadEntriesBuffer(content, &entries));
+    ASSERT_EQ(1u, entries.size());
+    EXPECT_EQ(ftl::StringPrintf("key %04zu", buffer_count),
+              entries[0].key.ToString());
+    EXPECT_EQ(values[buffer_count], entries[0].value.ToString());
+    ++buffer_count;
+  }
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(values.size(), buffer_count);
+}
+
 TEST_F(PageImplTest, PutGetSnapshotGetEntriesWithFetch) {
   std::string eager_key("a_key");
   std::string eager_value("an eager value");
@@ -948,6 +1215,59 @@ TEST_F(PageImplTest, SnapshotGetNeedsFetch) {
   EXPECT_EQ(Status::NEEDS_FETCH, status);
 }
 
+TEST_F(PageImplTest, SnapshotGetMany) {
+  std::string eager_key("eager_key");
+  std::string eager_value("an eager value");
+  std::string lazy_key("lazy_key");
+  std::string lazy_value("a lazy value");
+
+  Status status;
+  auto postquit_callback = [this] { message_loop_.PostQuitTask(); };
+  page_ptr_->Put(convert::ToArray(eager_key), convert::ToArray(eager_value),
+                 ::callback::Capture(postquit_callback, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  page_ptr_->PutWithPriority(convert::ToArray(lazy_key),
+                             convert::ToArray(lazy_value), Priority::LAZY,
+                             ::callback::Capture(postquit_callback, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  for (const auto& object : fake_storage_->GetObjects()) {
+    if (object.second == lazy_value) {
+      fake_storage_->DeleteObjectFromLocal(object.first);
+      break;
+    }
+  }
+
+  PageSnapshotPtr snapshot = GetSnapshot();
+
+  fidl::Array<fidl::Array<uint8_t>> keys =
+      fidl::Array<fidl::Array<uint8_t>>::New(0);
+  keys.push_back(convert::ToArray(lazy_key));
+  keys.push_back(convert::ToArray(eager_key));
+  keys.push_back(convert::ToArray("missing_key"));
+  keys.push_back(convert::ToArray(eager_key));
+  fidl::Array<ValueInBufferPtr> values;
+  mx::vmo buffer;
+  snapshot->GetMany(std::move(keys), ::callback::Capture(postquit_callback,
+                                                         &status, &values,
+                                                         &buffer));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_EQ(4u, values.size());
+  EXPECT_EQ(Status::NEEDS_FETCH, values[0]->status);
+  EXPECT_EQ(Status::KEY_NOT_FOUND, values[2]->status);
+
+  // The value requested twice is only written once in the buffer.
+  std::string content = ToString(buffer);
+  EXPECT_EQ(eager_value, content);
+  for (size_t i : {1u, 3u}) {
+    EXPECT_EQ(Status::OK, values[i]->status);
+    EXPECT_EQ(eager_value, content.substr(values[i]->offset, values[i]->size));
+  }
+}
+
 TEST_F(PageImplTest, SnapshotFetchPartial) {
   std::string key("some_key");
   std::string value("a small value");
@@ -1047,6 +1367,10 @@ TEST_F(PageImplTest, ParallelPut) {
 }
 
 TEST_F(PageImplTest, SerializedOperations) {
+  ImplicitCommitOptions options;
+  options.max_delay = ftl::TimeDelta::FromSeconds(60);
+  options.max_pending_changes = 3;
+  ResetPageManager(options);
   fake_storage_->set_autocommit(false);
 
   std::string key("some_key");
@@ -1069,16 +1393,16 @@ TEST_F(PageImplTest, SerializedOperations) {
                  callback_simple);
   page_ptr_->Commit(callback_simple);
 
-  // 3 first operations need to be serialized and blocked on commits.
-  for (size_t i = 0; i < 3; ++i) {
-    // Callbacks are blocked until operation commits.
-    EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
+  // 3 first operations are grouped in a single commit.
+  // Callbacks are blocked until this commit is done.
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
 
-    // The commit queue contains the new commit.
-    ASSERT_EQ(i + 1, fake_storage_->GetJournals().size());
-    CommitFirstPendingJournal(fake_storage_->GetJournals());
+  // The commit queue contains the new commit.
+  ASSERT_EQ(1u, fake_storage_->GetJournals().size());
+  CommitFirstPendingJournal(fake_storage_->GetJournals());
 
-    // The operation can now succeed.
+  // The operations can now succeed.
+  for (size_t i = 0; i < 3; ++i) {
     EXPECT_FALSE(RunLoopWithTimeout());
   }
 
@@ -1096,5 +1420,42 @@ TEST_F(PageImplTest, SerializedOperations) {
   EXPECT_FALSE(RunLoopWithTimeout());
 }
 
+TEST_F(PageImplTest, GroupedImplicitChanges) {
+  ImplicitCommitOptions options;
+  options.max_delay = ftl::TimeDelta::FromMilliseconds(50);
+  ResetPageManager(options);
+
+  int callback_count = 0;
+  auto callback = [this, &callback_count](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    // Changes are only acknowledged once they are committed.
+    const std::map<std::string,
+                   std::unique_ptr<storage::fake::FakeJournalDelegate>>&
+        journals = fake_storage_->GetJournals();
+    EXPECT_EQ(1u, journals.size());
+    EXPECT_TRUE(journals.begin()->second->IsCommitted());
+    if (++callback_count == 3) {
+      message_loop_.PostQuitTask();
+    }
+  };
+  page_ptr_->Put(convert::ToArray("key1"), convert::ToArray("value1"),
+                 callback);
+  page_ptr_->Put(convert::ToArray("key2"), convert::ToArray("value2"),
+                 callback);
+  page_ptr_->Delete(convert::ToArray("key3"), callback);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(3, callback_count);
+
+  const std::map<std::string,
+                 std::unique_ptr<storage::fake::FakeJournalDelegate>>&
+      journals = fake_storage_->GetJournals();
+  ASSERT_EQ(1u, journals.size());
+  const auto& data = journals.begin()->second->GetData();
+  EXPECT_EQ(3u, data.size());
+  EXPECT_FALSE(data.at("key1").deleted);
+  EXPECT_FALSE(data.at("key2").deleted);
+  EXPECT_TRUE(data.at("key3").deleted);
+}
+
 }  // namespace
 }  // namespace ledger
@@ -16,12 +16,14 @@ PageManager::PageManager(
     std::unique_ptr<storage::PageStorage> page_storage,
     std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context,
     std::unique_ptr<MergeResolver> merge_resolver,
-    ftl::TimeDelta sync_timeout)
+    ftl::TimeDelta sync_timeout,
+    ImplicitCommitOptions implicit_commit_options)
     : environment_(environment),
       page_storage_(std::move(page_storage)),
       page_sync_context_(std::move(page_sync_context)),
       merge_resolver_(std::move(merge_resolver)),
       sync_timeout_(sync_timeout),
+      implicit_commit_options_(implicit_commit_options),
       weak_factory_(this) {
   pages_.set_on_empty([this] { CheckEmpty(); });
   snapshots_.set_on_empty([this] { CheckEmpty(); });
@@ -55,7 +57,8 @@ PageManager::~PageManager() {}
 void PageManager::BindPage(fidl::InterfaceRequest<Page> page_request) {
   if (sync_backlog_downloaded_) {
     pages_.emplace(environment_->coroutine_service(), this, page_storage_.get(),
-                   std::move(page_request));
+                   std::move(page_request), environment_->main_runner(),
+                   implicit_commit_options_);
   } else {
     page_requests_.push_back(std::move(page_request));
   }
@@ -40,7 +40,9 @@ class PageManager {
               std::unique_ptr<storage::PageStorage> page_storage,
               std::unique_ptr<cloud_sync::PageSyncContext> page_sync,
               std::unique_ptr<MergeResolver> merge_resolver,
-              ftl::TimeDelta sync_timeout = ftl::TimeDelta::FromSeconds(5));
+              ftl::TimeDelta sync_timeout = ftl::TimeDelta::FromSeconds(5),
+              ImplicitCommitOptions implicit_commit_options =
+                  ImplicitCommitOptions());
   ~PageManager();
 
   // Creates a new PageImpl managed by this PageManager, and binds it to the
@@ -66,6 +68,7 @@ class PageManager {
   std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context_;
   std::unique_ptr<MergeResolver> merge_resolver_;
   const ftl::TimeDelta sync_timeout_;
+  const ImplicitCommitOptions implicit_commit_options_;
   callback::AutoCleanableSet<BoundInterface<PageSnapshot, PageSnapshotImpl>>
       snapshots_;
   callback::AutoCleanableSet<PageDelegate> pages_;
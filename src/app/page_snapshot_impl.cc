@@ -10,6 +10,7 @@
 
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 
+#include "apps/ledger/src/app/fidl/entries_buffer.h"
 #include "apps/ledger/src/app/fidl/serialization_size.h"
 #include "apps/ledger/src/app/page_utils.h"
 #include "apps/ledger/src/callback/trace_callback.h"
@@ -24,15 +25,51 @@
 namespace ledger {
 namespace {
 
+// Returns the smallest key that is greater than all the keys starting with
+// |prefix|, or an empty string if there is no such key.
+std::string GetPrefixEnd(std::string prefix) {
+  while (!prefix.empty() && static_cast<uint8_t>(prefix.back()) == 0xff) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) {
+    prefix.back() = static_cast<char>(static_cast<uint8_t>(prefix.back()) + 1);
+  }
+  return prefix;
+}
+
+Priority ConvertPriority(storage::KeyPriority priority) {
+  return priority == storage::KeyPriority::EAGER ? Priority::EAGER
+                                                 : Priority::LAZY;
+}
+
 EntryPtr CreateEntry(const storage::Entry& entry) {
   EntryPtr entry_ptr = Entry::New();
   entry_ptr->key = convert::ToArray(entry.key);
-  entry_ptr->priority = entry.priority == storage::KeyPriority::EAGER
-                            ? Priority::EAGER
-                            : Priority::LAZY;
+  entry_ptr->priority = ConvertPriority(entry.priority);
   return entry_ptr;
 }
 
+// Retrieves the value of |entry| if it is available locally. A |LAZY| value
+// that is not available is not an error: |callback| is then called with |OK|
+// and a null object.
+void GetLocalValue(
+    storage::PageStorage* page_storage,
+    const storage::Entry& entry,
+    std::function<void(storage::Status,
+                       std::unique_ptr<const storage::Object>)> callback) {
+  page_storage->GetObject(
+      entry.object_id, storage::PageStorage::Location::LOCAL, [
+        priority = entry.priority, callback = std::move(callback)
+      ](storage::Status status, std::unique_ptr<const storage::Object> object) {
+        if (status == storage::Status::NOT_FOUND &&
+            priority == storage::KeyPriority::LAZY) {
+          callback(storage::Status::OK, nullptr);
+        } else {
+          callback(status, std::move(object));
+        }
+      });
+}
+
 }  // namespace
 
 PageSnapshotImpl::PageSnapshotImpl(
@@ -48,6 +85,282 @@ PageSnapshotImpl::~PageSnapshotImpl() {}
 void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
                                   fidl::Array<uint8_t> token,
                                   const GetEntriesCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get_entries");
+  GetEntriesInternal(convert::ToString(key_start), "", false, std::move(token),
+                     std::move(timed_callback));
+}
+
+void PageSnapshotImpl::GetEntriesInRange(
+    fidl::Array<uint8_t> key_start,
+    fidl::Array<uint8_t> key_end,
+    bool reverse,
+    fidl::Array<uint8_t> token,
+    const GetEntriesInRangeCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_entries_in_range");
+  GetEntriesInternal(convert::ToString(key_start), convert::ToString(key_end),
+                     reverse, std::move(token), std::move(timed_callback));
+}
+
+void PageSnapshotImpl::Count(fidl::Array<uint8_t> key_start,
+                             fidl::Array<uint8_t> key_end,
+                             const CountCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_count");
+  std::string min_key = convert::ToString(key_start);
+  std::string max_key = convert::ToString(key_end);
+  RestrictToPrefix(&min_key, &max_key);
+  page_storage_->CountCommitContents(
+      *commit_, std::move(min_key), std::move(max_key),
+      [callback = std::move(timed_callback)](storage::Status status,
+                                             uint64_t count) {
+        callback(PageUtils::ConvertStatus(status), count);
+      });
+}
+
+void PageSnapshotImpl::GetEntriesAtOffset(
+    fidl::Array<uint8_t> key_start,
+    uint64_t offset,
+    const GetEntriesAtOffsetCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_entries_at_offset");
+  std::string min_key = convert::ToString(key_start);
+  std::string max_key;
+  RestrictToPrefix(&min_key, &max_key);
+
+  // The position of the first requested entry is the number of entries before
+  // |min_key|, plus |offset|.
+  auto get_entries = [ this, offset, callback = std::move(timed_callback) ](
+      storage::Status status, uint64_t start_index) {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status), nullptr, nullptr);
+      return;
+    }
+    page_storage_->GetEntryAtIndexFromCommit(
+        *commit_, start_index + offset,
+        [ this, callback = std::move(callback) ](storage::Status status,
+                                                 storage::Entry entry) {
+          if (status == storage::Status::NOT_FOUND ||
+              (status == storage::Status::OK &&
+               !PageUtils::MatchesPrefix(entry.key, key_prefix_))) {
+            callback(Status::OK, fidl::Array<EntryPtr>::New(0), nullptr);
+            return;
+          }
+          if (status != storage::Status::OK) {
+            callback(PageUtils::ConvertStatus(status), nullptr, nullptr);
+            return;
+          }
+          GetEntriesInternal(std::move(entry.key), "", false, nullptr,
+                             std::move(callback));
+        });
+  };
+  if (min_key.empty()) {
+    get_entries(storage::Status::OK, 0);
+    return;
+  }
+  page_storage_->CountCommitContents(*commit_, "", std::move(min_key),
+                                     std::move(get_entries));
+}
+
+void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
+                               fidl::Array<uint8_t> token,
+                               const GetKeysCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get_keys");
+  GetKeysInternal(convert::ToString(key_start), "", false, std::move(token),
+                  std::move(timed_callback));
+}
+
+void PageSnapshotImpl::GetKeysInRange(fidl::Array<uint8_t> key_start,
+                                      fidl::Array<uint8_t> key_end,
+                                      bool reverse,
+                                      fidl::Array<uint8_t> token,
+                                      const GetKeysInRangeCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_keys_in_range");
+  GetKeysInternal(convert::ToString(key_start), convert::ToString(key_end),
+                  reverse, std::move(token), std::move(timed_callback));
+}
+
+void PageSnapshotImpl::GetEntriesInBuffer(
+    fidl::Array<uint8_t> key_start,
+    fidl::Array<uint8_t> token,
+    const GetEntriesInBufferCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_entries_in_buffer");
+  FillEntriesBuffer(convert::ToString(key_start), std::move(token), true,
+                    std::move(timed_callback));
+}
+
+void PageSnapshotImpl::GetKeysInBuffer(
+    fidl::Array<uint8_t> key_start,
+    fidl::Array<uint8_t> token,
+    const GetKeysInBufferCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_keys_in_buffer");
+  FillEntriesBuffer(convert::ToString(key_start), std::move(token), false,
+                    std::move(timed_callback));
+}
+
+void PageSnapshotImpl::Get(fidl::Array<uint8_t> key,
+                           const GetCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get");
+
+  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
+    this, callback = std::move(timed_callback)
+  ](storage::Status status, storage::Entry entry) {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
+               mx::vmo());
+      return;
+    }
+    PageUtils::GetPartialReferenceAsBuffer(
+        page_storage_, entry.object_id, 0u, std::numeric_limits<int64_t>::max(),
+        storage::PageStorage::Location::LOCAL, Status::NEEDS_FETCH,
+        std::move(callback));
+  });
+}
+
+void PageSnapshotImpl::GetMany(fidl::Array<fidl::Array<uint8_t>> keys,
+                               const GetManyCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get_many");
+
+  // Storage expects sorted keys without duplicates.
+  std::vector<std::string> sorted_keys;
+  sorted_keys.reserve(keys.size());
+  for (const auto& key : keys) {
+    sorted_keys.push_back(convert::ToString(key));
+  }
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()),
+                    sorted_keys.end());
+
+  page_storage_->GetEntriesFromCommit(*commit_, std::move(sorted_keys),
+                                      ftl::MakeCopyable([
+    this, keys = std::move(keys), callback = std::move(timed_callback)
+  ](storage::Status status, std::vector<storage::Entry> entries) mutable {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status), nullptr, mx::vmo());
+      return;
+    }
+    auto waiter = callback::
+        Waiter<storage::Status, std::unique_ptr<const storage::Object>>::Create(
+            storage::Status::OK);
+    for (const storage::Entry& entry : entries) {
+      GetLocalValue(page_storage_, entry, waiter->NewCallback());
+    }
+    waiter->Finalize(ftl::MakeCopyable([
+      keys = std::move(keys), entries = std::move(entries),
+      callback = std::move(callback)
+    ](storage::Status status,
+      std::vector<std::unique_ptr<const storage::Object>> objects) {
+      if (status != storage::Status::OK) {
+        FTL_LOG(ERROR) << "Error while reading.";
+        callback(PageUtils::ConvertStatus(status), nullptr, mx::vmo());
+        return;
+      }
+      FTL_DCHECK(entries.size() == objects.size());
+
+      // Each value is written once in the buffer, even if its key is requested
+      // several times.
+      std::string buffer;
+      std::vector<ValueInBufferPtr> locations;
+      for (size_t i = 0; i < objects.size(); ++i) {
+        locations.push_back(ValueInBuffer::New());
+        if (!objects[i]) {
+          locations[i]->status = Status::NEEDS_FETCH;
+          continue;
+        }
+        ftl::StringView data;
+        if (objects[i]->GetData(&data) != storage::Status::OK) {
+          callback(Status::IO_ERROR, nullptr, mx::vmo());
+          return;
+        }
+        locations[i]->status = Status::OK;
+        locations[i]->offset = buffer.size();
+        locations[i]->size = data.size();
+        buffer.append(data.data(), data.size());
+      }
+
+      fidl::Array<ValueInBufferPtr> values =
+          fidl::Array<ValueInBufferPtr>::New(keys.size());
+      for (size_t i = 0; i < keys.size(); ++i) {
+        auto it = std::lower_bound(
+            entries.begin(), entries.end(), keys[i],
+            [](const storage::Entry& entry, const fidl::Array<uint8_t>& key) {
+              return entry.key < convert::ToString(key);
+            });
+        if (it == entries.end() || it->key != convert::ToString(keys[i])) {
+          values[i] = ValueInBuffer::New();
+          values[i]->status = Status::KEY_NOT_FOUND;
+          continue;
+        }
+        values[i] = locations[it - entries.begin()].Clone();
+      }
+
+      mx::vmo vmo;
+      if (!mtl::VmoFromString(buffer, &vmo)) {
+        callback(Status::IO_ERROR, nullptr, mx::vmo());
+        return;
+      }
+      callback(Status::OK, std::move(values), std::move(vmo));
+    }));
+  }));
+}
+
+void PageSnapshotImpl::Fetch(fidl::Array<uint8_t> key,
+                             const FetchCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_fetch");
+
+  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
+    this, callback = std::move(timed_callback)
+  ](storage::Status status, storage::Entry entry) {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
+               mx::vmo());
+      return;
+    }
+    PageUtils::GetPartialReferenceAsBuffer(
+        page_storage_, entry.object_id, 0u, std::numeric_limits<int64_t>::max(),
+        storage::PageStorage::Location::NETWORK, Status::INTERNAL_ERROR,
+        std::move(callback));
+  });
+}
+
+void PageSnapshotImpl::FetchPartial(fidl::Array<uint8_t> key,
+                                    int64_t offset,
+                                    int64_t max_size,
+                                    const FetchPartialCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_fetch_partial");
+
+  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
+    this, offset, max_size, callback = std::move(timed_callback)
+  ](storage::Status status, storage::Entry entry) {
+    if (status != storage::Status::OK) {
+      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
+               mx::vmo());
+      return;
+    }
+
+    PageUtils::GetPartialReferenceAsBuffer(
+        page_storage_, entry.object_id, offset, max_size,
+        storage::PageStorage::Location::NETWORK, Status::INTERNAL_ERROR,
+        callback);
+  });
+}
+
+void PageSnapshotImpl::GetEntriesInternal(
+    std::string key_start,
+    std::string key_end,
+    bool reverse,
+    fidl::Array<uint8_t> token,
+    std::function<void(Status, fidl::Array<EntryPtr>, fidl::Array<uint8_t>)>
+        callback) {
   // |token| represents the first key to be returned in the list of entries.
   // Initially, all entries starting from |token| are requested from storage.
   // Iteration stops if either all entries were found, or if the serialization
@@ -64,18 +377,12 @@ void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
     // have the value of the following entry's key.
     std::string next_token = "";
   };
-  auto timed_callback =
-      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get_entries");
 
   auto waiter = callback::
       Waiter<storage::Status, std::unique_ptr<const storage::Object>>::Create(
           storage::Status::OK);
 
   auto context = std::make_unique<Context>();
-  // Use |token| for the first key if present.
-  std::string start = token
-                          ? convert::ToString(token)
-                          : std::max(key_prefix_, convert::ToString(key_start));
   auto on_next = ftl::MakeCopyable([ this, context = context.get(),
                                      waiter ](storage::Entry entry) {
     if (!PageUtils::MatchesPrefix(entry.key, key_prefix_)) {
@@ -88,29 +395,22 @@ void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
       return false;
     }
     context->entries.push_back(CreateEntry(entry));
-    page_storage_->GetObject(
-        entry.object_id, storage::PageStorage::Location::LOCAL,
-        [ priority = entry.priority, waiter_callback = waiter->NewCallback() ](
-            storage::Status status,
-            std::unique_ptr<const storage::Object> object) {
-          if (status == storage::Status::NOT_FOUND &&
-              priority == storage::KeyPriority::LAZY) {
-            waiter_callback(storage::Status::OK, nullptr);
-          } else {
-            waiter_callback(status, std::move(object));
-          }
-        });
+    GetLocalValue(page_storage_, entry, waiter->NewCallback());
     return true;
   });
 
   auto on_done = ftl::MakeCopyable([
-    waiter, context = std::move(context), callback = std::move(timed_callback)
-  ](storage::Status status) mutable {
+    this, waiter, context = std::move(context), callback = std::move(callback)
+  ](storage::Status status,
+    std::unique_ptr<storage::PageStorage::ContentsCursor> cursor) mutable {
     if (status != storage::Status::OK) {
       FTL_LOG(ERROR) << "Error while reading.";
       callback(Status::IO_ERROR, nullptr, nullptr);
       return;
     }
+    if (cursor && !context->next_token.empty()) {
+      cursor_pool_.Put(context->next_token, std::move(cursor));
+    }
     std::function<void(storage::Status,
                        std::vector<std::unique_ptr<const storage::Object>>)>
         result_callback = ftl::MakeCopyable([
@@ -132,18 +432,13 @@ void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
               // Here, we just leave the value part of the entry null.
               continue;
             }
-            ftl::StringView object_contents;
-            storage::Status read_status = results[i]->GetData(&object_contents);
+            EntryPtr& entry_ptr = context->entries[i];
+            storage::Status read_status =
+                results[i]->GetVmo(&entry_ptr->value);
             if (read_status != storage::Status::OK) {
               callback(Status::IO_ERROR, nullptr, nullptr);
               return;
             }
-
-            EntryPtr& entry_ptr = context->entries[i];
-            if (!mtl::VmoFromString(object_contents, &entry_ptr->value)) {
-              callback(Status::INTERNAL_ERROR, nullptr, nullptr);
-              return;
-            }
           }
           if (!context->next_token.empty()) {
             callback(Status::PARTIAL_RESULT, std::move(context->entries),
@@ -154,13 +449,18 @@ void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
         });
     waiter->Finalize(result_callback);
   });
-  page_storage_->GetCommitContents(*commit_, std::move(start),
-                                   std::move(on_next), std::move(on_done));
+  IterateEntries(std::move(key_start), std::move(key_end), reverse,
+                 std::move(token), std::move(on_next), std::move(on_done));
 }
 
-void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
-                               fidl::Array<uint8_t> token,
-                               const GetKeysCallback& callback) {
+void PageSnapshotImpl::GetKeysInternal(
+    std::string key_start,
+    std::string key_end,
+    bool reverse,
+    fidl::Array<uint8_t> token,
+    std::function<void(Status,
+                       fidl::Array<fidl::Array<uint8_t>>,
+                       fidl::Array<uint8_t>)> callback) {
   // Represents the information that needs to be shared between on_next and
   // on_done callbacks.
   struct Context {
@@ -174,9 +474,6 @@ void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
     std::string next_token = "";
   };
 
-  auto timed_callback =
-      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get_keys");
-
   auto context = std::make_unique<Context>();
   auto on_next = ftl::MakeCopyable(
       [ this, context = context.get() ](storage::Entry entry) {
@@ -192,87 +489,187 @@ void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
         return true;
       });
   auto on_done = ftl::MakeCopyable([
-    context = std::move(context), callback = std::move(timed_callback)
-  ](storage::Status s) {
+    this, context = std::move(context), callback = std::move(callback)
+  ](storage::Status s,
+    std::unique_ptr<storage::PageStorage::ContentsCursor> cursor) {
     if (context->next_token.empty()) {
       callback(Status::OK, std::move(context->keys), nullptr);
     } else {
+      if (cursor) {
+        cursor_pool_.Put(context->next_token, std::move(cursor));
+      }
       callback(Status::PARTIAL_RESULT, std::move(context->keys),
                convert::ToArray(context->next_token));
     }
   });
-  if (token.is_null()) {
-    page_storage_->GetCommitContents(
-        *commit_, std::max(convert::ToString(key_start), key_prefix_),
-        std::move(on_next), std::move(on_done));
-
-  } else {
-    page_storage_->GetCommitContents(*commit_, convert::ToString(token),
-                                     std::move(on_next), std::move(on_done));
+  IterateEntries(std::move(key_start), std::move(key_end), reverse,
+                 std::move(token), std::move(on_next), std::move(on_done));
+}
+
+void PageSnapshotImpl::RestrictToPrefix(std::string* key_start,
+                                        std::string* key_end) const {
+  *key_start = std::max(*key_start, key_prefix_);
+  std::string prefix_end = GetPrefixEnd(key_prefix_);
+  if (!prefix_end.empty() && (key_end->empty() || prefix_end < *key_end)) {
+    *key_end = std::move(prefix_end);
   }
 }
 
-void PageSnapshotImpl::Get(fidl::Array<uint8_t> key,
-                           const GetCallback& callback) {
-  auto timed_callback =
-      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_get");
+void PageSnapshotImpl::IterateEntries(
+    std::string key_start,
+    std::string key_end,
+    bool reverse,
+    fidl::Array<uint8_t> token,
+    std::function<bool(storage::Entry)> on_next,
+    std::function<void(storage::Status,
+                       std::unique_ptr<storage::PageStorage::ContentsCursor>)>
+        on_done) {
+  RestrictToPrefix(&key_start, &key_end);
 
-  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
-    this, callback = std::move(timed_callback)
-  ](storage::Status status, storage::Entry entry) {
-    if (status != storage::Status::OK) {
-      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
-               mx::vmo());
-      return;
+  if (reverse) {
+    // |token| is the greatest key still to be returned.
+    if (token) {
+      key_end = convert::ToString(token);
+      key_end.push_back('\0');
     }
-    PageUtils::GetPartialReferenceAsBuffer(
-        page_storage_, entry.object_id, 0u, std::numeric_limits<int64_t>::max(),
-        storage::PageStorage::Location::LOCAL, Status::NEEDS_FETCH,
-        std::move(callback));
-  });
+    page_storage_->GetCommitContentsReverse(
+        *commit_, std::move(key_start), std::move(key_end), std::move(on_next),
+        [on_done = std::move(on_done)](storage::Status status) {
+          on_done(status, nullptr);
+        });
+    return;
+  }
+
+  // |token| is the smallest key still to be returned. Resume the previous page
+  // of results if its cursor is still available.
+  std::unique_ptr<storage::PageStorage::ContentsCursor> cursor;
+  if (token) {
+    key_start = convert::ToString(token);
+    cursor = cursor_pool_.Take(key_start);
+  }
+  if (!key_end.empty()) {
+    // Keys are visited in increasing order: stopping on the first key after
+    // the range skips all the following subtrees.
+    on_next = [ key_end = std::move(key_end),
+                on_next = std::move(on_next) ](storage::Entry entry) {
+      if (entry.key >= key_end) {
+        return false;
+      }
+      return on_next(std::move(entry));
+    };
+  }
+  page_storage_->GetCommitContentsFromCursor(
+      *commit_, std::move(key_start), std::move(cursor), std::move(on_next),
+      std::move(on_done));
 }
 
-void PageSnapshotImpl::Fetch(fidl::Array<uint8_t> key,
-                             const FetchCallback& callback) {
-  auto timed_callback =
-      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_fetch");
+void PageSnapshotImpl::FillEntriesBuffer(
+    std::string key_start,
+    fidl::Array<uint8_t> token,
+    bool include_values,
+    std::function<void(Status, mx::vmo, fidl::Array<uint8_t>)> callback) {
+  // Represents information shared between on_next and on_done callbacks.
+  struct Context {
+    std::vector<storage::Entry> entries;
+    // The size of the buffer holding the keys of |entries|. The size of the
+    // values is only known once they are read.
+    size_t size = 0;
+    // If the buffer is full, |next_token| holds the key of the following
+    // entry.
+    std::string next_token;
+  };
 
-  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
-    this, callback = std::move(timed_callback)
-  ](storage::Status status, storage::Entry entry) {
-    if (status != storage::Status::OK) {
-      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
-               mx::vmo());
-      return;
-    }
-    PageUtils::GetPartialReferenceAsBuffer(
-        page_storage_, entry.object_id, 0u, std::numeric_limits<int64_t>::max(),
-        storage::PageStorage::Location::NETWORK, Status::INTERNAL_ERROR,
-        std::move(callback));
-  });
-}
+  auto waiter = callback::
+      Waiter<storage::Status, std::unique_ptr<const storage::Object>>::Create(
+          storage::Status::OK);
+  auto context = std::make_unique<Context>();
 
-void PageSnapshotImpl::FetchPartial(fidl::Array<uint8_t> key,
-                                    int64_t offset,
-                                    int64_t max_size,
-                                    const FetchPartialCallback& callback) {
-  auto timed_callback =
-      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_fetch_partial");
+  auto on_next = [ this, include_values, context = context.get(),
+                   waiter ](storage::Entry entry) {
+    if (!PageUtils::MatchesPrefix(entry.key, key_prefix_)) {
+      return false;
+    }
+    size_t entry_size = GetEntriesBufferEntrySize(entry.key.size(), 0);
+    if (!context->entries.empty() &&
+        (context->entries.size() == kMaxEntriesBufferCount ||
+         context->size + entry_size > kMaxEntriesBufferSize)) {
+      context->next_token = std::move(entry.key);
+      return false;
+    }
+    context->size += entry_size;
+    if (include_values) {
+      GetLocalValue(page_storage_, entry, waiter->NewCallback());
+    }
+    context->entries.push_back(std::move(entry));
+    return true;
+  };
 
-  page_storage_->GetEntryFromCommit(*commit_, convert::ToString(key), [
-    this, offset, max_size, callback = std::move(timed_callback)
-  ](storage::Status status, storage::Entry entry) {
+  auto on_done = ftl::MakeCopyable([
+    this, waiter, include_values, context = std::move(context),
+    callback = std::move(callback)
+  ](storage::Status status,
+    std::unique_ptr<storage::PageStorage::ContentsCursor> cursor) mutable {
     if (status != storage::Status::OK) {
-      callback(PageUtils::ConvertStatus(status, Status::KEY_NOT_FOUND),
-               mx::vmo());
+      FTL_LOG(ERROR) << "Error while reading.";
+      callback(Status::IO_ERROR, mx::vmo(), nullptr);
       return;
     }
+    if (cursor && !context->next_token.empty()) {
+      cursor_pool_.Put(context->next_token, std::move(cursor));
+    }
+    waiter->Finalize(ftl::MakeCopyable([
+      include_values, context = std::move(context),
+      callback = std::move(callback)
+    ](storage::Status status,
+      std::vector<std::unique_ptr<const storage::Object>> objects) mutable {
+      if (status != storage::Status::OK) {
+        FTL_LOG(ERROR) << "Error while reading.";
+        callback(Status::IO_ERROR, mx::vmo(), nullptr);
+        return;
+      }
+      const std::vector<storage::Entry>& entries = context->entries;
+      FTL_DCHECK(!include_values || objects.size() == entries.size());
 
-    PageUtils::GetPartialReferenceAsBuffer(
-        page_storage_, entry.object_id, offset, max_size,
-        storage::PageStorage::Location::NETWORK, Status::INTERNAL_ERROR,
-        callback);
+      EntriesBufferWriter writer;
+      for (size_t i = 0; i < entries.size(); ++i) {
+        const storage::Entry& entry = entries[i];
+        Status value_status = Status::OK;
+        ftl::StringView value;
+        if (include_values) {
+          if (!objects[i]) {
+            value_status = Status::NEEDS_FETCH;
+          } else if (objects[i]->GetData(&value) != storage::Status::OK) {
+            callback(Status::IO_ERROR, mx::vmo(), nullptr);
+            return;
+          }
+        }
+        if (i > 0 &&
+            writer.size() + GetEntriesBufferEntrySize(
+                                entry.key.size(), value.size()) >
+                kMaxEntriesBufferSize) {
+          // The values do not fit: the next buffer starts at this entry.
+          context->next_token = entry.key;
+          break;
+        }
+        writer.AddEntry(entry.key, ConvertPriority(entry.priority),
+                        value_status, value);
+      }
+      mx::vmo buffer;
+      if (!writer.ToVmo(&buffer)) {
+        callback(Status::IO_ERROR, mx::vmo(), nullptr);
+        return;
+      }
+      if (context->next_token.empty()) {
+        callback(Status::OK, std::move(buffer), nullptr);
+        return;
+      }
+      callback(Status::PARTIAL_RESULT, std::move(buffer),
+               convert::ToArray(context->next_token));
+    }));
   });
+
+  IterateEntries(std::move(key_start), "", false, std::move(token),
+                 std::move(on_next), std::move(on_done));
 }
 
 }  // namespace ledger
@@ -5,9 +5,12 @@
 #ifndef APPS_LEDGER_SRC_APP_PAGE_SNAPSHOT_IMPL_H_
 #define APPS_LEDGER_SRC_APP_PAGE_SNAPSHOT_IMPL_H_
 
+#include <functional>
 #include <memory>
+#include <string>
 
 #include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/cursor_pool.h"
 #include "apps/ledger/src/storage/public/commit.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "lib/ftl/tasks/task_runner.h"
@@ -26,19 +29,94 @@ class PageSnapshotImpl : public PageSnapshot {
   void GetEntries(fidl::Array<uint8_t> key_start,
                   fidl::Array<uint8_t> token,
                   const GetEntriesCallback& callback) override;
+  void GetEntriesInRange(fidl::Array<uint8_t> key_start,
+                         fidl::Array<uint8_t> key_end,
+                         bool reverse,
+                         fidl::Array<uint8_t> token,
+                         const GetEntriesInRangeCallback& callback) override;
+  void Count(fidl::Array<uint8_t> key_start,
+             fidl::Array<uint8_t> key_end,
+             const CountCallback& callback) override;
+  void GetEntriesAtOffset(fidl::Array<uint8_t> key_start,
+                          uint64_t offset,
+                          const GetEntriesAtOffsetCallback& callback) override;
   void GetKeys(fidl::Array<uint8_t> key_start,
                fidl::Array<uint8_t> token,
                const GetKeysCallback& callback) override;
+  void GetKeysInRange(fidl::Array<uint8_t> key_start,
+                      fidl::Array<uint8_t> key_end,
+                      bool reverse,
+                      fidl::Array<uint8_t> token,
+                      const GetKeysInRangeCallback& callback) override;
+  void GetEntriesInBuffer(fidl::Array<uint8_t> key_start,
+                          fidl::Array<uint8_t> token,
+                          const GetEntriesInBufferCallback& callback) override;
+  void GetKeysInBuffer(fidl::Array<uint8_t> key_start,
+                       fidl::Array<uint8_t> token,
+                       const GetKeysInBufferCallback& callback) override;
   void Get(fidl::Array<uint8_t> key, const GetCallback& callback) override;
+  void GetMany(fidl::Array<fidl::Array<uint8_t>> keys,
+               const GetManyCallback& callback) override;
   void Fetch(fidl::Array<uint8_t> key, const FetchCallback& callback) override;
   void FetchPartial(fidl::Array<uint8_t> key,
                     int64_t offset,
                     int64_t max_size,
                     const FetchPartialCallback& callback) override;
 
+  // Implementations of GetEntriesInRange() and GetKeysInRange(). An empty
+  // |key_end| means that the range has no upper bound.
+  void GetEntriesInternal(
+      std::string key_start,
+      std::string key_end,
+      bool reverse,
+      fidl::Array<uint8_t> token,
+      std::function<void(Status, fidl::Array<EntryPtr>, fidl::Array<uint8_t>)>
+          callback);
+  void GetKeysInternal(std::string key_start,
+                       std::string key_end,
+                       bool reverse,
+                       fidl::Array<uint8_t> token,
+                       std::function<void(Status,
+                                          fidl::Array<fidl::Array<uint8_t>>,
+                                          fidl::Array<uint8_t>)> callback);
+
+  // Restricts [|key_start|, |key_end|) to the keys starting with the prefix of
+  // this snapshot. An empty |key_end| means that the range has no upper bound.
+  void RestrictToPrefix(std::string* key_start, std::string* key_end) const;
+
+  // Iterates over the entries of this snapshot with keys in [|key_start|,
+  // |key_end|), in decreasing order of keys if |reverse| is true. If |token| is
+  // not null, the iteration resumes from the key it holds. Forward iterations
+  // resume from the cursor of |token| if it is still in |cursor_pool_|, and
+  // return a cursor on the entry where |on_next| interrupted them.
+  void IterateEntries(
+      std::string key_start,
+      std::string key_end,
+      bool reverse,
+      fidl::Array<uint8_t> token,
+      std::function<bool(storage::Entry)> on_next,
+      std::function<void(storage::Status,
+                         std::unique_ptr<storage::PageStorage::ContentsCursor>)>
+          on_done);
+
+  // Returns the entries with keys starting from |key_start|, or from |token|
+  // if not null, and matching the prefix of this snapshot, packed in a single
+  // buffer. Values are only added to the buffer if |include_values| is true.
+  // The buffer is bounded by |kMaxEntriesBufferCount| entries and
+  // |kMaxEntriesBufferSize| bytes: if more entries remain, the status is
+  // |PARTIAL_RESULT| and the returned token is the key of the next entry.
+  void FillEntriesBuffer(
+      std::string key_start,
+      fidl::Array<uint8_t> token,
+      bool include_values,
+      std::function<void(Status, mx::vmo, fidl::Array<uint8_t>)> callback);
+
   storage::PageStorage* page_storage_;
   std::unique_ptr<const storage::Commit> commit_;
   const std::string key_prefix_;
+  // Cursors of the iterations interrupted by GetEntries() and GetKeys(), keyed
+  // by the returned continuation token.
+  CursorPool cursor_pool_;
 };
 
 }  // namespace ledger
@@ -5,6 +5,7 @@
 #include "apps/ledger/src/app/page_utils.h"
 
 #include <memory>
+#include <string>
 
 #include "apps/ledger/src/app/constants.h"
 #include "apps/ledger/src/storage/public/object.h"
@@ -14,50 +15,39 @@
 
 namespace ledger {
 namespace {
-Status ToBuffer(convert::ExtendedStringView value,
+Status ToBuffer(const storage::Object& object,
                 int64_t offset,
                 int64_t max_size,
                 mx::vmo* buffer) {
-  size_t start = value.size();
+  uint64_t size;
+  storage::Status status = object.GetSize(&size);
+  if (status != storage::Status::OK) {
+    return PageUtils::ConvertStatus(status);
+  }
+  uint64_t start = size;
   // Valid indices are between -N and N-1.
-  if (offset >= -static_cast<int64_t>(value.size()) &&
-      offset < static_cast<int64_t>(value.size())) {
-    start = offset < 0 ? value.size() + offset : offset;
+  if (offset >= -static_cast<int64_t>(size) &&
+      offset < static_cast<int64_t>(size)) {
+    start = offset < 0 ? size + offset : offset;
   }
-  size_t length = max_size < 0 ? value.size() : max_size;
+  uint64_t length = max_size < 0 ? size : max_size;
 
-  bool result = mtl::VmoFromString(value.substr(start, length), buffer);
+  if (start == 0 && length >= size) {
+    // The whole value is requested: the object can provide its own vmo
+    // without copying the data again.
+    status = object.GetVmo(buffer);
+    return status == storage::Status::OK ? Status::OK : Status::UNKNOWN_ERROR;
+  }
+  // Only read the requested range.
+  std::string data;
+  status = object.ReadData(start, length, &data);
+  if (status != storage::Status::OK) {
+    return PageUtils::ConvertStatus(status);
+  }
+  bool result = mtl::VmoFromString(data, buffer);
   return result ? Status::OK : Status::UNKNOWN_ERROR;
 }
 
-void GetReferenceAsStringView(
-    storage::PageStorage* storage,
-    convert::ExtendedStringView opaque_id,
-    storage::PageStorage::Location location,
-    Status not_found_status,
-    std::function<void(Status, ftl::StringView)> callback) {
-  storage->GetObject(
-      opaque_id, location,
-      [not_found_status, callback](
-          storage::Status status,
-          std::unique_ptr<const storage::Object> object) {
-        if (status != storage::Status::OK) {
-          callback(PageUtils::ConvertStatus(status, not_found_status),
-                   ftl::StringView());
-          return;
-        }
-        ftl::StringView data;
-        status = object->GetData(&data);
-        if (status != storage::Status::OK) {
-          callback(PageUtils::ConvertStatus(status, not_found_status),
-                   ftl::StringView());
-          return;
-        }
-
-        callback(Status::OK, data);
-      });
-}
-
 }  // namespace
 
 Status PageUtils::ConvertStatus(storage::Status status,
@@ -87,15 +77,18 @@ void PageUtils::GetPartialReferenceAsBuffer(
     storage::PageStorage::Location location,
     Status not_found_status,
     std::function<void(Status, mx::vmo)> callback) {
-  GetReferenceAsStringView(
-      storage, reference_id, location, not_found_status,
-      [offset, max_size, callback](Status status, ftl::StringView data) {
-        if (status != Status::OK) {
-          callback(status, mx::vmo());
+  storage->GetObject(
+      reference_id, location,
+      [offset, max_size, not_found_status, callback](
+          storage::Status status,
+          std::unique_ptr<const storage::Object> object) {
+        if (status != storage::Status::OK) {
+          callback(PageUtils::ConvertStatus(status, not_found_status),
+                   mx::vmo());
           return;
         }
         mx::vmo buffer;
-        Status buffer_status = ToBuffer(data, offset, max_size, &buffer);
+        Status buffer_status = ToBuffer(*object, offset, max_size, &buffer);
         if (buffer_status != Status::OK) {
           callback(buffer_status, mx::vmo());
           return;
@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/callback/worker_pool.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace callback {
+
+WorkerPool::WorkerPool(size_t thread_count) {
+  FTL_DCHECK(thread_count > 0);
+  threads_.resize(thread_count);
+  task_runners_.resize(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_[i] = mtl::CreateThread(&task_runners_[i], "worker thread");
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  for (const auto& task_runner : task_runners_) {
+    task_runner->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::PostTaskAndReply(ftl::Closure task, ftl::Closure reply) {
+  mtl::MessageLoop* message_loop = mtl::MessageLoop::GetCurrent();
+  FTL_DCHECK(message_loop);
+  ftl::RefPtr<ftl::TaskRunner> reply_runner = message_loop->task_runner();
+
+  ftl::RefPtr<ftl::TaskRunner>& task_runner = task_runners_[next_runner_];
+  next_runner_ = (next_runner_ + 1) % task_runners_.size();
+  task_runner->PostTask([
+    task = std::move(task), reply = std::move(reply),
+    reply_runner = std::move(reply_runner)
+  ] {
+    task();
+    reply_runner->PostTask(std::move(reply));
+  });
+}
+
+}  // namespace callback
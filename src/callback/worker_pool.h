@@ -0,0 +1,44 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CALLBACK_WORKER_POOL_H_
+#define APPS_LEDGER_SRC_CALLBACK_WORKER_POOL_H_
+
+#include <thread>
+#include <vector>
+
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace callback {
+
+// A fixed set of threads running CPU-bound tasks, such as encoding or hashing,
+// away from the thread posting them. Tasks are distributed over the threads
+// in a round-robin fashion. Tasks still pending when the pool is deleted are
+// not run.
+class WorkerPool {
+ public:
+  explicit WorkerPool(size_t thread_count);
+  ~WorkerPool();
+
+  size_t thread_count() const { return task_runners_.size(); }
+
+  // Runs |task| on one of the threads of the pool, then |reply| on the message
+  // loop of the calling thread. |reply| is not run if this message loop is
+  // deleted before |task| completes.
+  void PostTaskAndReply(ftl::Closure task, ftl::Closure reply);
+
+ private:
+  std::vector<std::thread> threads_;
+  std::vector<ftl::RefPtr<ftl::TaskRunner>> task_runners_;
+  size_t next_runner_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace callback
+
+#endif  // APPS_LEDGER_SRC_CALLBACK_WORKER_POOL_H_
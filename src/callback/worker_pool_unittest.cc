@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/callback/worker_pool.h"
+
+#include <thread>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace callback {
+namespace {
+
+using WorkerPoolTest = test::TestWithMessageLoop;
+
+TEST_F(WorkerPoolTest, RunTasksAndReplies) {
+  WorkerPool worker_pool(3);
+  EXPECT_EQ(3u, worker_pool.thread_count());
+
+  std::thread::id main_thread_id = std::this_thread::get_id();
+  const size_t kTaskCount = 10;
+  std::vector<int> results(kTaskCount, 0);
+  std::vector<std::thread::id> task_thread_ids(kTaskCount);
+  size_t reply_count = 0;
+  for (size_t i = 0; i < kTaskCount; ++i) {
+    worker_pool.PostTaskAndReply(
+        [&results, &task_thread_ids, i] {
+          results[i] = i * i;
+          task_thread_ids[i] = std::this_thread::get_id();
+        },
+        [this, &reply_count, main_thread_id] {
+          EXPECT_EQ(main_thread_id, std::this_thread::get_id());
+          if (++reply_count == kTaskCount) {
+            message_loop_.PostQuitTask();
+          }
+        });
+  }
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(kTaskCount, reply_count);
+  for (size_t i = 0; i < kTaskCount; ++i) {
+    EXPECT_EQ(static_cast<int>(i * i), results[i]);
+    EXPECT_NE(main_thread_id, task_thread_ids[i]);
+  }
+  // Consecutive tasks are run on different threads.
+  EXPECT_NE(task_thread_ids[0], task_thread_ids[1]);
+  EXPECT_EQ(task_thread_ids[0], task_thread_ids[3]);
+}
+
+}  // namespace
+}  // namespace callback
@@ -7,7 +7,6 @@
 #include "apps/ledger/src/cloud_provider/public/commit.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
 #include "lib/ftl/logging.h"
-#include "lib/mtl/vmo/strings.h"
 
 namespace cloud_sync {
 
@@ -60,15 +59,9 @@ void CommitUpload::Start() {
 }
 
 void CommitUpload::UploadObject(std::unique_ptr<const storage::Object> object) {
-  ftl::StringView data_view;
-  auto status = object->GetData(&data_view);
-  FTL_DCHECK(status == storage::Status::OK);
-
-  // TODO(ppi): get the virtual memory object directly from storage::Object,
-  // once it can give us one.
   mx::vmo data;
-  auto result = mtl::VmoFromString(data_view, &data);
-  FTL_DCHECK(result);
+  auto status = object->GetVmo(&data);
+  FTL_DCHECK(status == storage::Status::OK);
 
   storage::ObjectId id = object->GetId();
   cloud_provider_->AddObject(object->GetId(), std::move(data), [
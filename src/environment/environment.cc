@@ -4,6 +4,8 @@
 
 #include "apps/ledger/src/environment/environment.h"
 
+#include <algorithm>
+
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "lib/mtl/tasks/message_loop.h"
 #include "lib/mtl/threading/create_thread.h"
@@ -36,4 +38,12 @@ const ftl::RefPtr<ftl::TaskRunner> Environment::GetIORunner() {
   return io_runner_;
 }
 
+callback::WorkerPool* Environment::GetWorkerPool() {
+  if (!worker_pool_) {
+    worker_pool_ = std::make_unique<callback::WorkerPool>(
+        std::max(1u, std::thread::hardware_concurrency()));
+  }
+  return worker_pool_.get();
+}
+
 }  // namespace ledger
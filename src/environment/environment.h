@@ -5,8 +5,10 @@
 #ifndef APPS_LEDGER_SRC_ENVIRONMENT_ENVIRONMENT_H_
 #define APPS_LEDGER_SRC_ENVIRONMENT_ENVIRONMENT_H_
 
+#include <memory>
 #include <thread>
 
+#include "apps/ledger/src/callback/worker_pool.h"
 #include "apps/ledger/src/coroutine/coroutine.h"
 #include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
@@ -36,6 +38,11 @@ class Environment {
   // should be used to access the file system.
   const ftl::RefPtr<ftl::TaskRunner> GetIORunner();
 
+  // Returns the pool of threads on which CPU-bound work, such as encoding and
+  // hashing tree nodes, should be run. The pool is created on first use, with
+  // one thread per core.
+  callback::WorkerPool* GetWorkerPool();
+
  private:
   ftl::RefPtr<ftl::TaskRunner> main_runner_;
   NetworkService* const network_service_;
@@ -45,6 +52,8 @@ class Environment {
   std::thread io_thread_;
   ftl::RefPtr<ftl::TaskRunner> io_runner_;
 
+  std::unique_ptr<callback::WorkerPool> worker_pool_;
+
   FTL_DISALLOW_COPY_AND_ASSIGN(Environment);
 };
 
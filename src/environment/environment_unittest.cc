@@ -35,5 +35,14 @@ TEST(Environment, DefaultIOThread) {
   EXPECT_EQ(1, value);
 }
 
+TEST(Environment, WorkerPool) {
+  mtl::MessageLoop loop;
+  Environment env(loop.task_runner(), nullptr, ftl::TimeDelta());
+  callback::WorkerPool* worker_pool = env.GetWorkerPool();
+  ASSERT_TRUE(worker_pool);
+  EXPECT_LE(1u, worker_pool->thread_count());
+  EXPECT_EQ(worker_pool, env.GetWorkerPool());
+}
+
 }  // namespace
 }  // namespace ledger
@@ -0,0 +1,84 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/glue/compression/compression.h"
+
+#include <string.h>
+
+#include "lib/ftl/logging.h"
+#include "third_party/zlib/zlib.h"
+
+namespace glue {
+
+namespace {
+
+constexpr uint8_t kZlibFormat = 1;
+
+struct Header {
+  uint8_t format;
+  uint8_t padding[3];
+  uint32_t size;
+};
+
+static_assert(sizeof(Header) == 8, "Unexpected Header size");
+
+const Bytef* ToBytes(ftl::StringView str) {
+  return reinterpret_cast<const Bytef*>(str.data());
+}
+
+Bytef* ToBytes(std::string& str) {
+  return reinterpret_cast<Bytef*>(&str[0]);
+}
+
+}  // namespace
+
+bool Compress(ftl::StringView input, std::string* output) {
+  if (input.size() > UINT32_MAX) {
+    return false;
+  }
+  Header header = {};
+  header.format = kZlibFormat;
+  header.size = input.size();
+
+  std::string tmp_output;
+  uLongf compressed_size = compressBound(input.size());
+  tmp_output.resize(sizeof(Header) + compressed_size);
+  memcpy(&tmp_output[0], &header, sizeof(Header));
+  // Speed matters more than ratio: objects are compressed on every write.
+  int result = compress2(ToBytes(tmp_output) + sizeof(Header),
+                         &compressed_size, ToBytes(input), input.size(),
+                         Z_BEST_SPEED);
+  if (result != Z_OK) {
+    FTL_LOG(ERROR) << "Unable to compress data: " << result;
+    return false;
+  }
+  tmp_output.resize(sizeof(Header) + compressed_size);
+  output->swap(tmp_output);
+  return true;
+}
+
+bool Decompress(ftl::StringView input, std::string* output) {
+  Header header;
+  if (input.size() < sizeof(Header)) {
+    return false;
+  }
+  memcpy(&header, input.data(), sizeof(Header));
+  if (header.format != kZlibFormat) {
+    return false;
+  }
+  input = input.substr(sizeof(Header));
+
+  std::string tmp_output;
+  tmp_output.resize(header.size);
+  uLongf size = header.size;
+  int result =
+      uncompress(ToBytes(tmp_output), &size, ToBytes(input), input.size());
+  if (result != Z_OK || size != header.size) {
+    return false;
+  }
+  output->swap(tmp_output);
+  return true;
+}
+
+}  // namespace glue
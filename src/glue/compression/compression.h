@@ -0,0 +1,24 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_GLUE_COMPRESSION_COMPRESSION_H_
+#define APPS_LEDGER_SRC_GLUE_COMPRESSION_COMPRESSION_H_
+
+#include <string>
+
+#include "lib/ftl/strings/string_view.h"
+
+namespace glue {
+
+// Compresses |input| into |output|. The result starts with a header holding
+// the size of |input|, and can only be read back with |Decompress()|.
+bool Compress(ftl::StringView input, std::string* output);
+
+// Decompresses in |output| data compressed by |Compress()|. Returns false if
+// |input| is not valid compressed data.
+bool Decompress(ftl::StringView input, std::string* output);
+
+}  // namespace glue
+
+#endif  // APPS_LEDGER_SRC_GLUE_COMPRESSION_COMPRESSION_H_
@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/glue/compression/compression.h"
+
+#include "gtest/gtest.h"
+
+namespace glue {
+namespace {
+
+TEST(Compression, CompressAndDecompress) {
+  std::string input;
+  for (int i = 0; i < 100; ++i) {
+    input.append("{\"name\": \"value\", \"index\": ");
+    input.append(std::to_string(i));
+    input.append("}");
+  }
+
+  std::string compressed;
+  ASSERT_TRUE(Compress(input, &compressed));
+  EXPECT_LT(compressed.size(), input.size() / 2);
+
+  std::string decompressed;
+  ASSERT_TRUE(Decompress(compressed, &decompressed));
+  EXPECT_EQ(input, decompressed);
+}
+
+TEST(Compression, EmptyInput) {
+  std::string compressed;
+  ASSERT_TRUE(Compress("", &compressed));
+  std::string decompressed = "not empty";
+  ASSERT_TRUE(Decompress(compressed, &decompressed));
+  EXPECT_EQ("", decompressed);
+}
+
+TEST(Compression, DecompressInvalidData) {
+  std::string compressed;
+  ASSERT_TRUE(Compress("some data to compress", &compressed));
+
+  std::string output;
+  EXPECT_FALSE(Decompress("", &output));
+  EXPECT_FALSE(
+      Decompress(compressed.substr(0, compressed.size() - 1), &output));
+  compressed[0] = 0;
+  EXPECT_FALSE(Decompress(compressed, &output));
+  EXPECT_EQ("", output);
+}
+
+}  // namespace
+}  // namespace glue
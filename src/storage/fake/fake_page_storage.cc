@@ -37,6 +37,15 @@ class FakeObject : public Object {
   std::string content_;
 };
 
+// The fake cursor only remembers the key of the entry to resume from.
+class FakeContentsCursor : public PageStorage::ContentsCursor {
+ public:
+  explicit FakeContentsCursor(std::string key) : key(std::move(key)) {}
+  ~FakeContentsCursor() override {}
+
+  const std::string key;
+};
+
 storage::ObjectId ComputeObjectId(ftl::StringView value) {
   return glue::SHA256Hash(value.data(), value.size());
 }
@@ -85,6 +94,13 @@ void FakePageStorage::GetCommit(
       ftl::TimeDelta::FromMilliseconds(5));
 }
 
+void FakePageStorage::GetSkipAncestorIds(
+    CommitIdView commit_id,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  // The fake storage keeps no ancestry index.
+  callback(Status::OK, std::vector<CommitId>());
+}
+
 Status FakePageStorage::StartCommit(const CommitId& commit_id,
                                     JournalType journal_type,
                                     std::unique_ptr<Journal>* journal) {
@@ -181,6 +197,60 @@ void FakePageStorage::GetCommitContents(const Commit& commit,
   on_done(Status::OK);
 }
 
+void FakePageStorage::GetCommitContentsReverse(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status)> on_done) {
+  // |GetCommitContents| is synchronous.
+  std::vector<Entry> entries;
+  Status status;
+  GetCommitContents(commit, std::move(min_key),
+                    [&max_key, &entries](Entry entry) {
+                      if (!max_key.empty() && entry.key >= max_key) {
+                        return false;
+                      }
+                      entries.push_back(std::move(entry));
+                      return true;
+                    },
+                    [&status](Status s) { status = s; });
+  if (status == Status::OK) {
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+      if (!on_next(std::move(*it))) {
+        break;
+      }
+    }
+  }
+  on_done(status);
+}
+
+void FakePageStorage::GetCommitContentsFromCursor(
+    const Commit& commit,
+    std::string min_key,
+    std::unique_ptr<ContentsCursor> cursor,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done) {
+  if (cursor) {
+    min_key = static_cast<const FakeContentsCursor*>(cursor.get())->key;
+  }
+  // |GetCommitContents| is synchronous.
+  std::unique_ptr<ContentsCursor> next_cursor;
+  Status status;
+  GetCommitContents(commit, std::move(min_key),
+                    [&on_next, &next_cursor](Entry entry) {
+                      std::string key = entry.key;
+                      if (on_next(std::move(entry))) {
+                        return true;
+                      }
+                      next_cursor =
+                          std::make_unique<FakeContentsCursor>(std::move(key));
+                      return false;
+                    },
+                    [&status](Status s) { status = s; });
+  on_done(status, std::move(next_cursor));
+}
+
 void FakePageStorage::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
@@ -200,6 +270,73 @@ void FakePageStorage::GetEntryFromCommit(
   callback(Status::OK, Entry{key, entry.value, entry.priority});
 }
 
+void FakePageStorage::GetEntriesFromCommit(
+    const Commit& commit,
+    std::vector<std::string> keys,
+    std::function<void(Status, std::vector<Entry>)> callback) {
+  FakeJournalDelegate* journal = journals_[commit.GetId()].get();
+  if (!journal) {
+    callback(Status::NOT_FOUND, std::vector<Entry>());
+    return;
+  }
+  const std::map<std::string, fake::FakeJournalDelegate::Entry,
+                 convert::StringViewComparator>& data = journal->GetData();
+  std::vector<Entry> entries;
+  for (std::string& key : keys) {
+    auto it = data.find(key);
+    if (it != data.end()) {
+      entries.push_back(
+          Entry{std::move(key), it->second.value, it->second.priority});
+    }
+  }
+  callback(Status::OK, std::move(entries));
+}
+
+void FakePageStorage::CountCommitContents(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<void(Status, uint64_t)> callback) {
+  // |GetCommitContents| is synchronous.
+  uint64_t count = 0;
+  Status status;
+  GetCommitContents(commit, std::move(min_key),
+                    [&max_key, &count](Entry entry) {
+                      if (!max_key.empty() && entry.key >= max_key) {
+                        return false;
+                      }
+                      ++count;
+                      return true;
+                    },
+                    [&status](Status s) { status = s; });
+  callback(status, status == Status::OK ? count : 0);
+}
+
+void FakePageStorage::GetEntryAtIndexFromCommit(
+    const Commit& commit,
+    uint64_t index,
+    std::function<void(Status, Entry)> callback) {
+  // |GetCommitContents| is synchronous.
+  Entry result;
+  bool found = false;
+  Status status;
+  GetCommitContents(commit, "",
+                    [&index, &result, &found](Entry entry) {
+                      if (index > 0) {
+                        --index;
+                        return true;
+                      }
+                      result = std::move(entry);
+                      found = true;
+                      return false;
+                    },
+                    [&status](Status s) { status = s; });
+  if (status == Status::OK && !found) {
+    status = Status::NOT_FOUND;
+  }
+  callback(status, std::move(result));
+}
+
 const std::map<std::string, std::unique_ptr<FakeJournalDelegate>>&
 FakePageStorage::GetJournals() const {
   return journals_;
@@ -31,6 +31,9 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
   void GetCommit(CommitIdView commit_id,
                  std::function<void(Status, std::unique_ptr<const Commit>)>
                      callback) override;
+  void GetSkipAncestorIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
   Status StartCommit(const CommitId& commit_id,
                      JournalType journal_type,
                      std::unique_ptr<Journal>* journal) override;
@@ -48,9 +51,34 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
                          std::string min_key,
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
+  void GetCommitContentsReverse(const Commit& commit,
+                                std::string min_key,
+                                std::string max_key,
+                                std::function<bool(Entry)> on_next,
+                                std::function<void(Status)> on_done) override;
+  void GetCommitContentsFromCursor(
+      const Commit& commit,
+      std::string min_key,
+      std::unique_ptr<ContentsCursor> cursor,
+      std::function<bool(Entry)> on_next,
+      std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done)
+      override;
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
+  void GetEntriesFromCommit(
+      const Commit& commit,
+      std::vector<std::string> keys,
+      std::function<void(Status, std::vector<Entry>)> callback) override;
+  void CountCommitContents(
+      const Commit& commit,
+      std::string min_key,
+      std::string max_key,
+      std::function<void(Status, uint64_t)> callback) override;
+  void GetEntryAtIndexFromCommit(
+      const Commit& commit,
+      uint64_t index,
+      std::function<void(Status, Entry)> callback) override;
 
   // For testing:
   void set_autocommit(bool autocommit) { autocommit_ = autocommit; }
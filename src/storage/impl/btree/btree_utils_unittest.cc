@@ -6,14 +6,18 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <map>
+#include <tuple>
 
 #include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/callback/worker_pool.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "apps/ledger/src/storage/fake/fake_page_storage.h"
 #include "apps/ledger/src/storage/impl/btree/builder.h"
 #include "apps/ledger/src/storage/impl/btree/diff.h"
 #include "apps/ledger/src/storage/impl/btree/entry_change_iterator.h"
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
+#include "apps/ledger/src/storage/impl/btree/lookup.h"
 #include "apps/ledger/src/storage/impl/btree/tree_node.h"
 #include "apps/ledger/src/storage/public/constants.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -57,10 +61,15 @@ class TrackGetObjectFakePageStorage : public fake::FakePageStorage {
       const std::function<void(Status, std::unique_ptr<const Object>)>&
           callback) override {
     object_requests.insert(object_id.ToString());
+    ++object_request_count;
     fake::FakePageStorage::GetObject(object_id, location, callback);
   }
 
+  callback::WorkerPool* GetWorkerPool() override { return worker_pool; }
+
   std::set<ObjectId> object_requests;
+  size_t object_request_count = 0;
+  callback::WorkerPool* worker_pool = nullptr;
 };
 
 class BTreeUtilsTest : public StorageTest {
@@ -86,7 +95,7 @@ class BTreeUtilsTest : public StorageTest {
     ObjectId new_root_id;
     std::unordered_set<ObjectId> new_nodes;
     ApplyChanges(
-        &coroutine_service_, &fake_storage_, root_id,
+        &coroutine_service_, &fake_storage_, nullptr, root_id,
         std::make_unique<EntryChangeIterator>(entries.begin(), entries.end()),
         callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                           &new_root_id, &new_nodes),
@@ -96,17 +105,36 @@ class BTreeUtilsTest : public StorageTest {
     return new_root_id;
   }
 
+  // Applies the changes in [|begin|, |end|) on the tree with the given root
+  // and returns the id of the new root.
+  ObjectId ApplyChangeRange(ObjectId root_id,
+                            std::vector<EntryChange>::iterator begin,
+                            std::vector<EntryChange>::iterator end,
+                            const NodeLevelCalculator* node_level_calculator) {
+    Status status;
+    ObjectId new_root_id;
+    std::unordered_set<ObjectId> new_nodes;
+    ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
+                 std::make_unique<EntryChangeIterator>(begin, end),
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &new_root_id, &new_nodes),
+                 node_level_calculator);
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    return new_root_id;
+  }
+
   std::vector<Entry> GetEntriesList(ObjectId root_id) {
     std::vector<Entry> entries;
     auto on_next = [&entries](EntryAndNodeId entry) {
-      entries.push_back(entry.entry);
+      entries.push_back(ToEntry(entry.entry));
       return true;
     };
     auto on_done = [this](Status status) {
       EXPECT_EQ(Status::OK, status);
       message_loop_.PostQuitTask();
     };
-    ForEachEntry(&coroutine_service_, &fake_storage_, root_id, "",
+    ForEachEntry(&coroutine_service_, &fake_storage_, nullptr, root_id, "",
                  std::move(on_next), std::move(on_done));
     EXPECT_FALSE(RunLoopWithTimeout());
     return entries;
@@ -150,7 +178,7 @@ TEST_F(BTreeUtilsTest, ApplyChangesFromEmpty) {
   // Expected layout (X is key "keyX"):
   // [00, 01, 02]
   ApplyChanges(
-      &coroutine_service_, &fake_storage_, root_id,
+      &coroutine_service_, &fake_storage_, nullptr, root_id,
       std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &new_root_id, &new_nodes),
@@ -179,7 +207,7 @@ TEST_F(BTreeUtilsTest, ApplyChangeSingleLevel1Entry) {
   // Expected layout (XX is key "keyXX"):
   // [03]
 
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(golden_entries.begin(),
                                                      golden_entries.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -210,7 +238,7 @@ TEST_F(BTreeUtilsTest, ApplyChangesManyEntries) {
   //                 [03, 07]
   //            /       |            \
   // [00, 01, 02]  [04, 05, 06] [08, 09, 10]
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(golden_entries.begin(),
                                                      golden_entries.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -238,7 +266,7 @@ TEST_F(BTreeUtilsTest, ApplyChangesManyEntries) {
   //                 [03, 07]
   //            /       |            \
   // [00, 01, 02]  [04, 05, 06] [071, 08, 09, 10]
-  ApplyChanges(&coroutine_service_, &fake_storage_, new_root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, new_root_id,
                std::make_unique<EntryChangeIterator>(new_change.begin(),
                                                      new_change.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -282,7 +310,7 @@ TEST_F(BTreeUtilsTest, UpdateValue) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(update_changes.begin(),
                                                      update_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -333,7 +361,7 @@ TEST_F(BTreeUtilsTest, UpdateValueLevel1) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(update_changes.begin(),
                                                      update_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -382,7 +410,7 @@ TEST_F(BTreeUtilsTest, UpdateValueSplitChange) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(update_changes.begin(),
                                                      update_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -421,7 +449,7 @@ TEST_F(BTreeUtilsTest, NoOpUpdateChange) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(golden_entries.begin(),
                                                      golden_entries.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -455,7 +483,7 @@ TEST_F(BTreeUtilsTest, DeleteChanges) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(delete_changes.begin(),
                                                      delete_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -503,7 +531,7 @@ TEST_F(BTreeUtilsTest, DeleteLevel1Changes) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(delete_changes.begin(),
                                                      delete_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -548,7 +576,7 @@ TEST_F(BTreeUtilsTest, NoOpDeleteChange) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(delete_changes.begin(),
                                                      delete_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -588,7 +616,7 @@ TEST_F(BTreeUtilsTest, SplitMergeUpdate) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(update_changes.begin(),
                                                      update_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -619,7 +647,7 @@ TEST_F(BTreeUtilsTest, SplitMergeUpdate) {
       CreateEntryChanges(std::vector<size_t>({75}), &delete_changes, true));
 
   ObjectId final_node_id;
-  ApplyChanges(&coroutine_service_, &fake_storage_, new_root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, new_root_id,
                std::make_unique<EntryChangeIterator>(delete_changes.begin(),
                                                      delete_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -644,7 +672,7 @@ TEST_F(BTreeUtilsTest, DeleteAll) {
   Status status;
   ObjectId new_root_id;
   std::unordered_set<ObjectId> new_nodes;
-  ApplyChanges(&coroutine_service_, &fake_storage_, root_id,
+  ApplyChanges(&coroutine_service_, &fake_storage_, nullptr, root_id,
                std::make_unique<EntryChangeIterator>(delete_changes.begin(),
                                                      delete_changes.end()),
                callback::Capture([this] { message_loop_.PostQuitTask(); },
@@ -659,12 +687,117 @@ TEST_F(BTreeUtilsTest, DeleteAll) {
   EXPECT_TRUE(new_nodes.find(new_root_id) != new_nodes.end());
 }
 
+TEST_F(BTreeUtilsTest, BuildFromEmptyMatchesApplyChanges) {
+  ObjectId empty_id;
+  ASSERT_TRUE(GetEmptyNodeId(&empty_id));
+
+  std::vector<EntryChange> default_changes;
+  for (size_t i = 0; i < 1000; ++i) {
+    default_changes.push_back(EntryChange{
+        Entry{ftl::StringPrintf("key%04zu", i),
+              MakeObjectId(ftl::StringPrintf("object%04zu", i)),
+              KeyPriority::EAGER},
+        false});
+  }
+  std::vector<EntryChange> test_changes;
+  ASSERT_TRUE(CreateEntryChanges(100, &test_changes));
+  // Without level 0 entries, the empty node is kept as a leaf.
+  std::vector<EntryChange> no_leaf_changes;
+  ASSERT_TRUE(CreateEntryChanges(std::vector<size_t>({3, 50, 60}),
+                                 &no_leaf_changes));
+
+  std::vector<std::pair<std::vector<EntryChange>*, const NodeLevelCalculator*>>
+      cases = {{&default_changes, GetDefaultNodeLevelCalculator()},
+               {&test_changes, &kTestNodeLevelCalculator},
+               {&no_leaf_changes, &kTestNodeLevelCalculator}};
+  for (const auto& test_case : cases) {
+    std::vector<EntryChange>& changes = *test_case.first;
+    // The tree is built in a single pass from the empty node, but changes
+    // applied on a non-empty tree go through the node builders.
+    ObjectId bulk_root_id = ApplyChangeRange(empty_id, changes.begin(),
+                                             changes.end(), test_case.second);
+    ObjectId first_root_id = ApplyChangeRange(
+        empty_id, changes.begin(), changes.begin() + 1, test_case.second);
+    ObjectId root_id = ApplyChangeRange(first_root_id, changes.begin() + 1,
+                                        changes.end(), test_case.second);
+    EXPECT_EQ(root_id, bulk_root_id);
+    EXPECT_EQ(changes.size(), GetEntriesList(bulk_root_id).size());
+  }
+}
+
+TEST_F(BTreeUtilsTest, ParallelEncodingMatchesSequentialEncoding) {
+  ObjectId empty_id;
+  ASSERT_TRUE(GetEmptyNodeId(&empty_id));
+  std::vector<EntryChange> changes;
+  ASSERT_TRUE(CreateEntryChanges(100, &changes));
+  // Changes applied on a non-empty tree go through the node builders.
+  ObjectId first_root_id =
+      ApplyChangeRange(empty_id, changes.begin(), changes.begin() + 1,
+                       &kTestNodeLevelCalculator);
+
+  ObjectId sequential_root_id =
+      ApplyChangeRange(first_root_id, changes.begin() + 1, changes.end(),
+                       &kTestNodeLevelCalculator);
+
+  callback::WorkerPool worker_pool(3);
+  fake_storage_.worker_pool = &worker_pool;
+  ObjectId parallel_root_id =
+      ApplyChangeRange(first_root_id, changes.begin() + 1, changes.end(),
+                       &kTestNodeLevelCalculator);
+  fake_storage_.worker_pool = nullptr;
+
+  EXPECT_EQ(sequential_root_id, parallel_root_id);
+  std::vector<Entry> entries = GetEntriesList(parallel_root_id);
+  ASSERT_EQ(changes.size(), entries.size());
+  for (size_t i = 0; i < changes.size(); ++i) {
+    EXPECT_EQ(changes[i].entry, entries[i]);
+  }
+}
+
+TEST_F(BTreeUtilsTest, BatchedChangesMatchSingleChanges) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // Delete every third key, including keys of upper levels, and insert a key
+  // after every other one.
+  std::map<std::string, EntryChange> changes_by_key;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (i % 3 == 0) {
+      EntryChange change = entries[i];
+      change.deleted = true;
+      changes_by_key.emplace(change.entry.key, std::move(change));
+    }
+    if (i % 2 == 0) {
+      std::string key = ftl::StringPrintf("key%02zu5", i);
+      changes_by_key.emplace(
+          key, EntryChange{Entry{key, MakeObjectId("object" + key),
+                                 KeyPriority::EAGER},
+                           false});
+    }
+  }
+  std::vector<EntryChange> changes;
+  for (auto& change : changes_by_key) {
+    changes.push_back(std::move(change.second));
+  }
+
+  ObjectId batch_root_id = ApplyChangeRange(
+      root_id, changes.begin(), changes.end(), &kTestNodeLevelCalculator);
+  ObjectId single_root_id = root_id;
+  for (auto it = changes.begin(); it != changes.end(); ++it) {
+    single_root_id = ApplyChangeRange(single_root_id, it, it + 1,
+                                      &kTestNodeLevelCalculator);
+  }
+  EXPECT_EQ(single_root_id, batch_root_id);
+  EXPECT_EQ(100u - 34u + 50u, GetEntriesList(batch_root_id).size());
+}
+
 TEST_F(BTreeUtilsTest, GetObjectIdsFromEmpty) {
   ObjectId root_id;
   ASSERT_TRUE(GetEmptyNodeId(&root_id));
   Status status;
   std::set<ObjectId> object_ids;
-  GetObjectIds(&coroutine_service_, &fake_storage_, root_id,
+  GetObjectIds(&coroutine_service_, &fake_storage_, nullptr, root_id,
                callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &object_ids));
   ASSERT_FALSE(RunLoopWithTimeout());
@@ -680,7 +813,7 @@ TEST_F(BTreeUtilsTest, GetObjectOneNodeTree) {
 
   Status status;
   std::set<ObjectId> object_ids;
-  GetObjectIds(&coroutine_service_, &fake_storage_, root_id,
+  GetObjectIds(&coroutine_service_, &fake_storage_, nullptr, root_id,
                callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &object_ids));
   ASSERT_FALSE(RunLoopWithTimeout());
@@ -699,7 +832,7 @@ TEST_F(BTreeUtilsTest, GetObjectIdsBigTree) {
 
   Status status;
   std::set<ObjectId> object_ids;
-  GetObjectIds(&coroutine_service_, &fake_storage_, root_id,
+  GetObjectIds(&coroutine_service_, &fake_storage_, nullptr, root_id,
                callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &object_ids));
   ASSERT_FALSE(RunLoopWithTimeout());
@@ -724,7 +857,7 @@ TEST_F(BTreeUtilsTest, GetObjectsFromSync) {
   //       /        \
   // [00, 01, 02]  [04]
   GetObjectsFromSync(
-      &coroutine_service_, &fake_storage_, root_id,
+      &coroutine_service_, &fake_storage_, nullptr, root_id,
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
   ASSERT_FALSE(RunLoopWithTimeout());
   ASSERT_EQ(Status::OK, status);
@@ -738,7 +871,7 @@ TEST_F(BTreeUtilsTest, GetObjectsFromSync) {
   EXPECT_EQ(3 + 4u, object_requests.size());
 
   std::set<ObjectId> object_ids;
-  GetObjectIds(&coroutine_service_, &fake_storage_, root_id,
+  GetObjectIds(&coroutine_service_, &fake_storage_, nullptr, root_id,
                callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &object_ids));
   ASSERT_FALSE(RunLoopWithTimeout());
@@ -764,7 +897,7 @@ TEST_F(BTreeUtilsTest, ForEachEmptyTree) {
     EXPECT_EQ(Status::OK, status);
     message_loop_.PostQuitTask();
   };
-  ForEachEntry(&coroutine_service_, &fake_storage_, root_id, "",
+  ForEachEntry(&coroutine_service_, &fake_storage_, nullptr, root_id, "",
                std::move(on_next), std::move(on_done));
   ASSERT_FALSE(RunLoopWithTimeout());
 }
@@ -785,8 +918,8 @@ TEST_F(BTreeUtilsTest, ForEachAllEntries) {
     EXPECT_EQ(Status::OK, status);
     message_loop_.PostQuitTask();
   };
-  ForEachEntry(&coroutine_service_, &fake_storage_, root_id, "", on_next,
-               on_done);
+  ForEachEntry(&coroutine_service_, &fake_storage_, nullptr, root_id, "",
+               on_next, on_done);
   ASSERT_FALSE(RunLoopWithTimeout());
 }
 
@@ -811,11 +944,363 @@ TEST_F(BTreeUtilsTest, ForEachEntryPrefix) {
     EXPECT_EQ(40, current_key);
     message_loop_.PostQuitTask();
   };
-  ForEachEntry(&coroutine_service_, &fake_storage_, root_id, prefix, on_next,
-               on_done);
+  ForEachEntry(&coroutine_service_, &fake_storage_, nullptr, root_id, prefix,
+               on_next, on_done);
   ASSERT_FALSE(RunLoopWithTimeout());
 }
 
+TEST_F(BTreeUtilsTest, ForEachEntryReverse) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  int current_key = 99;
+  auto on_next = [&current_key](EntryAndNodeId e) {
+    EXPECT_EQ(ftl::StringPrintf("key%02d", current_key--), e.entry.key);
+    return true;
+  };
+  Status status;
+  ForEachEntryReverse(
+      &coroutine_service_, &fake_storage_, nullptr, root_id, "", "", on_next,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(-1, current_key);
+}
+
+TEST_F(BTreeUtilsTest, ForEachEntryReverseInRange) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // With the test node levels, the keys in [key01, key05) are in 3 nodes
+  // below the root: [03, 07, 30] -> [00, 01, 02] and [04, 05, 06].
+  fake_storage_.object_requests.clear();
+  int current_key = 4;
+  auto on_next = [&current_key](EntryAndNodeId e) {
+    EXPECT_EQ(ftl::StringPrintf("key%02d", current_key--), e.entry.key);
+    return true;
+  };
+  Status status;
+  ForEachEntryReverse(
+      &coroutine_service_, &fake_storage_, nullptr, root_id, "key01", "key05",
+      on_next,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(0, current_key);
+  EXPECT_EQ(4u, fake_storage_.object_requests.size());
+}
+
+TEST_F(BTreeUtilsTest, ForEachEntryFromIterator) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // Stop the iteration on key40.
+  int current_key = 0;
+  auto on_next = [&current_key](EntryAndNodeId e) {
+    if (current_key == 40) {
+      return false;
+    }
+    EXPECT_EQ(ftl::StringPrintf("key%02d", current_key++), e.entry.key);
+    return true;
+  };
+  Status status;
+  std::unique_ptr<BTreeIterator> iterator;
+  ForEachEntryFrom(&coroutine_service_, &fake_storage_, nullptr, root_id, "",
+                   nullptr, on_next,
+                   callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                     &status, &iterator));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  ASSERT_TRUE(iterator);
+
+  // Resuming starts from key40, without reading the nodes above it again.
+  fake_storage_.object_requests.clear();
+  auto resumed_on_next = [&current_key](EntryAndNodeId e) {
+    EXPECT_EQ(ftl::StringPrintf("key%02d", current_key++), e.entry.key);
+    return true;
+  };
+  ForEachEntryFrom(&coroutine_service_, &fake_storage_, nullptr, root_id, "",
+                   std::move(iterator), resumed_on_next,
+                   callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                     &status, &iterator));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_FALSE(iterator);
+  EXPECT_EQ(100, current_key);
+  EXPECT_EQ(0u, fake_storage_.object_requests.count(root_id));
+}
+
+TEST_F(BTreeUtilsTest, GetEntry) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  for (const EntryChange& change : entries) {
+    Status status;
+    Entry entry;
+    GetEntry(&fake_storage_, nullptr, root_id, change.entry.key,
+             callback::Capture([this] { message_loop_.PostQuitTask(); },
+                               &status, &entry));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(change.entry, entry);
+  }
+
+  // Keys before, between and after the keys of the tree are not found.
+  for (const char* key : {"", "key", "key305", "key99a"}) {
+    Status status;
+    Entry entry;
+    GetEntry(&fake_storage_, nullptr, root_id, key,
+             callback::Capture([this] { message_loop_.PostQuitTask(); },
+                               &status, &entry));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::NOT_FOUND, status);
+  }
+}
+
+TEST_F(BTreeUtilsTest, GetEntryOnlyReadsPath) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // With the test node levels, the path to key01 goes through 3 nodes:
+  // [50, 75] -> [03, 07, 30] -> [00, 01, 02].
+  fake_storage_.object_requests.clear();
+  Status status;
+  Entry entry;
+  GetEntry(&fake_storage_, nullptr, root_id, "key01",
+           callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                             &entry));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ("key01", entry.key);
+  EXPECT_EQ(3u, fake_storage_.object_requests.size());
+}
+
+TEST_F(BTreeUtilsTest, GetEntries) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // Missing keys are skipped: keys before, between and after the keys of the
+  // tree are mixed with existing ones.
+  std::vector<std::string> keys = {"",      "key00", "key01",  "key305",
+                                   "key50", "key51", "key99",  "key99a"};
+  Status status;
+  std::vector<Entry> found;
+  GetEntries(&fake_storage_, nullptr, root_id, keys,
+             callback::Capture([this] { message_loop_.PostQuitTask(); },
+                               &status, &found));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_EQ(5u, found.size());
+  EXPECT_EQ(entries[0].entry, found[0]);
+  EXPECT_EQ(entries[1].entry, found[1]);
+  EXPECT_EQ(entries[50].entry, found[2]);
+  EXPECT_EQ(entries[51].entry, found[3]);
+  EXPECT_EQ(entries[99].entry, found[4]);
+}
+
+TEST_F(BTreeUtilsTest, GetEntriesReadsSharedNodesOnce) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // With the test node levels, the paths to key01 and key02 share all their
+  // nodes: [50, 75] -> [03, 07, 30] -> [00, 01, 02]. The path to key05 only
+  // differs in the last node: [04, 05, 06].
+  fake_storage_.object_request_count = 0;
+  Status status;
+  std::vector<Entry> found;
+  GetEntries(&fake_storage_, nullptr, root_id, {"key01", "key02", "key05"},
+             callback::Capture([this] { message_loop_.PostQuitTask(); },
+                               &status, &found));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_EQ(3u, found.size());
+  EXPECT_EQ("key05", found[2].key);
+  EXPECT_EQ(4u, fake_storage_.object_request_count);
+}
+
+TEST_F(BTreeUtilsTest, CountEntries) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // The sizes of the subtrees are stored in the root: counting all entries
+  // only reads it.
+  fake_storage_.object_request_count = 0;
+  Status status;
+  uint64_t count;
+  CountEntries(&fake_storage_, nullptr, root_id, "", "",
+               callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &count));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(100u, count);
+  EXPECT_EQ(1u, fake_storage_.object_request_count);
+
+  std::vector<std::tuple<std::string, std::string, uint64_t>> ranges = {
+      std::make_tuple("key10", "key60", 50u),
+      std::make_tuple("key305", "key99a", 69u),
+      std::make_tuple("key01", "key02", 1u),
+      std::make_tuple("", "key50", 50u),
+      std::make_tuple("key60", "key10", 0u)};
+  for (const auto& range : ranges) {
+    CountEntries(&fake_storage_, nullptr, root_id, std::get<0>(range),
+                 std::get<1>(range),
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &count));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(std::get<2>(range), count);
+  }
+}
+
+TEST_F(BTreeUtilsTest, CountEntriesWithoutSubtreeSizes) {
+  // Nodes with children created directly do not store the sizes of their
+  // subtrees: [02, 03, 04] -> [00, 01].
+  std::vector<Entry> entries;
+  ASSERT_TRUE(CreateEntries(5, &entries));
+  std::unique_ptr<const TreeNode> child;
+  ASSERT_TRUE(CreateNodeFromEntries(
+      std::vector<Entry>(entries.begin(), entries.begin() + 2),
+      std::vector<ObjectId>(3), &child));
+  std::unique_ptr<const TreeNode> node;
+  ASSERT_TRUE(CreateNodeFromEntries(
+      std::vector<Entry>(entries.begin() + 2, entries.end()),
+      {child->GetId(), "", "", ""}, &node));
+  EXPECT_FALSE(node->HasSubtreeSizes());
+
+  Status status;
+  uint64_t count;
+  CountEntries(&fake_storage_, nullptr, node->GetId(), "", "",
+               callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &count));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(5u, count);
+
+  Entry entry;
+  GetEntryAtIndex(&fake_storage_, nullptr, node->GetId(), 3,
+                  callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                    &status, &entry));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(entries[3], entry);
+}
+
+TEST_F(BTreeUtilsTest, GetEntryAtIndex) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  Status status;
+  Entry entry;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    GetEntryAtIndex(&fake_storage_, nullptr, root_id, i,
+                    callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                      &status, &entry));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(entries[i].entry, entry);
+  }
+
+  GetEntryAtIndex(&fake_storage_, nullptr, root_id, entries.size(),
+                  callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                    &status, &entry));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::NOT_FOUND, status);
+
+  // Only the nodes on the path to the entry are read: [50, 75] ->
+  // [03, 07, 30] -> [04, 05, 06].
+  fake_storage_.object_request_count = 0;
+  GetEntryAtIndex(&fake_storage_, nullptr, root_id, 5,
+                  callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                    &status, &entry));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ("key05", entry.key);
+  EXPECT_EQ(3u, fake_storage_.object_request_count);
+}
+
+TEST_F(BTreeUtilsTest, ApplyChangesFromEmptyStoresSubtreeSizes) {
+  // Without level 0 entries, the empty root node is kept as the right-most
+  // leaf of the new tree: its size must be known for the new nodes to store
+  // the sizes of their subtrees.
+  std::vector<EntryChange> changes;
+  ASSERT_TRUE(CreateEntryChanges(std::vector<size_t>({3, 50, 60}), &changes));
+  ObjectId root_id = CreateTree(changes);
+
+  std::unique_ptr<const TreeNode> root;
+  ASSERT_TRUE(CreateNodeFromId(root_id, &root));
+  EXPECT_TRUE(root->HasSubtreeSizes());
+
+  fake_storage_.object_request_count = 0;
+  Status status;
+  uint64_t count;
+  CountEntries(&fake_storage_, nullptr, root_id, "", "",
+               callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &count));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(3u, count);
+  EXPECT_EQ(1u, fake_storage_.object_request_count);
+}
+
+TEST_F(BTreeUtilsTest, ApplyChangesComputesMissingSubtreeSizes) {
+  // Create a tree without subtree sizes, as written by older versions:
+  // [03] -> [00, 01, 02].
+  std::vector<Entry> entries;
+  ASSERT_TRUE(CreateEntries(4, &entries));
+  std::unique_ptr<const TreeNode> leaf;
+  ASSERT_TRUE(CreateNodeFromEntries(
+      std::vector<Entry>(entries.begin(), entries.begin() + 3),
+      std::vector<ObjectId>(4), &leaf));
+  Status status;
+  ObjectId root_id;
+  TreeNode::FromEntries(
+      &fake_storage_, nullptr, 1u, {entries[3]}, {leaf->GetId(), ""},
+      std::vector<uint64_t>(),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &root_id));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  std::unique_ptr<const TreeNode> root;
+  ASSERT_TRUE(CreateNodeFromId(root_id, &root));
+  EXPECT_FALSE(root->HasSubtreeSizes());
+
+  // Adding 04 rewrites the root, which then stores the sizes of its subtrees.
+  std::vector<EntryChange> changes;
+  ASSERT_TRUE(CreateEntryChanges(std::vector<size_t>({4}), &changes));
+  ObjectId new_root_id;
+  std::unordered_set<ObjectId> new_nodes;
+  ApplyChanges(
+      &coroutine_service_, &fake_storage_, nullptr, root_id,
+      std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &new_root_id, &new_nodes),
+      &kTestNodeLevelCalculator);
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  ASSERT_TRUE(CreateNodeFromId(new_root_id, &root));
+  ASSERT_TRUE(root->HasSubtreeSizes());
+  EXPECT_EQ(3u, root->GetSubtreeSize(0));
+  EXPECT_EQ(1u, root->GetSubtreeSize(1));
+
+  // The result does not depend on the version that wrote the initial tree.
+  std::vector<EntryChange> all_changes;
+  ASSERT_TRUE(CreateEntryChanges(5, &all_changes));
+  EXPECT_EQ(CreateTree(all_changes), new_root_id);
+}
+
 TEST_F(BTreeUtilsTest, ForEachDiff) {
   std::unique_ptr<const Object> object;
   ASSERT_TRUE(AddObject("change1", &object));
@@ -838,7 +1323,7 @@ TEST_F(BTreeUtilsTest, ForEachDiff) {
   ObjectId other_root_id;
   std::unordered_set<ObjectId> new_nodes;
   ApplyChanges(
-      &coroutine_service_, &fake_storage_, base_root_id,
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id,
       std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &other_root_id, &new_nodes),
@@ -849,7 +1334,8 @@ TEST_F(BTreeUtilsTest, ForEachDiff) {
   // ForEachDiff should return all changes just applied.
   size_t current_change = 0;
   ForEachDiff(
-      &coroutine_service_, &fake_storage_, base_root_id, other_root_id, "",
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id, other_root_id,
+      "",
       [&changes, &current_change](EntryChange e) {
         EXPECT_EQ(changes[current_change].deleted, e.deleted);
         if (e.deleted) {
@@ -890,7 +1376,7 @@ TEST_F(BTreeUtilsTest, ForEachDiffWithMinKey) {
   ObjectId other_root_id;
   std::unordered_set<ObjectId> new_nodes;
   ApplyChanges(
-      &coroutine_service_, &fake_storage_, base_root_id,
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id,
       std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &other_root_id, &new_nodes),
@@ -901,7 +1387,8 @@ TEST_F(BTreeUtilsTest, ForEachDiffWithMinKey) {
   // ForEachDiff with a "key0" as min_key should return both changes.
   size_t current_change = 0;
   ForEachDiff(
-      &coroutine_service_, &fake_storage_, base_root_id, other_root_id, "key0",
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id, other_root_id,
+      "key0",
       [&changes, &current_change](EntryChange e) {
         EXPECT_EQ(changes[current_change++].entry, e.entry);
         return true;
@@ -913,7 +1400,8 @@ TEST_F(BTreeUtilsTest, ForEachDiffWithMinKey) {
 
   // With "key60" as min_key, only key75 should be returned.
   ForEachDiff(
-      &coroutine_service_, &fake_storage_, base_root_id, other_root_id, "key60",
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id, other_root_id,
+      "key60",
       [&changes](EntryChange e) {
         EXPECT_EQ(changes[1].entry, e.entry);
         return true;
@@ -945,7 +1433,7 @@ TEST_F(BTreeUtilsTest, ForEachDiffWithMinKeySkipNodes) {
   ObjectId other_root_id;
   std::unordered_set<ObjectId> new_nodes;
   ApplyChanges(
-      &coroutine_service_, &fake_storage_, base_root_id,
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id,
       std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &other_root_id, &new_nodes),
@@ -954,7 +1442,8 @@ TEST_F(BTreeUtilsTest, ForEachDiffWithMinKeySkipNodes) {
   ASSERT_EQ(Status::OK, status);
 
   ForEachDiff(
-      &coroutine_service_, &fake_storage_, base_root_id, other_root_id, "key01",
+      &coroutine_service_, &fake_storage_, nullptr, base_root_id, other_root_id,
+      "key01",
       [&changes](EntryChange e) {
         EXPECT_EQ(changes[0].entry, e.entry);
         return true;
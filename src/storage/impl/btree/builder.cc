@@ -4,8 +4,12 @@
 
 #include "apps/ledger/src/storage/impl/btree/builder.h"
 
+#include <algorithm>
+
 #include "apps/ledger/src/callback/asynchronous_callback.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/callback/worker_pool.h"
+#include "apps/ledger/src/storage/impl/btree/encoding.h"
 #include "apps/ledger/src/storage/impl/btree/internal_helper.h"
 #include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
 #include "lib/ftl/functional/closure.h"
@@ -50,6 +54,110 @@ uint8_t GetNodeLevel(convert::ExtendedStringView key) {
 
 constexpr NodeLevelCalculator kDefaultNodeLevelCalculator = {&GetNodeLevel};
 
+// Subtree size of builders whose number of entries is not known.
+constexpr uint64_t kUnknownSubtreeSize = std::numeric_limits<uint64_t>::max();
+
+// Number of changes read from the change iterator and applied together.
+constexpr size_t kChangeBatchSize = 1024;
+
+// A batch of changes sorted by key, with the level of each key.
+struct ChangeBatch {
+  std::vector<EntryChange> changes;
+  std::vector<uint8_t> levels;
+};
+
+// Stores in |count| the number of entries in the tree rooted at |node_id|. The
+// subtrees whose size is stored in their parent are not read.
+Status CountSubtreeEntries(SynchronousStorage* page_storage,
+                           ObjectIdView node_id,
+                           uint64_t* count) {
+  std::unique_ptr<const TreeNode> node;
+  RETURN_ON_ERROR(page_storage->TreeNodeFromId(node_id, &node));
+  FTL_DCHECK(node);
+
+  *count = node->GetKeyCount();
+  for (int i = 0; i <= node->GetKeyCount(); ++i) {
+    if (node->HasSubtreeSizes()) {
+      *count += node->GetSubtreeSize(i);
+      continue;
+    }
+    ObjectIdView child_id = node->GetChildId(i);
+    if (child_id.empty()) {
+      continue;
+    }
+    uint64_t child_count;
+    RETURN_ON_ERROR(CountSubtreeEntries(page_storage, child_id, &child_count));
+    *count += child_count;
+  }
+  return Status::OK;
+}
+
+// The content of a tree node to be written in the storage.
+struct NodeContent {
+  uint8_t level;
+  std::vector<Entry> entries;
+  std::vector<ObjectId> children;
+  std::vector<uint64_t> subtree_sizes;
+};
+
+// Serializes the nodes in |contents| and stores the results in |encodings|, in
+// the same order. If |page_storage| has a worker pool, the nodes are split
+// among its threads and encoded concurrently.
+Status EncodeNodes(SynchronousStorage* page_storage,
+                   std::vector<NodeContent> contents,
+                   std::vector<std::string>* encodings) {
+  callback::WorkerPool* worker_pool =
+      page_storage->page_storage()->GetWorkerPool();
+  if (!worker_pool || contents.size() < 2) {
+    encodings->clear();
+    encodings->reserve(contents.size());
+    for (const NodeContent& content : contents) {
+      encodings->push_back(EncodeNode(content.level, content.entries,
+                                      content.children, content.subtree_sizes));
+    }
+    return Status::OK;
+  }
+
+  // The worker threads can outlive this call if the coroutine is interrupted:
+  // they share the ownership of the nodes and of their encodings.
+  struct EncodingState {
+    std::vector<NodeContent> contents;
+    std::vector<std::string> encodings;
+  };
+  auto state = std::make_shared<EncodingState>();
+  state->contents = std::move(contents);
+  state->encodings.resize(state->contents.size());
+
+  auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
+  size_t node_count = state->contents.size();
+  size_t task_count = std::min(worker_pool->thread_count(), node_count);
+  for (size_t task = 0; task < task_count; ++task) {
+    // Each task encodes a contiguous range of nodes.
+    size_t begin = task * node_count / task_count;
+    size_t end = (task + 1) * node_count / task_count;
+    worker_pool->PostTaskAndReply(
+        [state, begin, end] {
+          for (size_t i = begin; i < end; ++i) {
+            const NodeContent& content = state->contents[i];
+            state->encodings[i] =
+                EncodeNode(content.level, content.entries, content.children,
+                           content.subtree_sizes);
+          }
+        },
+        [callback = waiter->NewCallback()] { callback(Status::OK); });
+  }
+  Status status;
+  if (coroutine::SyncCall(page_storage->handler(),
+                          [&waiter](std::function<void(Status)> callback) {
+                            waiter->Finalize(std::move(callback));
+                          },
+                          &status)) {
+    return Status::ILLEGAL_STATE;
+  }
+  *encodings = std::move(state->encodings);
+  return status;
+}
+
 // Base class for tree nodes during construction. To apply mutations on a tree
 // node, one starts by creating an instance of NodeBuilder from the id of an
 // existing tree node, then applies mutation on it.  Once all mutations are
@@ -62,7 +170,9 @@ class NodeBuilder {
                        NodeBuilder* node_builder);
 
   // Creates a null builder.
-  NodeBuilder() : type_(BuilderType::NULL_NODE) { FTL_DCHECK(Validate()); }
+  NodeBuilder() : type_(BuilderType::NULL_NODE), subtree_size_(0) {
+    FTL_DCHECK(Validate());
+  }
 
   NodeBuilder(NodeBuilder&&) = default;
 
@@ -71,12 +181,31 @@ class NodeBuilder {
   // Returns whether the builder is null.
   explicit operator bool() const { return type_ != BuilderType::NULL_NODE; }
 
+  // Returns whether the builder holds an existing node with no entries and no
+  // children, such as the root of an empty tree.
+  bool IsEmptyNode() const {
+    return type_ == BuilderType::EXISTING_NODE && entries_.empty() &&
+           children_.size() == 1 && !children_[0];
+  }
+
   // Apply the given mutation on |node_builder|.
   Status Apply(const NodeLevelCalculator* node_level_calculator,
                SynchronousStorage* page_storage,
                EntryChange change,
                bool* did_mutate);
 
+  // Applies the changes of |batch| starting at index |*begin| and before
+  // |end|, and updates |*begin| to the index of the first change not yet
+  // applied. Consecutive changes that belong to the same child are applied on
+  // it together, so that the path to this child is only visited once. The
+  // result is the same as calling |Apply| on each change.
+  Status ApplyGroup(const NodeLevelCalculator* node_level_calculator,
+                    SynchronousStorage* page_storage,
+                    ChangeBatch* batch,
+                    size_t* begin,
+                    size_t end,
+                    bool* did_mutate);
+
   // Build the tree node represented by the builder |node_builder| in the
   // storage.
   Status Build(SynchronousStorage* page_storage,
@@ -90,9 +219,13 @@ class NodeBuilder {
     NULL_NODE,
   };
 
-  static NodeBuilder CreateExistingBuilder(uint8_t level, ObjectId object_id) {
-    return NodeBuilder(BuilderType::EXISTING_NODE, level, std::move(object_id),
+  static NodeBuilder CreateExistingBuilder(uint8_t level,
+                                           ObjectId object_id,
+                                           uint64_t subtree_size) {
+    NodeBuilder result(BuilderType::EXISTING_NODE, level, std::move(object_id),
                        {}, {});
+    result.subtree_size_ = subtree_size;
+    return result;
   }
 
   static NodeBuilder CreateNewBuilder(uint8_t level,
@@ -211,6 +344,9 @@ class NodeBuilder {
   ObjectId object_id_;
   std::vector<Entry> entries_;
   std::vector<NodeBuilder> children_;
+  // Number of entries in the tree rooted at this builder, if known. It is
+  // only up to date for |EXISTING_NODE| and |NULL_NODE| builders.
+  uint64_t subtree_size_ = kUnknownSubtreeSize;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(NodeBuilder);
 };
@@ -228,6 +364,12 @@ Status NodeBuilder::FromId(SynchronousStorage* page_storage,
   *result = NodeBuilder(BuilderType::EXISTING_NODE, node->level(),
                         std::move(object_id), std::move(entries),
                         std::move(children));
+  if (node->HasSubtreeSizes()) {
+    result->subtree_size_ = node->GetKeyCount();
+    for (int i = 0; i <= node->GetKeyCount(); ++i) {
+      result->subtree_size_ += node->GetSubtreeSize(i);
+    }
+  }
   return Status::OK;
 }
 
@@ -289,12 +431,59 @@ Status NodeBuilder::Apply(const NodeLevelCalculator* node_level_calculator,
                 did_mutate);
 }
 
+Status NodeBuilder::ApplyGroup(
+    const NodeLevelCalculator* node_level_calculator,
+    SynchronousStorage* page_storage,
+    ChangeBatch* batch,
+    size_t* begin,
+    size_t end,
+    bool* did_mutate) {
+  FTL_DCHECK(*begin < end);
+  size_t i = *begin;
+  *did_mutate = false;
+  if (*this && batch->levels[i] < level_) {
+    RETURN_ON_ERROR(ComputeContent(page_storage));
+  }
+  // Changes are applied one by one if they modify this node, or if it has no
+  // entries: it then becomes null as soon as its only child does, which
+  // changes how the following changes are applied.
+  if (!*this || batch->levels[i] >= level_ || entries_.empty()) {
+    ++*begin;
+    return Apply(node_level_calculator, page_storage,
+                 std::move(batch->changes[i]), did_mutate);
+  }
+
+  size_t index = GetEntryOrChildIndex(entries_, batch->changes[i].entry.key);
+  size_t group_end = i + 1;
+  while (group_end < end && batch->levels[group_end] < level_ &&
+         (index == entries_.size() ||
+          batch->changes[group_end].entry.key < entries_[index].key)) {
+    ++group_end;
+  }
+
+  NodeBuilder& child = children_[index];
+  while (i < group_end) {
+    bool child_did_mutate;
+    RETURN_ON_ERROR(child.ApplyGroup(node_level_calculator, page_storage,
+                                     batch, &i, group_end, &child_did_mutate));
+    if (child_did_mutate) {
+      *did_mutate = true;
+      child.ToLevel(level_ - 1);
+    }
+  }
+  if (*did_mutate) {
+    type_ = BuilderType::NEW_NODE;
+  }
+  *begin = group_end;
+  return Status::OK;
+}
+
 Status NodeBuilder::Build(SynchronousStorage* page_storage,
                           ObjectId* object_id,
                           std::unordered_set<ObjectId>* new_ids) {
   if (!*this) {
     RETURN_ON_ERROR(
-        page_storage->TreeNodeFromEntries(0, {}, {""}, &object_id_));
+        page_storage->TreeNodeFromEntries(0, {}, {""}, {0}, &object_id_));
 
     *object_id = object_id_;
     new_ids->insert(object_id_);
@@ -306,26 +495,57 @@ Status NodeBuilder::Build(SynchronousStorage* page_storage,
     return Status::OK;
   }
 
+  // All the nodes of a level are encoded and added to the storage
+  // concurrently, before the ids of the new nodes are used by their parents.
   std::vector<NodeBuilder*> to_build;
   while (CollectNodesToBuild(&to_build)) {
-    auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
+    std::vector<NodeContent> contents;
+    contents.reserve(to_build.size());
     for (NodeBuilder* child : to_build) {
-      std::vector<ObjectId> children;
-      for (const auto& sub_child : child->children_) {
+      NodeContent content;
+      content.level = child->level_;
+      // The content of built nodes is read back from the storage if needed.
+      content.entries = std::move(child->entries_);
+      std::vector<ObjectId>& children = content.children;
+      std::vector<uint64_t>& subtree_sizes = content.subtree_sizes;
+      uint64_t subtree_size = content.entries.size();
+      for (auto& sub_child : child->children_) {
         FTL_DCHECK(sub_child.type_ != BuilderType::NEW_NODE);
+        // Sizes are always stored, so that the id of a node does not depend
+        // on the version that wrote its subtrees: the size of subtrees written
+        // by older versions is computed once, when their parent is rewritten.
+        if (sub_child.subtree_size_ == kUnknownSubtreeSize) {
+          RETURN_ON_ERROR(CountSubtreeEntries(
+              page_storage, sub_child.object_id_, &sub_child.subtree_size_));
+        }
         children.push_back(sub_child.object_id_);
+        subtree_sizes.push_back(sub_child.subtree_size_);
+        subtree_size += sub_child.subtree_size_;
       }
-      TreeNode::FromEntries(page_storage->page_storage(), child->level_,
-                            child->entries_, std::move(children), [
-                              new_ids, child, callback = waiter->NewCallback()
-                            ](Status status, ObjectId object_id) {
-                              if (status == Status::OK) {
-                                child->type_ = BuilderType::EXISTING_NODE;
-                                child->object_id_ = std::move(object_id);
-                                new_ids->insert(child->object_id_);
-                              }
-                              callback(status);
-                            });
+      child->subtree_size_ = subtree_size;
+      child->entries_.clear();
+      child->children_.clear();
+      contents.push_back(std::move(content));
+    }
+
+    std::vector<std::string> encodings;
+    RETURN_ON_ERROR(EncodeNodes(page_storage, std::move(contents), &encodings));
+
+    auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
+    for (size_t i = 0; i < to_build.size(); ++i) {
+      NodeBuilder* child = to_build[i];
+      TreeNode::FromEncoding(page_storage->page_storage(),
+                             page_storage->tree_node_cache(),
+                             std::move(encodings[i]), [
+                               new_ids, child, callback = waiter->NewCallback()
+                             ](Status status, ObjectId object_id) {
+                               if (status == Status::OK) {
+                                 child->type_ = BuilderType::EXISTING_NODE;
+                                 child->object_id_ = std::move(object_id);
+                                 new_ids->insert(child->object_id_);
+                               }
+                               callback(status);
+                             });
     }
     Status status;
     if (coroutine::SyncCall(page_storage->handler(),
@@ -573,36 +793,180 @@ void NodeBuilder::ExtractContent(const TreeNode& node,
                                  std::vector<NodeBuilder>* children) {
   FTL_DCHECK(entries);
   FTL_DCHECK(children);
-  *entries = std::vector<Entry>(node.entries().begin(), node.entries().end());
+  entries->clear();
+  entries->reserve(node.entries().size());
+  for (const auto& entry : node.entries()) {
+    entries->push_back(ToEntry(entry));
+  }
   children->clear();
-  for (const auto& child_id : node.children_ids()) {
+  children->reserve(node.children_ids().size());
+  for (size_t i = 0; i < node.children_ids().size(); ++i) {
+    ObjectIdView child_id = node.children_ids()[i];
     if (child_id.empty()) {
       children->push_back(NodeBuilder());
     } else {
-      children->push_back(
-          NodeBuilder::CreateExistingBuilder(node.level() - 1, child_id));
+      children->push_back(NodeBuilder::CreateExistingBuilder(
+          node.level() - 1, child_id.ToString(),
+          node.HasSubtreeSizes() ? node.GetSubtreeSize(i)
+                                 : kUnknownSubtreeSize));
+    }
+  }
+}
+
+// Builds a tree from entries added in increasing order of keys, from the
+// leaves up. A node is written as soon as an entry of a higher level is added,
+// as no other entry can be added to it: only the nodes on the right-most path
+// of the tree are kept in memory.
+class BulkBuilder {
+ public:
+  BulkBuilder(SynchronousStorage* page_storage,
+              std::unordered_set<ObjectId>* new_ids)
+      : page_storage_(page_storage), new_ids_(new_ids) {}
+
+  // Adds |entry| at the given |level|. |entry| must be greater than all the
+  // entries already added.
+  Status Add(Entry entry, uint8_t level);
+
+  // Writes the remaining nodes and stores the id of the root in |object_id|.
+  // |empty_node_id| is the id of the empty node the tree is built from: it is
+  // returned if no entry was added.
+  Status Finish(ObjectIdView empty_node_id, ObjectId* object_id);
+
+ private:
+  // A node whose entries are all known, but whose last child might not be
+  // written yet.
+  struct PendingNode {
+    std::vector<Entry> entries;
+    std::vector<ObjectId> children = {""};
+    std::vector<uint64_t> subtree_sizes = {0};
+  };
+
+  // Writes the pending node at |level|, if it is not empty, and sets it as the
+  // last child of the pending node at |level| + 1.
+  Status WriteLevel(uint8_t level);
+
+  SynchronousStorage* page_storage_;
+  std::unordered_set<ObjectId>* new_ids_;
+  // Pending nodes, indexed by level.
+  std::vector<PendingNode> levels_;
+  bool has_leaf_entry_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BulkBuilder);
+};
+
+Status BulkBuilder::Add(Entry entry, uint8_t level) {
+  if (levels_.size() <= level) {
+    levels_.resize(level + 1);
+  }
+  for (uint8_t l = 0; l < level; ++l) {
+    RETURN_ON_ERROR(WriteLevel(l));
+  }
+  PendingNode& node = levels_[level];
+  FTL_DCHECK(node.entries.empty() || node.entries.back().key < entry.key);
+  node.entries.push_back(std::move(entry));
+  node.children.push_back("");
+  node.subtree_sizes.push_back(0);
+  if (level == 0) {
+    has_leaf_entry_ = true;
+  }
+  return Status::OK;
+}
+
+Status BulkBuilder::Finish(ObjectIdView empty_node_id, ObjectId* object_id) {
+  if (levels_.empty()) {
+    *object_id = empty_node_id.ToString();
+    return Status::OK;
+  }
+  if (!has_leaf_entry_) {
+    // When applied one by one on an empty tree, changes split the empty root
+    // node and keep it as the right-most leaf, until a level 0 entry is added
+    // to it. Reproduce this so that both methods build the same tree.
+    levels_[1].children.back() = empty_node_id.ToString();
+  }
+  uint8_t root_level = levels_.size() - 1;
+  for (uint8_t l = 0; l < root_level; ++l) {
+    RETURN_ON_ERROR(WriteLevel(l));
+  }
+  PendingNode& root = levels_[root_level];
+  RETURN_ON_ERROR(page_storage_->TreeNodeFromEntries(
+      root_level, root.entries, root.children, root.subtree_sizes, object_id));
+  new_ids_->insert(*object_id);
+  levels_.clear();
+  return Status::OK;
+}
+
+Status BulkBuilder::WriteLevel(uint8_t level) {
+  PendingNode& node = levels_[level];
+  if (node.entries.empty() && node.children[0].empty()) {
+    return Status::OK;
+  }
+  ObjectId object_id;
+  RETURN_ON_ERROR(page_storage_->TreeNodeFromEntries(
+      level, node.entries, node.children, node.subtree_sizes, &object_id));
+  new_ids_->insert(object_id);
+
+  uint64_t subtree_size = node.entries.size();
+  for (uint64_t size : node.subtree_sizes) {
+    subtree_size += size;
+  }
+  PendingNode& parent = levels_[level + 1];
+  parent.children.back() = std::move(object_id);
+  parent.subtree_sizes.back() = subtree_size;
+  node = PendingNode();
+  return Status::OK;
+}
+
+// Builds the tree containing the entries of |changes| with |BulkBuilder|.
+// |empty_node_id| must be the id of the empty node: deletions are ignored.
+Status BuildFromChanges(const NodeLevelCalculator* node_level_calculator,
+                        SynchronousStorage* page_storage,
+                        ObjectIdView empty_node_id,
+                        std::unique_ptr<Iterator<const EntryChange>> changes,
+                        ObjectId* object_id,
+                        std::unordered_set<ObjectId>* new_ids) {
+  BulkBuilder builder(page_storage, new_ids);
+  while (changes->Valid()) {
+    EntryChange change = std::move(**changes);
+    changes->Next();
+
+    if (change.deleted) {
+      continue;
     }
+    uint8_t level = node_level_calculator->GetNodeLevel(change.entry.key);
+    RETURN_ON_ERROR(builder.Add(std::move(change.entry), level));
   }
+
+  if (changes->GetStatus() != Status::OK) {
+    return changes->GetStatus();
+  }
+  return builder.Finish(empty_node_id, object_id);
 }
 
-// Apply |changes| on |root|. This is called recursively until |changes| is not
-// valid anymore. At this point, build is called on |root|.
+// Apply |changes| on |root|, in batches of |kChangeBatchSize| changes, until
+// |changes| is not valid anymore. At this point, build is called on |root|.
 Status ApplyChangesOnRoot(const NodeLevelCalculator* node_level_calculator,
                           SynchronousStorage* page_storage,
                           NodeBuilder root,
                           std::unique_ptr<Iterator<const EntryChange>> changes,
                           ObjectId* object_id,
                           std::unordered_set<ObjectId>* new_ids) {
-  Status status;
+  ChangeBatch batch;
   while (changes->Valid()) {
-    EntryChange change = std::move(**changes);
-    changes->Next();
+    batch.changes.clear();
+    batch.levels.clear();
+    while (changes->Valid() && batch.changes.size() < kChangeBatchSize) {
+      batch.changes.push_back(std::move(**changes));
+      batch.levels.push_back(node_level_calculator->GetNodeLevel(
+          batch.changes.back().entry.key));
+      changes->Next();
+    }
 
-    bool did_mutate;
-    status = root.Apply(node_level_calculator, page_storage, std::move(change),
-                        &did_mutate);
-    if (status != Status::OK) {
-      return status;
+    size_t index = 0;
+    while (index < batch.changes.size()) {
+      bool did_mutate;
+      RETURN_ON_ERROR(root.ApplyGroup(node_level_calculator, page_storage,
+                                      &batch, &index, batch.changes.size(),
+                                      &did_mutate));
     }
   }
 
@@ -621,28 +985,35 @@ const NodeLevelCalculator* GetDefaultNodeLevelCalculator() {
 void ApplyChanges(
     coroutine::CoroutineService* coroutine_service,
     PageStorage* page_storage,
+    TreeNodeCache* tree_node_cache,
     ObjectIdView root_id,
     std::unique_ptr<Iterator<const EntryChange>> changes,
     std::function<void(Status, ObjectId, std::unordered_set<ObjectId>)>
         callback,
     const NodeLevelCalculator* node_level_calculator) {
   coroutine_service->StartCoroutine(ftl::MakeCopyable([
-    page_storage, root_id = root_id.ToString(), changes = std::move(changes),
-    callback = std::move(callback), node_level_calculator
+    page_storage, tree_node_cache, root_id = root_id.ToString(),
+    changes = std::move(changes), callback = std::move(callback),
+    node_level_calculator
   ](coroutine::CoroutineHandler * handler) mutable {
-    SynchronousStorage storage(page_storage, handler);
+    SynchronousStorage storage(page_storage, tree_node_cache, handler);
 
     NodeBuilder root;
-    Status status = NodeBuilder::FromId(&storage, std::move(root_id), &root);
+    Status status = NodeBuilder::FromId(&storage, root_id, &root);
     if (status != Status::OK) {
       callback(status, "", {});
       return;
     }
     ObjectId object_id;
     std::unordered_set<ObjectId> new_ids;
-    status =
-        ApplyChangesOnRoot(node_level_calculator, &storage, std::move(root),
-                           std::move(changes), &object_id, &new_ids);
+    if (root.IsEmptyNode()) {
+      status = BuildFromChanges(node_level_calculator, &storage, root_id,
+                                std::move(changes), &object_id, &new_ids);
+    } else {
+      status =
+          ApplyChangesOnRoot(node_level_calculator, &storage, std::move(root),
+                             std::move(changes), &object_id, &new_ids);
+    }
     if (status != Status::OK) {
       callback(status, "", {});
       return;
@@ -9,6 +9,7 @@
 #include <unordered_set>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
 #include "apps/ledger/src/storage/public/iterator.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -28,10 +29,14 @@ const NodeLevelCalculator* GetDefaultNodeLevelCalculator();
 // Applies changes provided by |changes| to the BTree starting at |root_id|.
 // |changes| must provide |EntryChange| objects sorted by their key. The
 // callback will provide the status of the operation, the id of the new root
-// and the list of ids of all new nodes created after the changes.
+// and the list of ids of all new nodes created after the changes. If the tree
+// is empty, it is built from the leaves up in a single pass over |changes|,
+// which results in the same tree as applying the changes one by one. Nodes are
+// read from, and new nodes added to, |tree_node_cache| if it is not null.
 void ApplyChanges(
     coroutine::CoroutineService* coroutine_service,
     PageStorage* page_storage,
+    TreeNodeCache* tree_node_cache,
     ObjectIdView root_id,
     std::unique_ptr<Iterator<const EntryChange>> changes,
     std::function<void(Status, ObjectId, std::unordered_set<ObjectId>)>
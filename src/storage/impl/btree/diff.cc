@@ -253,12 +253,14 @@ class IteratorPair {
 
   // Send a diff using the right iterator.
   bool SendRight() {
-    return on_next_({right_.CurrentEntry(), !diff_from_left_to_right_});
+    return on_next_(
+        {ToEntry(right_.CurrentEntry()), !diff_from_left_to_right_});
   }
 
   // Send a diff using the left iterator.
   bool SendLeft() {
-    return on_next_({left_.CurrentEntry(), diff_from_left_to_right_});
+    return on_next_(
+        {ToEntry(left_.CurrentEntry()), diff_from_left_to_right_});
   }
 
   const std::function<bool(EntryChange)>& on_next_;
@@ -296,16 +298,18 @@ Status ForEachDiffInternal(SynchronousStorage* storage,
 
 void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  PageStorage* page_storage,
+                 TreeNodeCache* tree_node_cache,
                  ObjectIdView base_root_id,
                  ObjectIdView other_root_id,
                  std::string min_key,
                  std::function<bool(EntryChange)> on_next,
                  std::function<void(Status)> on_done) {
   coroutine_service->StartCoroutine([
-    page_storage, base_root_id, other_root_id, on_next = std::move(on_next),
-    min_key = std::move(min_key), on_done = std::move(on_done)
+    page_storage, tree_node_cache, base_root_id, other_root_id,
+    on_next = std::move(on_next), min_key = std::move(min_key),
+    on_done = std::move(on_done)
   ](coroutine::CoroutineHandler * handler) {
-    SynchronousStorage storage(page_storage, handler);
+    SynchronousStorage storage(page_storage, tree_node_cache, handler);
 
     on_done(ForEachDiffInternal(&storage, base_root_id, other_root_id,
                                 std::move(min_key), on_next));
@@ -18,9 +18,11 @@ namespace btree {
 // |base_root_id| and |other_root_id| and calls |on_next| on found differences.
 // Returning false from |on_next| will immediately stop the iteration. |on_done|
 // is called once, upon successfull completion, i.e. when there are no more
-// differences or iteration was interrupted, or if an error occurs.
+// differences or iteration was interrupted, or if an error occurs. Nodes are
+// read through |tree_node_cache| if it is not null.
 void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  PageStorage* page_storage,
+                 TreeNodeCache* tree_node_cache,
                  ObjectIdView base_root_id,
                  ObjectIdView other_root_id,
                  std::string min_key,
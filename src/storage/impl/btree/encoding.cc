@@ -65,6 +65,23 @@ bool CheckValidTreeNodeSerialization(ftl::StringView data) {
     return false;
   }
 
+  // Check that the subtree sizes, if any, match the children.
+  if (tree_node->subtree_sizes()) {
+    const auto* subtree_sizes = tree_node->subtree_sizes();
+    if (subtree_sizes->size() != tree_node->entries()->size() + 1) {
+      return false;
+    }
+    size_t next_child = 0;
+    for (size_t i = 0; i < subtree_sizes->size(); ++i) {
+      if (next_child < tree_node->children()->size() &&
+          tree_node->children()->Get(next_child)->index() == i) {
+        ++next_child;
+      } else if (subtree_sizes->Get(i) != 0) {
+        return false;
+      }
+    }
+  }
+
   // Check that keys are in order.
   auto it = std::adjacent_find(
       tree_node->entries()->begin(), tree_node->entries()->end(),
@@ -81,7 +98,9 @@ bool CheckValidTreeNodeSerialization(ftl::StringView data) {
 
 std::string EncodeNode(uint8_t level,
                        const std::vector<Entry>& entries,
-                       const std::vector<ObjectId>& children) {
+                       const std::vector<ObjectId>& children,
+                       const std::vector<uint64_t>& subtree_sizes) {
+  FTL_DCHECK(subtree_sizes.empty() || subtree_sizes.size() == children.size());
   flatbuffers::FlatBufferBuilder builder;
 
   auto entries_offsets = builder.CreateVector(
@@ -115,8 +134,17 @@ std::string EncodeNode(uint8_t level,
             ++current_index;
           }));
 
-  builder.Finish(
-      CreateTreeNodeStorage(builder, entries_offsets, children_offsets, level));
+  // The subtree sizes of a node without children are all 0, and are not
+  // stored: leaves keep the encoding, and so the id, they had before sizes
+  // were added.
+  flatbuffers::Offset<flatbuffers::Vector<uint64_t>> subtree_sizes_offset;
+  if (children_count > 0 && !subtree_sizes.empty()) {
+    subtree_sizes_offset = builder.CreateVector(subtree_sizes);
+  }
+
+  builder.Finish(CreateTreeNodeStorage(builder, entries_offsets,
+                                       children_offsets, level,
+                                       subtree_sizes_offset));
 
   return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
                      builder.GetSize());
@@ -147,4 +175,55 @@ bool DecodeNode(ftl::StringView data,
 
   return true;
 }
+
+bool DecodeNodeView(ftl::StringView data,
+                    uint8_t* level,
+                    std::vector<EntryView>* res_entries,
+                    std::vector<ObjectIdView>* res_children) {
+  FTL_DCHECK(CheckValidTreeNodeSerialization(data));
+
+  const TreeNodeStorage* tree_node =
+      GetTreeNodeStorage(reinterpret_cast<const unsigned char*>(data.data()));
+
+  *level = tree_node->level();
+  res_entries->clear();
+  res_entries->reserve(tree_node->entries()->size());
+  for (const auto* entry_storage : *(tree_node->entries())) {
+    res_entries->push_back(EntryView{entry_storage->key(),
+                                     entry_storage->object(),
+                                     ToKeyPriority(entry_storage->priority())});
+  }
+  res_children->clear();
+  res_children->reserve(tree_node->entries()->size() + 1);
+  for (const auto* child_storage : *(tree_node->children())) {
+    while (res_children->size() < child_storage->index()) {
+      res_children->push_back(ftl::StringView());
+    }
+    res_children->push_back(&child_storage->object_id());
+  }
+  while (res_children->size() < tree_node->entries()->size() + 1) {
+    res_children->push_back(ftl::StringView());
+  }
+
+  return true;
+}
+
+bool DecodeSubtreeSizes(ftl::StringView data,
+                        std::vector<uint64_t>* subtree_sizes) {
+  FTL_DCHECK(CheckValidTreeNodeSerialization(data));
+
+  const TreeNodeStorage* tree_node =
+      GetTreeNodeStorage(reinterpret_cast<const unsigned char*>(data.data()));
+
+  subtree_sizes->clear();
+  if (!tree_node->subtree_sizes()) {
+    if (tree_node->children()->size() == 0) {
+      subtree_sizes->resize(tree_node->entries()->size() + 1, 0);
+    }
+    return true;
+  }
+  subtree_sizes->assign(tree_node->subtree_sizes()->begin(),
+                        tree_node->subtree_sizes()->end());
+  return true;
+}
 }  // namespace storage
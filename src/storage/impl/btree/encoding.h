@@ -6,6 +6,7 @@
 #define APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_ENCODING_H_
 
 #include <string>
+#include <vector>
 
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/ftl/strings/string_view.h"
@@ -14,15 +15,33 @@ namespace storage {
 
 bool CheckValidTreeNodeSerialization(ftl::StringView data);
 
-std::string EncodeNode(uint8_t level,
-                       const std::vector<Entry>& entries,
-                       const std::vector<ObjectId>& children);
+// Encodes a node with the given content. If |subtree_sizes| is not empty, it
+// must hold the number of entries in the subtree of each element of
+// |children|, and is stored with the node, unless the node has no children.
+std::string EncodeNode(
+    uint8_t level,
+    const std::vector<Entry>& entries,
+    const std::vector<ObjectId>& children,
+    const std::vector<uint64_t>& subtree_sizes = std::vector<uint64_t>());
 
 bool DecodeNode(ftl::StringView data,
                 uint8_t* level,
                 std::vector<Entry>* entries,
                 std::vector<ObjectId>* children);
 
+// Decodes the node encoded in |data| without copying its content: the keys,
+// object ids and children ids are views on |data|, which must outlive them.
+bool DecodeNodeView(ftl::StringView data,
+                    uint8_t* level,
+                    std::vector<EntryView>* entries,
+                    std::vector<ObjectIdView>* children);
+
+// Stores in |subtree_sizes| the number of entries in the subtree of each child
+// of the node encoded in |data|. They are all 0 if the node has no children.
+// Otherwise, |subtree_sizes| is left empty if they are not stored in the node.
+bool DecodeSubtreeSizes(ftl::StringView data,
+                        std::vector<uint64_t>* subtree_sizes);
+
 }  // namespace storage
 
 #endif  // APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_ENCODING_H_
@@ -75,6 +75,35 @@ TEST(EncodingTest, MoreEntries) {
   EXPECT_EQ(children, res_children);
 }
 
+TEST(EncodingTest, DecodeView) {
+  uint8_t level = 2;
+  std::vector<Entry> entries = {
+      {"key1", MakeObjectId("abc"), KeyPriority::EAGER},
+      {"key2", MakeObjectId("def"), KeyPriority::LAZY},
+      {"key3", MakeObjectId("geh"), KeyPriority::EAGER}};
+  std::vector<ObjectId> children = {"", MakeObjectId("child_2"), "",
+                                    MakeObjectId("child_4")};
+
+  std::string bytes = EncodeNode(level, entries, children);
+
+  uint8_t res_level;
+  std::vector<EntryView> res_entries;
+  std::vector<ObjectIdView> res_children;
+  EXPECT_TRUE(DecodeNodeView(bytes, &res_level, &res_entries, &res_children));
+  EXPECT_EQ(level, res_level);
+  ASSERT_EQ(entries.size(), res_entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(entries[i], ToEntry(res_entries[i]));
+    // The decoded entries point into the encoded data.
+    EXPECT_LE(bytes.data(), res_entries[i].key.data());
+    EXPECT_GT(bytes.data() + bytes.size(), res_entries[i].key.data());
+  }
+  ASSERT_EQ(children.size(), res_children.size());
+  for (size_t i = 0; i < children.size(); ++i) {
+    EXPECT_EQ(children[i], res_children[i].ToString());
+  }
+}
+
 TEST(EncodingTest, ZeroByte) {
   uint8_t level = 13;
   std::vector<Entry> entries = {
@@ -93,6 +122,41 @@ TEST(EncodingTest, ZeroByte) {
   EXPECT_EQ(children, res_children);
 }
 
+TEST(EncodingTest, SubtreeSizes) {
+  uint8_t level = 1;
+  std::vector<Entry> entries = {
+      {"key1", MakeObjectId("abc"), KeyPriority::EAGER},
+      {"key2", MakeObjectId("def"), KeyPriority::LAZY}};
+  std::vector<ObjectId> children = {MakeObjectId("child_1"), "",
+                                    MakeObjectId("child_3")};
+  std::vector<uint64_t> subtree_sizes = {12, 0, 3};
+
+  std::string bytes = EncodeNode(level, entries, children, subtree_sizes);
+
+  uint8_t res_level;
+  std::vector<Entry> res_entries;
+  std::vector<ObjectId> res_children;
+  std::vector<uint64_t> res_subtree_sizes;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children));
+  EXPECT_TRUE(DecodeSubtreeSizes(bytes, &res_subtree_sizes));
+  EXPECT_EQ(entries, res_entries);
+  EXPECT_EQ(children, res_children);
+  EXPECT_EQ(subtree_sizes, res_subtree_sizes);
+
+  // Nodes encoded without their subtree sizes are still valid.
+  bytes = EncodeNode(level, entries, children);
+  EXPECT_TRUE(CheckValidTreeNodeSerialization(bytes));
+  EXPECT_TRUE(DecodeSubtreeSizes(bytes, &res_subtree_sizes));
+  EXPECT_TRUE(res_subtree_sizes.empty());
+
+  // The sizes of nodes without children are not stored, and are all 0.
+  children = {"", "", ""};
+  bytes = EncodeNode(0, entries, children, {0, 0, 0});
+  EXPECT_EQ(EncodeNode(0, entries, children), bytes);
+  EXPECT_TRUE(DecodeSubtreeSizes(bytes, &res_subtree_sizes));
+  EXPECT_EQ(std::vector<uint64_t>({0, 0, 0}), res_subtree_sizes);
+}
+
 std::string ToString(flatbuffers::FlatBufferBuilder* builder) {
   return std::string(reinterpret_cast<const char*>(builder->GetBufferPointer()),
                      builder->GetSize());
@@ -158,6 +222,24 @@ TEST(EncodingTest, Errors) {
               })),
       builder.CreateVectorOfStructs(children, 0)));
   EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
+
+  // Subtree sizes must be given for all children.
+  builder.Clear();
+  builder.Finish(CreateTreeNodeStorage(
+      builder,
+      builder.CreateVector(std::vector<flatbuffers::Offset<EntryStorage>>()),
+      builder.CreateVectorOfStructs(children, 0), 0,
+      builder.CreateVector(std::vector<uint64_t>{0, 0})));
+  EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
+
+  // An empty child cannot have entries.
+  builder.Clear();
+  builder.Finish(CreateTreeNodeStorage(
+      builder,
+      builder.CreateVector(std::vector<flatbuffers::Offset<EntryStorage>>()),
+      builder.CreateVectorOfStructs(children, 0), 0,
+      builder.CreateVector(std::vector<uint64_t>{1})));
+  EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
 }
 
 }  // namespace
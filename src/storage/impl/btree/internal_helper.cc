@@ -9,17 +9,31 @@
 namespace storage {
 namespace btree {
 
-// Returns the index of |entries| that contains |key|, or the first entry that
-// has key greather than |key|. In the second case, the key, if present, will
-// be found in the children at the returned index.
-size_t GetEntryOrChildIndex(const std::vector<Entry> entries,
-                            ftl::StringView key) {
+namespace {
+
+template <typename E>
+size_t GetIndex(const std::vector<E>& entries, ftl::StringView key) {
   auto lower = std::lower_bound(
       entries.begin(), entries.end(), key,
-      [](const Entry& entry, ftl::StringView key) { return entry.key < key; });
+      [](const E& entry, ftl::StringView key) { return entry.key < key; });
   FTL_DCHECK(lower == entries.end() || lower->key >= key);
   return lower - entries.begin();
 }
 
+}  // namespace
+
+// Returns the index of |entries| that contains |key|, or the first entry that
+// has key greather than |key|. In the second case, the key, if present, will
+// be found in the children at the returned index.
+size_t GetEntryOrChildIndex(const std::vector<Entry>& entries,
+                            ftl::StringView key) {
+  return GetIndex(entries, key);
+}
+
+size_t GetEntryOrChildIndex(const std::vector<EntryView>& entries,
+                            ftl::StringView key) {
+  return GetIndex(entries, key);
+}
+
 }  // namespace btree
 }  // namespace storage
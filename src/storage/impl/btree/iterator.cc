@@ -13,6 +13,24 @@ namespace btree {
 
 namespace {
 
+// Calls |on_next| on the entries starting from the current position of
+// |iterator|. If |on_next| returns false, the iterator is left on the
+// corresponding entry.
+Status ForEachEntryInternal(
+    BTreeIterator* iterator,
+    const std::function<bool(EntryAndNodeId)>& on_next) {
+  while (!iterator->Finished()) {
+    RETURN_ON_ERROR(iterator->AdvanceToValue());
+    if (iterator->HasValue()) {
+      if (!on_next({iterator->CurrentEntry(), iterator->GetNodeId()})) {
+        return Status::OK;
+      }
+      RETURN_ON_ERROR(iterator->Advance());
+    }
+  }
+  return Status::OK;
+}
+
 Status ForEachEntryInternal(
     SynchronousStorage* storage,
     ObjectIdView root_id,
@@ -21,14 +39,45 @@ Status ForEachEntryInternal(
   BTreeIterator iterator(storage);
   RETURN_ON_ERROR(iterator.Init(root_id));
   RETURN_ON_ERROR(iterator.SkipTo(min_key));
-  while (!iterator.Finished()) {
-    RETURN_ON_ERROR(iterator.AdvanceToValue());
-    if (iterator.HasValue()) {
-      if (!on_next({iterator.CurrentEntry(), iterator.GetNodeId()})) {
-        return Status::OK;
-      }
-      RETURN_ON_ERROR(iterator.Advance());
+  return ForEachEntryInternal(&iterator, on_next);
+}
+
+// Calls |on_next| on the entries of the subtree rooted at |node_id| with keys
+// in [|min_key|, |max_key|), in decreasing order. Sets |interrupted| to true
+// if |on_next| returns false.
+Status ForEachEntryReverseInternal(
+    SynchronousStorage* storage,
+    ObjectIdView node_id,
+    ftl::StringView min_key,
+    ftl::StringView max_key,
+    const std::function<bool(EntryAndNodeId)>& on_next,
+    bool* interrupted) {
+  if (node_id.empty()) {
+    return Status::OK;
+  }
+  std::unique_ptr<const TreeNode> node;
+  RETURN_ON_ERROR(storage->TreeNodeFromId(node_id, &node));
+  const std::vector<EntryView>& entries = node->entries();
+  const std::vector<ObjectIdView>& children = node->children_ids();
+
+  // Entries from |end| and the children after them only hold keys that are
+  // greater than or equal to |max_key|.
+  size_t end = max_key.empty() ? entries.size()
+                               : GetEntryOrChildIndex(entries, max_key);
+  RETURN_ON_ERROR(ForEachEntryReverseInternal(
+      storage, children[end], min_key, max_key, on_next, interrupted));
+  for (size_t i = end; i > 0 && !*interrupted; --i) {
+    const EntryView& entry = entries[i - 1];
+    // Entries and children before this one only hold smaller keys.
+    if (entry.key < min_key) {
+      return Status::OK;
     }
+    if (!on_next({entry, node->GetId()})) {
+      *interrupted = true;
+      return Status::OK;
+    }
+    RETURN_ON_ERROR(ForEachEntryReverseInternal(
+        storage, children[i - 1], min_key, max_key, on_next, interrupted));
   }
   return Status::OK;
 }
@@ -41,6 +90,10 @@ BTreeIterator::BTreeIterator(BTreeIterator&&) = default;
 
 BTreeIterator& BTreeIterator::operator=(BTreeIterator&&) = default;
 
+void BTreeIterator::SetStorage(SynchronousStorage* storage) {
+  storage_ = storage;
+}
+
 Status BTreeIterator::Init(ObjectIdView node_id) {
   return Descend(node_id);
 }
@@ -94,7 +147,7 @@ bool BTreeIterator::Finished() const {
   return stack_.empty();
 }
 
-const Entry& BTreeIterator::CurrentEntry() const {
+const EntryView& BTreeIterator::CurrentEntry() const {
   FTL_DCHECK(HasValue());
   return CurrentNode().entries()[CurrentIndex()];
 }
@@ -165,6 +218,7 @@ Status BTreeIterator::Descend(ftl::StringView node_id) {
 
 void GetObjectIds(coroutine::CoroutineService* coroutine_service,
                   PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
                   ObjectIdView root_id,
                   std::function<void(Status, std::set<ObjectId>)> callback) {
   FTL_DCHECK(!root_id.empty());
@@ -172,7 +226,7 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
   object_ids->insert(root_id.ToString());
 
   auto on_next = [object_ids = object_ids.get()](EntryAndNodeId e) {
-    object_ids->insert(e.entry.object_id);
+    object_ids->insert(e.entry.object_id.ToString());
     object_ids->insert(e.node_id);
     return true;
   };
@@ -185,12 +239,13 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
     }
     callback(status, std::move(*object_ids));
   });
-  ForEachEntry(coroutine_service, page_storage, root_id, "", std::move(on_next),
-               std::move(on_done));
+  ForEachEntry(coroutine_service, page_storage, tree_node_cache, root_id, "",
+               std::move(on_next), std::move(on_done));
 }
 
 void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
                         PageStorage* page_storage,
+                        TreeNodeCache* tree_node_cache,
                         ObjectIdView root_id,
                         std::function<void(Status)> callback) {
   ftl::RefPtr<callback::Waiter<Status, std::unique_ptr<const Object>>> waiter_ =
@@ -213,26 +268,89 @@ void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
       callback(s);
     });
   };
-  ForEachEntry(coroutine_service, page_storage, root_id, "", std::move(on_next),
-               std::move(on_done));
+  ForEachEntry(coroutine_service, page_storage, tree_node_cache, root_id, "",
+               std::move(on_next), std::move(on_done));
 }
 
 void ForEachEntry(coroutine::CoroutineService* coroutine_service,
                   PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
                   ObjectIdView root_id,
                   std::string min_key,
                   std::function<bool(EntryAndNodeId)> on_next,
                   std::function<void(Status)> on_done) {
   FTL_DCHECK(!root_id.empty());
   coroutine_service->StartCoroutine([
-    page_storage, root_id, min_key = std::move(min_key),
+    page_storage, tree_node_cache, root_id, min_key = std::move(min_key),
     on_next = std::move(on_next), on_done = std::move(on_done)
   ](coroutine::CoroutineHandler * handler) {
-    SynchronousStorage storage(page_storage, handler);
+    SynchronousStorage storage(page_storage, tree_node_cache, handler);
 
     on_done(ForEachEntryInternal(&storage, root_id, min_key, on_next));
   });
 }
 
+void ForEachEntryReverse(coroutine::CoroutineService* coroutine_service,
+                         PageStorage* page_storage,
+                         TreeNodeCache* tree_node_cache,
+                         ObjectIdView root_id,
+                         std::string min_key,
+                         std::string max_key,
+                         std::function<bool(EntryAndNodeId)> on_next,
+                         std::function<void(Status)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  coroutine_service->StartCoroutine([
+    page_storage, tree_node_cache, root_id, min_key = std::move(min_key),
+    max_key = std::move(max_key), on_next = std::move(on_next),
+    on_done = std::move(on_done)
+  ](coroutine::CoroutineHandler * handler) {
+    SynchronousStorage storage(page_storage, tree_node_cache, handler);
+
+    bool interrupted = false;
+    on_done(ForEachEntryReverseInternal(&storage, root_id, min_key, max_key,
+                                        on_next, &interrupted));
+  });
+}
+
+void ForEachEntryFrom(
+    coroutine::CoroutineService* coroutine_service,
+    PageStorage* page_storage,
+    TreeNodeCache* tree_node_cache,
+    ObjectIdView root_id,
+    std::string min_key,
+    std::unique_ptr<BTreeIterator> iterator,
+    std::function<bool(EntryAndNodeId)> on_next,
+    std::function<void(Status, std::unique_ptr<BTreeIterator>)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  coroutine_service->StartCoroutine(ftl::MakeCopyable([
+    page_storage, tree_node_cache, root_id, min_key = std::move(min_key),
+    iterator = std::move(iterator), on_next = std::move(on_next),
+    on_done = std::move(on_done)
+  ](coroutine::CoroutineHandler * handler) mutable {
+    SynchronousStorage storage(page_storage, tree_node_cache, handler);
+
+    Status status = Status::OK;
+    if (iterator) {
+      iterator->SetStorage(&storage);
+    } else {
+      iterator = std::make_unique<BTreeIterator>(&storage);
+      status = iterator->Init(root_id);
+      if (status == Status::OK) {
+        status = iterator->SkipTo(min_key);
+      }
+    }
+    if (status == Status::OK) {
+      status = ForEachEntryInternal(iterator.get(), on_next);
+    }
+    if (status != Status::OK || iterator->Finished()) {
+      on_done(status, nullptr);
+      return;
+    }
+    // |storage| is only valid in this coroutine.
+    iterator->SetStorage(nullptr);
+    on_done(Status::OK, std::move(iterator));
+  }));
+}
+
 }  // namespace btree
 }  // namespace storage
@@ -20,9 +20,10 @@
 namespace storage {
 namespace btree {
 
-// An entry and the id of the tree node in which it is stored.
+// An entry and the id of the tree node in which it is stored. Both are only
+// valid during the call to which they are given.
 struct EntryAndNodeId {
-  const Entry& entry;
+  const EntryView& entry;
   const ObjectId& node_id;
 };
 
@@ -35,6 +36,11 @@ class BTreeIterator {
   BTreeIterator(BTreeIterator&&);
   BTreeIterator& operator=(BTreeIterator&&);
 
+  // Changes the storage used to load tree nodes. This allows to keep the
+  // iterator after the end of the coroutine of its storage, and to resume the
+  // iteration in another one.
+  void SetStorage(SynchronousStorage* storage);
+
   // Initialize the iterator with the root node of the tree.
   Status Init(ObjectIdView node_id);
 
@@ -59,8 +65,8 @@ class BTreeIterator {
   bool Finished() const;
 
   // Returns the current value of the iterator. It is only valid when
-  // |HasValue| is true.
-  const Entry& CurrentEntry() const;
+  // |HasValue| is true, and until the iterator is advanced.
+  const EntryView& CurrentEntry() const;
 
   // Returns the identifier of the node at the top of the stack.
   const std::string& GetNodeId() const;
@@ -94,11 +100,15 @@ class BTreeIterator {
   FTL_DISALLOW_COPY_AND_ASSIGN(BTreeIterator);
 };
 
+// The functions below read the nodes of the tree through |tree_node_cache|,
+// which may be null, before falling back to |page_storage|.
+
 // Retrieves the ids of all objects in the BTree, i.e tree nodes and values of
 // entries in the tree. After a successfull call, |callback| will be called
 // with the set of results.
 void GetObjectIds(coroutine::CoroutineService* coroutine_service,
                   PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
                   ObjectIdView root_id,
                   std::function<void(Status, std::set<ObjectId>)> callback);
 
@@ -107,6 +117,7 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
 // all corresponding objects.
 void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
                         PageStorage* page_storage,
+                        TreeNodeCache* tree_node_cache,
                         ObjectIdView root_id,
                         std::function<void(Status)> callback);
 
@@ -119,11 +130,42 @@ void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
 // occurs.
 void ForEachEntry(coroutine::CoroutineService* coroutine_service,
                   PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
                   ObjectIdView root_id,
                   std::string min_key,
                   std::function<bool(EntryAndNodeId)> on_next,
                   std::function<void(Status)> on_done);
 
+// Iterates through the nodes of the tree with the given root and calls
+// |on_next| on found entries with a key in [|min_key|, |max_key|), in
+// decreasing order of keys. An empty |max_key| means that the range has no
+// upper bound. Subtrees whose keys are all outside of the range are not read.
+// As for |ForEachEntry|, returning false from |on_next| interrupts the
+// iteration, and |on_done| is called once, upon completion or on error.
+void ForEachEntryReverse(coroutine::CoroutineService* coroutine_service,
+                         PageStorage* page_storage,
+                         TreeNodeCache* tree_node_cache,
+                         ObjectIdView root_id,
+                         std::string min_key,
+                         std::string max_key,
+                         std::function<bool(EntryAndNodeId)> on_next,
+                         std::function<void(Status)> on_done);
+
+// Same as |ForEachEntry|, but allows to resume the iteration later. If
+// |iterator| is not null, the iteration continues from its current position
+// instead of searching |min_key| from the root. If |on_next| interrupts the
+// iteration, |on_done| receives an iterator positioned on the entry for which
+// |on_next| returned false. Otherwise, or on error, the iterator is null.
+void ForEachEntryFrom(
+    coroutine::CoroutineService* coroutine_service,
+    PageStorage* page_storage,
+    TreeNodeCache* tree_node_cache,
+    ObjectIdView root_id,
+    std::string min_key,
+    std::unique_ptr<BTreeIterator> iterator,
+    std::function<bool(EntryAndNodeId)> on_next,
+    std::function<void(Status, std::unique_ptr<BTreeIterator>)> on_done);
+
 }  // namespace btree
 }  // namespace storage
 
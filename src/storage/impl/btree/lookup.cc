@@ -0,0 +1,296 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/btree/lookup.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node.h"
+#include "lib/ftl/functional/make_copyable.h"
+
+namespace storage {
+namespace btree {
+namespace {
+
+// State shared by all the nodes visited by a call to |GetEntries|.
+struct GetEntriesContext {
+  PageStorage* page_storage;
+  TreeNodeCache* tree_node_cache;
+  std::vector<std::string> keys;
+  // |entries[i]| holds the entry of |keys[i]| if |found[i]| is true.
+  std::vector<Entry> entries;
+  std::vector<bool> found;
+};
+
+// Searches the keys of |context| with an index in [|begin|, |end|) in the
+// subtree rooted at |node_id|. Keys that fall in the same child of a node are
+// searched together, so that the child is only read once.
+void GetEntriesInSubtree(std::shared_ptr<GetEntriesContext> context,
+                         ObjectIdView node_id,
+                         size_t begin,
+                         size_t end,
+                         std::function<void(Status)> on_done) {
+  TreeNode::FromId(context->page_storage, context->tree_node_cache, node_id, [
+    context, begin, end, on_done = std::move(on_done)
+  ](Status status, std::unique_ptr<const TreeNode> node) mutable {
+    if (status != Status::OK) {
+      on_done(status);
+      return;
+    }
+    auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
+    const std::vector<EntryView>& node_entries = node->entries();
+    size_t i = begin;
+    while (i < end) {
+      int index;
+      if (node->FindKeyOrChild(context->keys[i], &index) == Status::OK) {
+        node->GetEntry(index, &context->entries[i]);
+        context->found[i] = true;
+        ++i;
+        continue;
+      }
+      // The following keys belong to the same child as long as they are
+      // smaller than the entry following it.
+      size_t group_end = i + 1;
+      if (static_cast<size_t>(index) == node_entries.size()) {
+        group_end = end;
+      } else {
+        while (group_end < end &&
+               convert::ExtendedStringView(context->keys[group_end]) <
+                   node_entries[index].key) {
+          ++group_end;
+        }
+      }
+      ObjectIdView child_id = node->GetChildId(index);
+      if (!child_id.empty()) {
+        // |child_id| is only used before |node| is deleted.
+        GetEntriesInSubtree(context, child_id, i, group_end,
+                            waiter->NewCallback());
+      }
+      i = group_end;
+    }
+    waiter->Finalize(std::move(on_done));
+  });
+}
+
+// Counts the entries with a key in [|min_key|, |max_key|) in the subtree
+// rooted at |node_id|. An empty |max_key| means that the range has no upper
+// bound.
+void CountEntriesInSubtree(PageStorage* page_storage,
+                           TreeNodeCache* tree_node_cache,
+                           ObjectIdView node_id,
+                           std::string min_key,
+                           std::string max_key,
+                           std::function<void(Status, uint64_t)> on_done) {
+  if (node_id.empty()) {
+    on_done(Status::OK, 0);
+    return;
+  }
+  TreeNode::FromId(page_storage, tree_node_cache, node_id, [
+    page_storage, tree_node_cache, min_key = std::move(min_key),
+    max_key = std::move(max_key), on_done = std::move(on_done)
+  ](Status status, std::unique_ptr<const TreeNode> node) {
+    if (status != Status::OK) {
+      on_done(status, 0);
+      return;
+    }
+    // Entries in [|begin|, |end|) are in the range.
+    int begin;
+    node->FindKeyOrChild(min_key, &begin);
+    int end = node->GetKeyCount();
+    if (!max_key.empty()) {
+      node->FindKeyOrChild(max_key, &end);
+    }
+    FTL_DCHECK(begin <= end);
+    uint64_t count = end - begin;
+    // Only the children at |begin| and |end| can be partially in the range.
+    auto waiter = callback::Waiter<Status, uint64_t>::Create(Status::OK);
+    for (int i = begin; i <= end; ++i) {
+      std::string child_min_key = i == begin ? min_key : "";
+      std::string child_max_key = i == end ? max_key : "";
+      if (child_min_key.empty() && child_max_key.empty() &&
+          node->HasSubtreeSizes()) {
+        count += node->GetSubtreeSize(i);
+        continue;
+      }
+      // The child id is only used before |node| is deleted.
+      CountEntriesInSubtree(page_storage, tree_node_cache, node->GetChildId(i),
+                            std::move(child_min_key), std::move(child_max_key),
+                            waiter->NewCallback());
+    }
+    waiter->Finalize([ count, on_done = std::move(on_done) ](
+        Status status, std::vector<uint64_t> counts) {
+      if (status != Status::OK) {
+        on_done(status, 0);
+        return;
+      }
+      uint64_t result = count;
+      for (uint64_t child_count : counts) {
+        result += child_count;
+      }
+      on_done(Status::OK, result);
+    });
+  });
+}
+
+// Calls |on_done| with the number of entries in the subtree of each child of
+// |node|. The sizes that are not stored in |node| are computed by counting the
+// entries of the corresponding subtree.
+void GetSubtreeSizes(
+    PageStorage* page_storage,
+    TreeNodeCache* tree_node_cache,
+    const TreeNode& node,
+    std::function<void(Status, std::vector<uint64_t>)> on_done) {
+  if (node.HasSubtreeSizes()) {
+    std::vector<uint64_t> sizes;
+    for (int i = 0; i <= node.GetKeyCount(); ++i) {
+      sizes.push_back(node.GetSubtreeSize(i));
+    }
+    on_done(Status::OK, std::move(sizes));
+    return;
+  }
+  auto waiter = callback::Waiter<Status, uint64_t>::Create(Status::OK);
+  for (ObjectIdView child_id : node.children_ids()) {
+    CountEntriesInSubtree(page_storage, tree_node_cache, child_id, "", "",
+                          waiter->NewCallback());
+  }
+  waiter->Finalize(std::move(on_done));
+}
+
+}  // namespace
+
+void GetEntry(PageStorage* page_storage,
+              TreeNodeCache* tree_node_cache,
+              ObjectIdView root_id,
+              std::string key,
+              std::function<void(Status, Entry)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  TreeNode::FromId(page_storage, tree_node_cache, root_id, [
+    page_storage, tree_node_cache, key = std::move(key),
+    on_done = std::move(on_done)
+  ](Status status, std::unique_ptr<const TreeNode> node) mutable {
+    if (status != Status::OK) {
+      on_done(status, Entry());
+      return;
+    }
+    int index;
+    if (node->FindKeyOrChild(key, &index) == Status::OK) {
+      Entry entry;
+      node->GetEntry(index, &entry);
+      on_done(Status::OK, std::move(entry));
+      return;
+    }
+    ObjectIdView child_id = node->GetChildId(index);
+    if (child_id.empty()) {
+      on_done(Status::NOT_FOUND, Entry());
+      return;
+    }
+    // |child_id| is only used before |node| is deleted.
+    GetEntry(page_storage, tree_node_cache, child_id, std::move(key),
+             std::move(on_done));
+  });
+}
+
+void GetEntries(PageStorage* page_storage,
+                TreeNodeCache* tree_node_cache,
+                ObjectIdView root_id,
+                std::vector<std::string> keys,
+                std::function<void(Status, std::vector<Entry>)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  FTL_DCHECK(std::is_sorted(keys.begin(), keys.end()));
+  if (keys.empty()) {
+    on_done(Status::OK, std::vector<Entry>());
+    return;
+  }
+  auto context = std::make_shared<GetEntriesContext>();
+  context->page_storage = page_storage;
+  context->tree_node_cache = tree_node_cache;
+  context->entries.resize(keys.size());
+  context->found.resize(keys.size(), false);
+  context->keys = std::move(keys);
+  size_t key_count = context->keys.size();
+  GetEntriesInSubtree(context, root_id, 0, key_count, [
+    context, on_done = std::move(on_done)
+  ](Status status) {
+    if (status != Status::OK) {
+      on_done(status, std::vector<Entry>());
+      return;
+    }
+    std::vector<Entry> result;
+    for (size_t i = 0; i < context->keys.size(); ++i) {
+      if (context->found[i]) {
+        result.push_back(std::move(context->entries[i]));
+      }
+    }
+    on_done(Status::OK, std::move(result));
+  });
+}
+
+void CountEntries(PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
+                  ObjectIdView root_id,
+                  std::string min_key,
+                  std::string max_key,
+                  std::function<void(Status, uint64_t)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  if (!max_key.empty() && max_key <= min_key) {
+    on_done(Status::OK, 0);
+    return;
+  }
+  CountEntriesInSubtree(page_storage, tree_node_cache, root_id,
+                        std::move(min_key), std::move(max_key),
+                        std::move(on_done));
+}
+
+void GetEntryAtIndex(PageStorage* page_storage,
+                     TreeNodeCache* tree_node_cache,
+                     ObjectIdView root_id,
+                     uint64_t index,
+                     std::function<void(Status, Entry)> on_done) {
+  FTL_DCHECK(!root_id.empty());
+  TreeNode::FromId(page_storage, tree_node_cache, root_id, [
+    page_storage, tree_node_cache, index, on_done = std::move(on_done)
+  ](Status status, std::unique_ptr<const TreeNode> node) mutable {
+    if (status != Status::OK) {
+      on_done(status, Entry());
+      return;
+    }
+    const TreeNode* node_ptr = node.get();
+    GetSubtreeSizes(
+        page_storage, tree_node_cache, *node_ptr, ftl::MakeCopyable([
+          page_storage, tree_node_cache, index, node = std::move(node),
+          on_done = std::move(on_done)
+        ](Status status, std::vector<uint64_t> sizes) mutable {
+          if (status != Status::OK) {
+            on_done(status, Entry());
+            return;
+          }
+          for (int i = 0; i <= node->GetKeyCount(); ++i) {
+            if (index < sizes[i]) {
+              // The child id is only used before |node| is deleted.
+              GetEntryAtIndex(page_storage, tree_node_cache,
+                              node->GetChildId(i), index, std::move(on_done));
+              return;
+            }
+            index -= sizes[i];
+            if (i == node->GetKeyCount()) {
+              break;
+            }
+            if (index == 0) {
+              Entry entry;
+              node->GetEntry(i, &entry);
+              on_done(Status::OK, std::move(entry));
+              return;
+            }
+            --index;
+          }
+          on_done(Status::NOT_FOUND, Entry());
+        }));
+  });
+}
+
+}  // namespace btree
+}  // namespace storage
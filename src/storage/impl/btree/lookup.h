@@ -0,0 +1,72 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_LOOKUP_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_LOOKUP_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "apps/ledger/src/storage/public/types.h"
+
+namespace storage {
+namespace btree {
+
+// The functions below read the nodes of the tree through |tree_node_cache|,
+// which may be null, before falling back to |page_storage|.
+
+// Retrieves the entry with the given |key| in the tree with the given root and
+// calls |on_done| with the result. The status of |on_done| is |OK| on success,
+// |NOT_FOUND| if there is no such key in the tree or an error status on
+// failure. The tree is searched from the root to the leaves without using a
+// coroutine: |on_done| is called synchronously if all the nodes on the path
+// are available locally.
+void GetEntry(PageStorage* page_storage,
+              TreeNodeCache* tree_node_cache,
+              ObjectIdView root_id,
+              std::string key,
+              std::function<void(Status, Entry)> on_done);
+
+// Retrieves the entries with the given |keys| in the tree with the given root
+// and calls |on_done| with the result. |keys| must be sorted and must not
+// contain duplicates. All keys are searched in a single traversal of the tree:
+// a node on the path to several keys is only read once. On success, the
+// entries found are returned in the order of |keys|; keys that are not in the
+// tree have no corresponding entry.
+void GetEntries(PageStorage* page_storage,
+                TreeNodeCache* tree_node_cache,
+                ObjectIdView root_id,
+                std::vector<std::string> keys,
+                std::function<void(Status, std::vector<Entry>)> on_done);
+
+// Counts the entries of the tree with the given root whose key is in
+// [|min_key|, |max_key|) and calls |on_done| with the result. An empty
+// |max_key| means that the range has no upper bound. The size of a subtree
+// fully contained in the range is read from its parent node when available,
+// so that only the nodes on the paths to |min_key| and |max_key| are read.
+void CountEntries(PageStorage* page_storage,
+                  TreeNodeCache* tree_node_cache,
+                  ObjectIdView root_id,
+                  std::string min_key,
+                  std::string max_key,
+                  std::function<void(Status, uint64_t)> on_done);
+
+// Retrieves the entry at position |index|, in key order, in the tree with the
+// given root and calls |on_done| with the result. The status of |on_done| is
+// |OK| on success, |NOT_FOUND| if the tree has |index| entries or less, or an
+// error status on failure. If the nodes store the size of their subtrees, only
+// the nodes on the path to the entry are read.
+void GetEntryAtIndex(PageStorage* page_storage,
+                     TreeNodeCache* tree_node_cache,
+                     ObjectIdView root_id,
+                     uint64_t index,
+                     std::function<void(Status, Entry)> on_done);
+
+}  // namespace btree
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_LOOKUP_H_
@@ -8,8 +8,11 @@ namespace storage {
 namespace btree {
 
 SynchronousStorage::SynchronousStorage(PageStorage* page_storage,
+                                       TreeNodeCache* tree_node_cache,
                                        coroutine::CoroutineHandler* handler)
-    : page_storage_(page_storage), handler_(handler) {}
+    : page_storage_(page_storage),
+      tree_node_cache_(tree_node_cache),
+      handler_(handler) {}
 
 Status SynchronousStorage::TreeNodeFromId(
     ObjectIdView object_id,
@@ -20,7 +23,8 @@ Status SynchronousStorage::TreeNodeFromId(
           [this, &object_id](
               std::function<void(Status, std::unique_ptr<const TreeNode>)>
                   callback) {
-            TreeNode::FromId(page_storage_, object_id, std::move(callback));
+            TreeNode::FromId(page_storage_, tree_node_cache_, object_id,
+                             std::move(callback));
           },
           &status, result)) {
     return Status::ILLEGAL_STATE;
@@ -35,7 +39,8 @@ Status SynchronousStorage::TreeNodesFromIds(
       callback::Waiter<Status, std::unique_ptr<const TreeNode>>::Create(
           Status::OK);
   for (const auto object_id : object_ids) {
-    TreeNode::FromId(page_storage_, object_id, waiter->NewCallback());
+    TreeNode::FromId(page_storage_, tree_node_cache_, object_id,
+                     waiter->NewCallback());
   }
   Status status;
   if (coroutine::SyncCall(
@@ -53,14 +58,16 @@ Status SynchronousStorage::TreeNodeFromEntries(
     uint8_t level,
     const std::vector<Entry>& entries,
     const std::vector<ObjectId>& children,
+    const std::vector<uint64_t>& subtree_sizes,
     ObjectId* result) {
   Status status;
   if (coroutine::SyncCall(handler_,
-                          [this, level, &entries, &children](
+                          [this, level, &entries, &children, &subtree_sizes](
                               std::function<void(Status, ObjectId)> callback) {
-                            TreeNode::FromEntries(page_storage_, level, entries,
-                                                  children,
-                                                  std::move(callback));
+                            TreeNode::FromEntries(
+                                page_storage_, tree_node_cache_, level,
+                                entries, children, subtree_sizes,
+                                std::move(callback));
                           },
                           &status, result)) {
     return Status::ILLEGAL_STATE;
@@ -18,13 +18,16 @@ namespace storage {
 namespace btree {
 
 // Wrapper for TreeNode and PageStorage that uses coroutines to make
-// asynchronous calls look like synchronous ones.
+// asynchronous calls look like synchronous ones. Tree nodes are cached in
+// |tree_node_cache|, if not null.
 class SynchronousStorage {
  public:
   SynchronousStorage(PageStorage* page_storage,
+                     TreeNodeCache* tree_node_cache,
                      coroutine::CoroutineHandler* handler);
 
   PageStorage* page_storage() { return page_storage_; }
+  TreeNodeCache* tree_node_cache() { return tree_node_cache_; }
   coroutine::CoroutineHandler* handler() { return handler_; }
 
   Status TreeNodeFromId(ObjectIdView object_id,
@@ -36,10 +39,12 @@ class SynchronousStorage {
   Status TreeNodeFromEntries(uint8_t level,
                              const std::vector<Entry>& entries,
                              const std::vector<ObjectId>& children,
+                             const std::vector<uint64_t>& subtree_sizes,
                              ObjectId* result);
 
  private:
   PageStorage* page_storage_;
+  TreeNodeCache* tree_node_cache_;
   coroutine::CoroutineHandler* handler_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(SynchronousStorage);
@@ -18,63 +18,115 @@
 
 namespace storage {
 
+namespace {
+
+// Decodes the node encoded in |encoding| and stores the result, which keeps
+// the encoding alive, in |data|.
+Status DecodeData(std::string encoding,
+                  std::shared_ptr<const TreeNodeData>* data) {
+  auto result = std::make_shared<TreeNodeData>();
+  result->encoding = std::move(encoding);
+  if (!DecodeNodeView(result->encoding, &result->level, &result->entries,
+                      &result->children) ||
+      !DecodeSubtreeSizes(result->encoding, &result->subtree_sizes)) {
+    return Status::FORMAT_ERROR;
+  }
+  *data = std::move(result);
+  return Status::OK;
+}
+
+}  // namespace
+
 TreeNode::TreeNode(PageStorage* page_storage,
+                   TreeNodeCache* cache,
                    std::string id,
-                   uint8_t level,
-                   std::vector<Entry> entries,
-                   std::vector<ObjectId> children)
+                   std::shared_ptr<const TreeNodeData> data)
     : page_storage_(page_storage),
+      cache_(cache),
       id_(std::move(id)),
-      level_(level),
-      entries_(entries),
-      children_(children) {
-  FTL_DCHECK(entries_.size() + 1 == children_.size());
+      data_(std::move(data)) {
+  FTL_DCHECK(data_->entries.size() + 1 == data_->children.size());
 }
 
 TreeNode::~TreeNode() {}
 
 void TreeNode::FromId(
     PageStorage* page_storage,
+    TreeNodeCache* cache,
     ObjectIdView id,
     std::function<void(Status, std::unique_ptr<const TreeNode>)> callback) {
-  std::unique_ptr<const Object> object;
+  if (cache) {
+    std::shared_ptr<const TreeNodeData> data = cache->Get(id);
+    if (data) {
+      callback(Status::OK,
+               std::unique_ptr<const TreeNode>(new TreeNode(
+                   page_storage, cache, id.ToString(), std::move(data))));
+      return;
+    }
+  }
   page_storage->GetObject(id, PageStorage::Location::NETWORK, [
-    page_storage, callback = std::move(callback)
+    page_storage, cache, callback = std::move(callback)
   ](Status status, std::unique_ptr<const Object> object) {
     if (status != Status::OK) {
       callback(status, nullptr);
       return;
     }
     std::unique_ptr<const TreeNode> node;
-    status = FromObject(page_storage, std::move(object), &node);
+    status = FromObject(page_storage, cache, std::move(object), &node);
     callback(status, std::move(node));
   });
 }
 
 void TreeNode::Empty(PageStorage* page_storage,
                      std::function<void(Status, ObjectId)> callback) {
-  FromEntries(page_storage, 0u, std::vector<Entry>(), std::vector<ObjectId>(1),
+  FromEntries(page_storage, nullptr, 0u, std::vector<Entry>(),
+              std::vector<ObjectId>(1), std::vector<uint64_t>(1),
               std::move(callback));
 }
 
 void TreeNode::FromEntries(PageStorage* page_storage,
+                           TreeNodeCache* cache,
                            uint8_t level,
                            const std::vector<Entry>& entries,
                            const std::vector<ObjectId>& children,
+                           const std::vector<uint64_t>& subtree_sizes,
                            std::function<void(Status, ObjectId)> callback) {
   FTL_DCHECK(entries.size() + 1 == children.size());
-  std::string encoding = storage::EncodeNode(level, entries, children);
+  FromEncoding(page_storage, cache,
+               storage::EncodeNode(level, entries, children, subtree_sizes),
+               std::move(callback));
+}
+
+void TreeNode::FromEncoding(PageStorage* page_storage,
+                            TreeNodeCache* cache,
+                            std::string encoding,
+                            std::function<void(Status, ObjectId)> callback) {
+  // New nodes are usually read back soon after being created: add them to the
+  // cache.
+  std::shared_ptr<const TreeNodeData> data;
+  if (!cache || DecodeData(encoding, &data) != Status::OK) {
+    page_storage->AddObjectFromLocal(
+        storage::DataSource::Create(std::move(encoding)), std::move(callback));
+    return;
+  }
   page_storage->AddObjectFromLocal(
-      storage::DataSource::Create(std::move(encoding)), std::move(callback));
+      storage::DataSource::Create(std::move(encoding)), [
+        cache, data = std::move(data), callback = std::move(callback)
+      ](Status status, ObjectId object_id) mutable {
+        if (status == Status::OK) {
+          cache->Put(object_id, std::move(data));
+        }
+        callback(status, std::move(object_id));
+      });
 }
 
 int TreeNode::GetKeyCount() const {
-  return entries_.size();
+  return data_->entries.size();
 }
 
 Status TreeNode::GetEntry(int index, Entry* entry) const {
   FTL_DCHECK(index >= 0 && index < GetKeyCount());
-  *entry = entries_[index];
+  *entry = ToEntry(data_->entries[index]);
   return Status::OK;
 }
 
@@ -83,35 +135,44 @@ void TreeNode::GetChild(
     std::function<void(Status, std::unique_ptr<const TreeNode>)> callback)
     const {
   FTL_DCHECK(index >= 0 && index <= GetKeyCount());
-  if (children_[index].empty()) {
+  if (data_->children[index].empty()) {
     callback(Status::NO_SUCH_CHILD, nullptr);
     return;
   }
-  return FromId(page_storage_, children_[index], std::move(callback));
+  return FromId(page_storage_, cache_, data_->children[index],
+                std::move(callback));
 }
 
 ObjectIdView TreeNode::GetChildId(int index) const {
   FTL_DCHECK(index >= 0 && index <= GetKeyCount());
-  return children_[index];
+  return data_->children[index];
+}
+
+uint64_t TreeNode::GetSubtreeSize(int index) const {
+  FTL_DCHECK(HasSubtreeSizes());
+  FTL_DCHECK(index >= 0 && index <= GetKeyCount());
+  return data_->subtree_sizes[index];
 }
 
 Status TreeNode::FindKeyOrChild(convert::ExtendedStringView key,
                                 int* index) const {
+  const std::vector<EntryView>& entries = data_->entries;
   if (key.empty()) {
     *index = 0;
-    return !entries_.empty() && entries_[0].key.empty() ? Status::OK
-                                                        : Status::NOT_FOUND;
+    return !entries.empty() && entries[0].key.empty() ? Status::OK
+                                                      : Status::NOT_FOUND;
   }
   auto it =
-      std::lower_bound(entries_.begin(), entries_.end(), key,
-                       [](const Entry& entry, convert::ExtendedStringView key) {
+      std::lower_bound(entries.begin(), entries.end(), key,
+                       [](const EntryView& entry,
+                          convert::ExtendedStringView key) {
                          return entry.key < key;
                        });
-  if (it == entries_.end()) {
-    *index = entries_.size();
+  if (it == entries.end()) {
+    *index = entries.size();
     return Status::NOT_FOUND;
   }
-  *index = it - entries_.begin();
+  *index = it - entries.begin();
   if (it->key == key) {
     return Status::OK;
   }
@@ -123,6 +184,7 @@ const ObjectId& TreeNode::GetId() const {
 }
 
 Status TreeNode::FromObject(PageStorage* page_storage,
+                            TreeNodeCache* cache,
                             std::unique_ptr<const Object> object,
                             std::unique_ptr<const TreeNode>* node) {
   ftl::StringView json;
@@ -130,14 +192,16 @@ Status TreeNode::FromObject(PageStorage* page_storage,
   if (status != Status::OK) {
     return status;
   }
-  uint8_t level;
-  std::vector<Entry> entries;
-  std::vector<ObjectId> children;
-  if (!DecodeNode(json, &level, &entries, &children)) {
-    return Status::FORMAT_ERROR;
+  std::shared_ptr<const TreeNodeData> data;
+  status = DecodeData(json.ToString(), &data);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (cache) {
+    cache->Put(object->GetId(), data);
   }
-  node->reset(new TreeNode(page_storage, object->GetId(), level,
-                           std::move(entries), std::move(children)));
+  node->reset(
+      new TreeNode(page_storage, cache, object->GetId(), std::move(data)));
   return Status::OK;
 }
 
@@ -10,34 +10,51 @@
 #include <vector>
 
 #include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
 #include "apps/ledger/src/storage/public/object.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
 
 namespace storage {
 
-// A node of the B-Tree holding the commit contents.
+// A node of the B-Tree holding the commit contents. The entries and children
+// ids of a node are views on its encoding, which is kept alive by the node.
 class TreeNode {
  public:
   ~TreeNode();
 
   // Creates a |TreeNode| object for an existing node and calls the given
-  // |callback| with the returned status and node.
+  // |callback| with the returned status and node. The node is only read and
+  // decoded if it is not in |cache|, which may be null, and is added to it
+  // otherwise.
   static void FromId(
       PageStorage* page_storage,
+      TreeNodeCache* cache,
       ObjectIdView id,
       std::function<void(Status, std::unique_ptr<const TreeNode>)> callback);
 
   // Creates a |TreeNode| object with the given entries and children. An empty
   // id in the children's vector indicates that there is no child in that
-  // index. The |callback| will be called with the success or error status and
-  // the id of the new node. It is expected that |children| = |entries| + 1.
+  // index. |subtree_sizes| is either empty, or holds the number of entries in
+  // the subtree of each child. The |callback| will be called with the success
+  // or error status and the id of the new node. It is expected that
+  // |children| = |entries| + 1. If |cache| is not null, the new node is added
+  // to it.
   static void FromEntries(PageStorage* page_storage,
+                          TreeNodeCache* cache,
                           uint8_t level,
                           const std::vector<Entry>& entries,
                           const std::vector<ObjectId>& children,
+                          const std::vector<uint64_t>& subtree_sizes,
                           std::function<void(Status, ObjectId)> callback);
 
+  // Same as |FromEntries|, for a node already serialized by |EncodeNode|. This
+  // allows nodes to be encoded away from the thread of |page_storage|.
+  static void FromEncoding(PageStorage* page_storage,
+                           TreeNodeCache* cache,
+                           std::string encoding,
+                           std::function<void(Status, ObjectId)> callback);
+
   // Creates an empty node, i.e. a TreeNode with no entries and an empty child
   // at index 0 and calls the callback with the result.
   static void Empty(PageStorage* page_storage,
@@ -46,8 +63,8 @@ class TreeNode {
   // Returns the number of entries stored in this tree node.
   int GetKeyCount() const;
 
-  // Finds the entry at position |index| and stores it in |entry|. |index| has
-  // to be in [0, GetKeyCount() - 1].
+  // Finds the entry at position |index| and stores a copy of it in |entry|.
+  // |index| has to be in [0, GetKeyCount() - 1].
   Status GetEntry(int index, Entry* entry) const;
 
   // Finds the child node at position |index| and calls the |callback| with the
@@ -63,6 +80,16 @@ class TreeNode {
   // GetKeyCount()].
   ObjectIdView GetChildId(int index) const;
 
+  // Returns whether the number of entries in the subtree of each child is
+  // known for this node. It is always known for nodes without children, but
+  // nodes with children written by older versions do not store it.
+  bool HasSubtreeSizes() const { return !data_->subtree_sizes.empty(); }
+
+  // Returns the number of entries in the subtree of the child at position
+  // |index|, which is 0 if the child is empty. |HasSubtreeSizes()| must be true
+  // and |index| has to be in [0, GetKeyCount()].
+  uint64_t GetSubtreeSize(int index) const;
+
   // Searches for the given |key| in this node. If it is found, |OK| is
   // returned and index contains the index of the entry. If not, |NOT_FOUND|
   // is returned and index stores the index of the child node where the key
@@ -71,30 +98,33 @@ class TreeNode {
 
   const ObjectId& GetId() const;
 
-  uint8_t level() const { return level_; }
+  uint8_t level() const { return data_->level; }
 
-  const std::vector<Entry>& entries() const { return entries_; }
+  // The returned views are valid as long as this node is alive.
+  const std::vector<EntryView>& entries() const { return data_->entries; }
 
-  const std::vector<ObjectId>& children_ids() const { return children_; }
+  const std::vector<ObjectIdView>& children_ids() const {
+    return data_->children;
+  }
 
  private:
   TreeNode(PageStorage* page_storage,
+           TreeNodeCache* cache,
            std::string id,
-           uint8_t level,
-           std::vector<Entry> entries,
-           std::vector<ObjectId> children);
+           std::shared_ptr<const TreeNodeData> data);
 
   // Creates a |TreeNode| object for an existing |object| and stores it in the
   // given |node|.
   static Status FromObject(PageStorage* page_storage,
+                           TreeNodeCache* cache,
                            std::unique_ptr<const Object> object,
                            std::unique_ptr<const TreeNode>* node);
 
   PageStorage* page_storage_;
+  TreeNodeCache* cache_;
   ObjectId id_;
-  const uint8_t level_;
-  const std::vector<Entry> entries_;
-  const std::vector<ObjectId> children_;
+  // The decoded content of the node, possibly shared with the tree node cache.
+  const std::shared_ptr<const TreeNodeData> data_;
 };
 
 }  // namespace storage
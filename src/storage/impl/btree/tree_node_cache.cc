@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+
+#include <utility>
+
+#include "apps/tracing/lib/trace/event.h"
+
+namespace storage {
+
+namespace {
+
+size_t EstimateSize(ObjectIdView id, const TreeNodeData& data) {
+  return sizeof(TreeNodeData) + 2 * id.size() + data.encoding.size() +
+         data.entries.size() * sizeof(EntryView) +
+         data.children.size() * sizeof(ObjectIdView) +
+         data.subtree_sizes.size() * sizeof(uint64_t);
+}
+
+}  // namespace
+
+constexpr size_t TreeNodeCache::kDefaultMaxBytes;
+
+TreeNodeCache::TreeNodeCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+TreeNodeCache::~TreeNodeCache() {}
+
+std::shared_ptr<const TreeNodeData> TreeNodeCache::Get(ObjectIdView id) {
+  auto it = index_.find(id);
+  if (it == index_.end()) {
+    ++miss_count_;
+    PublishCounters();
+    return nullptr;
+  }
+  ++hit_count_;
+  PublishCounters();
+  nodes_.splice(nodes_.begin(), nodes_, it->second);
+  return it->second->data;
+}
+
+void TreeNodeCache::Put(ObjectIdView id,
+                        std::shared_ptr<const TreeNodeData> data) {
+  size_t size = EstimateSize(id, *data);
+  if (size > max_bytes_) {
+    return;
+  }
+  auto it = index_.find(id);
+  if (it != index_.end()) {
+    nodes_.splice(nodes_.begin(), nodes_, it->second);
+    return;
+  }
+  while (size_in_bytes_ + size > max_bytes_) {
+    size_in_bytes_ -= nodes_.back().size;
+    index_.erase(nodes_.back().id);
+    nodes_.pop_back();
+  }
+  nodes_.push_front(CachedNode{id.ToString(), std::move(data), size});
+  index_[nodes_.front().id] = nodes_.begin();
+  size_in_bytes_ += size;
+}
+
+void TreeNodeCache::PublishCounters() {
+  TRACE_COUNTER("ledger", "tree_node_cache",
+                reinterpret_cast<uintptr_t>(this), "hits", hit_count_,
+                "misses", miss_count_, "bytes",
+                static_cast<uint64_t>(size_in_bytes_));
+}
+
+}  // namespace storage
@@ -0,0 +1,94 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_TREE_NODE_CACHE_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_TREE_NODE_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+
+namespace storage {
+
+// Decoded content of a node of the B-Tree. The entries and children ids are
+// views on |encoding|: this object cannot be copied, and |encoding| must not
+// be modified once they are set.
+struct TreeNodeData {
+  TreeNodeData() {}
+
+  std::string encoding;
+  uint8_t level = 0;
+  std::vector<EntryView> entries;
+  std::vector<ObjectIdView> children;
+  // Number of entries in the subtree of each child, or empty if they are not
+  // stored in the node.
+  std::vector<uint64_t> subtree_sizes;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(TreeNodeData);
+};
+
+// LRU cache of decoded tree nodes, indexed by the id of the object containing
+// their encoding. As objects are immutable, cached nodes never need to be
+// invalidated. The cache keeps the estimated memory used by the nodes it holds
+// under a given budget, and can be shared by all the pages of a repository.
+//
+// This class is not thread safe: it must only be used on the main thread.
+class TreeNodeCache {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 8 * 1024 * 1024;
+
+  explicit TreeNodeCache(size_t max_bytes = kDefaultMaxBytes);
+  ~TreeNodeCache();
+
+  // Returns the node with the given |id|, or nullptr if it is not in the
+  // cache.
+  std::shared_ptr<const TreeNodeData> Get(ObjectIdView id);
+
+  // Adds the node with the given |id| to the cache, evicting the least
+  // recently used nodes as needed. Nodes bigger than the budget of the cache
+  // are not stored.
+  void Put(ObjectIdView id, std::shared_ptr<const TreeNodeData> data);
+
+  // Returns the estimated number of bytes used by the cached nodes.
+  size_t size_in_bytes() const { return size_in_bytes_; }
+
+  // Returns the number of calls to |Get()| that found, or did not find, the
+  // requested node. These counters are also published as the
+  // "tree_node_cache" trace counter of the "ledger" category.
+  uint64_t hit_count() const { return hit_count_; }
+  uint64_t miss_count() const { return miss_count_; }
+
+ private:
+  struct CachedNode {
+    ObjectId id;
+    std::shared_ptr<const TreeNodeData> data;
+    size_t size;
+  };
+
+  // Records the hit and miss counts, and the size of the cache, in the trace.
+  void PublishCounters();
+
+  const size_t max_bytes_;
+  // Cached nodes, the most recently used first.
+  std::list<CachedNode> nodes_;
+  std::map<ObjectId, std::list<CachedNode>::iterator,
+           convert::StringViewComparator>
+      index_;
+  size_t size_in_bytes_ = 0;
+  uint64_t hit_count_ = 0;
+  uint64_t miss_count_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TreeNodeCache);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_TREE_NODE_CACHE_H_
@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+
+#include "apps/ledger/src/storage/impl/btree/encoding.h"
+#include "gtest/gtest.h"
+
+namespace storage {
+namespace {
+
+std::shared_ptr<const TreeNodeData> CreateData(size_t entry_count) {
+  std::vector<Entry> entries;
+  for (size_t i = 0; i < entry_count; ++i) {
+    entries.push_back(
+        Entry{"key" + std::to_string(i), "object_id", KeyPriority::EAGER});
+  }
+  auto data = std::make_shared<TreeNodeData>();
+  data->encoding =
+      EncodeNode(0u, entries, std::vector<ObjectId>(entry_count + 1));
+  EXPECT_TRUE(DecodeNodeView(data->encoding, &data->level, &data->entries,
+                             &data->children));
+  return data;
+}
+
+TEST(TreeNodeCacheTest, GetPut) {
+  TreeNodeCache cache;
+  EXPECT_EQ(nullptr, cache.Get("node1"));
+  EXPECT_EQ(0u, cache.hit_count());
+  EXPECT_EQ(1u, cache.miss_count());
+
+  std::shared_ptr<const TreeNodeData> data = CreateData(3);
+  cache.Put("node1", data);
+  EXPECT_LT(0u, cache.size_in_bytes());
+  EXPECT_EQ(data, cache.Get("node1"));
+  EXPECT_EQ(nullptr, cache.Get("node2"));
+  EXPECT_EQ(1u, cache.hit_count());
+  EXPECT_EQ(2u, cache.miss_count());
+
+  // Adding the same node again does not change the size of the cache.
+  size_t size = cache.size_in_bytes();
+  cache.Put("node1", CreateData(3));
+  EXPECT_EQ(size, cache.size_in_bytes());
+  EXPECT_EQ(data, cache.Get("node1"));
+}
+
+TEST(TreeNodeCacheTest, EvictLeastRecentlyUsed) {
+  TreeNodeCache probe;
+  probe.Put("node0", CreateData(10));
+  size_t node_size = probe.size_in_bytes();
+
+  // The cache can hold 2 nodes.
+  TreeNodeCache cache(2 * node_size + node_size / 2);
+  cache.Put("node0", CreateData(10));
+  cache.Put("node1", CreateData(10));
+  // Use node0, so that node1 becomes the least recently used.
+  EXPECT_NE(nullptr, cache.Get("node0"));
+  cache.Put("node2", CreateData(10));
+
+  EXPECT_NE(nullptr, cache.Get("node0"));
+  EXPECT_EQ(nullptr, cache.Get("node1"));
+  EXPECT_NE(nullptr, cache.Get("node2"));
+  EXPECT_EQ(2 * node_size, cache.size_in_bytes());
+}
+
+TEST(TreeNodeCacheTest, NodeBiggerThanBudget) {
+  TreeNodeCache cache(10);
+  cache.Put("node", CreateData(1));
+  EXPECT_EQ(nullptr, cache.Get("node"));
+  EXPECT_EQ(0u, cache.size_in_bytes());
+}
+
+}  // namespace
+}  // namespace storage
@@ -17,6 +17,24 @@
 namespace storage {
 namespace {
 
+// Fake page storage that tracks the objects it reads.
+class TrackGetObjectFakePageStorage : public fake::FakePageStorage {
+ public:
+  TrackGetObjectFakePageStorage(PageId id) : fake::FakePageStorage(id) {}
+  ~TrackGetObjectFakePageStorage() override {}
+
+  void GetObject(
+      ObjectIdView object_id,
+      Location location,
+      const std::function<void(Status, std::unique_ptr<const Object>)>&
+          callback) override {
+    ++object_requests;
+    fake::FakePageStorage::GetObject(object_id, location, callback);
+  }
+
+  int object_requests = 0;
+};
+
 class TreeNodeTest : public StorageTest {
  public:
   TreeNodeTest() : fake_storage_("page_id") {}
@@ -46,6 +64,14 @@ class TreeNodeTest : public StorageTest {
     return found_entry;
   }
 
+  std::vector<Entry> GetEntries(const TreeNode* node) {
+    std::vector<Entry> entries;
+    for (int i = 0; i < node->GetKeyCount(); ++i) {
+      entries.push_back(GetEntry(node, i));
+    }
+    return entries;
+  }
+
   std::vector<ObjectId> CreateChildren(int size) {
     std::vector<ObjectId> children;
     for (int i = 0; i < size; ++i) {
@@ -65,14 +91,14 @@ TEST_F(TreeNodeTest, CreateGetTreeNode) {
 
   Status status;
   std::unique_ptr<const TreeNode> found_node;
-  TreeNode::FromId(&fake_storage_, node->GetId(),
+  TreeNode::FromId(&fake_storage_, nullptr, node->GetId(),
                    callback::Capture([this] { message_loop_.PostQuitTask(); },
                                      &status, &found_node));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::OK, status);
   EXPECT_NE(nullptr, found_node);
 
-  TreeNode::FromId(&fake_storage_, RandomId(kObjectIdSize),
+  TreeNode::FromId(&fake_storage_, nullptr, RandomId(kObjectIdSize),
                    callback::Capture([this] { message_loop_.PostQuitTask(); },
                                      &status, &found_node));
   EXPECT_FALSE(RunLoopWithTimeout());
@@ -163,5 +189,53 @@ TEST_F(TreeNodeTest, Serialization) {
   EXPECT_EQ(children, parsed_children);
 }
 
+TEST_F(TreeNodeTest, FromIdUsesCache) {
+  TrackGetObjectFakePageStorage storage("page_id");
+  auto cache = std::make_unique<TreeNodeCache>();
+  std::vector<Entry> entries;
+  ASSERT_TRUE(CreateEntries(3, &entries));
+  Status status;
+  ObjectId node_id;
+  TreeNode::FromEntries(
+      &storage, cache.get(), 0u, entries, std::vector<ObjectId>(4),
+      std::vector<uint64_t>(),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &node_id));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  auto get_node = [this, &storage, &cache, &node_id] {
+    Status status;
+    std::unique_ptr<const TreeNode> node;
+    TreeNode::FromId(&storage, cache.get(), node_id,
+                     callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                       &status, &node));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    return node;
+  };
+
+  // Nodes created from their entries are cached.
+  std::unique_ptr<const TreeNode> node = get_node();
+  ASSERT_TRUE(node);
+  EXPECT_EQ(node_id, node->GetId());
+  EXPECT_EQ(entries, GetEntries(node.get()));
+  EXPECT_EQ(0, storage.object_requests);
+  EXPECT_EQ(1u, cache->hit_count());
+
+  // Nodes read from the storage are added to the cache.
+  cache = std::make_unique<TreeNodeCache>();
+  node = get_node();
+  ASSERT_TRUE(node);
+  EXPECT_EQ(entries, GetEntries(node.get()));
+  EXPECT_EQ(1, storage.object_requests);
+  node = get_node();
+  ASSERT_TRUE(node);
+  EXPECT_EQ(entries, GetEntries(node.get()));
+  EXPECT_EQ(1, storage.object_requests);
+  EXPECT_EQ(1u, cache->hit_count());
+  EXPECT_EQ(1u, cache->miss_count());
+}
+
 }  // namespace
 }  // namespace storage
@@ -0,0 +1,48 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/commit_cache.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace storage {
+
+constexpr size_t CommitCache::kDefaultMaxCommits;
+
+CommitCache::CommitCache(size_t max_commits) : max_commits_(max_commits) {
+  FTL_DCHECK(max_commits_ > 0);
+}
+
+CommitCache::~CommitCache() {}
+
+std::unique_ptr<const Commit> CommitCache::Get(CommitIdView id) {
+  auto it = index_.find(id);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  commits_.splice(commits_.begin(), commits_, it->second);
+  return (*it->second)->Clone();
+}
+
+bool CommitCache::Contains(CommitIdView id) const {
+  return index_.find(id) != index_.end();
+}
+
+void CommitCache::Put(std::unique_ptr<const Commit> commit) {
+  auto it = index_.find(commit->GetId());
+  if (it != index_.end()) {
+    commits_.splice(commits_.begin(), commits_, it->second);
+    return;
+  }
+  if (commits_.size() == max_commits_) {
+    index_.erase(commits_.back()->GetId());
+    commits_.pop_back();
+  }
+  commits_.push_front(std::move(commit));
+  index_[commits_.front()->GetId()] = commits_.begin();
+}
+
+}  // namespace storage
@@ -0,0 +1,59 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_COMMIT_CACHE_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_COMMIT_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+
+namespace storage {
+
+// LRU cache of parsed commits, indexed by their id. As commits are immutable,
+// cached commits never need to be invalidated. Cached commits are returned as
+// clones, which share the storage bytes of the cached ones.
+//
+// This class is not thread safe: it must only be used on the main thread.
+class CommitCache {
+ public:
+  static constexpr size_t kDefaultMaxCommits = 256;
+
+  explicit CommitCache(size_t max_commits = kDefaultMaxCommits);
+  ~CommitCache();
+
+  // Returns a clone of the commit with the given |id|, or nullptr if it is not
+  // in the cache.
+  std::unique_ptr<const Commit> Get(CommitIdView id);
+
+  // Returns whether the commit with the given |id| is in the cache, without
+  // updating its position.
+  bool Contains(CommitIdView id) const;
+
+  // Adds |commit| to the cache, evicting the least recently used commit if
+  // the cache is full.
+  void Put(std::unique_ptr<const Commit> commit);
+
+  size_t size() const { return commits_.size(); }
+
+ private:
+  const size_t max_commits_;
+  // Cached commits, the most recently used first.
+  std::list<std::unique_ptr<const Commit>> commits_;
+  std::map<CommitId,
+           std::list<std::unique_ptr<const Commit>>::iterator,
+           convert::StringViewComparator>
+      index_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CommitCache);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_COMMIT_CACHE_H_
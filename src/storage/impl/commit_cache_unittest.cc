@@ -0,0 +1,53 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/commit_cache.h"
+
+#include "apps/ledger/src/storage/test/commit_random_impl.h"
+#include "gtest/gtest.h"
+
+namespace storage {
+namespace {
+
+TEST(CommitCacheTest, GetPut) {
+  CommitCache cache;
+  auto commit = std::make_unique<test::CommitRandomImpl>();
+  CommitId id = commit->GetId();
+  EXPECT_EQ(nullptr, cache.Get(id));
+  EXPECT_FALSE(cache.Contains(id));
+
+  cache.Put(std::move(commit));
+  EXPECT_TRUE(cache.Contains(id));
+  std::unique_ptr<const Commit> found = cache.Get(id);
+  ASSERT_NE(nullptr, found);
+  EXPECT_EQ(id, found->GetId());
+
+  // Adding the same commit again does not change the size of the cache.
+  cache.Put(std::move(found));
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST(CommitCacheTest, EvictLeastRecentlyUsed) {
+  std::vector<std::unique_ptr<const Commit>> commits;
+  for (size_t i = 0; i < 3; ++i) {
+    commits.push_back(std::make_unique<test::CommitRandomImpl>());
+  }
+
+  // The cache can hold 2 commits.
+  CommitCache cache(2);
+  cache.Put(commits[0]->Clone());
+  cache.Put(commits[1]->Clone());
+  // Use the first commit, so that the second one becomes the least recently
+  // used.
+  EXPECT_NE(nullptr, cache.Get(commits[0]->GetId()));
+  cache.Put(commits[2]->Clone());
+
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_TRUE(cache.Contains(commits[0]->GetId()));
+  EXPECT_FALSE(cache.Contains(commits[1]->GetId()));
+  EXPECT_TRUE(cache.Contains(commits[2]->GetId()));
+}
+
+}  // namespace
+}  // namespace storage
@@ -66,25 +66,35 @@ CommitImpl::CommitImpl(PageStorage* page_storage,
                        uint64_t generation,
                        ObjectIdView root_node_id,
                        std::vector<CommitIdView> parent_ids,
-                       ftl::RefPtr<SharedStorageBytes> storage_bytes)
+                       ftl::RefPtr<SharedStorageBytes> storage_bytes,
+                       ftl::RefPtr<LiveCommitTracker> tracker)
     : page_storage_(page_storage),
       id_(std::move(id)),
       timestamp_(timestamp),
       generation_(generation),
       root_node_id_(root_node_id),
       parent_ids_(std::move(parent_ids)),
-      storage_bytes_(std::move(storage_bytes)) {
+      storage_bytes_(std::move(storage_bytes)),
+      tracker_(std::move(tracker)) {
   FTL_DCHECK(page_storage_ != nullptr);
   FTL_DCHECK(id_ == kFirstPageCommitId ||
              (!parent_ids_.empty() && parent_ids_.size() <= 2));
+  if (tracker_) {
+    tracker_->AddCommit(id_);
+  }
 }
 
-CommitImpl::~CommitImpl() {}
+CommitImpl::~CommitImpl() {
+  if (tracker_) {
+    tracker_->RemoveCommit(id_);
+  }
+}
 
 std::unique_ptr<Commit> CommitImpl::FromStorageBytes(
     PageStorage* page_storage,
     CommitId id,
-    std::string storage_bytes) {
+    std::string storage_bytes,
+    ftl::RefPtr<LiveCommitTracker> tracker) {
   FTL_DCHECK(id != kFirstPageCommitId);
   ftl::RefPtr<SharedStorageBytes> storage_ptr =
       SharedStorageBytes::Create(std::move(storage_bytes));
@@ -103,13 +113,14 @@ std::unique_ptr<Commit> CommitImpl::FromStorageBytes(
   return std::unique_ptr<Commit>(
       new CommitImpl(page_storage, std::move(id), commit_storage->timestamp(),
                      commit_storage->generation(), root_node_id, parent_ids,
-                     std::move(storage_ptr)));
+                     std::move(storage_ptr), std::move(tracker)));
 }
 
 std::unique_ptr<Commit> CommitImpl::FromContentAndParents(
     PageStorage* page_storage,
     ObjectIdView root_node_id,
-    std::vector<std::unique_ptr<const Commit>> parent_commits) {
+    std::vector<std::unique_ptr<const Commit>> parent_commits,
+    ftl::RefPtr<LiveCommitTracker> tracker) {
   FTL_DCHECK(parent_commits.size() == 1 || parent_commits.size() == 2);
 
   uint64_t parent_generation = 0;
@@ -142,7 +153,7 @@ std::unique_ptr<Commit> CommitImpl::FromContentAndParents(
   CommitId id = glue::SHA256Hash(storage_bytes.data(), storage_bytes.size());
 
   return FromStorageBytes(page_storage, std::move(id),
-                          std::move(storage_bytes));
+                          std::move(storage_bytes), std::move(tracker));
 }
 
 void CommitImpl::Empty(
@@ -161,7 +172,7 @@ void CommitImpl::Empty(
 
     auto ptr = std::unique_ptr<Commit>(new CommitImpl(
         page_storage, kFirstPageCommitId.ToString(), 0, 0, storage_ptr->bytes(),
-        std::vector<CommitIdView>(), std::move(storage_ptr)));
+        std::vector<CommitIdView>(), std::move(storage_ptr), nullptr));
     callback(Status::OK, std::move(ptr));
   });
 }
@@ -186,7 +197,7 @@ bool CommitImpl::CheckValidSerialization(ftl::StringView storage_bytes) {
 std::unique_ptr<Commit> CommitImpl::Clone() const {
   return std::unique_ptr<CommitImpl>(
       new CommitImpl(page_storage_, id_, timestamp_, generation_, root_node_id_,
-                     parent_ids_, storage_bytes_));
+                     parent_ids_, storage_bytes_, tracker_));
 }
 
 const CommitId& CommitImpl::GetId() const {
@@ -5,6 +5,7 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_IMPL_COMMIT_IMPL_H_
 #define APPS_LEDGER_SRC_STORAGE_IMPL_COMMIT_IMPL_H_
 
+#include "apps/ledger/src/storage/impl/live_commit_tracker.h"
 #include "apps/ledger/src/storage/public/commit.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "lib/ftl/memory/ref_ptr.h"
@@ -17,15 +18,19 @@ class CommitImpl : public Commit {
 
   // Factory method for creating a |CommitImpl| object given its storage
   // representation. If the format is incorrect, a NULL pointer will be
-  // returned.
-  static std::unique_ptr<Commit> FromStorageBytes(PageStorage* page_storage,
-                                                  CommitId id,
-                                                  std::string storage_bytes);
+  // returned. If |tracker| is not null, the commit and its clones are
+  // registered in it while they are alive.
+  static std::unique_ptr<Commit> FromStorageBytes(
+      PageStorage* page_storage,
+      CommitId id,
+      std::string storage_bytes,
+      ftl::RefPtr<LiveCommitTracker> tracker = nullptr);
 
   static std::unique_ptr<Commit> FromContentAndParents(
       PageStorage* page_storage,
       ObjectIdView root_node_id,
-      std::vector<std::unique_ptr<const Commit>> parent_commits);
+      std::vector<std::unique_ptr<const Commit>> parent_commits,
+      ftl::RefPtr<LiveCommitTracker> tracker = nullptr);
 
   // Factory method for creating an empty |CommitImpl| object, i.e. without
   // parents and with empty contents.
@@ -57,7 +62,8 @@ class CommitImpl : public Commit {
              uint64_t generation,
              ObjectIdView root_node_id,
              std::vector<CommitIdView> parent_ids,
-             ftl::RefPtr<SharedStorageBytes> storage_bytes);
+             ftl::RefPtr<SharedStorageBytes> storage_bytes,
+             ftl::RefPtr<LiveCommitTracker> tracker);
 
   PageStorage* page_storage_;
   const CommitId id_;
@@ -66,6 +72,7 @@ class CommitImpl : public Commit {
   const ObjectIdView root_node_id_;
   const std::vector<CommitIdView> parent_ids_;
   const ftl::RefPtr<SharedStorageBytes> storage_bytes_;
+  const ftl::RefPtr<LiveCommitTracker> tracker_;
 };
 
 }  // namespace storage
@@ -5,10 +5,13 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_IMPL_DB_H_
 #define APPS_LEDGER_SRC_STORAGE_IMPL_DB_H_
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "apps/ledger/src/storage/impl/pack_store.h"
 #include "apps/ledger/src/storage/public/iterator.h"
 #include "apps/ledger/src/storage/public/journal.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -22,6 +25,10 @@ class PageStorageImpl;
 // |DB| manages all Ledger related data that are stored in LevelDB. This
 // includes commit objects, information on head commits, as well as metadata on
 // on which objects and commits are not yet synchronized to the cloud.
+//
+// Methods taking a |callback| are asynchronous versions of the methods with the
+// same name: implementations can access LevelDB on an I/O thread, and
+// |callback| is called on the thread of the caller.
 class DB {
  public:
   class Batch {
@@ -30,6 +37,7 @@ class DB {
     virtual ~Batch() {}
 
     virtual Status Execute() = 0;
+    virtual void Execute(std::function<void(Status)> callback) = 0;
 
    private:
     FTL_DISALLOW_COPY_AND_ASSIGN(Batch);
@@ -54,6 +62,11 @@ class DB {
   // their id.
   virtual Status GetHeads(std::vector<CommitId>* heads) = 0;
 
+  // Finds all head commits, together with the timestamp given at their
+  // insertion. The resulting |heads| are not ordered.
+  virtual Status GetHeadsWithTimestamps(
+      std::vector<std::pair<CommitId, int64_t>>* heads) = 0;
+
   // Adds the given |head| in the set of commit heads.
   virtual Status AddHead(CommitIdView head, int64_t timestamp) = 0;
 
@@ -65,14 +78,155 @@ class DB {
   // storage bytes in the |storage_bytes| string.
   virtual Status GetCommitStorageBytes(CommitIdView commit_id,
                                        std::string* storage_bytes) = 0;
+  virtual void GetCommitStorageBytes(
+      CommitIdView commit_id,
+      std::function<void(Status, std::string)> callback) = 0;
 
   // Adds the given |commit| in the database.
   virtual Status AddCommitStorageBytes(const CommitId& commit_id,
                                        ftl::StringView storage_bytes) = 0;
 
-  // Removes the commit with the given |commit_id| from the commits.
+  // Removes the commit with the given |commit_id| from the commits. Not used by
+  // |GarbageCollector|, which keeps all the commits for now.
   virtual Status RemoveCommit(const CommitId& commit_id) = 0;
 
+  // Ancestry index.
+  // Finds the ids of the ancestors of the commit with the given |commit_id| at
+  // 1, 2, 4, ... generations of distance, as stored by |AddCommitSkipIds|.
+  // Returns |NOT_FOUND| if the commit is not in the index.
+  virtual Status GetCommitSkipIds(CommitIdView commit_id,
+                                  std::vector<CommitId>* skip_ids) = 0;
+  virtual void GetCommitSkipIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) = 0;
+
+  // Adds the ancestors of the commit with the given |commit_id| at 1, 2, 4, ...
+  // generations of distance in the index.
+  virtual Status AddCommitSkipIds(const CommitId& commit_id,
+                                  const std::vector<CommitId>& skip_ids) = 0;
+
+  // Delta objects.
+  // Finds the objects introduced by the commit with the given |commit_id|, as
+  // stored by |AddDeltaObjectIds|. Returns |NOT_FOUND| if no delta was stored
+  // for this commit.
+  virtual Status GetDeltaObjectIds(const CommitId& commit_id,
+                                   std::vector<ObjectId>* object_ids) = 0;
+  virtual void GetDeltaObjectIds(
+      const CommitId& commit_id,
+      std::function<void(Status, std::vector<ObjectId>)> callback) = 0;
+
+  // Stores the objects introduced by the commit with the given |commit_id|.
+  // |object_ids| can be empty.
+  virtual Status AddDeltaObjectIds(const CommitId& commit_id,
+                                   const std::vector<ObjectId>& object_ids) = 0;
+
+  // Finds, in increasing order of id, up to |max_count| commits whose delta is
+  // stored and whose id is greater than |min_commit_id|. The object rows of
+  // the deltas are skipped, not read.
+  virtual Status GetDeltaCommitIds(CommitIdView min_commit_id,
+                                   size_t max_count,
+                                   std::vector<CommitId>* commit_ids) = 0;
+  virtual void GetDeltaCommitIds(
+      CommitIdView min_commit_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<CommitId>)> callback) = 0;
+
+  // Removes the delta of the commit with the given |commit_id|.
+  virtual Status RemoveDeltaObjectIds(const CommitId& commit_id) = 0;
+  // The asynchronous version removes the deltas of all the given |commit_ids|
+  // on the io thread, in a batch of their own.
+  virtual void RemoveDeltaObjectIds(std::vector<CommitId> commit_ids,
+                                    std::function<void(Status)> callback) = 0;
+
+  // Objects.
+  // Finds the location in the pack segments of the object with the given
+  // |object_id|. Returns |NOT_FOUND| if the object is not stored locally.
+  virtual Status GetObjectLocation(ObjectIdView object_id,
+                                   PackLocation* location) = 0;
+  virtual void GetObjectLocation(
+      ObjectIdView object_id,
+      std::function<void(Status, PackLocation)> callback) = 0;
+
+  // Stores the |location| in the pack segments of the object with the given
+  // |object_id|.
+  virtual Status AddObjectLocation(ObjectIdView object_id,
+                                   const PackLocation& location) = 0;
+
+  // Removes the location of the object with the given |object_id|.
+  virtual Status RemoveObjectLocation(ObjectIdView object_id) = 0;
+
+  // Finds, in increasing order of id, up to |max_count| objects stored in the
+  // pack segments whose id is greater than |min_object_id|, along with their
+  // location.
+  virtual Status GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, PackLocation>>* locations) = 0;
+  virtual void GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status,
+                         std::vector<std::pair<ObjectId, PackLocation>>)>
+          callback) = 0;
+
+  // Finds the content of the object with the given |object_id|, if it is
+  // stored in the database. Returns |NOT_FOUND| otherwise.
+  virtual Status GetObjectContent(ObjectIdView object_id,
+                                  std::string* content) = 0;
+  virtual void GetObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) = 0;
+
+  // Stores the |content| of the object with the given |object_id| in the
+  // database.
+  virtual Status AddObjectContent(ObjectIdView object_id,
+                                  ftl::StringView content) = 0;
+
+  // Removes the content of the object with the given |object_id|.
+  virtual Status RemoveObjectContent(ObjectIdView object_id) = 0;
+
+  // Finds, in increasing order of id, up to |max_count| objects stored in the
+  // database whose id is greater than |min_object_id|, along with the size of
+  // their content.
+  virtual Status GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) = 0;
+  virtual void GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) = 0;
+
+  // Finds the compressed content of the object with the given |object_id|, if
+  // it is stored compressed in the database. Returns |NOT_FOUND| otherwise.
+  virtual Status GetCompressedObjectContent(ObjectIdView object_id,
+                                            std::string* content) = 0;
+  virtual void GetCompressedObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) = 0;
+
+  // Stores the compressed |content| of the object with the given |object_id|
+  // in the database.
+  virtual Status AddCompressedObjectContent(ObjectIdView object_id,
+                                            ftl::StringView content) = 0;
+
+  // Removes the compressed content of the object with the given |object_id|.
+  virtual Status RemoveCompressedObjectContent(ObjectIdView object_id) = 0;
+
+  // Finds, in increasing order of id, up to |max_count| objects stored
+  // compressed in the database whose id is greater than |min_object_id|, along
+  // with the size of their compressed content.
+  virtual Status GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) = 0;
+  virtual void GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) = 0;
+
   // Journals.
   // Creates a new |Journal| with the given |base| commit id and stores it on
   // the |journal| parameter.
@@ -101,6 +255,10 @@ class DB {
   // Removes all information on the journal with the given |journal_id| from the
   // database.
   virtual Status RemoveJournal(const JournalId& journal_id) = 0;
+  // The asynchronous version removes the rows of the journal on the io thread,
+  // in a batch of their own.
+  virtual void RemoveJournal(const JournalId& journal_id,
+                             std::function<void(Status)> callback) = 0;
 
   // Adds a new |key|-|value| pair with the given |priority| to the journal with
   // the given |journal_id|.
@@ -109,43 +267,29 @@ class DB {
                                  ftl::StringView value,
                                  KeyPriority priority) = 0;
 
-  // Finds the value for the given |key| in the journal with the given id.
-  virtual Status GetJournalValue(const JournalId& journal_id,
-                                 ftl::StringView key,
-                                 std::string* value) = 0;
-
   // Removes the given key from the journal with the given |journal_id|.
   virtual Status RemoveJournalEntry(const JournalId& journal_id,
                                     convert::ExtendedStringView key) = 0;
 
-  // Journal value counters can be used to keep track of how many times a given
-  // value is referenced in a journal.
-  // Returns the number of times the given value is refererenced.
-  virtual Status GetJournalValueCounter(const JournalId& journal_id,
-                                        ftl::StringView value,
-                                        int64_t* counter) = 0;
-
-  // Sets the number of times the given value is refererenced.
-  virtual Status SetJournalValueCounter(const JournalId& journal_id,
-                                        ftl::StringView value,
-                                        int64_t counter) = 0;
-
-  // Returns the set of values that are refererenced in the given journal, i.e.
-  // all values for which the journal value counter is a positive number.
-  virtual Status GetJournalValues(const JournalId& journal_id,
-                                  std::vector<std::string>* values) = 0;
-
   // Finds all the entries of the journal with the given |journal_id| and stores
   // an interator over the results on |entires|.
   virtual Status GetJournalEntries(
       const JournalId& journal_id,
       std::unique_ptr<Iterator<const EntryChange>>* entries) = 0;
+  // The asynchronous version reads all the entries before calling |callback|.
+  virtual void GetJournalEntries(
+      const JournalId& journal_id,
+      std::function<void(Status,
+                         std::unique_ptr<Iterator<const EntryChange>>)>
+          callback) = 0;
 
   // Commit sync metadata.
   // Finds the set of unsynced commits and replaces the contents of |commit_ids|
   // with their ids. The result is ordered by the timestamps given when calling
   // |MarkCommitIdUnsynced|.
   virtual Status GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) = 0;
+  virtual void GetUnsyncedCommitIds(
+      std::function<void(Status, std::vector<CommitId>)> callback) = 0;
 
   // Marks the given |commit_id| as synced.
   virtual Status MarkCommitIdSynced(const CommitId& commit_id) = 0;
@@ -161,6 +305,8 @@ class DB {
   // Finds the set of unsynced objects and replaces the contents of |object_ids|
   // with their ids. |object_ids| will be lexicographically sorted.
   virtual Status GetUnsyncedObjectIds(std::vector<ObjectId>* object_ids) = 0;
+  virtual void GetUnsyncedObjectIds(
+      std::function<void(Status, std::vector<ObjectId>)> callback) = 0;
 
   // Marks the given |object_id| as synced.
   virtual Status MarkObjectIdSynced(ObjectIdView object_id) = 0;
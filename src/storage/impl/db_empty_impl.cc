@@ -26,6 +26,10 @@ std::unique_ptr<DbEmptyImpl::Batch> DbEmptyImpl::StartBatch() {
 Status DbEmptyImpl::GetHeads(std::vector<CommitId>* heads) {
   return Status::NOT_IMPLEMENTED;
 }
+Status DbEmptyImpl::GetHeadsWithTimestamps(
+    std::vector<std::pair<CommitId, int64_t>>* heads) {
+  return Status::NOT_IMPLEMENTED;
+}
 Status DbEmptyImpl::AddHead(CommitIdView head, int64_t timestamp) {
   return Status::NOT_IMPLEMENTED;
 }
@@ -36,6 +40,11 @@ Status DbEmptyImpl::GetCommitStorageBytes(CommitIdView commit_id,
                                           std::string* storage_bytes) {
   return Status::NOT_IMPLEMENTED;
 }
+void DbEmptyImpl::GetCommitStorageBytes(
+    CommitIdView commit_id,
+    std::function<void(Status, std::string)> callback) {
+  callback(Status::NOT_IMPLEMENTED, "");
+}
 Status DbEmptyImpl::AddCommitStorageBytes(const CommitId& commit_id,
                                           ftl::StringView storage_bytes) {
   return Status::NOT_IMPLEMENTED;
@@ -43,6 +52,140 @@ Status DbEmptyImpl::AddCommitStorageBytes(const CommitId& commit_id,
 Status DbEmptyImpl::RemoveCommit(const CommitId& commit_id) {
   return Status::NOT_IMPLEMENTED;
 }
+Status DbEmptyImpl::GetCommitSkipIds(CommitIdView commit_id,
+                                     std::vector<CommitId>* skip_ids) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetCommitSkipIds(
+    CommitIdView commit_id,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  callback(Status::NOT_IMPLEMENTED, std::vector<CommitId>());
+}
+Status DbEmptyImpl::AddCommitSkipIds(const CommitId& commit_id,
+                                     const std::vector<CommitId>& skip_ids) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::GetDeltaObjectIds(const CommitId& commit_id,
+                                      std::vector<ObjectId>* object_ids) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetDeltaObjectIds(
+    const CommitId& commit_id,
+    std::function<void(Status, std::vector<ObjectId>)> callback) {
+  callback(Status::NOT_IMPLEMENTED, std::vector<ObjectId>());
+}
+Status DbEmptyImpl::AddDeltaObjectIds(const CommitId& commit_id,
+                                      const std::vector<ObjectId>& object_ids) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::GetDeltaCommitIds(CommitIdView min_commit_id,
+                                      size_t max_count,
+                                      std::vector<CommitId>* commit_ids) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetDeltaCommitIds(
+    CommitIdView min_commit_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  callback(Status::NOT_IMPLEMENTED, std::vector<CommitId>());
+}
+Status DbEmptyImpl::RemoveDeltaObjectIds(const CommitId& commit_id) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::RemoveDeltaObjectIds(std::vector<CommitId> commit_ids,
+                                       std::function<void(Status)> callback) {
+  callback(Status::NOT_IMPLEMENTED);
+}
+Status DbEmptyImpl::GetObjectLocation(ObjectIdView object_id,
+                                      PackLocation* location) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetObjectLocation(
+    ObjectIdView object_id,
+    std::function<void(Status, PackLocation)> callback) {
+  callback(Status::NOT_IMPLEMENTED, PackLocation());
+}
+Status DbEmptyImpl::AddObjectLocation(ObjectIdView object_id,
+                                      const PackLocation& location) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::RemoveObjectLocation(ObjectIdView object_id) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::GetObjectLocations(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, PackLocation>>* locations) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetObjectLocations(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, PackLocation>>)>
+        callback) {
+  callback(Status::NOT_IMPLEMENTED,
+           std::vector<std::pair<ObjectId, PackLocation>>());
+}
+Status DbEmptyImpl::GetObjectContent(ObjectIdView object_id,
+                                     std::string* content) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetObjectContent(
+    ObjectIdView object_id,
+    std::function<void(Status, std::string)> callback) {
+  callback(Status::NOT_IMPLEMENTED, "");
+}
+Status DbEmptyImpl::AddObjectContent(ObjectIdView object_id,
+                                     ftl::StringView content) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::RemoveObjectContent(ObjectIdView object_id) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::GetObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, uint64_t>>* sizes) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+        callback) {
+  callback(Status::NOT_IMPLEMENTED,
+           std::vector<std::pair<ObjectId, uint64_t>>());
+}
+Status DbEmptyImpl::GetCompressedObjectContent(ObjectIdView object_id,
+                                               std::string* content) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetCompressedObjectContent(
+    ObjectIdView object_id,
+    std::function<void(Status, std::string)> callback) {
+  callback(Status::NOT_IMPLEMENTED, "");
+}
+Status DbEmptyImpl::AddCompressedObjectContent(ObjectIdView object_id,
+                                               ftl::StringView content) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::RemoveCompressedObjectContent(ObjectIdView object_id) {
+  return Status::NOT_IMPLEMENTED;
+}
+Status DbEmptyImpl::GetCompressedObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, uint64_t>>* sizes) {
+  return Status::NOT_IMPLEMENTED;
+}
+void DbEmptyImpl::GetCompressedObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+        callback) {
+  callback(Status::NOT_IMPLEMENTED,
+           std::vector<std::pair<ObjectId, uint64_t>>());
+}
 Status DbEmptyImpl::GetImplicitJournalIds(std::vector<JournalId>* journal_ids) {
   return Status::NOT_IMPLEMENTED;
 }
@@ -56,17 +199,16 @@ Status DbEmptyImpl::RemoveExplicitJournals() {
 Status DbEmptyImpl::RemoveJournal(const JournalId& journal_id) {
   return Status::NOT_IMPLEMENTED;
 }
+void DbEmptyImpl::RemoveJournal(const JournalId& journal_id,
+                                std::function<void(Status)> callback) {
+  callback(Status::NOT_IMPLEMENTED);
+}
 Status DbEmptyImpl::AddJournalEntry(const JournalId& journal_id,
                                     ftl::StringView key,
                                     ftl::StringView value,
                                     KeyPriority priority) {
   return Status::NOT_IMPLEMENTED;
 }
-Status DbEmptyImpl::GetJournalValue(const JournalId& journal_id,
-                                    ftl::StringView key,
-                                    std::string* value) {
-  return Status::NOT_IMPLEMENTED;
-}
 Status DbEmptyImpl::RemoveJournalEntry(const JournalId& journal_id,
                                        convert::ExtendedStringView key) {
   return Status::NOT_IMPLEMENTED;
@@ -76,23 +218,19 @@ Status DbEmptyImpl::GetJournalEntries(
     std::unique_ptr<Iterator<const EntryChange>>* entries) {
   return Status::NOT_IMPLEMENTED;
 }
-Status DbEmptyImpl::GetJournalValueCounter(const JournalId& journal_id,
-                                           ftl::StringView value,
-                                           int64_t* counter) {
-  return Status::NOT_IMPLEMENTED;
-}
-Status DbEmptyImpl::SetJournalValueCounter(const JournalId& journal_id,
-                                           ftl::StringView value,
-                                           int64_t counter) {
-  return Status::NOT_IMPLEMENTED;
-}
-Status DbEmptyImpl::GetJournalValues(const JournalId& journal_id,
-                                     std::vector<std::string>* values) {
-  return Status::NOT_IMPLEMENTED;
+void DbEmptyImpl::GetJournalEntries(
+    const JournalId& journal_id,
+    std::function<void(Status, std::unique_ptr<Iterator<const EntryChange>>)>
+        callback) {
+  callback(Status::NOT_IMPLEMENTED, nullptr);
 }
 Status DbEmptyImpl::GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) {
   return Status::NOT_IMPLEMENTED;
 }
+void DbEmptyImpl::GetUnsyncedCommitIds(
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  callback(Status::NOT_IMPLEMENTED, {});
+}
 Status DbEmptyImpl::MarkCommitIdSynced(const CommitId& commit_id) {
   return Status::NOT_IMPLEMENTED;
 }
@@ -106,6 +244,10 @@ Status DbEmptyImpl::IsCommitSynced(const CommitId& commit_id, bool* is_synced) {
 Status DbEmptyImpl::GetUnsyncedObjectIds(std::vector<ObjectId>* object_ids) {
   return Status::NOT_IMPLEMENTED;
 }
+void DbEmptyImpl::GetUnsyncedObjectIds(
+    std::function<void(Status, std::vector<ObjectId>)> callback) {
+  callback(Status::NOT_IMPLEMENTED, {});
+}
 Status DbEmptyImpl::MarkObjectIdSynced(ObjectIdView object_id) {
   return Status::NOT_IMPLEMENTED;
 }
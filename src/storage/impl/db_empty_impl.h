@@ -24,44 +24,125 @@ class DbEmptyImpl : public DB {
 
   std::unique_ptr<Batch> StartBatch() override;
   Status GetHeads(std::vector<CommitId>* heads) override;
+  Status GetHeadsWithTimestamps(
+      std::vector<std::pair<CommitId, int64_t>>* heads) override;
   Status AddHead(CommitIdView head, int64_t timestamp) override;
   Status RemoveHead(CommitIdView head) override;
   Status GetCommitStorageBytes(CommitIdView commit_id,
                                std::string* storage_bytes) override;
+  void GetCommitStorageBytes(
+      CommitIdView commit_id,
+      std::function<void(Status, std::string)> callback) override;
   Status AddCommitStorageBytes(const CommitId& commit_id,
                                ftl::StringView storage_bytes) override;
   Status RemoveCommit(const CommitId& commit_id) override;
+  Status GetCommitSkipIds(CommitIdView commit_id,
+                          std::vector<CommitId>* skip_ids) override;
+  void GetCommitSkipIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
+  Status AddCommitSkipIds(const CommitId& commit_id,
+                          const std::vector<CommitId>& skip_ids) override;
+  Status GetDeltaObjectIds(const CommitId& commit_id,
+                           std::vector<ObjectId>* object_ids) override;
+  void GetDeltaObjectIds(
+      const CommitId& commit_id,
+      std::function<void(Status, std::vector<ObjectId>)> callback) override;
+  Status AddDeltaObjectIds(const CommitId& commit_id,
+                           const std::vector<ObjectId>& object_ids) override;
+  Status GetDeltaCommitIds(CommitIdView min_commit_id,
+                           size_t max_count,
+                           std::vector<CommitId>* commit_ids) override;
+  void GetDeltaCommitIds(
+      CommitIdView min_commit_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
+  Status RemoveDeltaObjectIds(const CommitId& commit_id) override;
+  void RemoveDeltaObjectIds(std::vector<CommitId> commit_ids,
+                            std::function<void(Status)> callback) override;
+  Status GetObjectLocation(ObjectIdView object_id,
+                           PackLocation* location) override;
+  void GetObjectLocation(
+      ObjectIdView object_id,
+      std::function<void(Status, PackLocation)> callback) override;
+  Status AddObjectLocation(ObjectIdView object_id,
+                           const PackLocation& location) override;
+  Status RemoveObjectLocation(ObjectIdView object_id) override;
+  Status GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, PackLocation>>* locations) override;
+  void GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status,
+                         std::vector<std::pair<ObjectId, PackLocation>>)>
+          callback) override;
+  Status GetObjectContent(ObjectIdView object_id,
+                          std::string* content) override;
+  void GetObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) override;
+  Status AddObjectContent(ObjectIdView object_id,
+                          ftl::StringView content) override;
+  Status RemoveObjectContent(ObjectIdView object_id) override;
+  Status GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) override;
+  void GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) override;
+  Status GetCompressedObjectContent(ObjectIdView object_id,
+                                    std::string* content) override;
+  void GetCompressedObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) override;
+  Status AddCompressedObjectContent(ObjectIdView object_id,
+                                    ftl::StringView content) override;
+  Status RemoveCompressedObjectContent(ObjectIdView object_id) override;
+  Status GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) override;
+  void GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) override;
   Status GetImplicitJournalIds(std::vector<JournalId>* journal_ids) override;
   Status GetImplicitJournal(const JournalId& journal_id,
                             std::unique_ptr<Journal>* journal) override;
   Status RemoveExplicitJournals() override;
   Status RemoveJournal(const JournalId& journal_id) override;
+  void RemoveJournal(const JournalId& journal_id,
+                     std::function<void(Status)> callback) override;
   Status AddJournalEntry(const JournalId& journal_id,
                          ftl::StringView key,
                          ftl::StringView value,
                          KeyPriority priority) override;
-  Status GetJournalValue(const JournalId& journal_id,
-                         ftl::StringView key,
-                         std::string* value) override;
   Status RemoveJournalEntry(const JournalId& journal_id,
                             convert::ExtendedStringView key) override;
   Status GetJournalEntries(
       const JournalId& journal_id,
       std::unique_ptr<Iterator<const EntryChange>>* entries) override;
-  Status GetJournalValueCounter(const JournalId& journal_id,
-                                ftl::StringView value,
-                                int64_t* counter) override;
-  Status SetJournalValueCounter(const JournalId& journal_id,
-                                ftl::StringView value,
-                                int64_t counter) override;
-  Status GetJournalValues(const JournalId& journal_id,
-                          std::vector<std::string>* values) override;
+  void GetJournalEntries(
+      const JournalId& journal_id,
+      std::function<void(Status,
+                         std::unique_ptr<Iterator<const EntryChange>>)>
+          callback) override;
   Status GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) override;
+  void GetUnsyncedCommitIds(
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
   Status MarkCommitIdSynced(const CommitId& commit_id) override;
   Status MarkCommitIdUnsynced(const CommitId& commit_id,
                               int64_t timestamp) override;
   Status IsCommitSynced(const CommitId& commit_id, bool* is_synced) override;
   Status GetUnsyncedObjectIds(std::vector<ObjectId>* object_ids) override;
+  void GetUnsyncedObjectIds(
+      std::function<void(Status, std::vector<ObjectId>)> callback) override;
   Status MarkObjectIdSynced(ObjectIdView object_id) override;
   Status MarkObjectIdUnsynced(ObjectIdView object_id) override;
   Status IsObjectSynced(ObjectIdView object_id, bool* is_synced) override;
@@ -5,13 +5,16 @@
 #include "apps/ledger/src/storage/impl/db_impl.h"
 
 #include <algorithm>
+#include <iterator>
 #include <string>
 
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
+#include "apps/ledger/src/storage/impl/io_thread.h"
 #include "apps/ledger/src/storage/impl/journal_db_impl.h"
 #include "apps/ledger/src/storage/impl/page_storage_impl.h"
-#include "lib/ftl/files/directory.h"
+#include "apps/ledger/src/storage/public/constants.h"
+#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/strings/concatenate.h"
 
 namespace storage {
@@ -20,17 +23,24 @@ namespace {
 
 constexpr ftl::StringView kHeadPrefix = "heads/";
 constexpr ftl::StringView kCommitPrefix = "commits/";
+constexpr ftl::StringView kCommitSkipIdsPrefix = "skip_ids/";
+// Delta keys are the commit id followed by the object id, with a row holding
+// only the commit id marking that the delta of the commit is stored.
+constexpr ftl::StringView kDeltaObjectPrefix = "deltas/";
+constexpr ftl::StringView kObjectLocationPrefix = "objects/locations/";
+// Suffix of the location values of compressed content.
+constexpr ftl::StringView kCompressedLocation = "Z";
+constexpr ftl::StringView kObjectContentPrefix = "objects/content/";
+constexpr ftl::StringView kCompressedObjectContentPrefix =
+    "objects/compressed_content/";
 
 // Journal keys
 const size_t kJournalIdSize = 16;
 constexpr ftl::StringView kJournalPrefix = "journals/";
 constexpr ftl::StringView kImplicitJournalMetaPrefix = "journals/implicit/";
 constexpr ftl::StringView kJournalEntry = "entry/";
-constexpr ftl::StringView kJournalCounter = "counter/";
 const char kImplicitJournalIdPrefix = 'I';
 const char kExplicitJournalIdPrefix = 'E';
-const size_t kJournalEntryPrefixSize =
-    kJournalPrefix.size() + kJournalIdSize + 1 + kJournalEntry.size();
 // Journal values
 const char kJournalEntryAdd = 'A';
 constexpr ftl::StringView kJournalEntryDelete = "D";
@@ -82,6 +92,38 @@ std::string GetCommitKeyFor(CommitIdView commit_id) {
   return ftl::Concatenate({kCommitPrefix, commit_id});
 }
 
+std::string GetCommitSkipIdsKeyFor(CommitIdView commit_id) {
+  return ftl::Concatenate({kCommitSkipIdsPrefix, commit_id});
+}
+
+std::string GetDeltaObjectPrefixFor(const CommitId& commit_id) {
+  return ftl::Concatenate({kDeltaObjectPrefix, commit_id});
+}
+
+// Returns the smallest key that is greater than all the keys starting with
+// |prefix|, or an empty string if there is no such key.
+std::string GetKeyAfterPrefix(std::string prefix) {
+  while (!prefix.empty() && static_cast<uint8_t>(prefix.back()) == 0xff) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) {
+    prefix.back() = static_cast<char>(static_cast<uint8_t>(prefix.back()) + 1);
+  }
+  return prefix;
+}
+
+std::string GetObjectLocationKeyFor(ObjectIdView object_id) {
+  return ftl::Concatenate({kObjectLocationPrefix, object_id});
+}
+
+std::string GetObjectContentKeyFor(ObjectIdView object_id) {
+  return ftl::Concatenate({kObjectContentPrefix, object_id});
+}
+
+std::string GetCompressedObjectContentKeyFor(ObjectIdView object_id) {
+  return ftl::Concatenate({kCompressedObjectContentPrefix, object_id});
+}
+
 std::string GetUnsyncedCommitKeyFor(const CommitId& commit_id) {
   return ftl::Concatenate({kUnsyncedCommitPrefix, commit_id});
 }
@@ -94,8 +136,14 @@ std::string GetImplicitJournalMetaKeyFor(const JournalId& journal_id) {
   return ftl::Concatenate({kImplicitJournalMetaPrefix, journal_id});
 }
 
+// The rows of a journal are all under this prefix. They include the journal
+// value counters written by previous versions.
+std::string GetJournalPrefixFor(const JournalId& journal_id) {
+  return ftl::Concatenate({kJournalPrefix, journal_id, "/"});
+}
+
 std::string GetJournalEntryPrefixFor(const JournalId& journal_id) {
-  return ftl::Concatenate({kJournalPrefix, journal_id, "/", kJournalEntry});
+  return ftl::Concatenate({GetJournalPrefixFor(journal_id), kJournalEntry});
 }
 
 std::string GetJournalEntryKeyFor(const JournalId id, ftl::StringView key) {
@@ -109,21 +157,50 @@ std::string GetJournalEntryValueFor(ftl::StringView value,
   return ftl::Concatenate({{&kJournalEntryAdd, 1}, {&priority_byte, 1}, value});
 }
 
-Status ExtractObjectId(ftl::StringView db_value, ObjectId* id) {
-  if (db_value[0] == kJournalEntryDelete[0]) {
-    return Status::NOT_FOUND;
-  }
-  *id = db_value.substr(kJournalEntryAddPrefixSize).ToString();
-  return Status::OK;
+// Locations of uncompressed content keep the format written by previous
+// versions. Compressed content is marked by a trailing byte.
+std::string SerializeLocation(const PackLocation& location) {
+  return ftl::Concatenate({SerializeNumber(location.segment),
+                           SerializeNumber(location.offset),
+                           SerializeNumber(location.size),
+                           location.compressed ? kCompressedLocation : ""});
 }
 
-std::string GetJournalCounterPrefixFor(const JournalId& id) {
-  return ftl::Concatenate({kJournalPrefix, id, "/", kJournalCounter});
+// Commit ids have a fixed size: skip ids are stored one after the other.
+Status DeserializeSkipIds(ftl::StringView value,
+                          std::vector<CommitId>* skip_ids) {
+  if (value.size() % kCommitIdSize != 0) {
+    return Status::FORMAT_ERROR;
+  }
+  skip_ids->clear();
+  skip_ids->reserve(value.size() / kCommitIdSize);
+  for (size_t i = 0; i < value.size(); i += kCommitIdSize) {
+    skip_ids->push_back(value.substr(i, kCommitIdSize).ToString());
+  }
+  return Status::OK;
 }
 
-std::string GetJournalCounterKeyFor(const JournalId& id,
-                                    ftl::StringView value) {
-  return ftl::Concatenate({GetJournalCounterPrefixFor(id), value});
+Status DeserializeLocation(ftl::StringView value, PackLocation* location) {
+  constexpr size_t kLocationSize = sizeof(location->segment) +
+                                   sizeof(location->offset) +
+                                   sizeof(location->size);
+  if (value.size() == kLocationSize + kCompressedLocation.size() &&
+      value.substr(kLocationSize) == kCompressedLocation) {
+    location->compressed = true;
+    value = value.substr(0, kLocationSize);
+  } else if (value.size() == kLocationSize) {
+    location->compressed = false;
+  } else {
+    return Status::FORMAT_ERROR;
+  }
+  location->segment = DeserializeNumber<uint32_t>(
+      value.substr(0, sizeof(location->segment)));
+  value = value.substr(sizeof(location->segment));
+  location->offset =
+      DeserializeNumber<uint64_t>(value.substr(0, sizeof(location->offset)));
+  location->size = DeserializeNumber<uint64_t>(
+      value.substr(sizeof(location->offset), sizeof(location->size)));
+  return Status::OK;
 }
 
 std::string NewJournalId(JournalType journal_type) {
@@ -182,7 +259,7 @@ class JournalEntryIterator : public Iterator<const EntryChange> {
     change_ = std::make_unique<EntryChange>();
 
     leveldb::Slice key_slice = it_->key();
-    key_slice.remove_prefix(kJournalEntryPrefixSize);
+    key_slice.remove_prefix(prefix_.size());
     change_->entry.key = key_slice.ToString();
 
     leveldb::Slice value = it_->value();
@@ -205,10 +282,39 @@ class JournalEntryIterator : public Iterator<const EntryChange> {
   std::unique_ptr<EntryChange> change_;
 };
 
+// Iterates over journal entries read in advance from the database.
+class LoadedJournalEntryIterator : public Iterator<const EntryChange> {
+ public:
+  explicit LoadedJournalEntryIterator(std::vector<EntryChange> changes)
+      : changes_(std::move(changes)), it_(changes_.begin()) {}
+
+  ~LoadedJournalEntryIterator() override {}
+
+  Iterator<const EntryChange>& Next() override {
+    FTL_DCHECK(Valid()) << "Iterator::Next iterator not valid";
+    ++it_;
+    return *this;
+  }
+
+  bool Valid() const override { return it_ != changes_.end(); }
+
+  Status GetStatus() const override { return Status::OK; }
+
+  const EntryChange& operator*() const override { return *it_; }
+  const EntryChange* operator->() const override { return &(*it_); }
+
+ private:
+  const std::vector<EntryChange> changes_;
+  std::vector<EntryChange>::const_iterator it_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LoadedJournalEntryIterator);
+};
+
 class BatchImpl : public DB::Batch {
  public:
-  BatchImpl(std::function<Status(bool)> callback)
-      : callback_(callback), executed_(false) {}
+  BatchImpl(std::function<Status(bool)> callback,
+            std::function<void(std::function<void(Status)>)> async_execute)
+      : callback_(callback), async_execute_(async_execute), executed_(false) {}
 
   ~BatchImpl() override {
     if (!executed_)
@@ -221,20 +327,35 @@ class BatchImpl : public DB::Batch {
     return callback_(true);
   }
 
+  void Execute(std::function<void(Status)> callback) override {
+    FTL_DCHECK(!executed_);
+    executed_ = true;
+    async_execute_(std::move(callback));
+  }
+
  private:
   std::function<Status(bool)> callback_;
+  std::function<void(std::function<void(Status)>)> async_execute_;
   bool executed_;
 };
 
 }  // namespace
 
-DbImpl::DbImpl(coroutine::CoroutineService* coroutine_service,
+DbImpl::DbImpl(ftl::RefPtr<ftl::TaskRunner> io_runner,
+               coroutine::CoroutineService* coroutine_service,
                PageStorageImpl* page_storage,
-               std::string db_path)
-    : coroutine_service_(coroutine_service),
+               RepositoryDb* repository_db,
+               std::string key_prefix,
+               size_t max_in_memory_journal_size)
+    : io_runner_(std::move(io_runner)),
+      coroutine_service_(coroutine_service),
       page_storage_(page_storage),
-      db_path_(db_path) {
+      repository_db_(repository_db),
+      key_prefix_(std::move(key_prefix)),
+      max_in_memory_journal_size_(max_in_memory_journal_size),
+      weak_factory_(this) {
   FTL_DCHECK(page_storage);
+  FTL_DCHECK(repository_db);
 }
 
 DbImpl::~DbImpl() {
@@ -242,38 +363,33 @@ DbImpl::~DbImpl() {
 }
 
 Status DbImpl::Init() {
-  if (!files::CreateDirectory(db_path_)) {
-    FTL_LOG(ERROR) << "Failed to create directory under " << db_path_;
-    return Status::INTERNAL_IO_ERROR;
+  // The repository database is opened once for all its pages.
+  db_ = repository_db_->db();
+  if (!db_) {
+    FTL_LOG(ERROR) << "The repository database is not initialized.";
+    return Status::ILLEGAL_STATE;
   }
-  leveldb::DB* db = nullptr;
-  leveldb::Options options;
-  options.create_if_missing = true;
-  leveldb::Status status = leveldb::DB::Open(options, db_path_, &db);
-  if (!status.ok()) {
-    FTL_LOG(ERROR) << "Failed to open ledger at " << db_path_
-                   << " with status: " << status.ToString();
-    return Status::INTERNAL_IO_ERROR;
-  }
-  db_.reset(db);
   return Status::OK;
 }
 
 std::unique_ptr<DB::Batch> DbImpl::StartBatch() {
   FTL_DCHECK(!batch_);
   batch_ = std::make_unique<leveldb::WriteBatch>();
-  return std::make_unique<BatchImpl>([this](bool execute) {
-    std::unique_ptr<leveldb::WriteBatch> batch = std::move(batch_);
-    if (execute) {
-      leveldb::Status status = db_->Write(write_options_, batch.get());
-      if (!status.ok()) {
-        FTL_LOG(ERROR) << "Fail to execute batch with status: "
-                       << status.ToString();
-        return Status::INTERNAL_IO_ERROR;
-      }
-    }
-    return Status::OK;
-  });
+  return std::make_unique<BatchImpl>(
+      [this](bool execute) {
+        std::unique_ptr<leveldb::WriteBatch> batch = std::move(batch_);
+        if (execute) {
+          return Write(batch.get());
+        }
+        return Status::OK;
+      },
+      [this](std::function<void(Status)> callback) {
+        // A new batch can be started while this one is being written.
+        RunOnIoThread(ftl::MakeCopyable([ this, batch = std::move(batch_) ] {
+                        return Write(batch.get());
+                      }),
+                      std::move(callback));
+      });
 }
 
 Status DbImpl::GetHeads(std::vector<CommitId>* heads) {
@@ -286,6 +402,22 @@ Status DbImpl::GetHeads(std::vector<CommitId>* heads) {
   return status;
 }
 
+Status DbImpl::GetHeadsWithTimestamps(
+    std::vector<std::pair<CommitId, int64_t>>* heads) {
+  std::vector<std::pair<std::string, std::string>> entries;
+  Status status = GetEntriesByPrefix(convert::ToSlice(kHeadPrefix), &entries);
+  if (status != Status::OK) {
+    return status;
+  }
+  heads->clear();
+  heads->reserve(entries.size());
+  for (std::pair<std::string, std::string>& entry : entries) {
+    heads->emplace_back(std::move(entry.first),
+                        DeserializeNumber<int64_t>(entry.second));
+  }
+  return Status::OK;
+}
+
 Status DbImpl::AddHead(CommitIdView head, int64_t timestamp) {
   return Put(GetHeadKeyFor(head), SerializeNumber(timestamp));
 }
@@ -299,23 +431,380 @@ Status DbImpl::GetCommitStorageBytes(CommitIdView commit_id,
   return Get(GetCommitKeyFor(commit_id), storage_bytes);
 }
 
+void DbImpl::GetCommitStorageBytes(
+    CommitIdView commit_id,
+    std::function<void(Status, std::string)> callback) {
+  auto storage_bytes = std::make_shared<std::string>();
+  RunOnIoThread(
+      [ this, key = GetCommitKeyFor(commit_id), storage_bytes ] {
+        return Get(key, storage_bytes.get());
+      },
+      [ storage_bytes, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*storage_bytes));
+      });
+}
+
 Status DbImpl::AddCommitStorageBytes(const CommitId& commit_id,
                                      ftl::StringView storage_bytes) {
   return Put(GetCommitKeyFor(commit_id), storage_bytes);
 }
 
 Status DbImpl::RemoveCommit(const CommitId& commit_id) {
+  Status status = Delete(GetCommitSkipIdsKeyFor(commit_id));
+  if (status != Status::OK) {
+    return status;
+  }
+  status = DeleteByPrefix(GetDeltaObjectPrefixFor(commit_id));
+  if (status != Status::OK) {
+    return status;
+  }
   return Delete(GetCommitKeyFor(commit_id));
 }
 
+Status DbImpl::GetCommitSkipIds(CommitIdView commit_id,
+                                std::vector<CommitId>* skip_ids) {
+  std::string value;
+  Status status = Get(GetCommitSkipIdsKeyFor(commit_id), &value);
+  if (status != Status::OK) {
+    return status;
+  }
+  return DeserializeSkipIds(value, skip_ids);
+}
+
+void DbImpl::GetCommitSkipIds(
+    CommitIdView commit_id,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  auto skip_ids = std::make_shared<std::vector<CommitId>>();
+  RunOnIoThread(
+      [ this, commit_id = commit_id.ToString(), skip_ids ] {
+        return GetCommitSkipIds(commit_id, skip_ids.get());
+      },
+      [ skip_ids, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*skip_ids));
+      });
+}
+
+Status DbImpl::AddCommitSkipIds(const CommitId& commit_id,
+                                const std::vector<CommitId>& skip_ids) {
+  std::string value;
+  value.reserve(skip_ids.size() * kCommitIdSize);
+  for (const CommitId& skip_id : skip_ids) {
+    FTL_DCHECK(skip_id.size() == kCommitIdSize);
+    value.append(skip_id);
+  }
+  return Put(GetCommitSkipIdsKeyFor(commit_id), value);
+}
+
+Status DbImpl::GetDeltaObjectIds(const CommitId& commit_id,
+                                 std::vector<ObjectId>* object_ids) {
+  std::vector<std::string> key_suffixes;
+  Status status =
+      GetByPrefix(GetDeltaObjectPrefixFor(commit_id), &key_suffixes);
+  if (status != Status::OK) {
+    return status;
+  }
+  // The marker row comes first, with an empty suffix.
+  if (key_suffixes.empty() || !key_suffixes.front().empty()) {
+    return Status::NOT_FOUND;
+  }
+  object_ids->assign(std::make_move_iterator(key_suffixes.begin() + 1),
+                     std::make_move_iterator(key_suffixes.end()));
+  return Status::OK;
+}
+
+void DbImpl::GetDeltaObjectIds(
+    const CommitId& commit_id,
+    std::function<void(Status, std::vector<ObjectId>)> callback) {
+  auto object_ids = std::make_shared<std::vector<ObjectId>>();
+  RunOnIoThread(
+      [ this, commit_id, object_ids ] {
+        return GetDeltaObjectIds(commit_id, object_ids.get());
+      },
+      [ object_ids, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*object_ids));
+      });
+}
+
+Status DbImpl::AddDeltaObjectIds(const CommitId& commit_id,
+                                 const std::vector<ObjectId>& object_ids) {
+  std::string prefix = GetDeltaObjectPrefixFor(commit_id);
+  Status status = Put(prefix, "");
+  for (const ObjectId& object_id : object_ids) {
+    if (status != Status::OK) {
+      return status;
+    }
+    status = Put(ftl::Concatenate({prefix, object_id}), "");
+  }
+  return status;
+}
+
+Status DbImpl::GetDeltaCommitIds(CommitIdView min_commit_id,
+                                 size_t max_count,
+                                 std::vector<CommitId>* commit_ids) {
+  std::string full_prefix = GetFullKey(convert::ToSlice(kDeltaObjectPrefix));
+  std::string next_key = min_commit_id.empty()
+                             ? full_prefix
+                             : GetKeyAfterPrefix(ftl::Concatenate(
+                                   {full_prefix, min_commit_id}));
+  std::vector<CommitId> result;
+  std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
+  while (!next_key.empty() && result.size() < max_count) {
+    it->Seek(next_key);
+    if (!it->Valid() || !it->key().starts_with(full_prefix)) {
+      break;
+    }
+    leveldb::Slice key = it->key();
+    key.remove_prefix(full_prefix.size());
+    if (key.size() < kCommitIdSize) {
+      return Status::FORMAT_ERROR;
+    }
+    // The marker row of a delta sorts before its object rows, which are
+    // skipped by seeking past the commit id.
+    std::string commit_prefix =
+        ftl::Concatenate({full_prefix, ftl::StringView(key.data(),
+                                                       kCommitIdSize)});
+    if (key.size() == kCommitIdSize) {
+      result.push_back(key.ToString());
+    }
+    next_key = GetKeyAfterPrefix(std::move(commit_prefix));
+  }
+  if (!it->status().ok()) {
+    return ConvertStatus(it->status());
+  }
+  commit_ids->swap(result);
+  return Status::OK;
+}
+
+void DbImpl::GetDeltaCommitIds(
+    CommitIdView min_commit_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  auto commit_ids = std::make_shared<std::vector<CommitId>>();
+  RunOnIoThread(
+      [
+        this, min_commit_id = min_commit_id.ToString(), max_count, commit_ids
+      ] {
+        return GetDeltaCommitIds(min_commit_id, max_count, commit_ids.get());
+      },
+      [ commit_ids, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*commit_ids));
+      });
+}
+
+Status DbImpl::RemoveDeltaObjectIds(const CommitId& commit_id) {
+  return DeleteByPrefix(GetDeltaObjectPrefixFor(commit_id));
+}
+
+void DbImpl::RemoveDeltaObjectIds(std::vector<CommitId> commit_ids,
+                                  std::function<void(Status)> callback) {
+  RunOnIoThread(
+      [ this, commit_ids = std::move(commit_ids) ] {
+        leveldb::WriteBatch batch;
+        for (const CommitId& commit_id : commit_ids) {
+          Status s =
+              DeleteByPrefix(GetDeltaObjectPrefixFor(commit_id), &batch);
+          if (s != Status::OK) {
+            return s;
+          }
+        }
+        return Write(&batch);
+      },
+      std::move(callback));
+}
+
+Status DbImpl::GetObjectLocation(ObjectIdView object_id,
+                                 PackLocation* location) {
+  std::string value;
+  Status s = Get(GetObjectLocationKeyFor(object_id), &value);
+  if (s != Status::OK) {
+    return s;
+  }
+  return DeserializeLocation(value, location);
+}
+
+void DbImpl::GetObjectLocation(
+    ObjectIdView object_id,
+    std::function<void(Status, PackLocation)> callback) {
+  auto location = std::make_shared<PackLocation>();
+  RunOnIoThread(
+      [ this, object_id = object_id.ToString(), location ] {
+        return GetObjectLocation(object_id, location.get());
+      },
+      [ location, callback = std::move(callback) ](Status status) {
+        callback(status, *location);
+      });
+}
+
+Status DbImpl::AddObjectLocation(ObjectIdView object_id,
+                                 const PackLocation& location) {
+  return Put(GetObjectLocationKeyFor(object_id), SerializeLocation(location));
+}
+
+Status DbImpl::RemoveObjectLocation(ObjectIdView object_id) {
+  return Delete(GetObjectLocationKeyFor(object_id));
+}
+
+Status DbImpl::GetObjectLocations(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, PackLocation>>* locations) {
+  std::vector<std::pair<std::string, std::string>> entries;
+  Status status = GetEntriesAfter(convert::ToSlice(kObjectLocationPrefix),
+                                  min_object_id, max_count, &entries);
+  if (status != Status::OK) {
+    return status;
+  }
+  std::vector<std::pair<ObjectId, PackLocation>> result;
+  result.reserve(entries.size());
+  for (auto& entry : entries) {
+    PackLocation location;
+    status = DeserializeLocation(entry.second, &location);
+    if (status != Status::OK) {
+      return status;
+    }
+    result.emplace_back(std::move(entry.first), location);
+  }
+  locations->swap(result);
+  return Status::OK;
+}
+
+void DbImpl::GetObjectLocations(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, PackLocation>>)>
+        callback) {
+  auto locations =
+      std::make_shared<std::vector<std::pair<ObjectId, PackLocation>>>();
+  RunOnIoThread(
+      [
+        this, min_object_id = min_object_id.ToString(), max_count, locations
+      ] {
+        return GetObjectLocations(min_object_id, max_count, locations.get());
+      },
+      [ locations, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*locations));
+      });
+}
+
+Status DbImpl::GetObjectContent(ObjectIdView object_id, std::string* content) {
+  return Get(GetObjectContentKeyFor(object_id), content);
+}
+
+void DbImpl::GetObjectContent(
+    ObjectIdView object_id,
+    std::function<void(Status, std::string)> callback) {
+  auto content = std::make_shared<std::string>();
+  RunOnIoThread(
+      [ this, key = GetObjectContentKeyFor(object_id), content ] {
+        return Get(key, content.get());
+      },
+      [ content, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*content));
+      });
+}
+
+Status DbImpl::AddObjectContent(ObjectIdView object_id,
+                                ftl::StringView content) {
+  return Put(GetObjectContentKeyFor(object_id), content);
+}
+
+Status DbImpl::RemoveObjectContent(ObjectIdView object_id) {
+  return Delete(GetObjectContentKeyFor(object_id));
+}
+
+Status DbImpl::GetObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, uint64_t>>* sizes) {
+  return GetEntrySizesAfter(convert::ToSlice(kObjectContentPrefix),
+                            min_object_id, max_count, sizes);
+}
+
+void DbImpl::GetObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+        callback) {
+  auto sizes = std::make_shared<std::vector<std::pair<ObjectId, uint64_t>>>();
+  RunOnIoThread(
+      [ this, min_object_id = min_object_id.ToString(), max_count, sizes ] {
+        return GetObjectContentSizes(min_object_id, max_count, sizes.get());
+      },
+      [ sizes, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*sizes));
+      });
+}
+
+Status DbImpl::GetCompressedObjectContent(ObjectIdView object_id,
+                                          std::string* content) {
+  return Get(GetCompressedObjectContentKeyFor(object_id), content);
+}
+
+void DbImpl::GetCompressedObjectContent(
+    ObjectIdView object_id,
+    std::function<void(Status, std::string)> callback) {
+  auto content = std::make_shared<std::string>();
+  RunOnIoThread(
+      [ this, key = GetCompressedObjectContentKeyFor(object_id), content ] {
+        return Get(key, content.get());
+      },
+      [ content, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*content));
+      });
+}
+
+Status DbImpl::AddCompressedObjectContent(ObjectIdView object_id,
+                                          ftl::StringView content) {
+  return Put(GetCompressedObjectContentKeyFor(object_id), content);
+}
+
+Status DbImpl::RemoveCompressedObjectContent(ObjectIdView object_id) {
+  return Delete(GetCompressedObjectContentKeyFor(object_id));
+}
+
+Status DbImpl::GetCompressedObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::vector<std::pair<ObjectId, uint64_t>>* sizes) {
+  return GetEntrySizesAfter(convert::ToSlice(kCompressedObjectContentPrefix),
+                            min_object_id, max_count, sizes);
+}
+
+void DbImpl::GetCompressedObjectContentSizes(
+    ObjectIdView min_object_id,
+    size_t max_count,
+    std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+        callback) {
+  auto sizes = std::make_shared<std::vector<std::pair<ObjectId, uint64_t>>>();
+  RunOnIoThread(
+      [ this, min_object_id = min_object_id.ToString(), max_count, sizes ] {
+        return GetCompressedObjectContentSizes(min_object_id, max_count,
+                                               sizes.get());
+      },
+      [ sizes, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*sizes));
+      });
+}
+
 Status DbImpl::CreateJournal(JournalType journal_type,
                              const CommitId& base,
                              std::unique_ptr<Journal>* journal) {
   JournalId id = NewJournalId(journal_type);
-  *journal = JournalDBImpl::Simple(journal_type, coroutine_service_,
-                                   page_storage_, this, id, base);
+  *journal =
+      JournalDBImpl::Simple(journal_type, coroutine_service_, page_storage_,
+                            this, id, base, max_in_memory_journal_size_);
   if (journal_type == JournalType::IMPLICIT) {
-    return Put(GetImplicitJournalMetaKeyFor(id), base);
+    // The journal is recorded on the io thread, before any of its entries.
+    std::unique_ptr<Batch> batch = StartBatch();
+    Status s = Put(GetImplicitJournalMetaKeyFor(id), base);
+    if (s != Status::OK) {
+      return s;
+    }
+    batch->Execute([](Status status) {
+      if (status != Status::OK) {
+        FTL_LOG(ERROR) << "Unable to record an implicit journal.";
+      }
+    });
   }
   return Status::OK;
 }
@@ -325,7 +814,8 @@ Status DbImpl::CreateMergeJournal(const CommitId& base,
                                   std::unique_ptr<Journal>* journal) {
   *journal =
       JournalDBImpl::Merge(coroutine_service_, page_storage_, this,
-                           NewJournalId(JournalType::EXPLICIT), base, other);
+                           NewJournalId(JournalType::EXPLICIT), base, other,
+                           max_in_memory_journal_size_);
   return Status::OK;
 }
 
@@ -341,7 +831,8 @@ Status DbImpl::GetImplicitJournal(const JournalId& journal_id,
   Status s = Get(GetImplicitJournalMetaKeyFor(journal_id), &base);
   if (s == Status::OK) {
     *journal = JournalDBImpl::Simple(JournalType::IMPLICIT, coroutine_service_,
-                                     page_storage_, this, journal_id, base);
+                                     page_storage_, this, journal_id, base,
+                                     max_in_memory_journal_size_);
   }
   return s;
 }
@@ -359,7 +850,24 @@ Status DbImpl::RemoveJournal(const JournalId& journal_id) {
       return s;
     }
   }
-  return DeleteByPrefix(GetJournalEntryPrefixFor(journal_id));
+  return DeleteByPrefix(GetJournalPrefixFor(journal_id));
+}
+
+void DbImpl::RemoveJournal(const JournalId& journal_id,
+                           std::function<void(Status)> callback) {
+  RunOnIoThread(
+      [ this, journal_id ] {
+        leveldb::WriteBatch batch;
+        if (journal_id[0] == kImplicitJournalIdPrefix) {
+          batch.Delete(GetFullKey(GetImplicitJournalMetaKeyFor(journal_id)));
+        }
+        Status s = DeleteByPrefix(GetJournalPrefixFor(journal_id), &batch);
+        if (s != Status::OK) {
+          return s;
+        }
+        return Write(&batch);
+      },
+      std::move(callback));
 }
 
 Status DbImpl::AddJournalEntry(const JournalId& journal_id,
@@ -375,57 +883,42 @@ Status DbImpl::RemoveJournalEntry(const JournalId& journal_id,
   return Put(GetJournalEntryKeyFor(journal_id, key), kJournalEntryDelete);
 }
 
-Status DbImpl::GetJournalValue(const JournalId& journal_id,
-                               ftl::StringView key,
-                               std::string* value) {
-  std::string db_value;
-  Status s = Get(GetJournalEntryKeyFor(journal_id, key), &db_value);
-  if (s != Status::OK) {
-    return s;
-  }
-  return ExtractObjectId(db_value, value);
-}
-
 Status DbImpl::GetJournalEntries(
     const JournalId& journal_id,
     std::unique_ptr<Iterator<const EntryChange>>* entries) {
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
-  std::string prefix = GetJournalEntryPrefixFor(journal_id);
+  std::string prefix = GetFullKey(GetJournalEntryPrefixFor(journal_id));
   it->Seek(prefix);
 
   *entries = std::make_unique<JournalEntryIterator>(std::move(it), prefix);
   return Status::OK;
 }
 
-Status DbImpl::GetJournalValueCounter(const JournalId& journal_id,
-                                      ftl::StringView value,
-                                      int64_t* counter) {
-  std::string counter_str;
-  Status s = Get(GetJournalCounterKeyFor(journal_id, value), &counter_str);
-  if (s == Status::NOT_FOUND) {
-    *counter = 0;
-    return Status::OK;
-  }
-  if (s != Status::OK) {
-    return s;
-  }
-  *counter = DeserializeNumber<int64_t>(counter_str);
-  return Status::OK;
-}
-
-Status DbImpl::SetJournalValueCounter(const JournalId& journal_id,
-                                      ftl::StringView value,
-                                      int64_t counter) {
-  FTL_DCHECK(counter >= 0);
-  if (counter == 0) {
-    return Delete(GetJournalCounterKeyFor(journal_id, value));
-  }
-  return Put(GetJournalCounterKeyFor(journal_id, value),
-             SerializeNumber(counter));
-}
-Status DbImpl::GetJournalValues(const JournalId& journal_id,
-                                std::vector<std::string>* values) {
-  return GetByPrefix(GetJournalCounterPrefixFor(journal_id), values);
+void DbImpl::GetJournalEntries(
+    const JournalId& journal_id,
+    std::function<void(Status, std::unique_ptr<Iterator<const EntryChange>>)>
+        callback) {
+  auto changes = std::make_shared<std::vector<EntryChange>>();
+  RunOnIoThread(
+      [ this, journal_id, changes ] {
+        std::unique_ptr<Iterator<const EntryChange>> entries;
+        Status status = GetJournalEntries(journal_id, &entries);
+        if (status != Status::OK) {
+          return status;
+        }
+        for (; entries->Valid(); entries->Next()) {
+          changes->push_back(**entries);
+        }
+        return entries->GetStatus();
+      },
+      [ changes, callback = std::move(callback) ](Status status) {
+        if (status != Status::OK) {
+          callback(status, nullptr);
+          return;
+        }
+        callback(Status::OK, std::make_unique<LoadedJournalEntryIterator>(
+                                 std::move(*changes)));
+      });
 }
 
 Status DbImpl::GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) {
@@ -439,6 +932,16 @@ Status DbImpl::GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) {
   return Status::OK;
 }
 
+void DbImpl::GetUnsyncedCommitIds(
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  auto commit_ids = std::make_shared<std::vector<CommitId>>();
+  RunOnIoThread(
+      [this, commit_ids] { return GetUnsyncedCommitIds(commit_ids.get()); },
+      [ commit_ids, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*commit_ids));
+      });
+}
+
 Status DbImpl::MarkCommitIdSynced(const CommitId& commit_id) {
   return Delete(GetUnsyncedCommitKeyFor(commit_id));
 }
@@ -462,6 +965,16 @@ Status DbImpl::GetUnsyncedObjectIds(std::vector<ObjectId>* object_ids) {
   return GetByPrefix(convert::ToSlice(kUnsyncedObjectPrefix), object_ids);
 }
 
+void DbImpl::GetUnsyncedObjectIds(
+    std::function<void(Status, std::vector<ObjectId>)> callback) {
+  auto object_ids = std::make_shared<std::vector<ObjectId>>();
+  RunOnIoThread(
+      [this, object_ids] { return GetUnsyncedObjectIds(object_ids.get()); },
+      [ object_ids, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*object_ids));
+      });
+}
+
 Status DbImpl::MarkObjectIdSynced(ObjectIdView object_id) {
   return Delete(GetUnsyncedObjectKeyFor(object_id));
 }
@@ -491,11 +1004,12 @@ Status DbImpl::GetSyncMetadata(std::string* sync_state) {
 Status DbImpl::GetByPrefix(const leveldb::Slice& prefix,
                            std::vector<std::string>* key_suffixes) {
   std::vector<std::string> result;
+  std::string full_prefix = GetFullKey(prefix);
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
-  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
-       it->Next()) {
+  for (it->Seek(full_prefix);
+       it->Valid() && it->key().starts_with(full_prefix); it->Next()) {
     leveldb::Slice key = it->key();
-    key.remove_prefix(prefix.size());
+    key.remove_prefix(full_prefix.size());
     result.push_back(key.ToString());
   }
   if (!it->status().ok()) {
@@ -509,11 +1023,40 @@ Status DbImpl::GetEntriesByPrefix(
     const leveldb::Slice& prefix,
     std::vector<std::pair<std::string, std::string>>* key_value_pairs) {
   std::vector<std::pair<std::string, std::string>> result;
+  std::string full_prefix = GetFullKey(prefix);
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
-  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+  for (it->Seek(full_prefix);
+       it->Valid() && it->key().starts_with(full_prefix); it->Next()) {
+    leveldb::Slice key = it->key();
+    key.remove_prefix(full_prefix.size());
+    result.push_back(std::pair<std::string, std::string>(
+        key.ToString(), it->value().ToString()));
+  }
+  if (!it->status().ok()) {
+    return ConvertStatus(it->status());
+  }
+  key_value_pairs->swap(result);
+  return Status::OK;
+}
+
+Status DbImpl::GetEntriesAfter(
+    const leveldb::Slice& prefix,
+    ftl::StringView min_key_suffix,
+    size_t max_count,
+    std::vector<std::pair<std::string, std::string>>* key_value_pairs) {
+  std::vector<std::pair<std::string, std::string>> result;
+  std::string full_prefix = GetFullKey(prefix);
+  std::string min_key = ftl::Concatenate({full_prefix, min_key_suffix});
+  std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
+  it->Seek(min_key);
+  if (it->Valid() && it->key() == min_key) {
+    it->Next();
+  }
+  for (; it->Valid() && it->key().starts_with(full_prefix) &&
+         result.size() < max_count;
        it->Next()) {
     leveldb::Slice key = it->key();
-    key.remove_prefix(prefix.size());
+    key.remove_prefix(full_prefix.size());
     result.push_back(std::pair<std::string, std::string>(
         key.ToString(), it->value().ToString()));
   }
@@ -524,33 +1067,87 @@ Status DbImpl::GetEntriesByPrefix(
   return Status::OK;
 }
 
+Status DbImpl::GetEntrySizesAfter(
+    const leveldb::Slice& prefix,
+    ftl::StringView min_key_suffix,
+    size_t max_count,
+    std::vector<std::pair<std::string, uint64_t>>* sizes) {
+  std::vector<std::pair<std::string, std::string>> entries;
+  Status status = GetEntriesAfter(prefix, min_key_suffix, max_count, &entries);
+  if (status != Status::OK) {
+    return status;
+  }
+  std::vector<std::pair<std::string, uint64_t>> result;
+  result.reserve(entries.size());
+  for (auto& entry : entries) {
+    result.emplace_back(std::move(entry.first), entry.second.size());
+  }
+  sizes->swap(result);
+  return Status::OK;
+}
+
 Status DbImpl::DeleteByPrefix(const leveldb::Slice& prefix) {
+  std::string full_prefix = GetFullKey(prefix);
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
-  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
-       it->Next()) {
-    Delete(it->key());
+  for (it->Seek(full_prefix);
+       it->Valid() && it->key().starts_with(full_prefix); it->Next()) {
+    leveldb::Slice key = it->key();
+    key.remove_prefix(key_prefix_.size());
+    Delete(key);
+  }
+  return ConvertStatus(it->status());
+}
+
+Status DbImpl::DeleteByPrefix(const leveldb::Slice& prefix,
+                              leveldb::WriteBatch* batch) {
+  std::string full_prefix = GetFullKey(prefix);
+  std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
+  for (it->Seek(full_prefix);
+       it->Valid() && it->key().starts_with(full_prefix); it->Next()) {
+    batch->Delete(it->key());
   }
   return ConvertStatus(it->status());
 }
 
 Status DbImpl::Get(convert::ExtendedStringView key, std::string* value) {
-  return ConvertStatus(db_->Get(read_options_, key, value));
+  return ConvertStatus(db_->Get(read_options_, GetFullKey(key), value));
 }
 
 Status DbImpl::Put(convert::ExtendedStringView key, ftl::StringView value) {
   if (batch_) {
-    batch_->Put(key, convert::ToSlice(value));
+    batch_->Put(GetFullKey(key), convert::ToSlice(value));
     return Status::OK;
   }
-  return ConvertStatus(db_->Put(write_options_, key, convert::ToSlice(value)));
+  return ConvertStatus(
+      db_->Put(write_options_, GetFullKey(key), convert::ToSlice(value)));
 }
 
 Status DbImpl::Delete(convert::ExtendedStringView key) {
   if (batch_) {
-    batch_->Delete(key);
+    batch_->Delete(GetFullKey(key));
     return Status::OK;
   }
-  return ConvertStatus(db_->Delete(write_options_, key));
+  return ConvertStatus(db_->Delete(write_options_, GetFullKey(key)));
+}
+
+Status DbImpl::Write(leveldb::WriteBatch* batch) {
+  leveldb::Status status = db_->Write(write_options_, batch);
+  if (!status.ok()) {
+    FTL_LOG(ERROR) << "Fail to execute batch with status: "
+                   << status.ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+std::string DbImpl::GetFullKey(convert::ExtendedStringView key) {
+  return ftl::Concatenate({key_prefix_, key});
+}
+
+void DbImpl::RunOnIoThread(std::function<Status()> operation,
+                           std::function<void(Status)> callback) {
+  storage::RunOnIoThread(io_runner_, weak_factory_.GetWeakPtr(),
+                         std::move(operation), std::move(callback));
 }
 
 }  // namespace storage
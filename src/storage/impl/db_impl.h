@@ -9,6 +9,9 @@
 
 #include "apps/ledger/src/coroutine/coroutine.h"
 #include "apps/ledger/src/storage/impl/db.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
 
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
@@ -17,23 +20,123 @@ namespace storage {
 
 class PageStorageImpl;
 
+// Explicit journals are kept in memory until the size of their keys and values
+// exceeds this, by default.
+constexpr size_t kDefaultMaxInMemoryJournalSize = 1024 * 1024;
+
+// The rows of a page are stored in the database of its repository, under its
+// own key prefix.
+//
+// The asynchronous methods of |DbImpl| access LevelDB on |io_runner|, so that
+// the thread of the caller is not blocked on disk accesses. They complete
+// synchronously if |io_runner| runs tasks on the current thread. The owner of
+// |DbImpl| must make sure that no task accessing it is running on |io_runner|
+// when deleting it.
 class DbImpl : public DB {
  public:
-  DbImpl(coroutine::CoroutineService* coroutine_service,
+  // The keys of the page are prefixed with |key_prefix| in |repository_db|,
+  // which must outlive this object. The changes of explicit journals are only
+  // written in the database once their size exceeds
+  // |max_in_memory_journal_size|.
+  DbImpl(ftl::RefPtr<ftl::TaskRunner> io_runner,
+         coroutine::CoroutineService* coroutine_service,
          PageStorageImpl* page_storage,
-         std::string db_path);
+         RepositoryDb* repository_db,
+         std::string key_prefix,
+         size_t max_in_memory_journal_size = kDefaultMaxInMemoryJournalSize);
   ~DbImpl() override;
 
   Status Init() override;
   std::unique_ptr<Batch> StartBatch() override;
   Status GetHeads(std::vector<CommitId>* heads) override;
+  Status GetHeadsWithTimestamps(
+      std::vector<std::pair<CommitId, int64_t>>* heads) override;
   Status AddHead(CommitIdView head, int64_t timestamp) override;
   Status RemoveHead(CommitIdView head) override;
   Status GetCommitStorageBytes(CommitIdView commit_id,
                                std::string* storage_bytes) override;
+  void GetCommitStorageBytes(
+      CommitIdView commit_id,
+      std::function<void(Status, std::string)> callback) override;
   Status AddCommitStorageBytes(const CommitId& commit_id,
                                ftl::StringView storage_bytes) override;
   Status RemoveCommit(const CommitId& commit_id) override;
+  Status GetCommitSkipIds(CommitIdView commit_id,
+                          std::vector<CommitId>* skip_ids) override;
+  void GetCommitSkipIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
+  Status AddCommitSkipIds(const CommitId& commit_id,
+                          const std::vector<CommitId>& skip_ids) override;
+  Status GetDeltaObjectIds(const CommitId& commit_id,
+                           std::vector<ObjectId>* object_ids) override;
+  void GetDeltaObjectIds(
+      const CommitId& commit_id,
+      std::function<void(Status, std::vector<ObjectId>)> callback) override;
+  Status AddDeltaObjectIds(const CommitId& commit_id,
+                           const std::vector<ObjectId>& object_ids) override;
+  Status GetDeltaCommitIds(CommitIdView min_commit_id,
+                           size_t max_count,
+                           std::vector<CommitId>* commit_ids) override;
+  void GetDeltaCommitIds(
+      CommitIdView min_commit_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
+  Status RemoveDeltaObjectIds(const CommitId& commit_id) override;
+  void RemoveDeltaObjectIds(std::vector<CommitId> commit_ids,
+                            std::function<void(Status)> callback) override;
+  Status GetObjectLocation(ObjectIdView object_id,
+                           PackLocation* location) override;
+  void GetObjectLocation(
+      ObjectIdView object_id,
+      std::function<void(Status, PackLocation)> callback) override;
+  Status AddObjectLocation(ObjectIdView object_id,
+                           const PackLocation& location) override;
+  Status RemoveObjectLocation(ObjectIdView object_id) override;
+  Status GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, PackLocation>>* locations) override;
+  void GetObjectLocations(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status,
+                         std::vector<std::pair<ObjectId, PackLocation>>)>
+          callback) override;
+  Status GetObjectContent(ObjectIdView object_id,
+                          std::string* content) override;
+  void GetObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) override;
+  Status AddObjectContent(ObjectIdView object_id,
+                          ftl::StringView content) override;
+  Status RemoveObjectContent(ObjectIdView object_id) override;
+  Status GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) override;
+  void GetObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) override;
+  Status GetCompressedObjectContent(ObjectIdView object_id,
+                                    std::string* content) override;
+  void GetCompressedObjectContent(
+      ObjectIdView object_id,
+      std::function<void(Status, std::string)> callback) override;
+  Status AddCompressedObjectContent(ObjectIdView object_id,
+                                    ftl::StringView content) override;
+  Status RemoveCompressedObjectContent(ObjectIdView object_id) override;
+  Status GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::vector<std::pair<ObjectId, uint64_t>>* sizes) override;
+  void GetCompressedObjectContentSizes(
+      ObjectIdView min_object_id,
+      size_t max_count,
+      std::function<void(Status, std::vector<std::pair<ObjectId, uint64_t>>)>
+          callback) override;
   Status CreateJournal(JournalType journal_type,
                        const CommitId& base,
                        std::unique_ptr<Journal>* journal) override;
@@ -45,32 +148,32 @@ class DbImpl : public DB {
                             std::unique_ptr<Journal>* journal) override;
   Status RemoveExplicitJournals() override;
   Status RemoveJournal(const JournalId& journal_id) override;
+  void RemoveJournal(const JournalId& journal_id,
+                     std::function<void(Status)> callback) override;
   Status AddJournalEntry(const JournalId& journal_id,
                          ftl::StringView key,
                          ftl::StringView value,
                          KeyPriority priority) override;
-  Status GetJournalValue(const JournalId& journal_id,
-                         ftl::StringView key,
-                         std::string* value) override;
   Status RemoveJournalEntry(const JournalId& journal_id,
                             convert::ExtendedStringView key) override;
-  Status GetJournalValueCounter(const JournalId& journal_id,
-                                ftl::StringView value,
-                                int64_t* counter) override;
-  Status SetJournalValueCounter(const JournalId& journal_id,
-                                ftl::StringView value,
-                                int64_t counter) override;
-  Status GetJournalValues(const JournalId& journal_id,
-                          std::vector<std::string>* values) override;
   Status GetJournalEntries(
       const JournalId& journal_id,
       std::unique_ptr<Iterator<const EntryChange>>* entries) override;
+  void GetJournalEntries(
+      const JournalId& journal_id,
+      std::function<void(Status,
+                         std::unique_ptr<Iterator<const EntryChange>>)>
+          callback) override;
   Status GetUnsyncedCommitIds(std::vector<CommitId>* commit_ids) override;
+  void GetUnsyncedCommitIds(
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
   Status MarkCommitIdSynced(const CommitId& commit_id) override;
   Status MarkCommitIdUnsynced(const CommitId& commit_id,
                               int64_t timestamp) override;
   Status IsCommitSynced(const CommitId& commit_id, bool* is_synced) override;
   Status GetUnsyncedObjectIds(std::vector<ObjectId>* object_ids) override;
+  void GetUnsyncedObjectIds(
+      std::function<void(Status, std::vector<ObjectId>)> callback) override;
   Status MarkObjectIdSynced(ObjectIdView object_id) override;
   Status MarkObjectIdUnsynced(ObjectIdView object_id) override;
   Status IsObjectSynced(ObjectIdView object_id, bool* is_synced) override;
@@ -83,20 +186,53 @@ class DbImpl : public DB {
   Status GetEntriesByPrefix(
       const leveldb::Slice& prefix,
       std::vector<std::pair<std::string, std::string>>* key_value_pairs);
+  // Finds, in increasing order of key, up to |max_count| rows whose key starts
+  // with |prefix| and whose key suffix is greater than |min_key_suffix|.
+  Status GetEntriesAfter(
+      const leveldb::Slice& prefix,
+      ftl::StringView min_key_suffix,
+      size_t max_count,
+      std::vector<std::pair<std::string, std::string>>* key_value_pairs);
+  // Same as |GetEntriesAfter|, but only returns the suffix of the keys and the
+  // size of the values.
+  Status GetEntrySizesAfter(
+      const leveldb::Slice& prefix,
+      ftl::StringView min_key_suffix,
+      size_t max_count,
+      std::vector<std::pair<std::string, uint64_t>>* sizes);
   Status DeleteByPrefix(const leveldb::Slice& prefix);
+  // Same as |DeleteByPrefix|, but adds the deletions to |batch| instead of
+  // |batch_|, so that it can be called on the io thread.
+  Status DeleteByPrefix(const leveldb::Slice& prefix,
+                        leveldb::WriteBatch* batch);
   Status Get(convert::ExtendedStringView key, std::string* value);
   Status Put(convert::ExtendedStringView key, ftl::StringView value);
   Status Delete(convert::ExtendedStringView key);
+  Status Write(leveldb::WriteBatch* batch);
+
+  // Returns the key of the row of this page whose key in the page is |key|.
+  std::string GetFullKey(convert::ExtendedStringView key);
 
+  // Runs |operation| on |io_runner_|, and calls |callback| with its result on
+  // the current thread. See |storage::RunOnIoThread|.
+  void RunOnIoThread(std::function<Status()> operation,
+                     std::function<void(Status)> callback);
+
+  const ftl::RefPtr<ftl::TaskRunner> io_runner_;
   coroutine::CoroutineService* const coroutine_service_;
   PageStorageImpl* const page_storage_;
-  const std::string db_path_;
-  std::unique_ptr<leveldb::DB> db_;
+  RepositoryDb* const repository_db_;
+  const std::string key_prefix_;
+  const size_t max_in_memory_journal_size_;
+  leveldb::DB* db_ = nullptr;
 
   const leveldb::WriteOptions write_options_;
   const leveldb::ReadOptions read_options_;
 
   std::unique_ptr<leveldb::WriteBatch> batch_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<DbImpl> weak_factory_;
 };
 
 }  // namespace storage
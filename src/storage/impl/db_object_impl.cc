@@ -0,0 +1,37 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/db_object_impl.h"
+
+#include <utility>
+
+#include "apps/ledger/src/glue/compression/compression.h"
+#include "lib/ftl/logging.h"
+
+namespace storage {
+
+DbObjectImpl::DbObjectImpl(ObjectId id, std::string content, Encoding encoding)
+    : id_(std::move(id)), content_(std::move(content)), encoding_(encoding) {}
+
+DbObjectImpl::~DbObjectImpl() {}
+
+ObjectId DbObjectImpl::GetId() const {
+  return id_;
+}
+
+Status DbObjectImpl::GetData(ftl::StringView* data) const {
+  if (encoding_ == Encoding::COMPRESSED) {
+    std::string content;
+    if (!glue::Decompress(content_, &content)) {
+      FTL_LOG(ERROR) << "Unable to decompress the content of an object.";
+      return Status::FORMAT_ERROR;
+    }
+    content_.swap(content);
+    encoding_ = Encoding::RAW;
+  }
+  *data = content_;
+  return Status::OK;
+}
+
+}  // namespace storage
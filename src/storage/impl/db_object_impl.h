@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_DB_OBJECT_IMPL_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_DB_OBJECT_IMPL_H_
+
+#include <string>
+
+#include "apps/ledger/src/storage/public/object.h"
+
+namespace storage {
+
+// Object whose content is stored in the page database. The content is read
+// from the database when the object is created. Compressed content is only
+// decompressed the first time it is accessed.
+class DbObjectImpl : public Object {
+ public:
+  enum class Encoding {
+    RAW,
+    COMPRESSED,
+  };
+
+  DbObjectImpl(ObjectId id,
+               std::string content,
+               Encoding encoding = Encoding::RAW);
+  ~DbObjectImpl() override;
+
+  // Object:
+  ObjectId GetId() const override;
+  Status GetData(ftl::StringView* data) const override;
+
+ private:
+  const ObjectId id_;
+  mutable std::string content_;
+  mutable Encoding encoding_;
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_DB_OBJECT_IMPL_H_
@@ -4,17 +4,21 @@
 
 #include "apps/ledger/src/storage/impl/db.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "apps/ledger/src/storage/impl/commit_impl.h"
 #include "apps/ledger/src/storage/impl/db_impl.h"
 #include "apps/ledger/src/storage/impl/journal_db_impl.h"
 #include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
 #include "apps/ledger/src/storage/public/constants.h"
 #include "apps/ledger/src/storage/test/commit_random_impl.h"
 #include "apps/ledger/src/storage/test/storage_test_utils.h"
@@ -22,6 +26,7 @@
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/macros.h"
 #include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
 
 namespace storage {
 namespace {
@@ -44,13 +49,19 @@ class DBTest : public ::testing::Test {
                       &coroutine_service_,
                       tmp_dir_.path(),
                       "page_id"),
-        db_(&coroutine_service_, &page_storage_, tmp_dir_.path()) {}
+        repository_db_(tmp_dir_.path() + "/db"),
+        db_(message_loop_.task_runner(),
+            &coroutine_service_,
+            &page_storage_,
+            &repository_db_,
+            "page/") {}
 
   ~DBTest() override {}
 
   // Test:
   void SetUp() override {
     std::srand(0);
+    ASSERT_EQ(Status::OK, repository_db_.Init());
     ASSERT_EQ(Status::OK, db_.Init());
   }
 
@@ -59,6 +70,7 @@ class DBTest : public ::testing::Test {
   files::ScopedTempDir tmp_dir_;
   coroutine::CoroutineServiceImpl coroutine_service_;
   PageStorageImpl page_storage_;
+  RepositoryDb repository_db_;
   DbImpl db_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(DBTest);
@@ -137,6 +149,100 @@ TEST_F(DBTest, Commits) {
             db_.GetCommitStorageBytes(commit->GetId(), &storage_bytes));
 }
 
+TEST_F(DBTest, CommitSkipIds) {
+  CommitId commit_id = RandomId(kCommitIdSize);
+  std::vector<CommitId> skip_ids = {RandomId(kCommitIdSize),
+                                    RandomId(kCommitIdSize),
+                                    RandomId(kCommitIdSize)};
+  std::vector<CommitId> found_skip_ids;
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetCommitSkipIds(commit_id, &found_skip_ids));
+
+  EXPECT_EQ(Status::OK, db_.AddCommitSkipIds(commit_id, skip_ids));
+  EXPECT_EQ(Status::OK, db_.GetCommitSkipIds(commit_id, &found_skip_ids));
+  EXPECT_EQ(skip_ids, found_skip_ids);
+
+  EXPECT_EQ(Status::OK, db_.RemoveCommit(commit_id));
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetCommitSkipIds(commit_id, &found_skip_ids));
+}
+
+TEST_F(DBTest, ObjectLocations) {
+  ObjectId object_id = RandomId(kObjectIdSize);
+  PackLocation location;
+  location.segment = 3;
+  location.offset = 1234;
+  location.size = 56;
+
+  PackLocation found_location;
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetObjectLocation(object_id, &found_location));
+
+  EXPECT_EQ(Status::OK, db_.AddObjectLocation(object_id, location));
+  EXPECT_EQ(Status::OK, db_.GetObjectLocation(object_id, &found_location));
+  EXPECT_EQ(location.segment, found_location.segment);
+  EXPECT_EQ(location.offset, found_location.offset);
+  EXPECT_EQ(location.size, found_location.size);
+  EXPECT_FALSE(found_location.compressed);
+
+  location.compressed = true;
+  EXPECT_EQ(Status::OK, db_.AddObjectLocation(object_id, location));
+  EXPECT_EQ(Status::OK, db_.GetObjectLocation(object_id, &found_location));
+  EXPECT_EQ(location.size, found_location.size);
+  EXPECT_TRUE(found_location.compressed);
+
+  EXPECT_EQ(Status::OK, db_.RemoveObjectLocation(object_id));
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetObjectLocation(object_id, &found_location));
+}
+
+TEST_F(DBTest, ObjectContents) {
+  ObjectId object_id = RandomId(kObjectIdSize);
+  std::string content = RandomId(100);
+
+  std::string found_content;
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetObjectContent(object_id, &found_content));
+
+  EXPECT_EQ(Status::OK, db_.AddObjectContent(object_id, content));
+  EXPECT_EQ(Status::OK, db_.GetObjectContent(object_id, &found_content));
+  EXPECT_EQ(content, found_content);
+
+  // The content and the location of objects are stored independently.
+  PackLocation location;
+  EXPECT_EQ(Status::NOT_FOUND, db_.GetObjectLocation(object_id, &location));
+
+  EXPECT_EQ(Status::OK, db_.RemoveObjectContent(object_id));
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetObjectContent(object_id, &found_content));
+}
+
+TEST_F(DBTest, CompressedObjectContents) {
+  ObjectId object_id = RandomId(kObjectIdSize);
+  std::string content = RandomId(100);
+
+  std::string found_content;
+  EXPECT_EQ(Status::OK, db_.AddCompressedObjectContent(object_id, content));
+  EXPECT_EQ(Status::OK,
+            db_.GetCompressedObjectContent(object_id, &found_content));
+  EXPECT_EQ(content, found_content);
+
+  // Compressed and uncompressed contents are stored independently.
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetObjectContent(object_id, &found_content));
+  std::vector<std::pair<ObjectId, uint64_t>> sizes;
+  EXPECT_EQ(Status::OK, db_.GetObjectContentSizes("", 10, &sizes));
+  EXPECT_TRUE(sizes.empty());
+  EXPECT_EQ(Status::OK, db_.GetCompressedObjectContentSizes("", 10, &sizes));
+  ASSERT_EQ(1u, sizes.size());
+  EXPECT_EQ(object_id, sizes[0].first);
+  EXPECT_EQ(content.size(), sizes[0].second);
+
+  EXPECT_EQ(Status::OK, db_.RemoveCompressedObjectContent(object_id));
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetCompressedObjectContent(object_id, &found_content));
+}
+
 TEST_F(DBTest, Journals) {
   CommitId commit_id = RandomId(kCommitIdSize);
 
@@ -201,6 +307,49 @@ TEST_F(DBTest, JournalEntries) {
   EXPECT_EQ(Status::OK, implicit_journal->Rollback());
 }
 
+TEST_F(DBTest, ExplicitJournalEntries) {
+  DbImpl db(message_loop_.task_runner(), &coroutine_service_, &page_storage_,
+            &repository_db_, "other_page/", 20);
+  ASSERT_EQ(Status::OK, db.Init());
+
+  std::unique_ptr<Journal> explicit_journal;
+  EXPECT_EQ(Status::OK, db.CreateJournal(JournalType::EXPLICIT,
+                                         RandomId(kCommitIdSize),
+                                         &explicit_journal));
+  JournalDBImpl* journal_impl =
+      static_cast<JournalDBImpl*>(explicit_journal.get());
+
+  // Changes are kept in memory while they are smaller than the limit.
+  EXPECT_EQ(Status::OK,
+            explicit_journal->Put("add-1", "value1", KeyPriority::LAZY));
+  EXPECT_EQ(Status::OK, explicit_journal->Delete("rm-2"));
+  EXPECT_TRUE(journal_impl->IsInMemory());
+  std::unique_ptr<Iterator<const EntryChange>> entries;
+  EXPECT_EQ(Status::OK, db.GetJournalEntries(journal_impl->GetId(), &entries));
+  EXPECT_FALSE(entries->Valid());
+  entries.reset();
+
+  // All the changes are written in the database once the limit is exceeded.
+  EXPECT_EQ(Status::OK,
+            explicit_journal->Put("add-3", "value3", KeyPriority::EAGER));
+  EXPECT_FALSE(journal_impl->IsInMemory());
+
+  EntryChange expected_changes[] = {
+      NewEntryChange("add-1", "value1", KeyPriority::LAZY),
+      NewEntryChange("add-3", "value3", KeyPriority::EAGER),
+      NewRemoveEntryChange("rm-2"),
+  };
+  EXPECT_EQ(Status::OK, db.GetJournalEntries(journal_impl->GetId(), &entries));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(entries->Valid());
+    ExpectChangesEqual(expected_changes[i], **entries);
+    entries->Next();
+  }
+  EXPECT_FALSE(entries->Valid());
+  entries.reset();
+  EXPECT_EQ(Status::OK, explicit_journal->Rollback());
+}
+
 TEST_F(DBTest, UnsyncedCommits) {
   CommitId commit_id = RandomId(kCommitIdSize);
   std::vector<CommitId> commit_ids;
@@ -260,6 +409,53 @@ TEST_F(DBTest, UnsyncedObjects) {
   EXPECT_TRUE(is_synced);
 }
 
+TEST_F(DBTest, DeltaObjects) {
+  CommitId commit_id = RandomId(kCommitIdSize);
+  CommitId empty_commit_id = RandomId(kCommitIdSize);
+  std::vector<ObjectId> object_ids = {RandomId(kObjectIdSize),
+                                      RandomId(kObjectIdSize)};
+  std::sort(object_ids.begin(), object_ids.end());
+
+  std::vector<ObjectId> found_object_ids;
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetDeltaObjectIds(commit_id, &found_object_ids));
+
+  EXPECT_EQ(Status::OK, db_.AddDeltaObjectIds(commit_id, object_ids));
+  EXPECT_EQ(Status::OK, db_.AddDeltaObjectIds(empty_commit_id, {}));
+  EXPECT_EQ(Status::OK, db_.GetDeltaObjectIds(commit_id, &found_object_ids));
+  EXPECT_EQ(object_ids, found_object_ids);
+  EXPECT_EQ(Status::OK,
+            db_.GetDeltaObjectIds(empty_commit_id, &found_object_ids));
+  EXPECT_TRUE(found_object_ids.empty());
+
+  EXPECT_EQ(Status::OK, db_.RemoveCommit(commit_id));
+  EXPECT_EQ(Status::NOT_FOUND,
+            db_.GetDeltaObjectIds(commit_id, &found_object_ids));
+}
+
+TEST_F(DBTest, GetDeltaCommitIds) {
+  std::vector<CommitId> commit_ids = {RandomId(kCommitIdSize),
+                                      RandomId(kCommitIdSize),
+                                      RandomId(kCommitIdSize)};
+  std::sort(commit_ids.begin(), commit_ids.end());
+  for (const CommitId& commit_id : commit_ids) {
+    EXPECT_EQ(Status::OK,
+              db_.AddDeltaObjectIds(commit_id, {RandomId(kObjectIdSize),
+                                                RandomId(kObjectIdSize)}));
+  }
+
+  std::vector<CommitId> found_commit_ids;
+  EXPECT_EQ(Status::OK, db_.GetDeltaCommitIds("", 2, &found_commit_ids));
+  EXPECT_EQ(std::vector<CommitId>(commit_ids.begin(), commit_ids.begin() + 2),
+            found_commit_ids);
+  EXPECT_EQ(Status::OK,
+            db_.GetDeltaCommitIds(commit_ids[1], 2, &found_commit_ids));
+  EXPECT_EQ(std::vector<CommitId>({commit_ids[2]}), found_commit_ids);
+  EXPECT_EQ(Status::OK,
+            db_.GetDeltaCommitIds(commit_ids[2], 2, &found_commit_ids));
+  EXPECT_TRUE(found_commit_ids.empty());
+}
+
 TEST_F(DBTest, Batch) {
   std::unique_ptr<DB::Batch> batch = db_.StartBatch();
 
@@ -277,6 +473,89 @@ TEST_F(DBTest, Batch) {
   EXPECT_EQ(object_id, object_ids[0]);
 }
 
+TEST_F(DBTest, AsyncAccessOnIoThread) {
+  ftl::RefPtr<ftl::TaskRunner> io_runner;
+  std::thread io_thread = mtl::CreateThread(&io_runner);
+  {
+    DbImpl db(io_runner, &coroutine_service_, &page_storage_, &repository_db_,
+              "other_page/");
+    ASSERT_EQ(Status::OK, db.Init());
+
+    CommitId commit_id = RandomId(kCommitIdSize);
+    ObjectId object_id = RandomId(kObjectIdSize);
+    // Implicit journals are recorded on the io thread, before the batch below
+    // is written.
+    std::unique_ptr<Journal> journal;
+    EXPECT_EQ(Status::OK,
+              db.CreateJournal(JournalType::IMPLICIT, commit_id, &journal));
+    JournalId journal_id = static_cast<JournalDBImpl*>(journal.get())->GetId();
+    std::unique_ptr<DB::Batch> batch = db.StartBatch();
+    EXPECT_EQ(Status::OK, db.AddCommitStorageBytes(commit_id, "bytes"));
+    EXPECT_EQ(Status::OK, db.MarkObjectIdUnsynced(object_id));
+    Status status;
+    batch->Execute(callback::Capture(
+        [this] { message_loop_.PostQuitTask(); }, &status));
+    message_loop_.Run();
+    EXPECT_EQ(Status::OK, status);
+
+    std::vector<JournalId> journal_ids;
+    EXPECT_EQ(Status::OK, db.GetImplicitJournalIds(&journal_ids));
+    EXPECT_EQ(std::vector<JournalId>({journal_id}), journal_ids);
+    db.RemoveJournal(journal_id, callback::Capture(
+                                     [this] { message_loop_.PostQuitTask(); },
+                                     &status));
+    message_loop_.Run();
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(Status::OK, db.GetImplicitJournalIds(&journal_ids));
+    EXPECT_TRUE(journal_ids.empty());
+
+    std::string storage_bytes;
+    db.GetCommitStorageBytes(
+        commit_id, callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                     &status, &storage_bytes));
+    message_loop_.Run();
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ("bytes", storage_bytes);
+
+    std::vector<ObjectId> object_ids;
+    db.GetUnsyncedObjectIds(callback::Capture(
+        [this] { message_loop_.PostQuitTask(); }, &status, &object_ids));
+    message_loop_.Run();
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(std::vector<ObjectId>({object_id}), object_ids);
+  }
+  io_runner->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread.join();
+}
+
+TEST_F(DBTest, PagesSharingRepositoryDb) {
+  DbImpl other_db(message_loop_.task_runner(), &coroutine_service_,
+                  &page_storage_, &repository_db_, "other_page/");
+  ASSERT_EQ(Status::OK, other_db.Init());
+
+  CommitId head = RandomId(kCommitIdSize);
+  CommitId other_head = RandomId(kCommitIdSize);
+  EXPECT_EQ(Status::OK, db_.AddHead(head, 1));
+  EXPECT_EQ(Status::OK, other_db.AddHead(other_head, 2));
+  EXPECT_EQ(Status::OK, other_db.SetSyncMetadata("other"));
+
+  // Each page only sees its own rows.
+  std::vector<CommitId> heads;
+  EXPECT_EQ(Status::OK, db_.GetHeads(&heads));
+  EXPECT_EQ(std::vector<CommitId>({head}), heads);
+  EXPECT_EQ(Status::OK, other_db.GetHeads(&heads));
+  EXPECT_EQ(std::vector<CommitId>({other_head}), heads);
+  std::string sync_state;
+  EXPECT_EQ(Status::NOT_FOUND, db_.GetSyncMetadata(&sync_state));
+
+  // Deleting the rows of a page leaves the other pages untouched.
+  EXPECT_EQ(Status::OK, repository_db_.DeleteByPrefix("other_page/"));
+  EXPECT_EQ(Status::OK, other_db.GetHeads(&heads));
+  EXPECT_TRUE(heads.empty());
+  EXPECT_EQ(Status::OK, db_.GetHeads(&heads));
+  EXPECT_EQ(std::vector<CommitId>({head}), heads);
+}
+
 TEST_F(DBTest, SyncMetadata) {
   std::string sync_state;
   EXPECT_EQ(Status::NOT_FOUND, db_.GetSyncMetadata(&sync_state));
@@ -0,0 +1,546 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/garbage_collector.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node.h"
+#include "apps/ledger/src/storage/impl/io_thread.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "lib/ftl/logging.h"
+
+namespace storage {
+
+namespace {
+
+// Sets |synced| to whether each of the given |objects| is synced to the cloud.
+template <typename T>
+Status GetSyncedFlags(DB* db,
+                      const std::vector<std::pair<ObjectId, T>>& objects,
+                      std::vector<bool>* synced) {
+  synced->reserve(objects.size());
+  for (const auto& object : objects) {
+    bool is_synced;
+    Status s = db->IsObjectSynced(object.first, &is_synced);
+    if (s != Status::OK) {
+      return s;
+    }
+    synced->push_back(is_synced);
+  }
+  return Status::OK;
+}
+
+}  // namespace
+
+struct GarbageCollector::Collection {
+  enum class Phase {
+    CONTENT,
+    COMPRESSED_CONTENT,
+    LOCATIONS,
+    DELTAS,
+    SEGMENTS
+  };
+
+  // The roots of the collection, and the ones whose reachable objects are not
+  // marked yet.
+  std::set<CommitId> roots;
+  std::vector<CommitId> roots_to_mark;
+  // The marked objects, and the marked tree nodes whose children are not
+  // marked yet.
+  std::set<ObjectId, convert::StringViewComparator> marked_objects;
+  std::vector<ObjectId> nodes_to_mark;
+
+  Phase phase = Phase::CONTENT;
+  // The id of the last object, or commit, swept in the current phase.
+  std::string last_swept_id;
+  // The segments that contain objects still indexed.
+  std::set<uint32_t> live_segments;
+  // Whether segments can be deleted at the end of the collection: only if no
+  // object is written while the locations of the objects are swept.
+  bool segments_collectable = false;
+  uint64_t object_writes_started = 0;
+
+  GarbageCollectionStats stats;
+};
+
+GarbageCollector::GarbageCollector(ftl::RefPtr<ftl::TaskRunner> main_runner,
+                                   ftl::RefPtr<ftl::TaskRunner> io_runner,
+                                   PageStorageImpl* page_storage,
+                                   DB* db,
+                                   PackStore* pack_store,
+                                   LiveCommitTracker* live_commit_tracker,
+                                   GarbageCollectorOptions options)
+    : main_runner_(std::move(main_runner)),
+      io_runner_(std::move(io_runner)),
+      page_storage_(page_storage),
+      db_(db),
+      pack_store_(pack_store),
+      live_commit_tracker_(live_commit_tracker),
+      options_(options),
+      weak_factory_(this) {}
+
+GarbageCollector::~GarbageCollector() {}
+
+void GarbageCollector::Start() {
+  if (started_) {
+    return;
+  }
+  started_ = true;
+  ScheduleCollection();
+}
+
+void GarbageCollector::Collect(
+    std::function<void(Status, GarbageCollectionStats)> callback) {
+  callbacks_.push_back(std::move(callback));
+  if (collection_) {
+    return;
+  }
+  collection_ = std::make_unique<Collection>();
+  StartCollection();
+}
+
+void GarbageCollector::ScheduleCollection() {
+  main_runner_->PostDelayedTask(
+      [weak_this = weak_factory_.GetWeakPtr()] {
+        if (!weak_this) {
+          return;
+        }
+        weak_this->Collect([weak_this](Status status,
+                                       GarbageCollectionStats stats) {
+          if (status != Status::OK) {
+            FTL_LOG(WARNING) << "Garbage collection failed with status "
+                             << status;
+          } else {
+            FTL_VLOG(1) << "Garbage collection deleted "
+                        << stats.objects_deleted << " objects and "
+                        << stats.segments_deleted << " segments, reclaiming "
+                        << stats.bytes_reclaimed << " bytes";
+          }
+          if (weak_this) {
+            weak_this->ScheduleCollection();
+          }
+        });
+      },
+      options_.collection_interval);
+}
+
+void GarbageCollector::RunOnIoThread(std::function<Status()> operation,
+                                     std::function<void(Status)> callback) {
+  storage::RunOnIoThread(io_runner_, weak_factory_.GetWeakPtr(),
+                         std::move(operation), std::move(callback));
+}
+
+void GarbageCollector::StartCollection() {
+  db_->GetUnsyncedCommitIds([this](Status s, std::vector<CommitId> commit_ids) {
+    if (s != Status::OK) {
+      Finish(s);
+      return;
+    }
+    for (CommitId& commit_id : commit_ids) {
+      if (collection_->roots.insert(commit_id).second) {
+        collection_->roots_to_mark.push_back(std::move(commit_id));
+      }
+    }
+    AddNewRoots();
+    Continue();
+  });
+}
+
+bool GarbageCollector::AddNewRoots() {
+  std::vector<CommitId> commit_ids;
+  page_storage_->GetHeadCommitIds(&commit_ids);
+  for (const auto& live_commit : live_commit_tracker_->live_commits()) {
+    // The commit cache of the page holds a use of the commits it contains,
+    // which does not make them roots.
+    size_t cached_uses = page_storage_->IsCommitCached(live_commit.first);
+    if (live_commit.second > cached_uses) {
+      commit_ids.push_back(live_commit.first);
+    }
+  }
+
+  bool added = false;
+  for (CommitId& commit_id : commit_ids) {
+    if (collection_->roots.insert(commit_id).second) {
+      collection_->roots_to_mark.push_back(std::move(commit_id));
+      added = true;
+    }
+  }
+  return added;
+}
+
+bool GarbageCollector::MustDelaySweep() {
+  // The objects of commits from sync that are being added are not reachable
+  // from the roots yet.
+  if (page_storage_->HasPendingCommitsFromSync()) {
+    return true;
+  }
+  // The objects reachable from new roots must be marked before deleting any
+  // other object.
+  return AddNewRoots();
+}
+
+void GarbageCollector::Continue() {
+  main_runner_->PostDelayedTask(
+      [weak_this = weak_factory_.GetWeakPtr()] {
+        if (weak_this) {
+          weak_this->RunStep();
+        }
+      },
+      options_.step_delay);
+}
+
+void GarbageCollector::RunStep() {
+  if (!collection_->nodes_to_mark.empty()) {
+    MarkNextNode(0);
+    return;
+  }
+  if (!collection_->roots_to_mark.empty()) {
+    MarkNextRoot();
+    return;
+  }
+  switch (collection_->phase) {
+    case Collection::Phase::CONTENT:
+    case Collection::Phase::COMPRESSED_CONTENT:
+      SweepContent();
+      return;
+    case Collection::Phase::LOCATIONS:
+      SweepLocations();
+      return;
+    case Collection::Phase::DELTAS:
+      SweepDeltas();
+      return;
+    case Collection::Phase::SEGMENTS:
+      SweepSegments();
+      return;
+  }
+}
+
+void GarbageCollector::MarkNextRoot() {
+  CommitId commit_id = std::move(collection_->roots_to_mark.back());
+  collection_->roots_to_mark.pop_back();
+  page_storage_->GetCommit(commit_id, [this](Status s,
+                                             std::unique_ptr<const Commit>
+                                                 commit) {
+    if (s == Status::NOT_FOUND) {
+      // A commit in use that is not stored yet: its tree is made of untracked
+      // objects, and of objects reachable from its parents.
+      MarkNextNode(0);
+      return;
+    }
+    if (s != Status::OK) {
+      Finish(s);
+      return;
+    }
+    ObjectId root_id = commit->GetRootId().ToString();
+    if (collection_->marked_objects.insert(root_id).second) {
+      collection_->nodes_to_mark.push_back(std::move(root_id));
+    }
+    MarkNextNode(0);
+  });
+}
+
+void GarbageCollector::MarkNextNode(size_t marked_nodes) {
+  if (collection_->nodes_to_mark.empty() ||
+      marked_nodes == options_.max_items_per_step) {
+    Continue();
+    return;
+  }
+  ObjectId node_id = std::move(collection_->nodes_to_mark.back());
+  collection_->nodes_to_mark.pop_back();
+  TreeNode::FromId(page_storage_, page_storage_->tree_node_cache(), node_id, [
+    this, marked_nodes
+  ](Status s, std::unique_ptr<const TreeNode> node) {
+    if (s != Status::OK) {
+      Finish(s);
+      return;
+    }
+    for (const EntryView& entry : node->entries()) {
+      collection_->marked_objects.insert(entry.object_id.ToString());
+    }
+    for (ObjectIdView child_id : node->children_ids()) {
+      if (child_id.empty()) {
+        continue;
+      }
+      ObjectId id = child_id.ToString();
+      if (collection_->marked_objects.insert(id).second) {
+        collection_->nodes_to_mark.push_back(std::move(id));
+      }
+    }
+    MarkNextNode(marked_nodes + 1);
+  });
+}
+
+void GarbageCollector::SweepContent() {
+  bool compressed = collection_->phase == Collection::Phase::COMPRESSED_CONTENT;
+  auto sizes = std::make_shared<std::vector<std::pair<ObjectId, uint64_t>>>();
+  auto synced = std::make_shared<std::vector<bool>>();
+  RunOnIoThread(
+      [
+        db = db_, compressed, min_object_id = collection_->last_swept_id,
+        max_count = options_.max_items_per_step, sizes, synced
+      ] {
+        Status s = compressed ? db->GetCompressedObjectContentSizes(
+                                    min_object_id, max_count, sizes.get())
+                              : db->GetObjectContentSizes(
+                                    min_object_id, max_count, sizes.get());
+        if (s != Status::OK) {
+          return s;
+        }
+        return GetSyncedFlags(db, *sizes, synced.get());
+      },
+      [ this, compressed, sizes, synced ](Status s) {
+        if (s != Status::OK) {
+          Finish(s);
+          return;
+        }
+        if (MustDelaySweep()) {
+          Continue();
+          return;
+        }
+        GarbageCollectionStats deleted;
+        std::unique_ptr<DB::Batch> batch = db_->StartBatch();
+        for (size_t i = 0; i < sizes->size(); ++i) {
+          const auto& object = (*sizes)[i];
+          if (!IsCollectable(object.first, (*synced)[i])) {
+            continue;
+          }
+          s = compressed ? db_->RemoveCompressedObjectContent(object.first)
+                         : db_->RemoveObjectContent(object.first);
+          if (s != Status::OK) {
+            Finish(s);
+            return;
+          }
+          ++deleted.objects_deleted;
+          deleted.bytes_reclaimed += object.second;
+        }
+        bool done = sizes->size() < options_.max_items_per_step;
+        if (!sizes->empty()) {
+          collection_->last_swept_id = std::move(sizes->back().first);
+        }
+        batch->Execute([ this, compressed, deleted, done ](Status s) {
+          if (s != Status::OK) {
+            Finish(s);
+            return;
+          }
+          collection_->stats.objects_deleted += deleted.objects_deleted;
+          collection_->stats.bytes_reclaimed += deleted.bytes_reclaimed;
+          if (done && !compressed) {
+            collection_->phase = Collection::Phase::COMPRESSED_CONTENT;
+            collection_->last_swept_id.clear();
+          } else if (done) {
+            collection_->phase = Collection::Phase::LOCATIONS;
+            collection_->last_swept_id.clear();
+            collection_->segments_collectable =
+                !page_storage_->HasPendingObjectWrites();
+            collection_->object_writes_started =
+                page_storage_->object_writes_started();
+          }
+          Continue();
+        });
+      });
+}
+
+void GarbageCollector::SweepLocations() {
+  auto locations =
+      std::make_shared<std::vector<std::pair<ObjectId, PackLocation>>>();
+  auto synced = std::make_shared<std::vector<bool>>();
+  RunOnIoThread(
+      [
+        db = db_, min_object_id = collection_->last_swept_id,
+        max_count = options_.max_items_per_step, locations, synced
+      ] {
+        Status s =
+            db->GetObjectLocations(min_object_id, max_count, locations.get());
+        if (s != Status::OK) {
+          return s;
+        }
+        return GetSyncedFlags(db, *locations, synced.get());
+      },
+      [ this, locations, synced ](Status s) {
+        if (s != Status::OK) {
+          Finish(s);
+          return;
+        }
+        if (MustDelaySweep()) {
+          Continue();
+          return;
+        }
+        // The space of the deleted objects is only reclaimed when their segment
+        // is deleted.
+        uint64_t objects_deleted = 0;
+        std::unique_ptr<DB::Batch> batch = db_->StartBatch();
+        for (size_t i = 0; i < locations->size(); ++i) {
+          const auto& object = (*locations)[i];
+          if (!IsCollectable(object.first, (*synced)[i])) {
+            collection_->live_segments.insert(object.second.segment);
+            continue;
+          }
+          s = db_->RemoveObjectLocation(object.first);
+          if (s != Status::OK) {
+            Finish(s);
+            return;
+          }
+          ++objects_deleted;
+        }
+        bool done = locations->size() < options_.max_items_per_step;
+        if (!locations->empty()) {
+          collection_->last_swept_id = std::move(locations->back().first);
+        }
+        batch->Execute([ this, objects_deleted, done ](Status s) {
+          if (s != Status::OK) {
+            Finish(s);
+            return;
+          }
+          collection_->stats.objects_deleted += objects_deleted;
+          if (done) {
+            collection_->phase = Collection::Phase::DELTAS;
+            collection_->last_swept_id.clear();
+          }
+          Continue();
+        });
+      });
+}
+
+void GarbageCollector::SweepDeltas() {
+  // The number of deltas read, and the ids of the synced commits among them.
+  auto read_count = std::make_shared<size_t>(0);
+  auto last_commit_id = std::make_shared<CommitId>();
+  auto synced_commit_ids = std::make_shared<std::vector<CommitId>>();
+  RunOnIoThread(
+      [
+        db = db_, min_commit_id = collection_->last_swept_id,
+        max_count = options_.max_items_per_step, read_count, last_commit_id,
+        synced_commit_ids
+      ] {
+        std::vector<CommitId> commit_ids;
+        Status s = db->GetDeltaCommitIds(min_commit_id, max_count, &commit_ids);
+        if (s != Status::OK) {
+          return s;
+        }
+        *read_count = commit_ids.size();
+        if (!commit_ids.empty()) {
+          *last_commit_id = commit_ids.back();
+        }
+        for (CommitId& commit_id : commit_ids) {
+          bool is_synced;
+          s = db->IsCommitSynced(commit_id, &is_synced);
+          if (s != Status::OK) {
+            return s;
+          }
+          if (is_synced) {
+            synced_commit_ids->push_back(std::move(commit_id));
+          }
+        }
+        return Status::OK;
+      },
+      [ this, read_count, last_commit_id, synced_commit_ids ](Status s) {
+        if (s != Status::OK) {
+          Finish(s);
+          return;
+        }
+        bool done = *read_count < options_.max_items_per_step;
+        if (*read_count != 0) {
+          collection_->last_swept_id = std::move(*last_commit_id);
+        }
+        uint64_t deltas_deleted = synced_commit_ids->size();
+        db_->RemoveDeltaObjectIds(
+            std::move(*synced_commit_ids),
+            [ this, deltas_deleted, done ](Status s) {
+              if (s != Status::OK) {
+                Finish(s);
+                return;
+              }
+              collection_->stats.deltas_deleted += deltas_deleted;
+              if (done) {
+                collection_->phase = Collection::Phase::SEGMENTS;
+                collection_->last_swept_id.clear();
+              }
+              Continue();
+            });
+      });
+}
+
+void GarbageCollector::SweepSegments() {
+  // Records written in the pack segments are only indexed once synced to disk.
+  // Segments can only be deleted if all their records were indexed when their
+  // locations were swept, and no record was written since then.
+  if (!collection_->segments_collectable ||
+      page_storage_->HasPendingObjectWrites() ||
+      page_storage_->object_writes_started() !=
+          collection_->object_writes_started) {
+    Finish(Status::OK);
+    return;
+  }
+  // New records are only written in the current segment or the ones after it.
+  auto segments = std::make_shared<std::vector<uint32_t>>();
+  auto current_segment = std::make_shared<uint32_t>();
+  RunOnIoThread(
+      [ pack_store = pack_store_, segments, current_segment ] {
+        return pack_store->GetSegments(segments.get(), current_segment.get());
+      },
+      [ this, segments, current_segment ](Status s) {
+        if (s != Status::OK) {
+          Finish(s);
+          return;
+        }
+        auto dead_segments = std::make_shared<std::vector<uint32_t>>();
+        for (uint32_t segment : *segments) {
+          if (segment < *current_segment &&
+              collection_->live_segments.count(segment) == 0) {
+            dead_segments->push_back(segment);
+          }
+        }
+        if (dead_segments->empty()) {
+          Finish(Status::OK);
+          return;
+        }
+        auto bytes_reclaimed = std::make_shared<uint64_t>(0);
+        auto segments_deleted = std::make_shared<uint64_t>(0);
+        RunOnIoThread(
+            [
+              pack_store = pack_store_, dead_segments, bytes_reclaimed,
+              segments_deleted
+            ] {
+              for (uint32_t segment : *dead_segments) {
+                uint64_t size;
+                Status s = pack_store->DeleteSegment(segment, &size);
+                if (s != Status::OK) {
+                  return s;
+                }
+                ++*segments_deleted;
+                *bytes_reclaimed += size;
+              }
+              return Status::OK;
+            },
+            [ this, bytes_reclaimed, segments_deleted ](Status s) {
+              collection_->stats.segments_deleted += *segments_deleted;
+              collection_->stats.bytes_reclaimed += *bytes_reclaimed;
+              Finish(s);
+            });
+      });
+}
+
+bool GarbageCollector::IsCollectable(ObjectIdView object_id, bool is_synced) {
+  // Unsynced objects cannot be fetched again.
+  return is_synced && collection_->marked_objects.count(object_id) == 0 &&
+         !page_storage_->ObjectIsUntracked(object_id);
+}
+
+void GarbageCollector::Finish(Status status) {
+  GarbageCollectionStats stats = collection_->stats;
+  collection_.reset();
+  std::vector<std::function<void(Status, GarbageCollectionStats)>> callbacks;
+  callbacks.swap(callbacks_);
+  for (const auto& callback : callbacks) {
+    callback(status, stats);
+  }
+}
+
+}  // namespace storage
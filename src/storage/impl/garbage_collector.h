@@ -0,0 +1,144 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_GARBAGE_COLLECTOR_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_GARBAGE_COLLECTOR_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "apps/ledger/src/storage/impl/db.h"
+#include "apps/ledger/src/storage/impl/live_commit_tracker.h"
+#include "apps/ledger/src/storage/impl/pack_store.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace storage {
+
+class PageStorageImpl;
+
+// Limits the work done by |GarbageCollector| at once.
+struct GarbageCollectorOptions {
+  // Delay between the end of a collection and the start of the next one.
+  ftl::TimeDelta collection_interval = ftl::TimeDelta::FromSeconds(600);
+  // Delay between two steps of a collection.
+  ftl::TimeDelta step_delay = ftl::TimeDelta::FromMilliseconds(20);
+  // Maximal number of tree nodes read, or of rows read and deleted, in a single
+  // step of a collection.
+  size_t max_items_per_step = 256;
+};
+
+// Summary of a collection.
+struct GarbageCollectionStats {
+  uint64_t objects_deleted = 0;
+  uint64_t segments_deleted = 0;
+  uint64_t deltas_deleted = 0;
+  // Size of the content of the objects deleted from the database, and of the
+  // pack segments deleted.
+  uint64_t bytes_reclaimed = 0;
+};
+
+// |GarbageCollector| reclaims the space used by the objects of a page that are
+// no longer reachable, with an incremental mark-and-sweep collection.
+//
+// The roots of the collection are the heads of the page, its unsynced commits,
+// and the commits in use, as tracked by |LiveCommitTracker|: the commits held
+// by snapshots and other clients of the page, and the parents of the journals
+// in progress. All the tree nodes and values reachable from the roots are
+// marked. The objects stored in the database and the pack segments are then
+// swept: an unmarked object is only deleted if it is synced to the cloud, and
+// can thus be fetched again, and if it is not untracked. A pack segment is
+// deleted once none of its objects is indexed anymore. The deltas of synced
+// commits, only needed to upload them, are deleted as well.
+//
+// Commits themselves are not collected yet. Every stored commit is an ancestor
+// of a head, and the ancestry is read to find the common ancestors of merges
+// and to sync the page: collecting old commits requires first bounding how far
+// back these traversals go.
+//
+// The collection runs in the background on the main thread. Each step reads or
+// deletes a bounded number of items, and steps are separated by a delay, so
+// that the collection does not compete with the other accesses to the page. If
+// new roots appear during a collection, the objects reachable from them are
+// marked before any other deletion. Objects are not deleted while commits from
+// sync are being added, as the objects of their trees are stored first.
+class GarbageCollector {
+ public:
+  // |page_storage|, |db|, |pack_store| and |live_commit_tracker| must outlive
+  // this object. |pack_store| is only accessed on |io_runner|.
+  GarbageCollector(ftl::RefPtr<ftl::TaskRunner> main_runner,
+                   ftl::RefPtr<ftl::TaskRunner> io_runner,
+                   PageStorageImpl* page_storage,
+                   DB* db,
+                   PackStore* pack_store,
+                   LiveCommitTracker* live_commit_tracker,
+                   GarbageCollectorOptions options = GarbageCollectorOptions());
+  ~GarbageCollector();
+
+  // Starts running collections periodically.
+  void Start();
+
+  // Runs a collection, and calls |callback| with its result once it completes.
+  // If a collection is already running, |callback| is called once it
+  // completes.
+  void Collect(std::function<void(Status, GarbageCollectionStats)> callback);
+
+ private:
+  struct Collection;
+
+  void ScheduleCollection();
+  // Runs |operation| on |io_runner_|, and calls |callback| with its result on
+  // the main thread. See |storage::RunOnIoThread|.
+  void RunOnIoThread(std::function<Status()> operation,
+                     std::function<void(Status)> callback);
+
+  void StartCollection();
+  // Adds the heads and the commits in use that are not roots of the current
+  // collection yet to its roots. Returns whether new roots were found.
+  bool AddNewRoots();
+  // Returns whether the sweep must wait before deleting objects: either commits
+  // from sync are being added, or new roots were found and must be marked.
+  bool MustDelaySweep();
+  // Schedules the next step of the collection.
+  void Continue();
+  // Marks the objects reachable from the roots that are not marked yet, if
+  // any, or resumes the sweep.
+  void RunStep();
+  void MarkNextRoot();
+  void MarkNextNode(size_t marked_nodes);
+  void SweepContent();
+  void SweepLocations();
+  void SweepDeltas();
+  void SweepSegments();
+  // Returns whether the object with the given |object_id|, synced to the cloud
+  // if |is_synced| is true, can be deleted.
+  bool IsCollectable(ObjectIdView object_id, bool is_synced);
+  void Finish(Status status);
+
+  const ftl::RefPtr<ftl::TaskRunner> main_runner_;
+  const ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  PageStorageImpl* const page_storage_;
+  DB* const db_;
+  PackStore* const pack_store_;
+  LiveCommitTracker* const live_commit_tracker_;
+  const GarbageCollectorOptions options_;
+
+  bool started_ = false;
+  std::unique_ptr<Collection> collection_;
+  std::vector<std::function<void(Status, GarbageCollectionStats)>> callbacks_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<GarbageCollector> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GarbageCollector);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_GARBAGE_COLLECTOR_H_
@@ -0,0 +1,47 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_IO_THREAD_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_IO_THREAD_H_
+
+#include <functional>
+#include <utility>
+
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace storage {
+
+// Runs |operation| on |io_runner|, and calls |callback| with its result on the
+// message loop of the calling thread, unless |owner| is deleted first. If this
+// is called on the io thread, |operation| and |callback| run immediately.
+template <typename T>
+void RunOnIoThread(const ftl::RefPtr<ftl::TaskRunner>& io_runner,
+                   ftl::WeakPtr<T> owner,
+                   std::function<Status()> operation,
+                   std::function<void(Status)> callback) {
+  if (io_runner->RunsTasksOnCurrentThread()) {
+    callback(operation());
+    return;
+  }
+  io_runner->PostTask([
+    owner = std::move(owner), operation = std::move(operation),
+    callback = std::move(callback),
+    reply_runner = mtl::MessageLoop::GetCurrent()->task_runner()
+  ] {
+    Status status = operation();
+    reply_runner->PostTask([owner, callback, status] {
+      if (owner) {
+        callback(status);
+      }
+    });
+  });
+}
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_IO_THREAD_H_
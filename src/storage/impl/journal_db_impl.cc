@@ -6,6 +6,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/storage/impl/btree/builder.h"
@@ -16,26 +17,70 @@
 
 namespace storage {
 
+namespace {
+
+// Iterates over the changes of an in-memory journal.
+class InMemoryChangeIterator : public Iterator<const EntryChange> {
+ public:
+  explicit InMemoryChangeIterator(
+      const std::map<std::string, EntryChange>& changes)
+      : it_(changes.begin()), end_(changes.end()) {}
+
+  ~InMemoryChangeIterator() override {}
+
+  Iterator<const EntryChange>& Next() override {
+    FTL_DCHECK(Valid()) << "Iterator::Next iterator not valid";
+    ++it_;
+    return *this;
+  }
+
+  bool Valid() const override { return it_ != end_; }
+
+  Status GetStatus() const override { return Status::OK; }
+
+  const EntryChange& operator*() const override { return it_->second; }
+  const EntryChange* operator->() const override { return &it_->second; }
+
+ private:
+  std::map<std::string, EntryChange>::const_iterator it_;
+  const std::map<std::string, EntryChange>::const_iterator end_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(InMemoryChangeIterator);
+};
+
+}  // namespace
+
 JournalDBImpl::JournalDBImpl(JournalType type,
                              coroutine::CoroutineService* coroutine_service,
                              PageStorageImpl* page_storage,
                              DB* db,
                              const JournalId& id,
-                             const CommitId& base)
+                             const CommitId& base,
+                             size_t max_in_memory_size)
     : type_(type),
       coroutine_service_(coroutine_service),
       page_storage_(page_storage),
       db_(db),
       id_(id),
       base_(base),
+      live_commit_tracker_(page_storage->GetLiveCommitTracker()),
       valid_(true),
-      failed_operation_(false) {}
+      failed_operation_(false),
+      max_in_memory_size_(max_in_memory_size),
+      in_memory_(type == JournalType::EXPLICIT),
+      weak_factory_(this) {
+  live_commit_tracker_->AddCommit(base_);
+}
 
 JournalDBImpl::~JournalDBImpl() {
   // Log a warning if the journal was not committed or rolled back.
   if (valid_) {
     FTL_LOG(WARNING) << "Journal not committed or rolled back.";
   }
+  live_commit_tracker_->RemoveCommit(base_);
+  if (other_) {
+    live_commit_tracker_->RemoveCommit(*other_);
+  }
 }
 
 std::unique_ptr<Journal> JournalDBImpl::Simple(
@@ -44,9 +89,10 @@ std::unique_ptr<Journal> JournalDBImpl::Simple(
     PageStorageImpl* page_storage,
     DB* db,
     const JournalId& id,
-    const CommitId& base) {
-  return std::unique_ptr<Journal>(
-      new JournalDBImpl(type, coroutine_service, page_storage, db, id, base));
+    const CommitId& base,
+    size_t max_in_memory_size) {
+  return std::unique_ptr<Journal>(new JournalDBImpl(
+      type, coroutine_service, page_storage, db, id, base, max_in_memory_size));
 }
 
 std::unique_ptr<Journal> JournalDBImpl::Merge(
@@ -55,10 +101,13 @@ std::unique_ptr<Journal> JournalDBImpl::Merge(
     DB* db,
     const JournalId& id,
     const CommitId& base,
-    const CommitId& other) {
-  JournalDBImpl* db_journal = new JournalDBImpl(
-      JournalType::EXPLICIT, coroutine_service, page_storage, db, id, base);
+    const CommitId& other,
+    size_t max_in_memory_size) {
+  JournalDBImpl* db_journal =
+      new JournalDBImpl(JournalType::EXPLICIT, coroutine_service, page_storage,
+                        db, id, base, max_in_memory_size);
   db_journal->other_ = std::make_unique<CommitId>(other);
+  db_journal->live_commit_tracker_->AddCommit(other);
   std::unique_ptr<Journal> journal(db_journal);
   return journal;
 }
@@ -67,22 +116,73 @@ const JournalId& JournalDBImpl::GetId() const {
   return id_;
 }
 
-Status JournalDBImpl::UpdateValueCounter(
-    ObjectIdView object_id,
-    const std::function<int64_t(int64_t)>& operation) {
-  // Update the counter fo untracked objects only.
-  if (!page_storage_->ObjectIsUntracked(object_id)) {
+Status JournalDBImpl::ApplyInMemory(EntryChange change) {
+  FTL_DCHECK(in_memory_);
+  // Only the values added or removed by |change| have their counter updated.
+  auto it = changes_.find(change.entry.key);
+  if (it != changes_.end()) {
+    changes_size_ -= it->first.size() + it->second.entry.object_id.size();
+    const EntryChange& previous = it->second;
+    if (!previous.deleted &&
+        (change.deleted ||
+         previous.entry.object_id != change.entry.object_id)) {
+      UpdateInMemoryValueCounter(previous.entry.object_id, -1);
+    }
+    if (!change.deleted &&
+        (previous.deleted ||
+         previous.entry.object_id != change.entry.object_id)) {
+      UpdateInMemoryValueCounter(change.entry.object_id, 1);
+    }
+  } else if (!change.deleted) {
+    UpdateInMemoryValueCounter(change.entry.object_id, 1);
+  }
+  changes_size_ += change.entry.key.size() + change.entry.object_id.size();
+  std::string key = change.entry.key;
+  changes_[std::move(key)] = std::move(change);
+
+  if (changes_size_ <= max_in_memory_size_) {
     return Status::OK;
   }
-  int64_t counter;
-  Status s = db_->GetJournalValueCounter(id_, object_id, &counter);
-  if (s != Status::OK) {
-    return s;
+  return WriteInMemoryChanges();
+}
+
+void JournalDBImpl::UpdateInMemoryValueCounter(const ObjectId& object_id,
+                                               int64_t delta) {
+  // Update the counter for untracked objects only.
+  if (!page_storage_->ObjectIsUntracked(object_id)) {
+    return;
+  }
+  int64_t& counter = value_counters_[object_id];
+  counter += delta;
+  FTL_DCHECK(counter >= 0);
+  if (counter == 0) {
+    value_counters_.erase(object_id);
+  }
+}
+
+Status JournalDBImpl::WriteInMemoryChanges() {
+  std::unique_ptr<DB::Batch> batch = db_->StartBatch();
+  std::vector<ObjectId> values;
+  for (const auto& change : changes_) {
+    Status s = change.second.deleted
+                   ? db_->RemoveJournalEntry(id_, change.first)
+                   : db_->AddJournalEntry(id_, change.first,
+                                          change.second.entry.object_id,
+                                          change.second.entry.priority);
+    if (s == Status::OK && !change.second.deleted) {
+      s = page_storage_->WriteLocalObject(change.second.entry.object_id);
+      values.push_back(change.second.entry.object_id);
+    }
+    if (s != Status::OK) {
+      return s;
+    }
   }
-  int64_t next_counter = operation(counter);
-  FTL_DCHECK(next_counter >= 0);
-  s = db_->SetJournalValueCounter(id_, object_id, next_counter);
-  return s;
+  ExecuteBatch(std::move(batch), std::move(values));
+  in_memory_ = false;
+  changes_.clear();
+  changes_size_ = 0;
+  value_counters_.clear();
+  return Status::OK;
 }
 
 Status JournalDBImpl::Put(convert::ExtendedStringView key,
@@ -91,42 +191,66 @@ Status JournalDBImpl::Put(convert::ExtendedStringView key,
   if (!valid_ || (type_ == JournalType::EXPLICIT && failed_operation_)) {
     return Status::ILLEGAL_STATE;
   }
-  std::string prev_id;
-  Status prev_entry_status = db_->GetJournalValue(id_, key, &prev_id);
-
+  if (in_memory_) {
+    Status s = ApplyInMemory(EntryChange{
+        Entry{key.ToString(), object_id.ToString(), priority}, false});
+    if (s != Status::OK) {
+      failed_operation_ = true;
+    }
+    return s;
+  }
   std::unique_ptr<DB::Batch> batch = db_->StartBatch();
   Status s = db_->AddJournalEntry(id_, key, object_id, priority);
+  if (s == Status::OK) {
+    // The content of the value is written with the entry.
+    s = page_storage_->WriteLocalObject(object_id);
+  }
   if (s != Status::OK) {
     failed_operation_ = true;
     return s;
   }
-  if (object_id != prev_id) {
-    UpdateValueCounter(object_id, [](int64_t counter) { return counter + 1; });
-    if (prev_entry_status == Status::OK) {
-      UpdateValueCounter(prev_id, [](int64_t counter) { return counter - 1; });
-    }
-  }
-  return batch->Execute();
+  ExecuteBatch(std::move(batch), {object_id.ToString()});
+  return Status::OK;
 }
 
 Status JournalDBImpl::Delete(convert::ExtendedStringView key) {
   if (!valid_ || (type_ == JournalType::EXPLICIT && failed_operation_)) {
     return Status::ILLEGAL_STATE;
   }
-  std::string prev_id;
-  Status prev_entry_status = db_->GetJournalValue(id_, key, &prev_id);
-
+  if (in_memory_) {
+    Status s = ApplyInMemory(
+        EntryChange{Entry{key.ToString(), "", KeyPriority::EAGER}, true});
+    if (s != Status::OK) {
+      failed_operation_ = true;
+    }
+    return s;
+  }
   std::unique_ptr<DB::Batch> batch = db_->StartBatch();
   Status s = db_->RemoveJournalEntry(id_, key);
   if (s != Status::OK) {
     failed_operation_ = true;
     return s;
   }
+  ExecuteBatch(std::move(batch), {});
+  return Status::OK;
+}
 
-  if (prev_entry_status == Status::OK) {
-    UpdateValueCounter(prev_id, [](int64_t counter) { return counter - 1; });
-  }
-  return batch->Execute();
+void JournalDBImpl::ExecuteBatch(std::unique_ptr<DB::Batch> batch,
+                                 std::vector<ObjectId> values) {
+  batch->Execute([
+    weak_this = weak_factory_.GetWeakPtr(), page_storage = page_storage_,
+    values = std::move(values)
+  ](Status status) {
+    if (status != Status::OK) {
+      if (weak_this && weak_this->write_status_ == Status::OK) {
+        weak_this->write_status_ = status;
+      }
+      return;
+    }
+    for (const ObjectId& object_id : values) {
+      page_storage->MarkObjectWritten(object_id);
+    }
+  });
 }
 
 void JournalDBImpl::GetParents(
@@ -143,37 +267,58 @@ void JournalDBImpl::GetParents(
   waiter->Finalize(std::move(callback));
 }
 
-Status JournalDBImpl::ClearCommittedJournal(
-    std::unordered_set<ObjectId> new_nodes) {
+void JournalDBImpl::ClearCommittedJournal(
+    const CommitId& commit_id,
+    std::unordered_set<ObjectId> new_nodes,
+    std::function<void(Status)> callback) {
   // Mark objects as unsynced in a single batch.
   std::vector<ObjectId> objects_to_sync;
-  Status status = db_->GetJournalValues(id_, &objects_to_sync);
-  if (status != Status::OK) {
-    return status;
+  for (const auto& value_counter : value_counters_) {
+    objects_to_sync.push_back(value_counter.first);
   }
+  Status status;
   std::unique_ptr<DB::Batch> batch = db_->StartBatch();
   for (const ObjectId& tree_node_id : new_nodes) {
     status = db_->MarkObjectIdUnsynced(tree_node_id);
     if (status != Status::OK) {
-      return status;
+      callback(status);
+      return;
     }
   }
   for (const ObjectId& object_id : objects_to_sync) {
     status = db_->MarkObjectIdUnsynced(object_id);
     if (status != Status::OK) {
-      return status;
+      callback(status);
+      return;
     }
   }
-  status = batch->Execute();
+  std::vector<ObjectId> delta_objects(new_nodes.begin(), new_nodes.end());
+  delta_objects.insert(delta_objects.end(), objects_to_sync.begin(),
+                       objects_to_sync.end());
+  status = db_->AddDeltaObjectIds(commit_id, delta_objects);
   if (status != Status::OK) {
-    return status;
-  }
-  // Notify PageStorage that the objects are now tracked.
-  for (const ObjectId& object_id : objects_to_sync) {
-    page_storage_->MarkObjectTracked(object_id);
+    callback(status);
+    return;
   }
-  db_->RemoveJournal(id_);
-  return Status::OK;
+  batch->Execute([
+    this, objects_to_sync = std::move(objects_to_sync),
+    callback = std::move(callback)
+  ](Status status) {
+    if (status != Status::OK) {
+      callback(status);
+      return;
+    }
+    // Notify PageStorage that the objects are now tracked.
+    for (const ObjectId& object_id : objects_to_sync) {
+      page_storage_->MarkObjectTracked(object_id);
+    }
+    changes_.clear();
+    value_counters_.clear();
+    if (!in_memory_) {
+      RemoveFromDb();
+    }
+    callback(Status::OK);
+  });
 }
 
 void JournalDBImpl::Commit(
@@ -191,63 +336,111 @@ void JournalDBImpl::Commit(
       callback(status, nullptr);
       return;
     }
-    std::unique_ptr<Iterator<const EntryChange>> entries;
-    status = db_->GetJournalEntries(id_, &entries);
-    if (status != Status::OK) {
-      callback(status, nullptr);
+    if (in_memory_) {
+      CommitEntries(std::make_unique<InMemoryChangeIterator>(changes_),
+                    std::move(parents), std::move(callback));
       return;
     }
-    btree::ApplyChanges(
-        coroutine_service_, page_storage_, parents[0]->GetRootId(),
-        std::move(entries),
-        ftl::MakeCopyable([
-          this, parents = std::move(parents), callback = std::move(callback)
-        ](Status status, ObjectId object_id,
-          std::unordered_set<ObjectId> new_nodes) mutable {
-          if (status != Status::OK) {
-            callback(status, nullptr);
-            return;
-          }
-          // If the commit is a no-op, returns early.
-          if (parents.size() == 1 &&
-              parents.front()->GetRootId() == object_id) {
-            FTL_DCHECK(new_nodes.empty());
-            callback(Rollback(), std::move(parents.front()));
-            return;
-          }
-          std::unique_ptr<storage::Commit> commit =
-              CommitImpl::FromContentAndParents(page_storage_, object_id,
-                                                std::move(parents));
-          page_storage_->AddCommitFromLocal(
-              commit->Clone(), ftl::MakeCopyable([
-                this, commit = std::move(commit),
-                new_nodes = std::move(new_nodes), callback
-              ](Status status) mutable {
-                valid_ = false;
-                if (status != Status::OK) {
-                  callback(status, nullptr);
-                  return;
-                }
-                status = ClearCommittedJournal(std::move(new_nodes));
-                if (status != Status::OK) {
-                  callback(status, nullptr);
-                } else {
-                  callback(Status::OK, std::move(commit));
-                }
-              }));
-        }));
+    // The entries are read after all the writes of this journal: their
+    // failures are known by then.
+    db_->GetJournalEntries(id_, ftl::MakeCopyable([
+      this, parents = std::move(parents), callback = std::move(callback)
+    ](Status status,
+      std::unique_ptr<Iterator<const EntryChange>> entries) mutable {
+      if (status == Status::OK) {
+        status = write_status_;
+      }
+      if (status != Status::OK) {
+        callback(status, nullptr);
+        return;
+      }
+      // The untracked values referenced by the entries are counted as for
+      // in-memory journals.
+      for (; entries->Valid(); entries->Next()) {
+        const EntryChange& change = **entries;
+        if (!change.deleted) {
+          UpdateInMemoryValueCounter(change.entry.object_id, 1);
+        }
+        changes_[change.entry.key] = change;
+      }
+      CommitEntries(std::make_unique<InMemoryChangeIterator>(changes_),
+                    std::move(parents), std::move(callback));
+    }));
   });
 }
 
+void JournalDBImpl::CommitEntries(
+    std::unique_ptr<Iterator<const EntryChange>> entries,
+    std::vector<std::unique_ptr<const storage::Commit>> parents,
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
+  btree::ApplyChanges(
+      coroutine_service_, page_storage_, page_storage_->tree_node_cache(),
+      parents[0]->GetRootId(), std::move(entries),
+      ftl::MakeCopyable([
+        this, parents = std::move(parents), callback = std::move(callback)
+      ](Status status, ObjectId object_id,
+        std::unordered_set<ObjectId> new_nodes) mutable {
+        if (status != Status::OK) {
+          callback(status, nullptr);
+          return;
+        }
+        // If the commit is a no-op, returns early.
+        if (parents.size() == 1 && parents.front()->GetRootId() == object_id) {
+          FTL_DCHECK(new_nodes.empty());
+          callback(Rollback(), std::move(parents.front()));
+          return;
+        }
+        std::unique_ptr<storage::Commit> commit =
+            CommitImpl::FromContentAndParents(page_storage_, object_id,
+                                              std::move(parents),
+                                              live_commit_tracker_);
+        page_storage_->AddCommitFromLocal(
+            commit->Clone(), ftl::MakeCopyable([
+              this, commit = std::move(commit),
+              new_nodes = std::move(new_nodes), callback
+            ](Status status) mutable {
+              valid_ = false;
+              if (status != Status::OK) {
+                callback(status, nullptr);
+                return;
+              }
+              CommitId commit_id = commit->GetId();
+              ClearCommittedJournal(
+                  commit_id, std::move(new_nodes), ftl::MakeCopyable([
+                    commit = std::move(commit), callback
+                  ](Status status) mutable {
+                    if (status != Status::OK) {
+                      callback(status, nullptr);
+                    } else {
+                      callback(Status::OK, std::move(commit));
+                    }
+                  }));
+            }));
+      }));
+}
+
 Status JournalDBImpl::Rollback() {
   if (!valid_) {
     return Status::ILLEGAL_STATE;
   }
-  Status s = db_->RemoveJournal(id_);
-  if (s == Status::OK) {
+  if (in_memory_) {
+    changes_.clear();
+    value_counters_.clear();
     valid_ = false;
+    return Status::OK;
   }
-  return s;
+  RemoveFromDb();
+  valid_ = false;
+  return Status::OK;
+}
+
+void JournalDBImpl::RemoveFromDb() {
+  db_->RemoveJournal(id_, [](Status status) {
+    if (status != Status::OK) {
+      FTL_LOG(ERROR) << "Unable to remove a journal from the database.";
+    }
+  });
 }
 
 }  // namespace storage
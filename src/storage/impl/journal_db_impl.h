@@ -8,20 +8,29 @@
 #include "apps/ledger/src/storage/public/journal.h"
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
 #include "apps/ledger/src/storage/impl/db.h"
+#include "apps/ledger/src/storage/impl/live_commit_tracker.h"
 #include "apps/ledger/src/storage/impl/page_storage_impl.h"
 #include "apps/ledger/src/storage/public/commit.h"
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
 
 namespace storage {
 
-// A |JournalDBImpl| represents a commit in progress.
+// A |JournalDBImpl| represents a commit in progress. The changes of implicit
+// journals are written in the database, so that they can be committed after a
+// restart. Explicit journals are discarded on restart: their changes are kept
+// in memory, and only written in the database once their size exceeds
+// |max_in_memory_size|. Changes are written on the io thread after |Put| and
+// |Delete| return: the failure of a write is reported by |Commit|.
 class JournalDBImpl : public Journal {
  public:
   ~JournalDBImpl() override;
@@ -33,7 +42,8 @@ class JournalDBImpl : public Journal {
       PageStorageImpl* page_storage,
       DB* db,
       const JournalId& id,
-      const CommitId& base);
+      const CommitId& base,
+      size_t max_in_memory_size);
 
   // Creates a new Journal for a merge commit.
   static std::unique_ptr<Journal> Merge(
@@ -42,11 +52,15 @@ class JournalDBImpl : public Journal {
       DB* db,
       const JournalId& id,
       const CommitId& base,
-      const CommitId& other);
+      const CommitId& other,
+      size_t max_in_memory_size);
 
   // Returns the id of this journal.
   const JournalId& GetId() const;
 
+  // Returns whether the changes of this journal are only kept in memory.
+  bool IsInMemory() const { return in_memory_; }
+
   // Journal :
   Status Put(convert::ExtendedStringView key,
              ObjectIdView object_id,
@@ -63,17 +77,40 @@ class JournalDBImpl : public Journal {
                 PageStorageImpl* page_storage,
                 DB* db,
                 const JournalId& id,
-                const CommitId& base);
-
-  Status UpdateValueCounter(ObjectIdView object_id,
-                            const std::function<int64_t(int64_t)>& operation);
+                const CommitId& base,
+                size_t max_in_memory_size);
+
+  // Records |change| in |changes_|, and writes all the changes in the database
+  // if they become too big to be kept in memory.
+  Status ApplyInMemory(EntryChange change);
+  void UpdateInMemoryValueCounter(const ObjectId& object_id, int64_t delta);
+  // Writes the changes kept in memory in the database.
+  Status WriteInMemoryChanges();
+  // Writes |batch| on the io thread, and marks the locally created |values|
+  // whose content it contains as written.
+  void ExecuteBatch(std::unique_ptr<DB::Batch> batch,
+                    std::vector<ObjectId> values);
+  // Removes the rows of this journal from the database, on the io thread.
+  void RemoveFromDb();
 
   void GetParents(
       std::function<void(Status,
                          std::vector<std::unique_ptr<const storage::Commit>>)>
           callback);
 
-  Status ClearCommittedJournal(std::unordered_set<ObjectId> new_nodes);
+  // Builds the tree of the new commit from the changes in |entries|, and adds
+  // this commit to the page storage.
+  void CommitEntries(
+      std::unique_ptr<Iterator<const EntryChange>> entries,
+      std::vector<std::unique_ptr<const storage::Commit>> parents,
+      std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+          callback);
+
+  // Marks the objects introduced by the commit with the given |commit_id| as
+  // unsynced, records them as its delta, and removes this journal.
+  void ClearCommittedJournal(const CommitId& commit_id,
+                             std::unordered_set<ObjectId> new_nodes,
+                             std::function<void(Status)> callback);
 
   const JournalType type_;
   coroutine::CoroutineService* const coroutine_service_;
@@ -82,6 +119,9 @@ class JournalDBImpl : public Journal {
   const JournalId id_;
   CommitId base_;
   std::unique_ptr<CommitId> other_;
+  // Keeps the parents of the commit in progress in use while this journal is
+  // alive.
+  const ftl::RefPtr<LiveCommitTracker> live_commit_tracker_;
   // A journal is no longer valid if either commit or rollback have been
   // executed.
   bool valid_;
@@ -90,6 +130,23 @@ class JournalDBImpl : public Journal {
   // other than rolling back will fail. IMPLICIT journals can still be commited
   // even if some operations have failed.
   bool failed_operation_;
+  // The status of the first write of this journal that failed on the io
+  // thread, after the operation requesting it returned.
+  Status write_status_ = Status::OK;
+
+  const size_t max_in_memory_size_;
+  bool in_memory_;
+  // The changes of an in-memory journal, by key, and the total size of their
+  // keys and values.
+  std::map<std::string, EntryChange> changes_;
+  size_t changes_size_ = 0;
+  // The number of times each untracked object is referenced in |changes_|.
+  // The changes of journals written in the database are only loaded in
+  // |changes_| when committing.
+  std::map<ObjectId, int64_t> value_counters_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<JournalDBImpl> weak_factory_;
 };
 
 }  // namespace storage
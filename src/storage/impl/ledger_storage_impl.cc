@@ -66,13 +66,21 @@ LedgerStorageImpl::LedgerStorageImpl(
     ftl::RefPtr<ftl::TaskRunner> main_runner,
     ftl::RefPtr<ftl::TaskRunner> io_runner,
     coroutine::CoroutineService* coroutine_service,
+    RepositoryDb* repository_db,
     const std::string& base_storage_dir,
-    const std::string& ledger_name)
+    const std::string& ledger_name,
+    TreeNodeCache* tree_node_cache,
+    callback::WorkerPool* worker_pool)
     : main_runner_(std::move(main_runner)),
       io_runner_(std::move(io_runner)),
-      coroutine_service_(coroutine_service) {
-  storage_dir_ = ftl::Concatenate({base_storage_dir, "/", kSerializationVersion,
-                                   "/", GetDirectoryName(ledger_name)});
+      coroutine_service_(coroutine_service),
+      repository_db_(repository_db),
+      tree_node_cache_(tree_node_cache),
+      worker_pool_(worker_pool),
+      ledger_dir_name_(GetDirectoryName(ledger_name)) {
+  FTL_DCHECK(repository_db_->db());
+  storage_dir_ = ftl::Concatenate(
+      {base_storage_dir, "/", kSerializationVersion, "/", ledger_dir_name_});
 }
 
 LedgerStorageImpl::~LedgerStorageImpl() {}
@@ -86,8 +94,11 @@ void LedgerStorageImpl::CreatePageStorage(
     callback(Status::INTERNAL_IO_ERROR, nullptr);
     return;
   }
+  std::string key_prefix = GetKeyPrefixFor(page_id);
   auto result = std::make_unique<PageStorageImpl>(
-      main_runner_, io_runner_, coroutine_service_, path, std::move(page_id));
+      main_runner_, io_runner_, coroutine_service_, path, std::move(page_id),
+      PackSyncOptions(), kDefaultMaxDbObjectSize, tree_node_cache_,
+      worker_pool_, repository_db_, std::move(key_prefix));
   result->Init(ftl::MakeCopyable([
     callback = std::move(callback), result = std::move(result)
   ](Status status) mutable {
@@ -105,8 +116,20 @@ void LedgerStorageImpl::GetPageStorage(
     const std::function<void(Status, std::unique_ptr<PageStorage>)>& callback) {
   std::string path = GetPathFor(page_id);
   if (files::IsDirectory(path)) {
+    std::string key_prefix = GetKeyPrefixFor(page_id);
+    // Pages created by previous versions have their own database.
+    std::string legacy_db_path = ftl::Concatenate({path, "/", kPageDbDir});
+    if (files::IsDirectory(legacy_db_path)) {
+      Status status = repository_db_->ImportPageDb(legacy_db_path, key_prefix);
+      if (status != Status::OK) {
+        callback(status, nullptr);
+        return;
+      }
+    }
     auto result = std::make_unique<PageStorageImpl>(
-        main_runner_, io_runner_, coroutine_service_, path, std::move(page_id));
+        main_runner_, io_runner_, coroutine_service_, path, std::move(page_id),
+        PackSyncOptions(), kDefaultMaxDbObjectSize, tree_node_cache_,
+        worker_pool_, repository_db_, std::move(key_prefix));
     result->Init(ftl::MakeCopyable([
       callback = std::move(callback), result = std::move(result)
     ](Status status) mutable {
@@ -129,6 +152,11 @@ bool LedgerStorageImpl::DeletePageStorage(PageIdView page_id) {
   if (!files::IsDirectory(path)) {
     return false;
   }
+  // Delete the rows of the page first: a page directory without rows is an
+  // empty page.
+  if (repository_db_->DeleteByPrefix(GetKeyPrefixFor(page_id)) != Status::OK) {
+    return false;
+  }
   if (!files::DeletePath(path, true)) {
     FTL_LOG(ERROR) << "Unable to delete: " << path;
     return false;
@@ -151,4 +179,9 @@ std::string LedgerStorageImpl::GetPathFor(PageIdView page_id) {
   return ftl::Concatenate({storage_dir_, "/", GetDirectoryName(page_id)});
 }
 
+std::string LedgerStorageImpl::GetKeyPrefixFor(PageIdView page_id) {
+  FTL_DCHECK(!page_id.empty());
+  return GetPageKeyPrefix(ledger_dir_name_, GetDirectoryName(page_id));
+}
+
 }  // namespace storage
@@ -8,6 +8,8 @@
 #include <string>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
 #include "apps/ledger/src/storage/public/ledger_storage.h"
 #include "lib/ftl/tasks/task_runner.h"
 
@@ -15,11 +17,18 @@ namespace storage {
 
 class LedgerStorageImpl : public LedgerStorage {
  public:
+  // The pages created by this object store their rows in |repository_db|,
+  // which must be initialized. They decode their tree nodes through
+  // |tree_node_cache|, and run their CPU-bound work on |worker_pool|, if not
+  // null. The database, the cache and the pool must outlive these pages.
   LedgerStorageImpl(ftl::RefPtr<ftl::TaskRunner> main_runner,
                     ftl::RefPtr<ftl::TaskRunner> io_runner,
                     coroutine::CoroutineService* coroutine_service,
+                    RepositoryDb* repository_db,
                     const std::string& base_storage_dir,
-                    const std::string& ledger_name);
+                    const std::string& ledger_name,
+                    TreeNodeCache* tree_node_cache = nullptr,
+                    callback::WorkerPool* worker_pool = nullptr);
   ~LedgerStorageImpl() override;
 
   void CreatePageStorage(
@@ -39,10 +48,15 @@ class LedgerStorageImpl : public LedgerStorage {
 
  private:
   std::string GetPathFor(PageIdView page_id);
+  std::string GetKeyPrefixFor(PageIdView page_id);
 
   ftl::RefPtr<ftl::TaskRunner> main_runner_;
   ftl::RefPtr<ftl::TaskRunner> io_runner_;
   coroutine::CoroutineService* const coroutine_service_;
+  RepositoryDb* const repository_db_;
+  TreeNodeCache* const tree_node_cache_;
+  callback::WorkerPool* const worker_pool_;
+  const std::string ledger_dir_name_;
   std::string storage_dir_;
 };
 
@@ -8,10 +8,15 @@
 
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/glue/crypto/base64.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/public/constants.h"
 #include "apps/ledger/src/test/test_with_message_loop.h"
 #include "gtest/gtest.h"
+#include "lib/ftl/files/directory.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/concatenate.h"
 #include "lib/mtl/tasks/message_loop.h"
 
 namespace storage {
@@ -20,27 +25,31 @@ namespace {
 class LedgerStorageTest : public test::TestWithMessageLoop {
  public:
   LedgerStorageTest()
-      : storage_(message_loop_.task_runner(),
-                 message_loop_.task_runner(),
-                 &coroutine_service_,
-                 tmp_dir_.path(),
-                 "test_app") {}
+      : repository_db_(GetRepositoryDbPath(tmp_dir_.path())) {}
 
   ~LedgerStorageTest() override {}
 
- private:
-  files::ScopedTempDir tmp_dir_;
-  coroutine::CoroutineServiceImpl coroutine_service_;
+  // Test:
+  void SetUp() override {
+    ::test::TestWithMessageLoop::SetUp();
+    ASSERT_EQ(Status::OK, repository_db_.Init());
+    storage_ = std::make_unique<LedgerStorageImpl>(
+        message_loop_.task_runner(), message_loop_.task_runner(),
+        &coroutine_service_, &repository_db_, tmp_dir_.path(), "test_app");
+  }
 
  protected:
-  LedgerStorageImpl storage_;
+  files::ScopedTempDir tmp_dir_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  RepositoryDb repository_db_;
+  std::unique_ptr<LedgerStorageImpl> storage_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(LedgerStorageTest);
 };
 
 TEST_F(LedgerStorageTest, CreateGetCreatePageStorage) {
   PageId page_id = "1234";
-  storage_.GetPageStorage(
+  storage_->GetPageStorage(
       page_id,
       [this](Status status, std::unique_ptr<PageStorage> page_storage) {
         EXPECT_EQ(Status::NOT_FOUND, status);
@@ -51,14 +60,14 @@ TEST_F(LedgerStorageTest, CreateGetCreatePageStorage) {
 
   std::unique_ptr<PageStorage> page_storage;
   storage::Status status;
-  storage_.CreatePageStorage(
+  storage_->CreatePageStorage(
       page_id, callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &page_storage));
   EXPECT_FALSE(RunLoopWithTimeout());
   ASSERT_EQ(Status::OK, status);
   ASSERT_EQ(page_id, page_storage->GetId());
   page_storage.reset();
-  storage_.GetPageStorage(
+  storage_->GetPageStorage(
       page_id,
       [this](Status status, std::unique_ptr<PageStorage> page_storage) {
         EXPECT_EQ(Status::OK, status);
@@ -72,14 +81,14 @@ TEST_F(LedgerStorageTest, CreateDeletePageStorage) {
   PageId page_id = "1234";
   Status status;
   std::unique_ptr<PageStorage> page_storage;
-  storage_.CreatePageStorage(
+  storage_->CreatePageStorage(
       page_id, callback::Capture([this] { message_loop_.PostQuitTask(); },
                                  &status, &page_storage));
   EXPECT_FALSE(RunLoopWithTimeout());
   ASSERT_EQ(Status::OK, status);
   ASSERT_EQ(page_id, page_storage->GetId());
   page_storage.reset();
-  storage_.GetPageStorage(
+  storage_->GetPageStorage(
       page_id,
       [this](Status status, std::unique_ptr<PageStorage> page_storage) {
         EXPECT_EQ(Status::OK, status);
@@ -88,8 +97,8 @@ TEST_F(LedgerStorageTest, CreateDeletePageStorage) {
       });
   EXPECT_FALSE(RunLoopWithTimeout());
 
-  EXPECT_TRUE(storage_.DeletePageStorage(page_id));
-  storage_.GetPageStorage(
+  EXPECT_TRUE(storage_->DeletePageStorage(page_id));
+  storage_->GetPageStorage(
       page_id,
       [this](Status status, std::unique_ptr<PageStorage> page_storage) {
         EXPECT_EQ(Status::NOT_FOUND, status);
@@ -99,5 +108,48 @@ TEST_F(LedgerStorageTest, CreateDeletePageStorage) {
   EXPECT_FALSE(RunLoopWithTimeout());
 }
 
+TEST_F(LedgerStorageTest, ImportLegacyPageDb) {
+  PageId page_id = "1234";
+  // Neither the ledger name nor the page id contain bytes whose base64
+  // encoding is changed in directory names.
+  std::string ledger_dir_name;
+  std::string page_dir_name;
+  glue::Base64Encode("test_app", &ledger_dir_name);
+  glue::Base64Encode(page_id, &page_dir_name);
+  std::string page_dir =
+      ftl::Concatenate({tmp_dir_.path(), "/", kSerializationVersion, "/",
+                        ledger_dir_name, "/", page_dir_name});
+  std::string legacy_db_path = ftl::Concatenate({page_dir, "/", kPageDbDir});
+
+  // Create a page with its own database, as previous versions did.
+  Status status;
+  {
+    PageStorageImpl legacy_storage(message_loop_.task_runner(),
+                                   message_loop_.task_runner(),
+                                   &coroutine_service_, page_dir, page_id);
+    legacy_storage.Init(
+        callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    ASSERT_EQ(Status::OK, status);
+    EXPECT_EQ(Status::OK, legacy_storage.SetSyncMetadata("legacy"));
+  }
+  EXPECT_TRUE(files::IsDirectory(legacy_db_path));
+
+  std::unique_ptr<PageStorage> page_storage;
+  storage_->GetPageStorage(
+      page_id, callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &page_storage));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  EXPECT_FALSE(files::IsDirectory(legacy_db_path));
+
+  std::string sync_state;
+  EXPECT_EQ(Status::OK, page_storage->GetSyncMetadata(&sync_state));
+  EXPECT_EQ("legacy", sync_state);
+  std::vector<CommitId> heads;
+  EXPECT_EQ(Status::OK, page_storage->GetHeadCommitIds(&heads));
+  EXPECT_EQ(std::vector<CommitId>({kFirstPageCommitId.ToString()}), heads);
+}
+
 }  // namespace
 }  // namespace storage
@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/live_commit_tracker.h"
+
+#include "lib/ftl/logging.h"
+
+namespace storage {
+
+LiveCommitTracker::LiveCommitTracker() {}
+
+LiveCommitTracker::~LiveCommitTracker() {}
+
+void LiveCommitTracker::AddCommit(const CommitId& commit_id) {
+  ++live_commits_[commit_id];
+}
+
+void LiveCommitTracker::RemoveCommit(const CommitId& commit_id) {
+  auto it = live_commits_.find(commit_id);
+  FTL_DCHECK(it != live_commits_.end());
+  if (--it->second == 0) {
+    live_commits_.erase(it);
+  }
+}
+
+}  // namespace storage
@@ -0,0 +1,55 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_LIVE_COMMIT_TRACKER_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_LIVE_COMMIT_TRACKER_H_
+
+#include <map>
+
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+
+namespace storage {
+
+// Keeps track of the commits of a page that are in use: the commits of the
+// page that are alive, and the base commits of its journals in progress. The
+// objects reachable from these commits must be kept by the garbage collector.
+//
+// The tracker is shared by the commits it tracks, which can outlive the page
+// storage. This class is not thread safe: it must only be used on the main
+// thread.
+class LiveCommitTracker : public ftl::RefCountedThreadSafe<LiveCommitTracker> {
+ public:
+  inline static ftl::RefPtr<LiveCommitTracker> Create() {
+    return ftl::AdoptRef(new LiveCommitTracker());
+  }
+
+  // Registers a new use of the commit with the given |commit_id|.
+  void AddCommit(const CommitId& commit_id);
+
+  // Unregisters a use of the commit with the given |commit_id|, previously
+  // registered with |AddCommit|.
+  void RemoveCommit(const CommitId& commit_id);
+
+  // Returns the commits currently in use, with their number of uses.
+  const std::map<CommitId, size_t>& live_commits() const {
+    return live_commits_;
+  }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(LiveCommitTracker);
+  LiveCommitTracker();
+  ~LiveCommitTracker();
+
+  // Number of uses of each live commit.
+  std::map<CommitId, size_t> live_commits_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LiveCommitTracker);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_LIVE_COMMIT_TRACKER_H_
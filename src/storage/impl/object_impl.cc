@@ -6,35 +6,243 @@
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-#include <vector>
+#include <algorithm>
+#include <utility>
 
-#include "lib/ftl/files/file.h"
+#include "apps/ledger/src/glue/compression/compression.h"
+#include "lib/ftl/files/eintr_wrapper.h"
 #include "lib/ftl/logging.h"
+#include "lib/mtl/vmo/strings.h"
 
 namespace storage {
 
 ObjectImpl::ObjectImpl(ObjectId id, std::string file_path)
-    : id_(id), file_path_(file_path) {}
+    : id_(id),
+      file_path_(file_path),
+      is_range_(false),
+      offset_(0),
+      encoding_(Encoding::RAW),
+      vmo_cache_(nullptr),
+      size_(0),
+      size_known_(false) {}
 
-ObjectImpl::~ObjectImpl() {}
+ObjectImpl::ObjectImpl(ObjectId id,
+                       std::string file_path,
+                       uint64_t offset,
+                       uint64_t size,
+                       Encoding encoding,
+                       ftl::RefPtr<ObjectVmoCache> vmo_cache)
+    : id_(id),
+      file_path_(file_path),
+      is_range_(true),
+      offset_(offset),
+      encoding_(encoding),
+      vmo_cache_(std::move(vmo_cache)),
+      size_(size),
+      size_known_(true) {}
+
+ObjectImpl::~ObjectImpl() {
+  if (mapped_address_) {
+    munmap(mapped_address_, mapped_size_);
+  }
+}
+
+Status ObjectImpl::Init() {
+  return Open() ? Status::OK : Status::INTERNAL_IO_ERROR;
+}
 
 ObjectId ObjectImpl::GetId() const {
   return id_;
 }
 
 Status ObjectImpl::GetData(ftl::StringView* data) const {
-  if (data_.empty()) {
-    std::string res;
-    // TODO(nellyv): Replace with mmap when supported.
-    if (!files::ReadFileToString(file_path_.data(), &res)) {
-      return Status::INTERNAL_IO_ERROR;
-    }
-    data_.swap(res);
+  if (!loaded_ && !Load()) {
+    return Status::INTERNAL_IO_ERROR;
   }
   *data = data_;
   return Status::OK;
 }
 
+Status ObjectImpl::GetVmo(mx::vmo* vmo) const {
+  if (!vmo_) {
+    Status status = LoadVmo();
+    if (status != Status::OK) {
+      return status;
+    }
+  }
+  if (vmo_.duplicate(MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ |
+                         MX_RIGHT_MAP | MX_RIGHT_GET_PROPERTY,
+                     vmo) != NO_ERROR) {
+    FTL_LOG(ERROR) << "Unable to duplicate the vmo of " << file_path_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+Status ObjectImpl::GetSize(uint64_t* size) const {
+  if (encoding_ == Encoding::COMPRESSED) {
+    // The size of the content is only known once decompressed.
+    ftl::StringView data;
+    Status status = GetData(&data);
+    if (status != Status::OK) {
+      return status;
+    }
+    *size = data.size();
+    return Status::OK;
+  }
+  if (!size_known_ && !Open()) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  *size = size_;
+  return Status::OK;
+}
+
+Status ObjectImpl::ReadData(uint64_t offset,
+                            uint64_t max_size,
+                            std::string* data) const {
+  if (!loaded_ && encoding_ == Encoding::COMPRESSED && !Load()) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  if (loaded_) {
+    *data = data_.substr(offset, max_size).ToString();
+    return Status::OK;
+  }
+  if (!Open()) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  if (offset >= size_) {
+    data->clear();
+    return Status::OK;
+  }
+  if (!ReadRange(fd_.get(), offset, std::min(max_size, size_ - offset),
+                 data)) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+bool ObjectImpl::Open() const {
+  if (fd_.is_valid()) {
+    return true;
+  }
+  ftl::UniqueFD fd(HANDLE_EINTR(open(file_path_.c_str(), O_RDONLY)));
+  if (!fd.is_valid()) {
+    FTL_LOG(ERROR) << "Unable to open " << file_path_;
+    return false;
+  }
+  struct stat stat_buffer;
+  if (fstat(fd.get(), &stat_buffer) != 0) {
+    FTL_LOG(ERROR) << "Unable to stat " << file_path_;
+    return false;
+  }
+  uint64_t file_size = stat_buffer.st_size;
+  if (!is_range_) {
+    size_ = file_size;
+    size_known_ = true;
+  }
+  if (offset_ + size_ > file_size) {
+    FTL_LOG(ERROR) << "Unable to read " << size_ << " bytes at offset "
+                   << offset_ << " in " << file_path_;
+    return false;
+  }
+  fd_ = std::move(fd);
+  return true;
+}
+
+bool ObjectImpl::Load() const {
+  if (!Open()) {
+    return false;
+  }
+  if (size_ == 0) {
+    data_ = ftl::StringView();
+    loaded_ = true;
+    return true;
+  }
+
+  // Mappings must start at a page boundary.
+  uint64_t page_size = sysconf(_SC_PAGESIZE);
+  uint64_t map_offset = offset_ - offset_ % page_size;
+  size_t map_size = size_ + (offset_ - map_offset);
+  void* address =
+      mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd_.get(), map_offset);
+  if (address != MAP_FAILED) {
+    mapped_address_ = address;
+    mapped_size_ = map_size;
+    data_ = ftl::StringView(
+        static_cast<const char*>(address) + (offset_ - map_offset), size_);
+  } else {
+    // Not all file systems support mapping files.
+    if (!ReadRange(fd_.get(), 0, size_, &read_data_)) {
+      return false;
+    }
+    data_ = read_data_;
+  }
+  // The mapping, or the copy, keeps the content readable.
+  fd_.reset();
+  if (encoding_ == Encoding::COMPRESSED && !Decompress()) {
+    return false;
+  }
+  loaded_ = true;
+  return true;
+}
+
+bool ObjectImpl::Decompress() const {
+  std::string content;
+  if (!glue::Decompress(data_, &content)) {
+    FTL_LOG(ERROR) << "Unable to decompress the content of an object in "
+                   << file_path_;
+    return false;
+  }
+  read_data_.swap(content);
+  data_ = read_data_;
+  if (mapped_address_) {
+    munmap(mapped_address_, mapped_size_);
+    mapped_address_ = nullptr;
+    mapped_size_ = 0;
+  }
+  return true;
+}
+
+Status ObjectImpl::LoadVmo() const {
+  if (vmo_cache_ && vmo_cache_->Get(id_, &vmo_)) {
+    return Status::OK;
+  }
+  ftl::StringView data;
+  Status status = GetData(&data);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!mtl::VmoFromString(data, &vmo_)) {
+    FTL_LOG(ERROR) << "Unable to create a vmo for " << file_path_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+  if (vmo_cache_) {
+    vmo_cache_->Put(id_, vmo_, data.size());
+  }
+  return Status::OK;
+}
+
+bool ObjectImpl::ReadRange(int fd,
+                           uint64_t offset,
+                           uint64_t size,
+                           std::string* data) const {
+  data->resize(size);
+  uint64_t read_bytes = 0;
+  while (read_bytes < size) {
+    ssize_t result =
+        HANDLE_EINTR(pread(fd, &(*data)[read_bytes], size - read_bytes,
+                           offset_ + offset + read_bytes));
+    if (result <= 0) {
+      FTL_LOG(ERROR) << "Unable to read " << size << " bytes at offset "
+                     << offset_ + offset << " in " << file_path_;
+      return false;
+    }
+    read_bytes += result;
+  }
+  return true;
+}
+
 }  // namespace storage
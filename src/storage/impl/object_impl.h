@@ -5,24 +5,92 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_IMPL_OBJECT_IMPL_H_
 #define APPS_LEDGER_SRC_STORAGE_IMPL_OBJECT_IMPL_H_
 
+#include "apps/ledger/src/storage/impl/object_vmo_cache.h"
 #include "apps/ledger/src/storage/public/object.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/memory/ref_ptr.h"
 
 namespace storage {
 
+// Object whose content is stored in a file. The file is mapped in memory the
+// first time the content is accessed, and unmapped when the object is deleted.
+// The file is opened by |Init()|, or else on first access: once opened, the
+// content stays readable even if the file is deleted. Compressed content is
+// only decompressed the first time it is accessed.
 class ObjectImpl : public Object {
  public:
+  enum class Encoding {
+    RAW,
+    COMPRESSED,
+  };
+
+  // Creates an object whose content is the whole file at |file_path|.
   ObjectImpl(ObjectId id, std::string file_path);
+  // Creates an object whose content is stored in the |size| bytes starting at
+  // |offset| in the file at |file_path|, following |encoding|. If |vmo_cache|
+  // is not null, the vmo of the object is shared with the other objects with
+  // the same id using it.
+  ObjectImpl(ObjectId id,
+             std::string file_path,
+             uint64_t offset,
+             uint64_t size,
+             Encoding encoding = Encoding::RAW,
+             ftl::RefPtr<ObjectVmoCache> vmo_cache = nullptr);
   ~ObjectImpl() override;
 
+  // Opens the file and checks that it contains the content of the object.
+  Status Init();
+
   // Object:
   ObjectId GetId() const override;
   Status GetData(ftl::StringView* data) const override;
+  // Returns a read-only handle to a vmo filled from the mapped file. The vmo
+  // is created once and shared by all the handles returned by this object,
+  // and by the objects sharing its vmo cache.
+  Status GetVmo(mx::vmo* vmo) const override;
+  // Reads only the requested range from the file, unless the content of the
+  // object is already loaded or is compressed.
+  Status GetSize(uint64_t* size) const override;
+  Status ReadData(uint64_t offset,
+                  uint64_t max_size,
+                  std::string* data) const override;
 
  private:
+  // Opens the file unless already done, and checks that it contains the
+  // stored content of the object. Computes |size_| for objects covering the
+  // whole file.
+  bool Open() const;
+  // Maps the content of the object in memory. Falls back to reading it if the
+  // file cannot be mapped. Compressed content is decompressed in memory.
+  bool Load() const;
+  // Replaces the loaded compressed content by its decompressed version.
+  bool Decompress() const;
+  // Sets |vmo_| from the vmo cache, or else fills it with the content of the
+  // object.
+  Status LoadVmo() const;
+  // Reads |size| bytes starting at |offset| in the content of the object.
+  bool ReadRange(int fd,
+                 uint64_t offset,
+                 uint64_t size,
+                 std::string* data) const;
+
   const ObjectId id_;
   const std::string file_path_;
+  const bool is_range_;
+  const uint64_t offset_;
+  const Encoding encoding_;
+  const ftl::RefPtr<ObjectVmoCache> vmo_cache_;
+  // Number of bytes stored in the file.
+  mutable uint64_t size_;
+  mutable bool size_known_;
+  mutable ftl::UniqueFD fd_;
 
-  mutable std::string data_;
+  mutable bool loaded_ = false;
+  mutable void* mapped_address_ = nullptr;
+  mutable size_t mapped_size_ = 0;
+  mutable std::string read_data_;
+  mutable ftl::StringView data_;
+  mutable mx::vmo vmo_;
 };
 
 }  // namespace storage
@@ -7,13 +7,16 @@
 #include <algorithm>
 #include <memory>
 
+#include "apps/ledger/src/glue/compression/compression.h"
 #include "apps/ledger/src/glue/crypto/base64.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "apps/ledger/src/storage/impl/constants.h"
 #include "gtest/gtest.h"
 #include "lib/ftl/files/file.h"
+#include "lib/ftl/files/path.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/logging.h"
+#include "lib/mtl/vmo/strings.h"
 
 namespace storage {
 namespace {
@@ -70,5 +73,143 @@ TEST_F(ObjectTest, Object) {
   EXPECT_EQ(0, memcmp(data.data(), found_data.data(), kFileSize));
 }
 
+TEST_F(ObjectTest, ObjectRange) {
+  std::string data = RandomString(kFileSize);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, data.data(), kFileSize));
+
+  const size_t offset = 10;
+  const size_t size = 100;
+  ObjectImpl object((std::string(object_id_)), std::string(object_file_path_),
+                    offset, size);
+  EXPECT_EQ(object_id_, object.GetId());
+  ftl::StringView found_data;
+  EXPECT_EQ(Status::OK, object.GetData(&found_data));
+  EXPECT_EQ(size, found_data.size());
+  EXPECT_EQ(0, memcmp(data.data() + offset, found_data.data(), size));
+
+  // Reading past the end of the file fails.
+  ObjectImpl truncated_object((std::string(object_id_)),
+                              std::string(object_file_path_), kFileSize - 10,
+                              size);
+  EXPECT_EQ(Status::INTERNAL_IO_ERROR, truncated_object.GetData(&found_data));
+}
+
+TEST_F(ObjectTest, ObjectVmo) {
+  std::string data = RandomString(kFileSize);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, data.data(), kFileSize));
+
+  const size_t offset = 10;
+  const size_t size = 100;
+  ObjectImpl object((std::string(object_id_)), std::string(object_file_path_),
+                    offset, size);
+  mx::vmo vmo;
+  ASSERT_EQ(Status::OK, object.GetVmo(&vmo));
+  std::string vmo_data;
+  ASSERT_TRUE(mtl::StringFromVmo(vmo, &vmo_data));
+  EXPECT_EQ(data.substr(offset, size), vmo_data);
+
+  // The data is still available after the vmo has been created.
+  ftl::StringView found_data;
+  EXPECT_EQ(Status::OK, object.GetData(&found_data));
+  EXPECT_EQ(data.substr(offset, size), found_data.ToString());
+}
+
+TEST_F(ObjectTest, ObjectVmoShared) {
+  std::string data = RandomString(kFileSize);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, data.data(), kFileSize));
+
+  const size_t offset = 10;
+  const size_t size = 100;
+  ftl::RefPtr<ObjectVmoCache> vmo_cache = ObjectVmoCache::Create();
+  // Two reads of the same object share a single vmo: only the first one
+  // fills it.
+  for (size_t i = 0; i < 2; ++i) {
+    ObjectImpl object((std::string(object_id_)),
+                      std::string(object_file_path_), offset, size,
+                      ObjectImpl::Encoding::RAW, vmo_cache);
+    mx::vmo vmo;
+    ASSERT_EQ(Status::OK, object.GetVmo(&vmo));
+    std::string vmo_data;
+    ASSERT_TRUE(mtl::StringFromVmo(vmo, &vmo_data));
+    EXPECT_EQ(data.substr(offset, size), vmo_data);
+  }
+  EXPECT_EQ(1u, vmo_cache->miss_count());
+  EXPECT_EQ(1u, vmo_cache->hit_count());
+}
+
+TEST_F(ObjectTest, CompressedObject) {
+  std::string data;
+  while (data.size() < kFileSize) {
+    data.append("{\"key\": \"some key\", \"value\": \"some value\"}");
+  }
+  std::string compressed_data;
+  ASSERT_TRUE(glue::Compress(data, &compressed_data));
+  const size_t offset = 10;
+  std::string file_content =
+      RandomString(offset) + compressed_data + RandomString(10);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, file_content.data(),
+                               file_content.size()));
+
+  ObjectImpl object((std::string(object_id_)), std::string(object_file_path_),
+                    offset, compressed_data.size(),
+                    ObjectImpl::Encoding::COMPRESSED);
+  uint64_t found_size;
+  EXPECT_EQ(Status::OK, object.GetSize(&found_size));
+  EXPECT_EQ(data.size(), found_size);
+  std::string read_data;
+  EXPECT_EQ(Status::OK, object.ReadData(20, 30, &read_data));
+  EXPECT_EQ(data.substr(20, 30), read_data);
+  ftl::StringView found_data;
+  EXPECT_EQ(Status::OK, object.GetData(&found_data));
+  EXPECT_EQ(data, found_data.ToString());
+}
+
+TEST_F(ObjectTest, ObjectFileDeletedAfterInit) {
+  std::string data = RandomString(kFileSize);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, data.data(), kFileSize));
+
+  const size_t offset = 10;
+  const size_t size = 100;
+  ObjectImpl object((std::string(object_id_)), std::string(object_file_path_),
+                    offset, size);
+  ASSERT_EQ(Status::OK, object.Init());
+  ASSERT_TRUE(files::DeletePath(object_file_path_, false));
+
+  std::string read_data;
+  EXPECT_EQ(Status::OK, object.ReadData(0, size, &read_data));
+  EXPECT_EQ(data.substr(offset, size), read_data);
+  ftl::StringView found_data;
+  EXPECT_EQ(Status::OK, object.GetData(&found_data));
+  EXPECT_EQ(data.substr(offset, size), found_data.ToString());
+}
+
+TEST_F(ObjectTest, ObjectReadData) {
+  std::string data = RandomString(kFileSize);
+  EXPECT_TRUE(files::WriteFile(object_file_path_, data.data(), kFileSize));
+
+  const size_t offset = 10;
+  const size_t size = 100;
+  ObjectImpl object((std::string(object_id_)), std::string(object_file_path_),
+                    offset, size);
+  uint64_t found_size;
+  EXPECT_EQ(Status::OK, object.GetSize(&found_size));
+  EXPECT_EQ(size, found_size);
+
+  std::string found_data;
+  EXPECT_EQ(Status::OK, object.ReadData(20, 30, &found_data));
+  EXPECT_EQ(data.substr(offset + 20, 30), found_data);
+  // Reads are truncated at the end of the object.
+  EXPECT_EQ(Status::OK, object.ReadData(90, 30, &found_data));
+  EXPECT_EQ(data.substr(offset + 90, 10), found_data);
+  EXPECT_EQ(Status::OK, object.ReadData(size, 30, &found_data));
+  EXPECT_EQ("", found_data);
+
+  // The size of an object covering a whole file is the size of the file.
+  ObjectImpl file_object((std::string(object_id_)),
+                         std::string(object_file_path_));
+  EXPECT_EQ(Status::OK, file_object.GetSize(&found_size));
+  EXPECT_EQ(kFileSize, found_size);
+}
+
 }  // namespace
 }  // namespace storage
@@ -0,0 +1,58 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/object_vmo_cache.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace storage {
+
+namespace {
+
+constexpr mx_rights_t kVmoRights = MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER |
+                                   MX_RIGHT_READ | MX_RIGHT_MAP |
+                                   MX_RIGHT_GET_PROPERTY;
+
+}  // namespace
+
+constexpr size_t ObjectVmoCache::kDefaultMaxBytes;
+
+ObjectVmoCache::ObjectVmoCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+ObjectVmoCache::~ObjectVmoCache() {}
+
+bool ObjectVmoCache::Get(ObjectIdView id, mx::vmo* vmo) {
+  auto it = index_.find(id);
+  if (it == index_.end() ||
+      it->second->vmo.duplicate(kVmoRights, vmo) != NO_ERROR) {
+    ++miss_count_;
+    return false;
+  }
+  ++hit_count_;
+  vmos_.splice(vmos_.begin(), vmos_, it->second);
+  return true;
+}
+
+void ObjectVmoCache::Put(ObjectIdView id, const mx::vmo& vmo, size_t size) {
+  if (size > max_bytes_ || index_.count(id) != 0) {
+    return;
+  }
+  mx::vmo cached_vmo;
+  if (vmo.duplicate(kVmoRights, &cached_vmo) != NO_ERROR) {
+    FTL_LOG(WARNING) << "Unable to duplicate the vmo of an object";
+    return;
+  }
+  while (size_in_bytes_ + size > max_bytes_) {
+    size_in_bytes_ -= vmos_.back().size;
+    index_.erase(vmos_.back().id);
+    vmos_.pop_back();
+  }
+  vmos_.push_front(CachedVmo{id.ToString(), std::move(cached_vmo), size});
+  index_[vmos_.front().id] = vmos_.begin();
+  size_in_bytes_ += size;
+}
+
+}  // namespace storage
@@ -0,0 +1,76 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_OBJECT_VMO_CACHE_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_OBJECT_VMO_CACHE_H_
+
+#include <list>
+#include <map>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "mx/vmo.h"
+
+namespace storage {
+
+// LRU cache of the vmos holding the content of the objects of a page, indexed
+// by object id. The objects returned for the same id share a single vmo while
+// it is in the cache, instead of each filling their own. The cache keeps the
+// size of the vmos it holds under a given budget.
+//
+// The cache is shared by the objects using it, which can outlive the page
+// storage. This class is not thread safe: it must only be used on the main
+// thread.
+class ObjectVmoCache : public ftl::RefCountedThreadSafe<ObjectVmoCache> {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 16 * 1024 * 1024;
+
+  inline static ftl::RefPtr<ObjectVmoCache> Create(
+      size_t max_bytes = kDefaultMaxBytes) {
+    return ftl::AdoptRef(new ObjectVmoCache(max_bytes));
+  }
+
+  // Sets |vmo| to a handle to the vmo of the object with the given |id|.
+  // Returns false if it is not in the cache.
+  bool Get(ObjectIdView id, mx::vmo* vmo);
+
+  // Adds |vmo|, whose content has the given |size|, as the vmo of the object
+  // with the given |id|, evicting the least recently used vmos as needed.
+  void Put(ObjectIdView id, const mx::vmo& vmo, size_t size);
+
+  // Returns the number of calls to |Get()| that found, or did not find, the
+  // requested vmo.
+  uint64_t hit_count() const { return hit_count_; }
+  uint64_t miss_count() const { return miss_count_; }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(ObjectVmoCache);
+  explicit ObjectVmoCache(size_t max_bytes);
+  ~ObjectVmoCache();
+
+  struct CachedVmo {
+    ObjectId id;
+    mx::vmo vmo;
+    size_t size;
+  };
+
+  const size_t max_bytes_;
+  // Cached vmos, the most recently used first.
+  std::list<CachedVmo> vmos_;
+  std::map<ObjectId, std::list<CachedVmo>::iterator,
+           convert::StringViewComparator>
+      index_;
+  size_t size_in_bytes_ = 0;
+  uint64_t hit_count_ = 0;
+  uint64_t miss_count_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectVmoCache);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_OBJECT_VMO_CACHE_H_
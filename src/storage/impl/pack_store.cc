@@ -0,0 +1,305 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/pack_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "apps/ledger/src/storage/impl/constants.h"
+#include "apps/ledger/src/storage/impl/directory_reader.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+
+namespace storage {
+
+namespace {
+
+constexpr uint32_t kRecordMagic = 0x4b50474c;  // "LGPK"
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t id_size;
+  uint64_t size;
+};
+
+static_assert(sizeof(RecordHeader) == 16, "Unexpected RecordHeader size");
+
+constexpr uint64_t kRecordPrefixSize = sizeof(RecordHeader) + kObjectHashSize;
+
+bool WriteAt(int fd, const char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t written = HANDLE_EINTR(pwrite(fd, data, size, offset));
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+}  // namespace
+
+PackStore::Writer::Writer(int fd,
+                          uint32_t segment,
+                          uint64_t record_offset,
+                          uint64_t size)
+    : fd_(fd), segment_(segment), record_offset_(record_offset), size_(size) {}
+
+PackStore::Writer::~Writer() {}
+
+Status PackStore::Writer::Append(ftl::StringView data) {
+  if (written_ + data.size() > size_) {
+    FTL_LOG(ERROR) << "Object content exceeds its expected size: " << size_;
+    return Status::IO_ERROR;
+  }
+  if (!WriteAt(fd_, data.data(), data.size(),
+               record_offset_ + kRecordPrefixSize + written_)) {
+    FTL_LOG(ERROR) << "Error writing data to disk: " << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+  written_ += data.size();
+  return Status::OK;
+}
+
+Status PackStore::Writer::Finish(ObjectIdView object_id,
+                                 PackLocation* location) {
+  TRACE_DURATION("ledger", "pack_store_finish_object");
+  if (written_ != size_) {
+    FTL_LOG(ERROR) << "Object content has wrong size. Expected: " << size_
+                   << ", but found: " << written_;
+    return Status::IO_ERROR;
+  }
+  FTL_DCHECK(object_id.size() == kObjectHashSize);
+
+  std::string prefix;
+  prefix.reserve(kRecordPrefixSize);
+  RecordHeader header = {kRecordMagic, kObjectHashSize, size_};
+  prefix.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  prefix.append(object_id.data(), object_id.size());
+  if (!WriteAt(fd_, prefix.data(), prefix.size(), record_offset_)) {
+    FTL_LOG(ERROR) << "Error writing data to disk: " << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  location->segment = segment_;
+  location->offset = record_offset_ + kRecordPrefixSize;
+  location->size = size_;
+  return Status::OK;
+}
+
+constexpr uint64_t PackStore::kDefaultMaxSegmentSize;
+
+PackStore::PackStore(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                     std::string pack_dir,
+                     PackSyncOptions sync_options,
+                     uint64_t max_segment_size)
+    : task_runner_(std::move(task_runner)),
+      pack_dir_(std::move(pack_dir)),
+      sync_options_(sync_options),
+      max_segment_size_(max_segment_size),
+      weak_ptr_factory_(this) {}
+
+PackStore::~PackStore() {}
+
+Status PackStore::Init() {
+  if (!files::CreateDirectory(pack_dir_)) {
+    FTL_LOG(ERROR) << "Unable to create directory " << pack_dir_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  uint32_t last_segment = 0;
+  if (!DirectoryReader::GetDirectoryEntries(
+          pack_dir_, [&last_segment](ftl::StringView entry) {
+            uint32_t segment;
+            if (ftl::StringToNumberWithError(entry, &segment) &&
+                segment > last_segment) {
+              last_segment = segment;
+            }
+            return true;
+          })) {
+    FTL_LOG(ERROR) << "Unable to read directory " << pack_dir_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  return OpenSegment(last_segment);
+}
+
+std::unique_ptr<PackStore::Writer> PackStore::StartObject(uint64_t size) {
+  FTL_DCHECK(!segment_fds_.empty());
+  uint64_t record_size = kRecordPrefixSize + size;
+  if (current_offset_ > 0 &&
+      current_offset_ + record_size > max_segment_size_) {
+    if (OpenSegment(current_segment_ + 1) != Status::OK) {
+      return nullptr;
+    }
+  }
+  uint64_t record_offset = current_offset_;
+  current_offset_ += record_size;
+  return std::unique_ptr<Writer>(new Writer(
+      segment_fds_[current_segment_].get(), current_segment_, record_offset,
+      size));
+}
+
+Status PackStore::AddObject(ObjectIdView object_id,
+                            ftl::StringView content,
+                            PackLocation* location) {
+  std::unique_ptr<Writer> writer = StartObject(content.size());
+  if (!writer) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  Status status = writer->Append(content);
+  if (status != Status::OK) {
+    return status;
+  }
+  return writer->Finish(object_id, location);
+}
+
+void PackStore::Sync(const PackLocation& location,
+                     std::function<void(Status)> callback) {
+  dirty_segments_.insert(location.segment);
+  pending_callbacks_.push_back(std::move(callback));
+  pending_bytes_ += location.size;
+  if (pending_callbacks_.size() >= sync_options_.max_pending_records ||
+      pending_bytes_ >= sync_options_.max_pending_bytes) {
+    Flush();
+    return;
+  }
+  if (flush_scheduled_) {
+    return;
+  }
+  // A scheduled flush is not cancelled by an early one: records never wait
+  // more than |max_delay|.
+  flush_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      [weak_this = weak_ptr_factory_.GetWeakPtr()] {
+        if (weak_this) {
+          weak_this->flush_scheduled_ = false;
+          weak_this->Flush();
+        }
+      },
+      sync_options_.max_delay);
+}
+
+Status PackStore::Flush() {
+  if (pending_callbacks_.empty()) {
+    return Status::OK;
+  }
+  TRACE_DURATION("ledger", "pack_store_flush");
+  std::set<uint32_t> segments;
+  std::vector<std::function<void(Status)>> callbacks;
+  segments.swap(dirty_segments_);
+  callbacks.swap(pending_callbacks_);
+  pending_bytes_ = 0;
+
+  Status status = Status::OK;
+  for (uint32_t segment : segments) {
+    if (fdatasync(segment_fds_[segment].get()) != 0) {
+      FTL_LOG(ERROR) << "Unable to save segment " << segment
+                     << " to disk: " << strerror(errno);
+      status = Status::INTERNAL_IO_ERROR;
+      break;
+    }
+  }
+  for (const auto& callback : callbacks) {
+    callback(status);
+  }
+  return status;
+}
+
+void PackStore::CancelPendingSyncs() {
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  flush_scheduled_ = false;
+  dirty_segments_.clear();
+  pending_callbacks_.clear();
+  pending_bytes_ = 0;
+}
+
+std::string PackStore::GetSegmentPath(uint32_t segment) const {
+  return ftl::Concatenate({pack_dir_, "/", ftl::NumberToString(segment)});
+}
+
+Status PackStore::GetSegments(std::vector<uint32_t>* segments,
+                              uint32_t* current_segment) {
+  std::vector<uint32_t> result;
+  if (!DirectoryReader::GetDirectoryEntries(
+          pack_dir_, [&result](ftl::StringView entry) {
+            uint32_t segment;
+            if (ftl::StringToNumberWithError(entry, &segment)) {
+              result.push_back(segment);
+            }
+            return true;
+          })) {
+    FTL_LOG(ERROR) << "Unable to read directory " << pack_dir_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+  segments->swap(result);
+  *current_segment = current_segment_;
+  return Status::OK;
+}
+
+Status PackStore::DeleteSegment(uint32_t segment, uint64_t* size) {
+  if (segment >= current_segment_ || dirty_segments_.count(segment) != 0) {
+    return Status::ILLEGAL_STATE;
+  }
+  std::string path = GetSegmentPath(segment);
+  struct stat stat_buffer;
+  if (stat(path.c_str(), &stat_buffer) != 0) {
+    FTL_LOG(ERROR) << "Unable to stat segment " << path << ": "
+                   << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+  segment_fds_.erase(segment);
+  if (unlink(path.c_str()) != 0) {
+    FTL_LOG(ERROR) << "Unable to delete segment " << path << ": "
+                   << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+  *size = stat_buffer.st_size;
+  return Status::OK;
+}
+
+Status PackStore::OpenSegment(uint32_t segment) {
+  std::string path = GetSegmentPath(segment);
+  ftl::UniqueFD fd(HANDLE_EINTR(open(path.c_str(), O_WRONLY | O_CREAT, 0600)));
+  if (!fd.is_valid()) {
+    FTL_LOG(ERROR) << "Unable to open segment " << path << ": "
+                   << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+  struct stat stat_buffer;
+  if (fstat(fd.get(), &stat_buffer) != 0) {
+    FTL_LOG(ERROR) << "Unable to stat segment " << path << ": "
+                   << strerror(errno);
+    return Status::INTERNAL_IO_ERROR;
+  }
+  if (stat_buffer.st_size == 0) {
+    // Make sure the new segment survives a crash of the device.
+    ftl::UniqueFD dir_fd(HANDLE_EINTR(open(pack_dir_.c_str(), O_RDONLY)));
+    if (!dir_fd.is_valid() || fsync(dir_fd.get()) != 0) {
+      FTL_LOG(ERROR) << "Unable to save directory " << pack_dir_;
+      return Status::INTERNAL_IO_ERROR;
+    }
+  }
+  // Any incomplete record at the end of the segment, left by a previous
+  // execution, is never referenced: new records are appended after it.
+  current_segment_ = segment;
+  current_offset_ = stat_buffer.st_size;
+  segment_fds_[segment] = std::move(fd);
+  return Status::OK;
+}
+
+}  // namespace storage
@@ -0,0 +1,176 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_PACK_STORE_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_PACK_STORE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace storage {
+
+// Position of the content of an object inside the pack segments. |size| is
+// the number of bytes stored: if |compressed| is true, they hold the content
+// of the object compressed with |glue::Compress()|.
+struct PackLocation {
+  uint32_t segment = 0;
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  bool compressed = false;
+};
+
+// Controls how the syncs of completed records are grouped. A group of records
+// is synced as soon as any of the limits below is reached.
+struct PackSyncOptions {
+  // Maximal time a completed record waits for other records to complete before
+  // being synced.
+  ftl::TimeDelta max_delay = ftl::TimeDelta::FromMilliseconds(2);
+  // Maximal number of bytes of content waiting to be synced.
+  uint64_t max_pending_bytes = 1024 * 1024;
+  // Maximal number of records waiting to be synced.
+  size_t max_pending_records = 64;
+};
+
+// |PackStore| stores objects as records appended to a small number of large
+// segment files, instead of using one file per object. Each record is laid out
+// as:
+//   [header][object id][content]
+// where the header contains a magic number and the sizes of the id and of the
+// content.
+//
+// Space for a record is reserved when the object is started, so that multiple
+// objects can be written concurrently without interleaving their content. The
+// header and id are written once all the content has been received. Records
+// are not flushed to disk individually: |Sync()| groups the records completed
+// within a short window in a single flush of the segments, following
+// |PackSyncOptions|. Callers must only persist a |PackLocation| once its record
+// has been synced: a crash can then at worst leave unreferenced space in a
+// segment, never an index entry pointing to incomplete data.
+//
+// |PackStore| does not maintain the object id to location index, nor does it
+// read objects back: it only provides the path of the segment files.
+class PackStore {
+ public:
+  static constexpr uint64_t kDefaultMaxSegmentSize = 64 * 1024 * 1024;
+
+  // Writes the content of a single object in the space reserved for it.
+  class Writer {
+   public:
+    ~Writer();
+
+    // Appends |data| to the content of the object.
+    Status Append(ftl::StringView data);
+
+    // Completes the record of the object with the given |object_id|. Fails if
+    // the content written does not match the size given to |StartObject()|. On
+    // success, |location| contains the position of the content of the object.
+    // The record must then be synced before |location| is persisted.
+    Status Finish(ObjectIdView object_id, PackLocation* location);
+
+   private:
+    friend class PackStore;
+    Writer(int fd, uint32_t segment, uint64_t record_offset, uint64_t size);
+
+    const int fd_;
+    const uint32_t segment_;
+    const uint64_t record_offset_;
+    const uint64_t size_;
+    uint64_t written_ = 0;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Writer);
+  };
+
+  // |task_runner| is the runner on which this store is used. Segments are not
+  // rotated before reaching |max_segment_size| bytes. Objects bigger than this
+  // are stored alone in their segment.
+  PackStore(ftl::RefPtr<ftl::TaskRunner> task_runner,
+            std::string pack_dir,
+            PackSyncOptions sync_options = PackSyncOptions(),
+            uint64_t max_segment_size = kDefaultMaxSegmentSize);
+  ~PackStore();
+
+  // Initializes the store, opening the last segment for writing. Returns
+  // |INTERNAL_IO_ERROR| on failure.
+  Status Init();
+
+  // Reserves space for an object whose content has the given |size| and
+  // returns a |Writer| for it, or nullptr on failure. The returned writer must
+  // not outlive this object.
+  std::unique_ptr<Writer> StartObject(uint64_t size);
+
+  // Writes the object with the given id and content in a single call. This is
+  // equivalent to starting a new object, appending |content| and finishing it.
+  Status AddObject(ObjectIdView object_id,
+                   ftl::StringView content,
+                   PackLocation* location);
+
+  // Calls |callback| once the record at |location| has been flushed to disk.
+  // The flush is shared with the other records completed within the limits of
+  // |PackSyncOptions|. Callbacks of records that are still waiting when this
+  // store is deleted are never called.
+  void Sync(const PackLocation& location, std::function<void(Status)> callback);
+
+  // Immediately flushes to disk all completed records, and calls the pending
+  // |Sync()| callbacks.
+  Status Flush();
+
+  // Drops the pending |Sync()| callbacks without calling them, and cancels the
+  // scheduled flush. This must be called on the runner of this store before
+  // deleting it from another thread.
+  void CancelPendingSyncs();
+
+  // Returns the path of the segment file with the given id.
+  std::string GetSegmentPath(uint32_t segment) const;
+
+  // Lists the ids of the segment files in |segments|. |current_segment| is set
+  // to the id of the segment new records are appended to: records are never
+  // added to the segments before it.
+  Status GetSegments(std::vector<uint32_t>* segments,
+                     uint32_t* current_segment);
+
+  // Deletes the segment file with the given id, whose records must not be
+  // referenced anymore. On success, |size| contains the size of the deleted
+  // file. Returns |ILLEGAL_STATE| if records can still be added to the segment
+  // or are waiting to be synced.
+  Status DeleteSegment(uint32_t segment, uint64_t* size);
+
+ private:
+  Status OpenSegment(uint32_t segment);
+
+  const ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  const std::string pack_dir_;
+  const PackSyncOptions sync_options_;
+  const uint64_t max_segment_size_;
+  std::map<uint32_t, ftl::UniqueFD> segment_fds_;
+  uint32_t current_segment_ = 0;
+  uint64_t current_offset_ = 0;
+
+  // Records waiting to be synced.
+  std::set<uint32_t> dirty_segments_;
+  std::vector<std::function<void(Status)>> pending_callbacks_;
+  uint64_t pending_bytes_ = 0;
+  bool flush_scheduled_ = false;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<PackStore> weak_ptr_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PackStore);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_PACK_STORE_H_
@@ -0,0 +1,304 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/pack_store.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/glue/crypto/hash.h"
+#include "apps/ledger/src/glue/crypto/rand.h"
+#include "apps/ledger/src/storage/impl/constants.h"
+#include "apps/ledger/src/storage/impl/object_impl.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace storage {
+namespace {
+
+std::string RandomString(size_t size) {
+  std::string result;
+  result.resize(size);
+  glue::RandBytes(&result[0], size);
+  return result;
+}
+
+class PackStoreTest : public test::TestWithMessageLoop {
+ public:
+  PackStoreTest() {}
+
+  ~PackStoreTest() override {}
+
+ protected:
+  std::string GetPackDir() { return tmp_dir_.path() + "/packs"; }
+
+  std::string ReadObject(const PackStore& pack_store,
+                         const PackLocation& location) {
+    ObjectImpl object("", pack_store.GetSegmentPath(location.segment),
+                      location.offset, location.size);
+    ftl::StringView data;
+    EXPECT_EQ(Status::OK, object.GetData(&data));
+    return data.ToString();
+  }
+
+  files::ScopedTempDir tmp_dir_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(PackStoreTest);
+};
+
+TEST_F(PackStoreTest, AddObject) {
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::string content = RandomString(256);
+  ObjectId id = glue::SHA256Hash(content.data(), content.size());
+  PackLocation location;
+  ASSERT_EQ(Status::OK, pack_store.AddObject(id, content, &location));
+  EXPECT_EQ(content.size(), location.size);
+  EXPECT_EQ(content, ReadObject(pack_store, location));
+}
+
+TEST_F(PackStoreTest, ConcurrentWriters) {
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::string content1 = RandomString(100);
+  std::string content2 = RandomString(200);
+  std::unique_ptr<PackStore::Writer> writer1 =
+      pack_store.StartObject(content1.size());
+  std::unique_ptr<PackStore::Writer> writer2 =
+      pack_store.StartObject(content2.size());
+  ASSERT_TRUE(writer1);
+  ASSERT_TRUE(writer2);
+
+  // Interleave the writes of both objects.
+  EXPECT_EQ(Status::OK, writer2->Append(content2.substr(0, 50)));
+  EXPECT_EQ(Status::OK, writer1->Append(content1.substr(0, 50)));
+  EXPECT_EQ(Status::OK, writer2->Append(content2.substr(50)));
+  EXPECT_EQ(Status::OK, writer1->Append(content1.substr(50)));
+
+  PackLocation location1;
+  PackLocation location2;
+  EXPECT_EQ(Status::OK,
+            writer2->Finish(glue::SHA256Hash(content2.data(), content2.size()),
+                            &location2));
+  EXPECT_EQ(Status::OK,
+            writer1->Finish(glue::SHA256Hash(content1.data(), content1.size()),
+                            &location1));
+
+  EXPECT_EQ(content1, ReadObject(pack_store, location1));
+  EXPECT_EQ(content2, ReadObject(pack_store, location2));
+}
+
+TEST_F(PackStoreTest, WrongSize) {
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::string content = RandomString(100);
+  ObjectId id = glue::SHA256Hash(content.data(), content.size());
+  PackLocation location;
+
+  std::unique_ptr<PackStore::Writer> writer = pack_store.StartObject(50);
+  EXPECT_EQ(Status::IO_ERROR, writer->Append(content));
+
+  writer = pack_store.StartObject(200);
+  EXPECT_EQ(Status::OK, writer->Append(content));
+  EXPECT_EQ(Status::IO_ERROR, writer->Finish(id, &location));
+}
+
+TEST_F(PackStoreTest, Reopen) {
+  std::string content1 = RandomString(100);
+  std::string content2 = RandomString(100);
+  PackLocation location1;
+  PackLocation location2;
+  {
+    PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+    ASSERT_EQ(Status::OK, pack_store.Init());
+    ASSERT_EQ(Status::OK,
+              pack_store.AddObject(
+                  glue::SHA256Hash(content1.data(), content1.size()), content1,
+                  &location1));
+    // Leave an incomplete record at the end of the segment.
+    std::unique_ptr<PackStore::Writer> writer = pack_store.StartObject(100);
+    EXPECT_EQ(Status::OK, writer->Append(content2.substr(0, 10)));
+  }
+
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+  ASSERT_EQ(Status::OK, pack_store.Init());
+  ASSERT_EQ(Status::OK,
+            pack_store.AddObject(
+                glue::SHA256Hash(content2.data(), content2.size()), content2,
+                &location2));
+  EXPECT_EQ(location1.segment, location2.segment);
+  EXPECT_LT(location1.offset + location1.size, location2.offset);
+  EXPECT_EQ(content1, ReadObject(pack_store, location1));
+  EXPECT_EQ(content2, ReadObject(pack_store, location2));
+}
+
+TEST_F(PackStoreTest, SegmentRotation) {
+  const size_t kContentSize = 100;
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir(),
+                       PackSyncOptions(), 2 * kContentSize);
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::vector<std::string> contents;
+  std::vector<PackLocation> locations;
+  for (size_t i = 0; i < 3; ++i) {
+    contents.push_back(RandomString(kContentSize));
+    PackLocation location;
+    ASSERT_EQ(Status::OK,
+              pack_store.AddObject(glue::SHA256Hash(contents.back().data(),
+                                                    contents.back().size()),
+                                   contents.back(), &location));
+    locations.push_back(location);
+  }
+
+  // Each record is bigger than half a segment.
+  EXPECT_EQ(0u, locations[0].segment);
+  EXPECT_EQ(1u, locations[1].segment);
+  EXPECT_EQ(2u, locations[2].segment);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    EXPECT_EQ(contents[i], ReadObject(pack_store, locations[i]));
+  }
+
+  // A big object is written alone in a new segment.
+  std::string big_content = RandomString(4 * kContentSize);
+  PackLocation big_location;
+  ASSERT_EQ(Status::OK,
+            pack_store.AddObject(
+                glue::SHA256Hash(big_content.data(), big_content.size()),
+                big_content, &big_location));
+  EXPECT_EQ(3u, big_location.segment);
+  EXPECT_EQ(big_content, ReadObject(pack_store, big_location));
+}
+
+TEST_F(PackStoreTest, DeleteSegment) {
+  const size_t kContentSize = 100;
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir(),
+                       PackSyncOptions(), 2 * kContentSize);
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::string content = RandomString(kContentSize);
+  PackLocation location;
+  for (size_t i = 0; i < 2; ++i) {
+    content = RandomString(kContentSize);
+    ASSERT_EQ(Status::OK,
+              pack_store.AddObject(
+                  glue::SHA256Hash(content.data(), content.size()), content,
+                  &location));
+  }
+  EXPECT_EQ(1u, location.segment);
+
+  std::vector<uint32_t> segments;
+  uint32_t current_segment;
+  ASSERT_EQ(Status::OK, pack_store.GetSegments(&segments, &current_segment));
+  std::sort(segments.begin(), segments.end());
+  EXPECT_EQ(std::vector<uint32_t>({0, 1}), segments);
+  EXPECT_EQ(1u, current_segment);
+
+  // The current segment cannot be deleted.
+  uint64_t size;
+  EXPECT_EQ(Status::ILLEGAL_STATE, pack_store.DeleteSegment(1, &size));
+
+  ASSERT_EQ(Status::OK, pack_store.DeleteSegment(0, &size));
+  EXPECT_LT(kContentSize, size);
+  EXPECT_FALSE(files::IsFile(pack_store.GetSegmentPath(0)));
+  EXPECT_EQ(content, ReadObject(pack_store, location));
+
+  ASSERT_EQ(Status::OK, pack_store.GetSegments(&segments, &current_segment));
+  EXPECT_EQ(std::vector<uint32_t>({1}), segments);
+}
+
+TEST_F(PackStoreTest, GroupedSync) {
+  PackSyncOptions sync_options;
+  sync_options.max_delay = ftl::TimeDelta::FromMilliseconds(10);
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir(),
+                       sync_options);
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  std::vector<Status> statuses;
+  for (size_t i = 0; i < 3; ++i) {
+    std::string content = RandomString(100);
+    PackLocation location;
+    ASSERT_EQ(Status::OK, pack_store.AddObject(
+                              glue::SHA256Hash(content.data(), content.size()),
+                              content, &location));
+    pack_store.Sync(location,
+                    [&statuses](Status status) { statuses.push_back(status); });
+  }
+  // No record is synced before the end of the window.
+  EXPECT_TRUE(statuses.empty());
+
+  message_loop_.task_runner()->PostDelayedTask(
+      [this] { message_loop_.PostQuitTask(); },
+      ftl::TimeDelta::FromMilliseconds(50));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(std::vector<Status>(3, Status::OK), statuses);
+}
+
+TEST_F(PackStoreTest, SyncLimits) {
+  PackSyncOptions sync_options;
+  sync_options.max_delay = ftl::TimeDelta::FromSeconds(60);
+  sync_options.max_pending_records = 2;
+  sync_options.max_pending_bytes = 1000;
+  PackStore pack_store(message_loop_.task_runner(), GetPackDir(),
+                       sync_options);
+  ASSERT_EQ(Status::OK, pack_store.Init());
+
+  int sync_count = 0;
+  auto add_object = [&pack_store, &sync_count](size_t size) {
+    std::string content = RandomString(size);
+    PackLocation location;
+    EXPECT_EQ(Status::OK, pack_store.AddObject(
+                              glue::SHA256Hash(content.data(), content.size()),
+                              content, &location));
+    pack_store.Sync(location, [&sync_count](Status status) {
+      EXPECT_EQ(Status::OK, status);
+      ++sync_count;
+    });
+  };
+
+  // The records are synced when the maximal number of records is reached.
+  add_object(100);
+  EXPECT_EQ(0, sync_count);
+  add_object(100);
+  EXPECT_EQ(2, sync_count);
+
+  // A record is synced alone when it exceeds the maximal number of bytes.
+  add_object(2000);
+  EXPECT_EQ(3, sync_count);
+
+  // Pending records are synced on explicit flushes.
+  add_object(100);
+  EXPECT_EQ(3, sync_count);
+  EXPECT_EQ(Status::OK, pack_store.Flush());
+  EXPECT_EQ(4, sync_count);
+}
+
+TEST_F(PackStoreTest, CancelPendingSyncs) {
+  bool called = false;
+  {
+    PackStore pack_store(message_loop_.task_runner(), GetPackDir());
+    ASSERT_EQ(Status::OK, pack_store.Init());
+
+    std::string content = RandomString(100);
+    PackLocation location;
+    ASSERT_EQ(Status::OK, pack_store.AddObject(
+                              glue::SHA256Hash(content.data(), content.size()),
+                              content, &location));
+    pack_store.Sync(location, [&called](Status status) { called = true; });
+    pack_store.CancelPendingSyncs();
+  }
+
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(50)));
+  EXPECT_FALSE(called);
+}
+
+}  // namespace
+}  // namespace storage
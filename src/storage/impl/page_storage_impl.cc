@@ -19,21 +19,25 @@
 #include "apps/ledger/src/callback/asynchronous_callback.h"
 #include "apps/ledger/src/callback/trace_callback.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/callback/worker_pool.h"
+#include "apps/ledger/src/glue/compression/compression.h"
 #include "apps/ledger/src/glue/crypto/hash.h"
 #include "apps/ledger/src/storage/impl/btree/diff.h"
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
+#include "apps/ledger/src/storage/impl/btree/lookup.h"
 #include "apps/ledger/src/storage/impl/commit_impl.h"
 #include "apps/ledger/src/storage/impl/constants.h"
+#include "apps/ledger/src/storage/impl/db_object_impl.h"
+#include "apps/ledger/src/storage/impl/directory_reader.h"
 #include "apps/ledger/src/storage/impl/inlined_object_impl.h"
+#include "apps/ledger/src/storage/impl/io_thread.h"
 #include "apps/ledger/src/storage/impl/object_impl.h"
 #include "apps/ledger/src/storage/public/constants.h"
 #include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/arraysize.h"
 #include "lib/ftl/files/directory.h"
 #include "lib/ftl/files/file.h"
-#include "lib/ftl/files/file_descriptor.h"
 #include "lib/ftl/files/path.h"
-#include "lib/ftl/files/unique_fd.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/memory/weak_ptr.h"
@@ -45,9 +49,11 @@ namespace {
 
 using StreamingHash = glue::SHA256StreamingHash;
 
-const char kLevelDbDir[] = "/leveldb";
-const char kObjectDir[] = "/objects";
-const char kStagingDir[] = "/staging";
+const char kPackDir[] = "/packs";
+// Directories used to store objects, one file per object, before pack segments
+// were introduced. Their content is migrated on initialization.
+const char kLegacyObjectDir[] = "/objects";
+const char kLegacyStagingDir[] = "/staging";
 
 static_assert(kObjectHashSize == StreamingHash::kHashSize,
               "Unexpected kObjectHashSize value");
@@ -68,89 +74,126 @@ struct StringPointerComparator {
   }
 };
 
-std::string GetFilePath(ftl::StringView objects_dir,
-                        convert::ExtendedStringView object_id) {
-  std::string hex = convert::ToHex(object_id);
-
-  FTL_DCHECK(hex.size() > 2);
-  ftl::StringView hex_view = hex;
+// Objects used to be stored in |objects_dir|/xx/<hex>, where xx are the first
+// two characters of the hexadecimal representation of their id.
+std::string GetLegacyObjectPath(ftl::StringView objects_dir,
+                                ftl::StringView hex_id) {
+  FTL_DCHECK(hex_id.size() > 2);
   return ftl::Concatenate(
-      {objects_dir, "/", hex_view.substr(0, 2), "/", hex_view.substr(2)});
-}
-
-Status StagingToDestination(size_t expected_size,
-                            std::string source_path,
-                            std::string destination_path) {
-  TRACE_DURATION("ledger", "page_storage_staging_to_destination");
-  // Check if file already exists.
-  size_t size = 0;
-  if (files::GetFileSize(destination_path, &size)) {
-    if (size != expected_size) {
-      // If size is not the correct one, something is really wrong.
-      FTL_LOG(ERROR) << "Internal error. Path \"" << destination_path
-                     << "\" has wrong size. Expected: " << expected_size
-                     << ", but found: " << size;
+      {objects_dir, "/", hex_id.substr(0, 2), "/", hex_id.substr(2)});
+}
 
-      return Status::INTERNAL_IO_ERROR;
+// Lists the hexadecimal representation of the ids of the objects stored in
+// |objects_dir|.
+bool GetLegacyObjectHexIds(const std::string& objects_dir,
+                           std::vector<std::string>* hex_ids) {
+  std::vector<std::string> prefixes;
+  if (!DirectoryReader::GetDirectoryEntries(
+          objects_dir, [&prefixes](ftl::StringView entry) {
+            prefixes.push_back(entry.ToString());
+            return true;
+          })) {
+    return false;
+  }
+  for (const std::string& prefix : prefixes) {
+    if (!DirectoryReader::GetDirectoryEntries(
+            ftl::Concatenate({objects_dir, "/", prefix}),
+            [&prefix, hex_ids](ftl::StringView entry) {
+              hex_ids->push_back(ftl::Concatenate({prefix, entry}));
+              return true;
+            })) {
+      return false;
     }
-    // Source path already existed at destination. Clear the source.
-    files::DeletePath(source_path, false);
-    return Status::OK;
   }
+  return true;
+}
 
-  std::string destination_dir = files::GetDirectoryName(destination_path);
-  if (!files::IsDirectory(destination_dir) &&
-      !files::CreateDirectory(destination_dir)) {
-    return Status::INTERNAL_IO_ERROR;
+// Objects written in the pack segments are buffered in memory up to this
+// size, to be deduplicated and compressed before the space of their record is
+// reserved. Bigger objects are streamed to their record.
+constexpr size_t kMaxBufferedPackObjectSize = 1024 * 1024;
+
+// Compresses |content| in |compressed_content|. Returns false if compressing
+// fails or saves less than an eighth of the size of |content|.
+bool CompressContent(ftl::StringView content, std::string* compressed_content) {
+  return glue::Compress(content, compressed_content) &&
+         compressed_content->size() <= content.size() - content.size() / 8;
+}
+
+// Returns the description of how to store the given |content| in the database.
+// If |compress| is true, the content is stored compressed, unless it does not
+// compress well.
+ObjectStorageInfo GetDbStorageInfo(std::string content, bool compress) {
+  ObjectStorageInfo info;
+  std::string compressed_content;
+  if (compress && CompressContent(content, &compressed_content)) {
+    info.db_content = std::move(compressed_content);
+    info.db_content_compressed = true;
+    return info;
   }
+  info.db_content = std::move(content);
+  return info;
+}
 
-  if (rename(source_path.c_str(), destination_path.c_str()) != 0) {
-    // If rename failed, the file might have been saved by another call.
-    if (!files::GetFileSize(destination_path, &size) || size != expected_size) {
-      FTL_LOG(ERROR) << "Internal error. Failed to rename \n\"" << source_path
-                     << "\" to \n\"" << destination_path << "\"";
-      return Status::INTERNAL_IO_ERROR;
-    }
-    // Source path already existed at destination. Clear the source.
-    files::DeletePath(source_path, false);
+// Writes |content| in the pack segments. If |compress| is true, the content is
+// stored compressed, unless it is too big to be buffered or does not compress
+// well.
+Status AddPackObject(PackStore* pack_store,
+                     ObjectIdView object_id,
+                     ftl::StringView content,
+                     bool compress,
+                     PackLocation* location) {
+  std::string compressed_content;
+  if (!compress || content.size() > kMaxBufferedPackObjectSize ||
+      !CompressContent(content, &compressed_content)) {
+    return pack_store->AddObject(object_id, content, location);
+  }
+  Status status =
+      pack_store->AddObject(object_id, compressed_content, location);
+  if (status != Status::OK) {
+    return status;
   }
+  location->compressed = true;
   return Status::OK;
 }
 
-class FileWriterOnIOThread {
+class ObjectWriterOnIOThread {
  public:
-  FileWriterOnIOThread(const std::string& staging_dir,
-                       const std::string& object_dir)
-      : staging_dir_(staging_dir), object_dir_(object_dir) {}
-
-  ~FileWriterOnIOThread() {
-    // Cleanup staging file.
-    if (!file_path_.empty()) {
-      fd_.reset();
-      unlink(file_path_.c_str());
-    }
-  }
-
-  void Start(std::unique_ptr<DataSource> data_source,
-             std::function<void(Status, ObjectId)> callback) {
+  // |is_stored| sets whether the object with the given id is already stored:
+  // buffered objects are then not written again.
+  ObjectWriterOnIOThread(
+      PackStore* pack_store,
+      bool compress,
+      std::function<Status(ObjectIdView, bool*)> is_stored)
+      : pack_store_(pack_store),
+        compress_(compress),
+        is_stored_(std::move(is_stored)) {}
+
+  ~ObjectWriterOnIOThread() {}
+
+  void Start(
+      std::unique_ptr<DataSource> data_source,
+      std::function<void(Status, ObjectId, ObjectStorageInfo)> callback) {
     callback_ = std::move(callback);
-    // Using mkstemp to create an unique file. XXXXXX will be replaced.
-    file_path_ = staging_dir_ + "/XXXXXX";
-    fd_.reset(mkstemp(&file_path_[0]));
-    if (!fd_.is_valid()) {
-      FTL_LOG(ERROR) << "Unable to create file in staging directory ("
-                     << staging_dir_ << ")";
-      callback_(Status::INTERNAL_IO_ERROR, "");
-      return;
+    buffered_ = data_source->GetSize() <= kMaxBufferedPackObjectSize;
+    if (!buffered_) {
+      writer_ = pack_store_->StartObject(data_source->GetSize());
+      if (!writer_) {
+        FTL_LOG(ERROR) << "Unable to reserve space in the pack segments.";
+        callback_(Status::INTERNAL_IO_ERROR, "", ObjectStorageInfo());
+        return;
+      }
     }
     data_source_ = std::move(data_source);
     data_source_->Get([this](std::unique_ptr<DataSource::DataChunk> chunk,
                              DataSource::Status status) {
       if (status == DataSource::Status::ERROR) {
-        callback_(Status::IO_ERROR, "");
+        callback_(Status::IO_ERROR, "", ObjectStorageInfo());
+        return;
+      }
+      if (!OnDataAvailable(chunk->Get())) {
         return;
       }
-      OnDataAvailable(chunk->Get());
       if (status == DataSource::Status::DONE) {
         OnDataComplete();
       }
@@ -158,43 +201,80 @@ class FileWriterOnIOThread {
   }
 
  private:
-  void OnDataAvailable(ftl::StringView data) {
+  bool OnDataAvailable(ftl::StringView data) {
     hash_.Update(data);
-    if (!ftl::WriteFileDescriptor(fd_.get(), data.data(), data.size())) {
-      FTL_LOG(ERROR) << "Error writing data to disk: " << strerror(errno);
-      callback_(Status::INTERNAL_IO_ERROR, "");
-      return;
+    if (buffered_) {
+      if (content_.size() + data.size() > data_source_->GetSize()) {
+        FTL_LOG(ERROR) << "Object content exceeds its expected size: "
+                       << data_source_->GetSize();
+        callback_(Status::IO_ERROR, "", ObjectStorageInfo());
+        return false;
+      }
+      content_.append(data.data(), data.size());
+      return true;
     }
+    Status status = writer_->Append(data);
+    if (status != Status::OK) {
+      callback_(status, "", ObjectStorageInfo());
+      return false;
+    }
+    return true;
   }
 
   void OnDataComplete() {
-    if (fsync(fd_.get()) != 0) {
-      FTL_LOG(ERROR) << "Unable to save to disk.";
-      callback_(Status::INTERNAL_IO_ERROR, "");
-      return;
-    }
-    fd_.reset();
-
     std::string object_id;
     hash_.Finish(&object_id);
 
-    std::string final_path = storage::GetFilePath(object_dir_, object_id);
-    Status status = StagingToDestination(data_source_->GetSize(), file_path_,
-                                         std::move(final_path));
+    ObjectStorageInfo info;
+    Status status = buffered_ ? AddBufferedObject(object_id, &info)
+                              : writer_->Finish(object_id, &info.pack_location);
     if (status != Status::OK) {
-      callback_(Status::INTERNAL_IO_ERROR, "");
+      callback_(status, "", ObjectStorageInfo());
       return;
     }
+    if (info.already_stored) {
+      callback_(Status::OK, std::move(object_id), std::move(info));
+      return;
+    }
+
+    // The callback is only called once the object is on disk. |this| might be
+    // deleted before the sync happens.
+    pack_store_->Sync(info.pack_location, [
+      callback = callback_, object_id = std::move(object_id), info
+    ](Status status) {
+      if (status != Status::OK) {
+        callback(status, "", ObjectStorageInfo());
+        return;
+      }
+      callback(Status::OK, object_id, info);
+    });
+  }
 
-    callback_(Status::OK, std::move(object_id));
+  Status AddBufferedObject(ObjectIdView object_id, ObjectStorageInfo* info) {
+    if (content_.size() != data_source_->GetSize()) {
+      FTL_LOG(ERROR) << "Object content has wrong size. Expected: "
+                     << data_source_->GetSize()
+                     << ", but found: " << content_.size();
+      return Status::IO_ERROR;
+    }
+    Status status = is_stored_(object_id, &info->already_stored);
+    if (status != Status::OK || info->already_stored) {
+      return status;
+    }
+    status = AddPackObject(pack_store_, object_id, content_, compress_,
+                           &info->pack_location);
+    content_.clear();
+    return status;
   }
 
-  const std::string& staging_dir_;
-  const std::string& object_dir_;
-  std::function<void(Status, ObjectId)> callback_;
+  PackStore* const pack_store_;
+  const bool compress_;
+  std::function<Status(ObjectIdView, bool*)> is_stored_;
+  std::function<void(Status, ObjectId, ObjectStorageInfo)> callback_;
   std::unique_ptr<DataSource> data_source_;
-  std::string file_path_;
-  ftl::UniqueFD fd_;
+  bool buffered_ = false;
+  std::string content_;
+  std::unique_ptr<PackStore::Writer> writer_;
   StreamingHash hash_;
 };
 
@@ -204,14 +284,25 @@ class ObjectSourceHandler {
   ObjectSourceHandler() {}
   virtual ~ObjectSourceHandler() {}
 
-  virtual void Start(std::function<void(Status, ObjectId)> callback) = 0;
+  // Drains the data source. On success, |callback| is called with the id of
+  // the object and the description of where its content must be stored.
+  virtual void Start(
+      std::function<void(Status, ObjectId, ObjectStorageInfo)> callback) = 0;
 
+  // Objects smaller than |max_db_object_size| are kept in memory, to be
+  // written in the database. They are hashed, and compressed if
+  // |compress_objects| is true, on |worker_pool| if it is not null. Bigger
+  // objects are written in the pack segments, and compressed there on the io
+  // thread, unless |is_stored| finds them already stored.
   static std::unique_ptr<ObjectSourceHandler> Create(
       std::unique_ptr<DataSource> data_source,
       ftl::RefPtr<ftl::TaskRunner> main_runner,
       ftl::RefPtr<ftl::TaskRunner> io_runner,
-      const std::string& staging_dir,
-      const std::string& object_dir);
+      PackStore* pack_store,
+      size_t max_db_object_size,
+      bool compress_objects,
+      std::function<Status(ObjectIdView, bool*)> is_stored,
+      callback::WorkerPool* worker_pool);
 
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(ObjectSourceHandler);
@@ -219,66 +310,120 @@ class ObjectSourceHandler {
 
 class SmallObjectObjectSourceHandler : public ObjectSourceHandler {
  public:
-  SmallObjectObjectSourceHandler(std::unique_ptr<DataSource> data_source)
-      : data_source_(std::move(data_source)) {}
+  SmallObjectObjectSourceHandler(std::unique_ptr<DataSource> data_source,
+                                 bool compress,
+                                 callback::WorkerPool* worker_pool)
+      : data_source_(std::move(data_source)),
+        compress_(compress),
+        worker_pool_(worker_pool),
+        weak_ptr_factory_(this) {}
 
-  void Start(std::function<void(Status, ObjectId)> callback) override {
+  void Start(std::function<void(Status, ObjectId, ObjectStorageInfo)> callback)
+      override {
     callback_ = std::move(callback);
 
     data_source_->Get([this](std::unique_ptr<DataSource::DataChunk> chunk,
                              DataSource::Status status) {
       if (status == DataSource::Status::ERROR) {
-        callback_(Status::IO_ERROR, "");
+        callback_(Status::IO_ERROR, "", ObjectStorageInfo());
         return;
       }
       auto view = chunk->Get();
       content_.append(view.data(), view.size());
       if (status == DataSource::Status::DONE) {
-        callback_(Status::OK, std::move(content_));
+        OnDataComplete();
       }
     });
   }
 
  private:
+  void OnDataComplete() {
+    if (content_.size() != data_source_->GetSize()) {
+      FTL_LOG(ERROR) << "Object content has wrong size. Expected: "
+                     << data_source_->GetSize()
+                     << ", but found: " << content_.size();
+      callback_(Status::IO_ERROR, "", ObjectStorageInfo());
+      return;
+    }
+    if (content_.size() < kObjectHashSize) {
+      // The object is inlined in its id.
+      callback_(Status::OK, std::move(content_), ObjectStorageInfo());
+      return;
+    }
+    // The id is always the hash of the uncompressed content.
+    if (!worker_pool_) {
+      ObjectId object_id = glue::SHA256Hash(content_.data(), content_.size());
+      callback_(Status::OK, std::move(object_id),
+                GetDbStorageInfo(std::move(content_), compress_));
+      return;
+    }
+
+    // The content, the id and the storage info are owned by the task and the
+    // reply: |this| might be deleted before they are computed.
+    auto content = std::make_shared<std::string>(std::move(content_));
+    auto object_id = std::make_shared<ObjectId>();
+    auto info = std::make_shared<ObjectStorageInfo>();
+    worker_pool_->PostTaskAndReply(
+        [ content, object_id, info, compress = compress_ ] {
+          *object_id = glue::SHA256Hash(content->data(), content->size());
+          *info = GetDbStorageInfo(std::move(*content), compress);
+        },
+        [ weak_this = weak_ptr_factory_.GetWeakPtr(), object_id, info ] {
+          if (!weak_this) {
+            return;
+          }
+          weak_this->callback_(Status::OK, std::move(*object_id),
+                               std::move(*info));
+        });
+  }
+
   std::unique_ptr<DataSource> data_source_;
+  const bool compress_;
+  callback::WorkerPool* const worker_pool_;
   std::string content_;
-  std::function<void(Status, ObjectId)> callback_;
+  std::function<void(Status, ObjectId, ObjectStorageInfo)> callback_;
+
+  ftl::WeakPtrFactory<SmallObjectObjectSourceHandler> weak_ptr_factory_;
 };
 
-class FileWriter : public ObjectSourceHandler {
+class ObjectWriter : public ObjectSourceHandler {
  public:
-  FileWriter(std::unique_ptr<DataSource> data_source,
-             ftl::RefPtr<ftl::TaskRunner> main_runner,
-             ftl::RefPtr<ftl::TaskRunner> io_runner,
-             const std::string& staging_dir,
-             const std::string& object_dir)
+  ObjectWriter(std::unique_ptr<DataSource> data_source,
+               ftl::RefPtr<ftl::TaskRunner> main_runner,
+               ftl::RefPtr<ftl::TaskRunner> io_runner,
+               PackStore* pack_store,
+               bool compress,
+               std::function<Status(ObjectIdView, bool*)> is_stored)
       : data_source_(std::move(data_source)),
         main_runner_(std::move(main_runner)),
         io_runner_(std::move(io_runner)),
-        file_writer_on_io_thread_(
-            std::make_unique<FileWriterOnIOThread>(staging_dir, object_dir)),
+        object_writer_on_io_thread_(std::make_unique<ObjectWriterOnIOThread>(
+            pack_store,
+            compress,
+            std::move(is_stored))),
         weak_ptr_factory_(this) {
     FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
   }
 
-  ~FileWriter() {
+  ~ObjectWriter() {
     FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
 
     if (!io_runner_->RunsTasksOnCurrentThread()) {
       io_runner_->PostTask(ftl::MakeCopyable([
         this,
         guard = std::make_unique<std::lock_guard<std::mutex>>(deletion_mutex_)
-      ] { file_writer_on_io_thread_.reset(); }));
+      ] { object_writer_on_io_thread_.reset(); }));
       std::lock_guard<std::mutex> wait_for_deletion(deletion_mutex_);
     }
   }
 
-  void Start(std::function<void(Status, ObjectId)> callback) override {
+  void Start(std::function<void(Status, ObjectId, ObjectStorageInfo)> callback)
+      override {
     FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
 
     if (io_runner_->RunsTasksOnCurrentThread()) {
-      file_writer_on_io_thread_->Start(std::move(data_source_),
-                                       std::move(callback));
+      object_writer_on_io_thread_->Start(std::move(data_source_),
+                                         std::move(callback));
       return;
     }
     callback_ = std::move(callback);
@@ -287,22 +432,25 @@ class FileWriter : public ObjectSourceHandler {
     ]() mutable {
       // Called on the io runner.
 
-      // |this| cannot be deleted here, because if the destructor of FileWriter
-      // has been called after Start and before this has been run, it is still
-      // waiting on the lock to be released as the posts are run in-order.
-      file_writer_on_io_thread_->Start(std::move(data_source_), [
+      // |this| cannot be deleted here, because if the destructor of
+      // ObjectWriter has been called after Start and before this has been run,
+      // it is still waiting on the lock to be released as the posts are run
+      // in-order.
+      object_writer_on_io_thread_->Start(std::move(data_source_), [
         weak_this, main_runner = main_runner_
-      ](Status status, ObjectId object_id) {
+      ](Status status, ObjectId object_id, ObjectStorageInfo info) {
         // Called on the io runner.
 
-        main_runner->PostTask(
-            [ weak_this, status, object_id = std::move(object_id) ]() {
-              // Called on the main runner.
+        main_runner->PostTask(ftl::MakeCopyable([
+          weak_this, status, object_id = std::move(object_id),
+          info = std::move(info)
+        ]() mutable {
+          // Called on the main runner.
 
-              if (weak_this) {
-                weak_this->callback_(status, std::move(object_id));
-              }
-            });
+          if (weak_this) {
+            weak_this->callback_(status, std::move(object_id), std::move(info));
+          }
+        }));
       });
     }));
   }
@@ -313,66 +461,131 @@ class FileWriter : public ObjectSourceHandler {
   ftl::RefPtr<ftl::TaskRunner> main_runner_;
   ftl::RefPtr<ftl::TaskRunner> io_runner_;
 
-  std::function<void(Status, ObjectId)> callback_;
+  std::function<void(Status, ObjectId, ObjectStorageInfo)> callback_;
 
-  std::unique_ptr<FileWriterOnIOThread> file_writer_on_io_thread_;
+  std::unique_ptr<ObjectWriterOnIOThread> object_writer_on_io_thread_;
 
-  ftl::WeakPtrFactory<FileWriter> weak_ptr_factory_;
+  ftl::WeakPtrFactory<ObjectWriter> weak_ptr_factory_;
 };
 
 std::unique_ptr<ObjectSourceHandler> ObjectSourceHandler::Create(
     std::unique_ptr<DataSource> data_source,
     ftl::RefPtr<ftl::TaskRunner> main_runner,
     ftl::RefPtr<ftl::TaskRunner> io_runner,
-    const std::string& staging_dir,
-    const std::string& object_dir) {
-  if (data_source->GetSize() < kObjectHashSize) {
+    PackStore* pack_store,
+    size_t max_db_object_size,
+    bool compress_objects,
+    std::function<Status(ObjectIdView, bool*)> is_stored,
+    callback::WorkerPool* worker_pool) {
+  if (data_source->GetSize() < std::max(kObjectHashSize, max_db_object_size)) {
     return std::make_unique<SmallObjectObjectSourceHandler>(
-        std::move(data_source));
+        std::move(data_source), compress_objects, worker_pool);
   }
-  return std::make_unique<FileWriter>(
+  return std::make_unique<ObjectWriter>(
       std::move(data_source), std::move(main_runner), std::move(io_runner),
-      staging_dir, object_dir);
+      pack_store, compress_objects, std::move(is_stored));
 }
 
+// A cursor keeping the iterator of an interrupted iteration.
+class ContentsCursorImpl : public PageStorage::ContentsCursor {
+ public:
+  explicit ContentsCursorImpl(std::unique_ptr<btree::BTreeIterator> iterator)
+      : iterator(std::move(iterator)) {}
+  ~ContentsCursorImpl() override {}
+
+  std::unique_ptr<btree::BTreeIterator> iterator;
+};
+
 }  // namespace
 
 PageStorageImpl::PageStorageImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                                  ftl::RefPtr<ftl::TaskRunner> io_runner,
                                  coroutine::CoroutineService* coroutine_service,
                                  std::string page_dir,
-                                 PageId page_id)
+                                 PageId page_id,
+                                 PackSyncOptions sync_options,
+                                 size_t max_db_object_size,
+                                 TreeNodeCache* tree_node_cache,
+                                 callback::WorkerPool* worker_pool,
+                                 RepositoryDb* repository_db,
+                                 std::string db_key_prefix,
+                                 GarbageCollectorOptions gc_options,
+                                 bool compress_objects)
     : main_runner_(task_runner),
       io_runner_(io_runner),
       coroutine_service_(coroutine_service),
       page_dir_(page_dir),
       page_id_(std::move(page_id)),
-      db_(coroutine_service, this, page_dir_ + kLevelDbDir),
-      objects_dir_(page_dir_ + kObjectDir),
-      staging_dir_(page_dir_ + kStagingDir),
-      page_sync_(nullptr) {}
-
-PageStorageImpl::~PageStorageImpl() {}
+      own_db_(repository_db
+                  ? nullptr
+                  : std::make_unique<RepositoryDb>(
+                        ftl::Concatenate({page_dir_, "/", kPageDbDir}))),
+      db_(io_runner_,
+          coroutine_service,
+          this,
+          repository_db ? repository_db : own_db_.get(),
+          std::move(db_key_prefix)),
+      live_commit_tracker_(LiveCommitTracker::Create()),
+      pack_store_(io_runner_, page_dir_ + kPackDir, sync_options),
+      object_vmo_cache_(ObjectVmoCache::Create()),
+      max_db_object_size_(max_db_object_size),
+      compress_objects_(compress_objects),
+      tree_node_cache_(tree_node_cache),
+      worker_pool_(worker_pool),
+      page_sync_(nullptr),
+      garbage_collector_(main_runner_,
+                         io_runner_,
+                         this,
+                         &db_,
+                         &pack_store_,
+                         live_commit_tracker_.get(),
+                         gc_options),
+      weak_factory_(this) {}
+
+PageStorageImpl::~PageStorageImpl() {
+  FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
+
+  // Syncs of the pack store and accesses to the database are run on the io
+  // thread. Wait for any running one and cancel the scheduled syncs before
+  // deleting the store.
+  if (!io_runner_->RunsTasksOnCurrentThread()) {
+    std::mutex deletion_mutex;
+    io_runner_->PostTask(ftl::MakeCopyable([
+      this,
+      guard = std::make_unique<std::lock_guard<std::mutex>>(deletion_mutex)
+    ] { pack_store_.CancelPendingSyncs(); }));
+    std::lock_guard<std::mutex> wait_for_deletion(deletion_mutex);
+  }
+}
 
 void PageStorageImpl::Init(std::function<void(Status)> callback) {
-  // Initialize DB.
-  Status s = db_.Init();
+  // Initialize DB. Pages using the database of their repository do not need
+  // to open it.
+  Status s = own_db_ ? own_db_->Init() : Status::OK;
+  if (s == Status::OK) {
+    s = db_.Init();
+  }
   if (s != Status::OK) {
     callback(s);
     return;
   }
 
-  // Initialize paths.
-  if (!files::CreateDirectory(objects_dir_) ||
-      !files::CreateDirectory(staging_dir_)) {
-    FTL_LOG(ERROR) << "Unable to create directories for PageStorageImpl.";
-    callback(Status::INTERNAL_IO_ERROR);
+  // Initialize the object store.
+  s = pack_store_.Init();
+  if (s != Status::OK) {
+    FTL_LOG(ERROR) << "Unable to initialize the object store.";
+    callback(s);
+    return;
+  }
+  s = MigrateLegacyObjects();
+  if (s != Status::OK) {
+    callback(s);
     return;
   }
 
   // Add the default page head if this page is empty.
-  std::vector<CommitId> heads;
-  s = db_.GetHeads(&heads);
+  std::vector<std::pair<CommitId, int64_t>> heads;
+  s = db_.GetHeadsWithTimestamps(&heads);
   if (s != Status::OK) {
     callback(s);
     return;
@@ -383,6 +596,11 @@ void PageStorageImpl::Init(std::function<void(Status)> callback) {
       callback(s);
       return;
     }
+    heads.emplace_back(kFirstPageCommitId.ToString(), 0);
+  }
+  // From now on, heads are only read from memory.
+  for (const auto& head : heads) {
+    AddHeadInMemory(head.first, head.second);
   }
 
   // Remove uncommited explicit journals.
@@ -425,10 +643,18 @@ PageId PageStorageImpl::GetId() {
 
 void PageStorageImpl::SetSyncDelegate(PageSyncDelegate* page_sync) {
   page_sync_ = page_sync;
+  if (page_sync_) {
+    garbage_collector_.Start();
+  }
 }
 
 Status PageStorageImpl::GetHeadCommitIds(std::vector<CommitId>* commit_ids) {
-  return db_.GetHeads(commit_ids);
+  commit_ids->clear();
+  commit_ids->reserve(heads_.size());
+  for (const auto& head : heads_) {
+    commit_ids->push_back(head.second);
+  }
+  return Status::OK;
 }
 
 void PageStorageImpl::GetCommit(
@@ -438,19 +664,58 @@ void PageStorageImpl::GetCommit(
     CommitImpl::Empty(this, std::move(callback));
     return;
   }
-  std::string bytes;
-  Status s = db_.GetCommitStorageBytes(commit_id, &bytes);
-  if (s != Status::OK) {
-    callback(s, nullptr);
+  auto pending = pending_commits_.find(commit_id);
+  if (pending != pending_commits_.end()) {
+    callback(Status::OK, pending->second.commit->Clone());
+    return;
+  }
+  std::unique_ptr<const Commit> cached_commit = commit_cache_.Get(commit_id);
+  if (cached_commit) {
+    callback(Status::OK, std::move(cached_commit));
+    return;
+  }
+  db_.GetCommitStorageBytes(commit_id, [
+    this, commit_id = commit_id.ToString(), callback = std::move(callback)
+  ](Status s, std::string bytes) {
+    if (s != Status::OK) {
+      callback(s, nullptr);
+      return;
+    }
+    std::unique_ptr<const Commit> commit =
+        CommitImpl::FromStorageBytes(this, commit_id, std::move(bytes),
+                                     live_commit_tracker_);
+    if (!commit) {
+      callback(Status::FORMAT_ERROR, nullptr);
+      return;
+    }
+    commit_cache_.Put(commit->Clone());
+    callback(Status::OK, std::move(commit));
+  });
+}
+
+void PageStorageImpl::GetSkipAncestorIds(
+    CommitIdView commit_id,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  if (IsFirstCommit(commit_id)) {
+    callback(Status::OK, std::vector<CommitId>());
     return;
   }
-  std::unique_ptr<const Commit> commit = CommitImpl::FromStorageBytes(
-      this, commit_id.ToString(), std::move(bytes));
-  if (!commit) {
-    callback(Status::FORMAT_ERROR, nullptr);
+  auto pending = pending_commits_.find(commit_id);
+  if (pending != pending_commits_.end()) {
+    callback(Status::OK, pending->second.skip_ids);
     return;
   }
-  callback(Status::OK, std::move(commit));
+  db_.GetCommitSkipIds(
+      commit_id, [callback = std::move(callback)](
+                     Status s, std::vector<CommitId> skip_ids) {
+        // Merge commits and commits added before the ancestry index existed
+        // are not in it.
+        if (s == Status::NOT_FOUND) {
+          callback(Status::OK, std::vector<CommitId>());
+          return;
+        }
+        callback(s, std::move(skip_ids));
+      });
 }
 
 void PageStorageImpl::AddCommitFromLocal(std::unique_ptr<const Commit> commit,
@@ -477,7 +742,8 @@ void PageStorageImpl::AddCommitsFromSync(
     }
 
     std::unique_ptr<const Commit> commit =
-        CommitImpl::FromStorageBytes(this, id, std::move(storage_bytes));
+        CommitImpl::FromStorageBytes(this, id, std::move(storage_bytes),
+                                     live_commit_tracker_);
     if (!commit) {
       FTL_LOG(ERROR) << "Unable to add commit. Id: " << convert::ToHex(id);
       callback(Status::FORMAT_ERROR);
@@ -500,22 +766,28 @@ void PageStorageImpl::AddCommitsFromSync(
     return;
   }
 
+  ++pending_commits_from_sync_;
+  auto on_done = [ this, callback = std::move(callback) ](Status status) {
+    --pending_commits_from_sync_;
+    callback(status);
+  };
+
   auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
   // Get all objects from sync and then add the commit objects.
   for (const auto& leaf : leaves) {
-    btree::GetObjectsFromSync(coroutine_service_, this,
+    btree::GetObjectsFromSync(coroutine_service_, this, tree_node_cache_,
                               leaf.second->GetRootId(), waiter->NewCallback());
   }
 
   waiter->Finalize(ftl::MakeCopyable([
-    this, commits = std::move(commits), callback = std::move(callback)
+    this, commits = std::move(commits), on_done = std::move(on_done)
   ](Status status) mutable {
     if (status != Status::OK) {
-      callback(status);
+      on_done(status);
       return;
     }
 
-    AddCommits(std::move(commits), ChangeSource::SYNC, callback);
+    AddCommits(std::move(commits), ChangeSource::SYNC, std::move(on_done));
   }));
 }
 
@@ -550,25 +822,27 @@ Status PageStorageImpl::RemoveCommitWatcher(CommitWatcher* watcher) {
 void PageStorageImpl::GetUnsyncedCommits(
     std::function<void(Status, std::vector<std::unique_ptr<const Commit>>)>
         callback) {
-  std::vector<CommitId> commit_ids;
-  Status s = db_.GetUnsyncedCommitIds(&commit_ids);
-  if (s != Status::OK) {
-    callback(s, {});
-    return;
-  }
-
-  auto waiter = callback::Waiter<Status, std::unique_ptr<const Commit>>::Create(
-      Status::OK);
-  for (size_t i = 0; i < commit_ids.size(); ++i) {
-    GetCommit(commit_ids[i], waiter->NewCallback());
-  }
-  waiter->Finalize([callback = std::move(callback)](
-      Status s, std::vector<std::unique_ptr<const Commit>> commits) {
+  db_.GetUnsyncedCommitIds([ this, callback = std::move(callback) ](
+      Status s, std::vector<CommitId> commit_ids) {
     if (s != Status::OK) {
       callback(s, {});
       return;
     }
-    callback(Status::OK, std::move(commits));
+
+    auto waiter =
+        callback::Waiter<Status, std::unique_ptr<const Commit>>::Create(
+            Status::OK);
+    for (size_t i = 0; i < commit_ids.size(); ++i) {
+      GetCommit(commit_ids[i], waiter->NewCallback());
+    }
+    waiter->Finalize([callback = std::move(callback)](
+        Status s, std::vector<std::unique_ptr<const Commit>> commits) {
+      if (s != Status::OK) {
+        callback(s, {});
+        return;
+      }
+      callback(Status::OK, std::move(commits));
+    });
   });
 }
 
@@ -578,37 +852,83 @@ Status PageStorageImpl::MarkCommitSynced(const CommitId& commit_id) {
 
 Status PageStorageImpl::GetDeltaObjects(const CommitId& commit_id,
                                         std::vector<ObjectId>* objects) {
-  return Status::NOT_IMPLEMENTED;
+  return db_.GetDeltaObjectIds(commit_id, objects);
 }
 
 void PageStorageImpl::GetUnsyncedObjectIds(
     const CommitId& commit_id,
     std::function<void(Status, std::vector<ObjectId>)> callback) {
+  // The delta of the commit, and whether each of its objects is synced, are
+  // read in a single task on the io thread.
+  auto object_ids = std::make_shared<std::vector<ObjectId>>();
+  RunOnIoThread(
+      io_runner_, weak_factory_.GetWeakPtr(),
+      [ this, commit_id, object_ids ] {
+        std::vector<ObjectId> delta;
+        Status s = db_.GetDeltaObjectIds(commit_id, &delta);
+        if (s != Status::OK) {
+          return s;
+        }
+        for (ObjectId& object_id : delta) {
+          bool is_synced;
+          s = db_.IsObjectSynced(object_id, &is_synced);
+          if (s != Status::OK) {
+            return s;
+          }
+          if (!is_synced) {
+            object_ids->push_back(std::move(object_id));
+          }
+        }
+        return Status::OK;
+      },
+      [ this, commit_id, object_ids, callback ](Status s) {
+        if (s == Status::NOT_FOUND) {
+          // The delta of commits received from sync, or created before deltas
+          // were recorded, is not known.
+          GetUnsyncedObjectIdsFromTree(commit_id, callback);
+          return;
+        }
+        if (s != Status::OK) {
+          callback(s, std::vector<ObjectId>());
+          return;
+        }
+        std::sort(object_ids->begin(), object_ids->end());
+        callback(Status::OK, std::move(*object_ids));
+      });
+}
+
+void PageStorageImpl::GetUnsyncedObjectIdsFromTree(
+    const CommitId& commit_id,
+    std::function<void(Status, std::vector<ObjectId>)> callback) {
   GetCommit(commit_id, [ this, callback = std::move(callback) ](
                            Status s, std::unique_ptr<const Commit> commit) {
     if (s != Status::OK) {
       callback(s, {});
       return;
     }
-    btree::GetObjectIds(coroutine_service_, this, commit->GetRootId(), [
+    btree::GetObjectIds(coroutine_service_, this, tree_node_cache_,
+                        commit->GetRootId(), [
       this, callback = std::move(callback)
     ](Status s, std::set<ObjectId> commit_objects) {
       if (s != Status::OK) {
         callback(s, {});
         return;
       }
-      std::vector<ObjectId> object_ids;
-      std::vector<ObjectId> unsynced_objects;
-      s = db_.GetUnsyncedObjectIds(&unsynced_objects);
-      if (s != Status::OK) {
-        callback(s, std::move(object_ids));
-        return;
-      }
+      db_.GetUnsyncedObjectIds(ftl::MakeCopyable([
+        commit_objects = std::move(commit_objects),
+        callback = std::move(callback)
+      ](Status s, std::vector<ObjectId> unsynced_objects) {
+        std::vector<ObjectId> object_ids;
+        if (s != Status::OK) {
+          callback(s, std::move(object_ids));
+          return;
+        }
 
-      std::set_intersection(commit_objects.begin(), commit_objects.end(),
-                            unsynced_objects.begin(), unsynced_objects.end(),
-                            std::back_inserter(object_ids));
-      callback(Status::OK, std::move(object_ids));
+        std::set_intersection(commit_objects.begin(), commit_objects.end(),
+                              unsynced_objects.begin(), unsynced_objects.end(),
+                              std::back_inserter(object_ids));
+        callback(Status::OK, std::move(object_ids));
+      }));
     });
   });
 }
@@ -621,28 +941,53 @@ void PageStorageImpl::AddObjectFromSync(
     ObjectIdView object_id,
     std::unique_ptr<DataSource> data_source,
     const std::function<void(Status)>& callback) {
-  AddObject(std::move(data_source), [
-    this, object_id = object_id.ToString(), callback
-  ](Status status, ObjectId found_id) {
-    if (status != Status::OK) {
-      callback(status);
-    } else if (found_id != object_id) {
-      FTL_LOG(ERROR) << "Object ID mismatch. Given ID: "
-                     << convert::ToHex(object_id)
-                     << ". Found: " << convert::ToHex(found_id);
-      files::DeletePath(GetFilePath(found_id), false);
-      callback(Status::OBJECT_ID_MISMATCH);
-    } else {
-      callback(Status::OK);
-    }
-  });
+  // The id of the object is known: the index is looked up before any space is
+  // reserved for its content.
+  auto stored = std::make_shared<bool>(false);
+  RunOnIoThread(
+      io_runner_, weak_factory_.GetWeakPtr(),
+      [ this, object_id = object_id.ToString(), stored ] {
+        return IsObjectStored(object_id, stored.get());
+      },
+      ftl::MakeCopyable([
+        this, object_id = object_id.ToString(),
+        data_source = std::move(data_source), callback, stored
+      ](Status status) mutable {
+        if (status != Status::OK || *stored) {
+          callback(status);
+          return;
+        }
+        AddObject(std::move(data_source), [
+          this, object_id = std::move(object_id), callback
+        ](Status status, ObjectId found_id, ObjectStorageInfo info) {
+          if (status != Status::OK) {
+            callback(status);
+          } else if (found_id != object_id) {
+            // Content written in the pack segments is left unreferenced.
+            FTL_LOG(ERROR) << "Object ID mismatch. Given ID: "
+                           << convert::ToHex(object_id)
+                           << ". Found: " << convert::ToHex(found_id);
+            callback(Status::OBJECT_ID_MISMATCH);
+          } else {
+            callback(IndexObject(found_id, info));
+          }
+        });
+      }));
 }
 
 void PageStorageImpl::AddObjectFromLocal(
     std::unique_ptr<DataSource> data_source,
     const std::function<void(Status, ObjectId)>& callback) {
   AddObject(std::move(data_source), [ this, callback = std::move(callback) ](
-                                        Status status, ObjectId object_id) {
+                                        Status status, ObjectId object_id,
+                                        ObjectStorageInfo info) {
+    if (status == Status::OK && !info.db_content.empty()) {
+      // The content is written with the first journal entry or commit
+      // referencing the object.
+      unwritten_objects_[object_id] = std::move(info);
+    } else if (status == Status::OK) {
+      status = IndexObject(object_id, info);
+    }
     untracked_objects_.insert(object_id);
     callback(status, std::move(object_id));
   });
@@ -658,17 +1003,25 @@ void PageStorageImpl::GetObject(
              std::make_unique<InlinedObjectImpl>(object_id.ToString()));
     return;
   }
-  std::string file_path = GetFilePath(object_id);
-  if (!files::IsFile(file_path)) {
-    if (location == Location::NETWORK) {
-      GetObjectFromSync(object_id, callback);
-    } else {
-      callback(Status::NOT_FOUND, nullptr);
-    }
+  auto it = unwritten_objects_.find(object_id);
+  if (it != unwritten_objects_.end()) {
+    callback(Status::OK,
+             std::make_unique<DbObjectImpl>(
+                 object_id.ToString(), it->second.db_content,
+                 it->second.db_content_compressed
+                     ? DbObjectImpl::Encoding::COMPRESSED
+                     : DbObjectImpl::Encoding::RAW));
     return;
   }
-  callback(Status::OK, std::make_unique<ObjectImpl>(object_id.ToString(),
-                                                    std::move(file_path)));
+  GetLocalObject(object_id, [
+    this, object_id = object_id.ToString(), location, callback
+  ](Status status, std::unique_ptr<const Object> object) {
+    if (status == Status::NOT_FOUND && location == Location::NETWORK) {
+      GetObjectFromSync(object_id, callback);
+      return;
+    }
+    callback(status, std::move(object));
+  });
 }
 
 Status PageStorageImpl::SetSyncMetadata(ftl::StringView sync_state) {
@@ -684,41 +1037,88 @@ void PageStorageImpl::GetCommitContents(const Commit& commit,
                                         std::function<bool(Entry)> on_next,
                                         std::function<void(Status)> on_done) {
   btree::ForEachEntry(
-      coroutine_service_, this, commit.GetRootId(), min_key,
+      coroutine_service_, this, tree_node_cache_, commit.GetRootId(), min_key,
+      [on_next = std::move(on_next)](btree::EntryAndNodeId next) {
+        return on_next(ToEntry(next.entry));
+      },
+      std::move(on_done));
+}
+
+void PageStorageImpl::GetCommitContentsReverse(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status)> on_done) {
+  btree::ForEachEntryReverse(
+      coroutine_service_, this, tree_node_cache_, commit.GetRootId(),
+      std::move(min_key), std::move(max_key),
       [on_next = std::move(on_next)](btree::EntryAndNodeId next) {
-        return on_next(next.entry);
+        return on_next(ToEntry(next.entry));
       },
       std::move(on_done));
 }
 
+void PageStorageImpl::GetCommitContentsFromCursor(
+    const Commit& commit,
+    std::string min_key,
+    std::unique_ptr<ContentsCursor> cursor,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done) {
+  std::unique_ptr<btree::BTreeIterator> iterator;
+  if (cursor) {
+    iterator =
+        std::move(static_cast<ContentsCursorImpl*>(cursor.get())->iterator);
+  }
+  btree::ForEachEntryFrom(
+      coroutine_service_, this, tree_node_cache_, commit.GetRootId(),
+      std::move(min_key), std::move(iterator),
+      [on_next = std::move(on_next)](btree::EntryAndNodeId next) {
+        return on_next(ToEntry(next.entry));
+      },
+      [on_done = std::move(on_done)](
+          Status status, std::unique_ptr<btree::BTreeIterator> iterator) {
+        if (!iterator) {
+          on_done(status, nullptr);
+          return;
+        }
+        on_done(status,
+                std::make_unique<ContentsCursorImpl>(std::move(iterator)));
+      });
+}
+
 void PageStorageImpl::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
     std::function<void(Status, Entry)> callback) {
-  std::unique_ptr<bool> key_found = std::make_unique<bool>(false);
-  auto on_next = [ key, key_found = key_found.get(),
-                   callback ](btree::EntryAndNodeId next) {
-    if (next.entry.key == key) {
-      *key_found = true;
-      callback(Status::OK, next.entry);
-    }
-    return false;
-  };
+  btree::GetEntry(this, tree_node_cache_, commit.GetRootId(), std::move(key),
+                  std::move(callback));
+}
 
-  auto on_done = ftl::MakeCopyable([
-    key_found = std::move(key_found), callback = std::move(callback)
-  ](Status s) mutable {
-    if (*key_found) {
-      return;
-    }
-    if (s == Status::OK) {
-      callback(Status::NOT_FOUND, Entry());
-      return;
-    }
-    callback(s, Entry());
-  });
-  btree::ForEachEntry(coroutine_service_, this, commit.GetRootId(),
-                      std::move(key), std::move(on_next), std::move(on_done));
+void PageStorageImpl::GetEntriesFromCommit(
+    const Commit& commit,
+    std::vector<std::string> keys,
+    std::function<void(Status, std::vector<Entry>)> callback) {
+  btree::GetEntries(this, tree_node_cache_, commit.GetRootId(),
+                    std::move(keys), std::move(callback));
+}
+
+void PageStorageImpl::CountCommitContents(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<void(Status, uint64_t)> callback) {
+  btree::CountEntries(this, tree_node_cache_, commit.GetRootId(),
+                      std::move(min_key), std::move(max_key),
+                      std::move(callback));
+}
+
+void PageStorageImpl::GetEntryAtIndexFromCommit(
+    const Commit& commit,
+    uint64_t index,
+    std::function<void(Status, Entry)> callback) {
+  btree::GetEntryAtIndex(this, tree_node_cache_, commit.GetRootId(), index,
+                         std::move(callback));
 }
 
 void PageStorageImpl::GetCommitContentsDiff(
@@ -727,11 +1127,16 @@ void PageStorageImpl::GetCommitContentsDiff(
     std::string min_key,
     std::function<bool(EntryChange)> on_next_diff,
     std::function<void(Status)> on_done) {
-  btree::ForEachDiff(coroutine_service_, this, base_commit.GetRootId(),
-                     other_commit.GetRootId(), std::move(min_key),
+  btree::ForEachDiff(coroutine_service_, this, tree_node_cache_,
+                     base_commit.GetRootId(), other_commit.GetRootId(),
+                     std::move(min_key),
                      std::move(on_next_diff), std::move(on_done));
 }
 
+callback::WorkerPool* PageStorageImpl::GetWorkerPool() {
+  return worker_pool_;
+}
+
 void PageStorageImpl::NotifyWatchers() {
   while (!commits_to_send_.empty()) {
     auto to_send = std::move(commits_to_send_.front());
@@ -746,9 +1151,25 @@ void PageStorageImpl::AddCommits(
     std::vector<std::unique_ptr<const Commit>> commits,
     ChangeSource source,
     std::function<void(Status)> callback) {
+  if (source == ChangeSource::SYNC) {
+    // The same commits can be received again while a previous batch adding
+    // them is written: only add them once.
+    commits.erase(std::remove_if(commits.begin(), commits.end(),
+                                 [this](const auto& commit) {
+                                   return ContainsCommit(commit->GetId()) ==
+                                          Status::OK;
+                                 }),
+                  commits.end());
+    if (commits.empty()) {
+      callback(Status::OK);
+      return;
+    }
+  }
+
   // Apply all changes atomically.
   std::unique_ptr<DB::Batch> batch = db_.StartBatch();
   std::set<const CommitId*, StringPointerComparator> added_commits;
+  std::map<CommitId, std::vector<CommitId>> batch_skip_ids;
 
   for (const auto& commit : commits) {
     Status s =
@@ -793,22 +1214,76 @@ void PageStorageImpl::AddCommits(
       db_.RemoveHead(parent_id);
     }
 
+    std::vector<CommitId> skip_ids;
+    s = ComputeSkipIds(*commit, batch_skip_ids, &skip_ids);
+    if (s == Status::OK && !skip_ids.empty()) {
+      s = db_.AddCommitSkipIds(commit->GetId(), skip_ids);
+    }
+    if (s != Status::OK) {
+      callback(s);
+      return;
+    }
+    batch_skip_ids[commit->GetId()] = std::move(skip_ids);
+
     added_commits.insert(&commit->GetId());
   }
 
-  Status s = batch->Execute();
-  bool notify_watchers = commits_to_send_.empty();
-  commits_to_send_.emplace(source, std::move(commits));
-  callback(s);
+  // The objects created locally that are not written yet are written with the
+  // commits: these include the values and tree nodes they reference.
+  std::vector<ObjectId> written_objects;
+  if (source == ChangeSource::LOCAL) {
+    written_objects.reserve(unwritten_objects_.size());
+    for (const auto& object : unwritten_objects_) {
+      Status s = IndexObject(object.first, object.second);
+      if (s != Status::OK) {
+        callback(s);
+        return;
+      }
+      written_objects.push_back(object.first);
+    }
+  }
 
-  if (s == Status::OK && notify_watchers) {
-    NotifyWatchers();
+  // Until the batch is written, the commits are only visible through
+  // |pending_commits_|.
+  for (const auto& commit : commits) {
+    pending_commits_[commit->GetId()] = PendingCommit{
+        commit->Clone(), std::move(batch_skip_ids[commit->GetId()])};
   }
 
+  batch->Execute(ftl::MakeCopyable([
+    this, commits = std::move(commits), source,
+    written_objects = std::move(written_objects),
+    callback = std::move(callback)
+  ](Status s) mutable {
+    for (const auto& commit : commits) {
+      pending_commits_.erase(commit->GetId());
+    }
+    if (s == Status::OK) {
+      for (const ObjectId& object_id : written_objects) {
+        MarkObjectWritten(object_id);
+      }
+      // Replay the updates of the heads written in the batch.
+      for (const auto& commit : commits) {
+        AddHeadInMemory(commit->GetId(), commit->GetTimestamp());
+        for (const CommitIdView& parent_id : commit->GetParentIds()) {
+          RemoveHeadInMemory(parent_id);
+        }
+        commit_cache_.Put(commit->Clone());
+      }
+    }
+    bool notify_watchers = commits_to_send_.empty();
+    commits_to_send_.emplace(source, std::move(commits));
+    callback(s);
+
+    if (s == Status::OK && notify_watchers) {
+      NotifyWatchers();
+    }
+  }));
 }
 
 Status PageStorageImpl::ContainsCommit(CommitIdView id) {
-  if (IsFirstCommit(id)) {
+  if (IsFirstCommit(id) || head_timestamps_.count(id) != 0 ||
+      pending_commits_.count(id) != 0 || commit_cache_.Contains(id)) {
     return Status::OK;
   }
   std::string bytes;
@@ -819,24 +1294,257 @@ bool PageStorageImpl::IsFirstCommit(CommitIdView id) {
   return id == kFirstPageCommitId;
 }
 
+Status PageStorageImpl::ComputeSkipIds(
+    const Commit& commit,
+    const std::map<CommitId, std::vector<CommitId>>& batch_skip_ids,
+    std::vector<CommitId>* skip_ids) {
+  skip_ids->clear();
+  std::vector<CommitIdView> parent_ids = commit.GetParentIds();
+  if (parent_ids.size() != 1) {
+    return Status::OK;
+  }
+  skip_ids->push_back(parent_ids[0].ToString());
+  std::vector<CommitId> ancestor_skip_ids;
+  while (true) {
+    // The ancestor at 2^(k + 1) generations of distance is the ancestor at 2^k
+    // generations of distance of the ancestor at 2^k generations of distance.
+    size_t level = skip_ids->size() - 1;
+    const CommitId& ancestor_id = skip_ids->back();
+    if (IsFirstCommit(ancestor_id)) {
+      return Status::OK;
+    }
+    auto it = batch_skip_ids.find(ancestor_id);
+    auto pending = pending_commits_.find(ancestor_id);
+    if (it != batch_skip_ids.end()) {
+      ancestor_skip_ids = it->second;
+    } else if (pending != pending_commits_.end()) {
+      ancestor_skip_ids = pending->second.skip_ids;
+    } else {
+      Status s = db_.GetCommitSkipIds(ancestor_id, &ancestor_skip_ids);
+      if (s == Status::NOT_FOUND) {
+        // Merge commits and commits added before the ancestry index existed
+        // end the linear history known to the index.
+        return Status::OK;
+      }
+      if (s != Status::OK) {
+        return s;
+      }
+    }
+    if (ancestor_skip_ids.size() <= level) {
+      return Status::OK;
+    }
+    skip_ids->push_back(std::move(ancestor_skip_ids[level]));
+  }
+}
+
+void PageStorageImpl::AddHeadInMemory(CommitIdView head, int64_t timestamp) {
+  auto it = head_timestamps_.find(head);
+  if (it != head_timestamps_.end()) {
+    heads_.erase(std::make_pair(it->second, it->first));
+    it->second = timestamp;
+  } else {
+    it = head_timestamps_.emplace(head.ToString(), timestamp).first;
+  }
+  heads_.emplace(timestamp, it->first);
+}
+
+void PageStorageImpl::RemoveHeadInMemory(CommitIdView head) {
+  auto it = head_timestamps_.find(head);
+  if (it == head_timestamps_.end()) {
+    return;
+  }
+  heads_.erase(std::make_pair(it->second, it->first));
+  head_timestamps_.erase(it);
+}
+
 void PageStorageImpl::AddObject(
     std::unique_ptr<DataSource> data_source,
-    const std::function<void(Status, ObjectId)>& callback) {
+    const std::function<void(Status, ObjectId, ObjectStorageInfo)>& callback) {
   auto traced_callback =
       TRACE_CALLBACK(std::move(callback), "ledger", "page_storage_add_object");
 
-  auto handler = pending_operation_manager_.Manage(
-      ObjectSourceHandler::Create(std::move(data_source), main_runner_,
-                                  io_runner_, staging_dir_, objects_dir_));
+  auto handler = pending_operation_manager_.Manage(ObjectSourceHandler::Create(
+      std::move(data_source), main_runner_, io_runner_, &pack_store_,
+      max_db_object_size_, compress_objects_,
+      [this](ObjectIdView object_id, bool* stored) {
+        return IsObjectStored(object_id, stored);
+      },
+      worker_pool_));
 
+  // The object is indexed by |callback|: it is only then that the garbage
+  // collector can find the segment it is written in.
+  ++object_writes_started_;
+  ++pending_object_writes_;
   (*handler.first)->Start([
-    cleanup = std::move(handler.second), callback = std::move(traced_callback)
-  ](Status status, ObjectId object_id) {
-    callback(status, std::move(object_id));
+    this, cleanup = std::move(handler.second),
+    callback = std::move(traced_callback)
+  ](Status status, ObjectId object_id, ObjectStorageInfo info) {
+    callback(status, std::move(object_id), std::move(info));
+    --pending_object_writes_;
     cleanup();
   });
 }
 
+Status PageStorageImpl::IndexObject(ObjectIdView object_id,
+                                    const ObjectStorageInfo& info) {
+  if (info.already_stored) {
+    return Status::OK;
+  }
+  if (info.db_content_compressed) {
+    return db_.AddCompressedObjectContent(object_id, info.db_content);
+  }
+  if (!info.db_content.empty()) {
+    return db_.AddObjectContent(object_id, info.db_content);
+  }
+  if (info.pack_location.size == 0) {
+    // Inlined objects are not stored.
+    return Status::OK;
+  }
+  return db_.AddObjectLocation(object_id, info.pack_location);
+}
+
+Status PageStorageImpl::GetLocalObject(ObjectIdView object_id,
+                                       std::unique_ptr<const Object>* object) {
+  std::string content;
+  Status status = db_.GetCompressedObjectContent(object_id, &content);
+  if (status == Status::OK) {
+    *object = std::make_unique<DbObjectImpl>(
+        object_id.ToString(), std::move(content),
+        DbObjectImpl::Encoding::COMPRESSED);
+    return Status::OK;
+  }
+  if (status != Status::NOT_FOUND) {
+    return status;
+  }
+
+  status = db_.GetObjectContent(object_id, &content);
+  if (status == Status::OK) {
+    *object = std::make_unique<DbObjectImpl>(object_id.ToString(),
+                                             std::move(content));
+    return Status::OK;
+  }
+  if (status != Status::NOT_FOUND) {
+    return status;
+  }
+
+  PackLocation location;
+  status = db_.GetObjectLocation(object_id, &location);
+  if (status != Status::OK) {
+    return status;
+  }
+  // The segment is opened in the same io thread task as the lookup of the
+  // location, so that the object stays readable if the segment is collected
+  // afterwards.
+  auto pack_object = std::make_unique<ObjectImpl>(
+      object_id.ToString(), pack_store_.GetSegmentPath(location.segment),
+      location.offset, location.size,
+      location.compressed ? ObjectImpl::Encoding::COMPRESSED
+                          : ObjectImpl::Encoding::RAW,
+      object_vmo_cache_);
+  status = pack_object->Init();
+  if (status != Status::OK) {
+    return status;
+  }
+  *object = std::move(pack_object);
+  return Status::OK;
+}
+
+Status PageStorageImpl::IsObjectStored(ObjectIdView object_id, bool* stored) {
+  PackLocation location;
+  Status status = db_.GetObjectLocation(object_id, &location);
+  std::string content;
+  if (status == Status::NOT_FOUND) {
+    status = db_.GetCompressedObjectContent(object_id, &content);
+  }
+  if (status == Status::NOT_FOUND) {
+    status = db_.GetObjectContent(object_id, &content);
+  }
+  if (status == Status::NOT_FOUND) {
+    *stored = false;
+    return Status::OK;
+  }
+  *stored = status == Status::OK;
+  return status;
+}
+
+void PageStorageImpl::GetLocalObject(
+    ObjectIdView object_id,
+    std::function<void(Status, std::unique_ptr<const Object>)> callback) {
+  // All the places the object can be stored in are looked up in a single task
+  // on the io thread.
+  auto object = std::make_shared<std::unique_ptr<const Object>>();
+  RunOnIoThread(io_runner_, weak_factory_.GetWeakPtr(),
+                [ this, object_id = object_id.ToString(), object ] {
+                  return GetLocalObject(object_id, object.get());
+                },
+                [ object, callback = std::move(callback) ](Status status) {
+                  callback(status, std::move(*object));
+                });
+}
+
+Status PageStorageImpl::MigrateLegacyObjects() {
+  std::string objects_dir = page_dir_ + kLegacyObjectDir;
+  if (!files::IsDirectory(objects_dir)) {
+    return Status::OK;
+  }
+  TRACE_DURATION("ledger", "page_storage_migrate_legacy_objects");
+
+  std::vector<std::string> hex_ids;
+  if (!GetLegacyObjectHexIds(objects_dir, &hex_ids)) {
+    FTL_LOG(ERROR) << "Unable to read directory " << objects_dir;
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  std::unique_ptr<DB::Batch> batch = db_.StartBatch();
+  for (const std::string& hex_id : hex_ids) {
+    std::string content;
+    if (!files::ReadFileToString(GetLegacyObjectPath(objects_dir, hex_id),
+                                 &content)) {
+      return Status::INTERNAL_IO_ERROR;
+    }
+    ObjectId object_id = glue::SHA256Hash(content.data(), content.size());
+    if (convert::ToHex(object_id) != hex_id) {
+      // The file is corrupted. The object is not added to the index, and will
+      // be fetched again if needed.
+      FTL_LOG(ERROR) << "Content of object " << hex_id
+                     << " does not match its id. Ignoring it.";
+      continue;
+    }
+    ObjectStorageInfo info;
+    if (content.size() < max_db_object_size_) {
+      info = GetDbStorageInfo(std::move(content), compress_objects_);
+    } else {
+      Status status = AddPackObject(&pack_store_, object_id, content,
+                                    compress_objects_, &info.pack_location);
+      if (status != Status::OK) {
+        return status;
+      }
+    }
+    Status status = IndexObject(object_id, info);
+    if (status != Status::OK) {
+      return status;
+    }
+  }
+  // All the migrated objects are flushed to disk at once, before being indexed.
+  Status status = pack_store_.Flush();
+  if (status != Status::OK) {
+    return status;
+  }
+  status = batch->Execute();
+  if (status != Status::OK) {
+    return status;
+  }
+
+  // The legacy directories are only deleted once all their objects have been
+  // indexed: an interrupted migration is restarted on the next initialization.
+  if (!files::DeletePath(objects_dir, true) ||
+      !files::DeletePath(page_dir_ + kLegacyStagingDir, true)) {
+    FTL_LOG(ERROR) << "Unable to delete the legacy object directories.";
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
 void PageStorageImpl::GetObjectFromSync(
     ObjectIdView object_id,
     const std::function<void(Status, std::unique_ptr<const Object>)>&
@@ -859,18 +1567,14 @@ void PageStorageImpl::GetObjectFromSync(
         callback(status, nullptr);
         return;
       }
-      std::string file_path = GetFilePath(object_id);
-      FTL_DCHECK(files::IsFile(file_path));
-      callback(Status::OK, std::make_unique<ObjectImpl>(std::move(object_id),
-                                                        std::move(file_path)));
+      std::unique_ptr<const Object> object;
+      status = GetLocalObject(object_id, &object);
+      FTL_DCHECK(status != Status::NOT_FOUND);
+      callback(status, std::move(object));
     });
   });
 }
 
-std::string PageStorageImpl::GetFilePath(ObjectIdView object_id) const {
-  return storage::GetFilePath(objects_dir_, object_id);
-}
-
 bool PageStorageImpl::ObjectIsUntracked(ObjectIdView object_id) {
   return untracked_objects_.find(object_id) != untracked_objects_.end();
 }
@@ -882,4 +1586,24 @@ void PageStorageImpl::MarkObjectTracked(ObjectIdView object_id) {
   }
 }
 
+Status PageStorageImpl::WriteLocalObject(ObjectIdView object_id) {
+  auto it = unwritten_objects_.find(object_id);
+  if (it == unwritten_objects_.end()) {
+    return Status::OK;
+  }
+  return IndexObject(object_id, it->second);
+}
+
+void PageStorageImpl::MarkObjectWritten(ObjectIdView object_id) {
+  auto it = unwritten_objects_.find(object_id);
+  if (it != unwritten_objects_.end()) {
+    unwritten_objects_.erase(it);
+  }
+}
+
+void PageStorageImpl::CollectGarbage(
+    std::function<void(Status, GarbageCollectionStats)> callback) {
+  garbage_collector_.Collect(std::move(callback));
+}
+
 }  // namespace storage
@@ -7,27 +7,73 @@
 
 #include "apps/ledger/src/storage/public/page_storage.h"
 
+#include <map>
 #include <queue>
 #include <set>
+#include <string>
+#include <utility>
 
 #include "apps/ledger/src/callback/pending_operation.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/storage/impl/btree/tree_node_cache.h"
+#include "apps/ledger/src/storage/impl/commit_cache.h"
 #include "apps/ledger/src/storage/impl/db_impl.h"
+#include "apps/ledger/src/storage/impl/garbage_collector.h"
+#include "apps/ledger/src/storage/impl/live_commit_tracker.h"
+#include "apps/ledger/src/storage/impl/object_vmo_cache.h"
+#include "apps/ledger/src/storage/impl/pack_store.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
 #include "apps/ledger/src/storage/public/page_sync_delegate.h"
 #include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/strings/string_view.h"
 #include "lib/ftl/tasks/task_runner.h"
 
 namespace storage {
 
+// Objects whose content is smaller than this are stored in the page database
+// instead of the pack segments, by default.
+constexpr size_t kDefaultMaxDbObjectSize = 8 * 1024;
+
+// Describes where the content of a newly added object must be stored. Objects
+// written in the pack segments have a |pack_location| with a non-zero size.
+// Objects small enough to be stored in the database have their |db_content|
+// set, compressed if |db_content_compressed| is true. Objects inlined in their
+// id have neither. Objects found already stored have |already_stored| set, and
+// nothing to write.
+struct ObjectStorageInfo {
+  PackLocation pack_location;
+  std::string db_content;
+  bool db_content_compressed = false;
+  bool already_stored = false;
+};
+
 class PageStorageImpl : public PageStorage {
  public:
-  PageStorageImpl(ftl::RefPtr<ftl::TaskRunner> main_runner,
-                  ftl::RefPtr<ftl::TaskRunner> io_runner,
-                  coroutine::CoroutineService* coroutine_service,
-                  std::string page_dir,
-                  PageId page_id);
+  // Objects whose content is smaller than |max_db_object_size| are stored in
+  // the page database. |tree_node_cache| and |worker_pool|, if not null, must
+  // outlive this object. The rows of the page are stored under |db_key_prefix|
+  // in |repository_db|, which must be initialized and outlive this object. If
+  // |repository_db| is null, the page uses its own database, in |page_dir|.
+  // Unreachable objects are collected following |gc_options| once the page is
+  // synced. If |compress_objects| is true, the content of the objects is
+  // compressed, unless it does not compress well, or is written in the pack
+  // segments and too big to be buffered in memory.
+  PageStorageImpl(
+      ftl::RefPtr<ftl::TaskRunner> main_runner,
+      ftl::RefPtr<ftl::TaskRunner> io_runner,
+      coroutine::CoroutineService* coroutine_service,
+      std::string page_dir,
+      PageId page_id,
+      PackSyncOptions sync_options = PackSyncOptions(),
+      size_t max_db_object_size = kDefaultMaxDbObjectSize,
+      TreeNodeCache* tree_node_cache = nullptr,
+      callback::WorkerPool* worker_pool = nullptr,
+      RepositoryDb* repository_db = nullptr,
+      std::string db_key_prefix = "",
+      GarbageCollectorOptions gc_options = GarbageCollectorOptions(),
+      bool compress_objects = true);
   ~PageStorageImpl() override;
 
   // Initializes this PageStorageImpl. This includes initializing the underlying
@@ -47,6 +93,50 @@ class PageStorageImpl : public PageStorage {
   // Marks the given object as tracked.
   void MarkObjectTracked(ObjectIdView object_id);
 
+  // Adds the content of the given object to the open batch of the database if
+  // the object was created locally, is stored in the database, and has not
+  // been written yet. This lets the content be written with the first journal
+  // entry referencing the object. |MarkObjectWritten| must be called once the
+  // batch is executed.
+  Status WriteLocalObject(ObjectIdView object_id);
+
+  // Marks the content of the given object as written in the database.
+  void MarkObjectWritten(ObjectIdView object_id);
+
+  // Returns the tracker of the commits of this page that are in use. The
+  // commits returned by this object are registered in it while they are alive.
+  const ftl::RefPtr<LiveCommitTracker>& GetLiveCommitTracker() {
+    return live_commit_tracker_;
+  }
+
+  // Returns whether the commit with the given |commit_id| is kept in the
+  // in-memory cache of recently used commits.
+  bool IsCommitCached(CommitIdView commit_id) const {
+    return commit_cache_.Contains(commit_id);
+  }
+
+  // Returns the cache of decoded tree nodes used by this page, or nullptr if
+  // decoded nodes are not cached. The cache may be shared with other pages.
+  TreeNodeCache* tree_node_cache() { return tree_node_cache_; }
+
+  // Returns the number of objects whose writing started since this object was
+  // created, and whether some of them are not written and indexed yet.
+  uint64_t object_writes_started() const { return object_writes_started_; }
+  bool HasPendingObjectWrites() const { return pending_object_writes_ != 0; }
+
+  // Returns whether commits from sync are being added. The objects of their
+  // trees are fetched and stored before the commits: until then, they are not
+  // reachable from the heads of the page.
+  bool HasPendingCommitsFromSync() const {
+    return pending_commits_from_sync_ != 0;
+  }
+
+  // Collects the objects that are not reachable anymore. Collections are also
+  // run periodically once a sync delegate is set: objects are only deleted if
+  // they can be fetched again from the cloud.
+  void CollectGarbage(
+      std::function<void(Status, GarbageCollectionStats)> callback);
+
   // PageStorage:
   PageId GetId() override;
   void SetSyncDelegate(PageSyncDelegate* page_sync) override;
@@ -54,6 +144,9 @@ class PageStorageImpl : public PageStorage {
   void GetCommit(CommitIdView commit_id,
                  std::function<void(Status, std::unique_ptr<const Commit>)>
                      callback) override;
+  void GetSkipAncestorIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
   void AddCommitsFromSync(std::vector<CommitIdAndBytes> ids_and_bytes,
                           std::function<void(Status)>) override;
   Status StartCommit(const CommitId& commit_id,
@@ -93,30 +186,103 @@ class PageStorageImpl : public PageStorage {
                          std::string min_key,
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
+  void GetCommitContentsReverse(const Commit& commit,
+                                std::string min_key,
+                                std::string max_key,
+                                std::function<bool(Entry)> on_next,
+                                std::function<void(Status)> on_done) override;
+  void GetCommitContentsFromCursor(
+      const Commit& commit,
+      std::string min_key,
+      std::unique_ptr<ContentsCursor> cursor,
+      std::function<bool(Entry)> on_next,
+      std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done)
+      override;
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
+  void GetEntriesFromCommit(
+      const Commit& commit,
+      std::vector<std::string> keys,
+      std::function<void(Status, std::vector<Entry>)> callback) override;
+  void CountCommitContents(
+      const Commit& commit,
+      std::string min_key,
+      std::string max_key,
+      std::function<void(Status, uint64_t)> callback) override;
+  void GetEntryAtIndexFromCommit(
+      const Commit& commit,
+      uint64_t index,
+      std::function<void(Status, Entry)> callback) override;
   void GetCommitContentsDiff(const Commit& base_commit,
                              const Commit& other_commit,
                              std::string min_key,
                              std::function<bool(EntryChange)> on_next_diff,
                              std::function<void(Status)> on_done) override;
 
+  callback::WorkerPool* GetWorkerPool() override;
+
  private:
   friend class PageStorageImplAccessorForTest;
 
+  // A commit added to a batch that is not written in the database yet.
+  struct PendingCommit {
+    std::unique_ptr<const Commit> commit;
+    std::vector<CommitId> skip_ids;
+  };
+
   void AddCommits(std::vector<std::unique_ptr<const Commit>> commits,
                   ChangeSource source,
                   std::function<void(Status)> callback);
+  // Finds the unsynced objects of the commit with the given |commit_id| by
+  // listing all the objects of its tree. Used when its delta is not known.
+  void GetUnsyncedObjectIdsFromTree(
+      const CommitId& commit_id,
+      std::function<void(Status, std::vector<ObjectId>)> callback);
+  // Returns |OK| if the commit with the given |id| is stored, or is being
+  // written in the database.
   Status ContainsCommit(CommitIdView id);
   bool IsFirstCommit(CommitIdView id);
+  // Computes the ancestors of |commit| at 1, 2, 4, ... generations of distance
+  // in its linear history. The ancestors of the commits added in the same batch
+  // are found in |batch_skip_ids|, the others in |pending_commits_| or in the
+  // database.
+  Status ComputeSkipIds(
+      const Commit& commit,
+      const std::map<CommitId, std::vector<CommitId>>& batch_skip_ids,
+      std::vector<CommitId>* skip_ids);
+  // Updates the in-memory set of heads. These must be applied in the same
+  // order as the corresponding updates of the database.
+  void AddHeadInMemory(CommitIdView head, int64_t timestamp);
+  void RemoveHeadInMemory(CommitIdView head);
   void AddObject(std::unique_ptr<DataSource> data_source,
-                 const std::function<void(Status, ObjectId)>& callback);
+                 const std::function<void(Status, ObjectId, ObjectStorageInfo)>&
+                     callback);
+  // Adds the object with the given |object_id| to the locally stored objects:
+  // its content is written in the database, or its location in the pack
+  // segments is indexed, depending on |info|.
+  Status IndexObject(ObjectIdView object_id, const ObjectStorageInfo& info);
+  // Returns the object with the given |object_id| if it is stored locally,
+  // either in the database or in the pack segments, or |NOT_FOUND| otherwise.
+  // Inlined objects are not handled by this method.
+  Status GetLocalObject(ObjectIdView object_id,
+                        std::unique_ptr<const Object>* object);
+  // Sets |stored| to whether the object with the given |object_id| is stored
+  // locally, either in the database or in the pack segments. This must be
+  // called on the io thread.
+  Status IsObjectStored(ObjectIdView object_id, bool* stored);
+  // Asynchronous version of |GetLocalObject|: the database is accessed on the
+  // io thread.
+  void GetLocalObject(
+      ObjectIdView object_id,
+      std::function<void(Status, std::unique_ptr<const Object>)> callback);
   void GetObjectFromSync(
       ObjectIdView object_id,
       const std::function<void(Status, std::unique_ptr<const Object>)>&
           callback);
-  std::string GetFilePath(ObjectIdView object_id) const;
+  // Moves the objects stored one file per object by previous versions of
+  // PageStorageImpl in the pack segments.
+  Status MigrateLegacyObjects();
 
   // Notifies the registered watchers with the |commits| in commit_to_send_.
   void NotifyWatchers();
@@ -126,14 +292,45 @@ class PageStorageImpl : public PageStorage {
   coroutine::CoroutineService* const coroutine_service_;
   const std::string page_dir_;
   const PageId page_id_;
+  // Only set if this page does not use the database of its repository.
+  std::unique_ptr<RepositoryDb> own_db_;
   DbImpl db_;
+  // The heads of the page, ordered by timestamp and id, and the timestamp of
+  // each of them. They are loaded from the database in |Init|, and updated
+  // once the commits changing them are written.
+  std::set<std::pair<int64_t, CommitId>> heads_;
+  std::map<CommitId, int64_t, convert::StringViewComparator> head_timestamps_;
+  const ftl::RefPtr<LiveCommitTracker> live_commit_tracker_;
+  CommitCache commit_cache_;
+  // The commits being written in the database, indexed by id. They are added
+  // to the heads and to |commit_cache_| once written.
+  std::map<CommitId, PendingCommit, convert::StringViewComparator>
+      pending_commits_;
   std::vector<CommitWatcher*> watchers_;
   std::set<ObjectId, convert::StringViewComparator> untracked_objects_;
-  std::string objects_dir_;
-  std::string staging_dir_;
+  // The objects created locally and stored in the database whose content is
+  // not written yet. The content is written in the same batch as the first
+  // journal entry or commit referencing them, and is read from here until
+  // then.
+  std::map<ObjectId, ObjectStorageInfo, convert::StringViewComparator>
+      unwritten_objects_;
+  PackStore pack_store_;
+  const ftl::RefPtr<ObjectVmoCache> object_vmo_cache_;
+  const size_t max_db_object_size_;
+  const bool compress_objects_;
+  TreeNodeCache* const tree_node_cache_;
+  callback::WorkerPool* const worker_pool_;
   callback::PendingOperationManager pending_operation_manager_;
   PageSyncDelegate* page_sync_;
+  uint64_t object_writes_started_ = 0;
+  size_t pending_object_writes_ = 0;
+  size_t pending_commits_from_sync_ = 0;
   std::queue<std::pair<ChangeSource, std::vector<std::unique_ptr<const Commit>>>> commits_to_send_;
+  // Must be deleted before the database and the pack segments.
+  GarbageCollector garbage_collector_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<PageStorageImpl> weak_factory_;
 };
 
 }  // namespace storage
@@ -4,8 +4,6 @@
 
 #include "apps/ledger/src/storage/impl/page_storage_impl.h"
 
-#include <dirent.h>
-
 #include <chrono>
 #include <memory>
 #include <mutex>
@@ -19,7 +17,6 @@
 #include "apps/ledger/src/storage/impl/commit_impl.h"
 #include "apps/ledger/src/storage/impl/constants.h"
 #include "apps/ledger/src/storage/impl/db_empty_impl.h"
-#include "apps/ledger/src/storage/impl/directory_reader.h"
 #include "apps/ledger/src/storage/impl/journal_db_impl.h"
 #include "apps/ledger/src/storage/public/commit_watcher.h"
 #include "apps/ledger/src/storage/public/constants.h"
@@ -33,6 +30,8 @@
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/ftl/strings/string_printf.h"
 #include "lib/mtl/socket/strings.h"
 #include "lib/mtl/tasks/message_loop.h"
@@ -42,24 +41,52 @@ namespace storage {
 
 class PageStorageImplAccessorForTest {
  public:
-  static std::string GetFilePath(const PageStorageImpl& storage,
-                                 ObjectIdView object_id) {
-    return storage.GetFilePath(object_id);
+  static Status GetObjectLocation(PageStorageImpl* storage,
+                                  ObjectIdView object_id,
+                                  PackLocation* location) {
+    return storage->db_.GetObjectLocation(object_id, location);
+  }
+
+  static Status RemoveObjectLocation(PageStorageImpl* storage,
+                                     ObjectIdView object_id) {
+    return storage->db_.RemoveObjectLocation(object_id);
+  }
+
+  static Status GetObjectContent(PageStorageImpl* storage,
+                                 ObjectIdView object_id,
+                                 std::string* content) {
+    return storage->db_.GetObjectContent(object_id, content);
+  }
+
+  static Status RemoveObjectContent(PageStorageImpl* storage,
+                                    ObjectIdView object_id) {
+    return storage->db_.RemoveObjectContent(object_id);
+  }
+
+  static Status GetCompressedObjectContent(PageStorageImpl* storage,
+                                           ObjectIdView object_id,
+                                           std::string* content) {
+    return storage->db_.GetCompressedObjectContent(object_id, content);
+  }
+
+  static Status RemoveCompressedObjectContent(PageStorageImpl* storage,
+                                              ObjectIdView object_id) {
+    return storage->db_.RemoveCompressedObjectContent(object_id);
+  }
+
+  static Status RemoveCommit(PageStorageImpl* storage,
+                             const CommitId& commit_id) {
+    return storage->db_.RemoveCommit(commit_id);
+  }
+
+  static bool RemoveUnwrittenObject(PageStorageImpl* storage,
+                                    ObjectIdView object_id) {
+    return storage->unwritten_objects_.erase(object_id.ToString()) != 0;
   }
 };
 
 namespace {
 
-bool IsDirectoryEmpty(const std::string& directory) {
-  bool is_empty = true;
-  DirectoryReader::GetDirectoryEntries(directory,
-                                       [&is_empty](ftl::StringView dir) {
-                                         is_empty = false;
-                                         return false;
-                                       });
-  return is_empty;
-}
-
 std::vector<PageStorage::CommitIdAndBytes> CommitAndBytesFromCommit(
     const Commit& commit) {
   std::vector<PageStorage::CommitIdAndBytes> result;
@@ -106,8 +133,44 @@ class FakeSyncDelegate : public PageSyncDelegate {
   std::map<ObjectId, std::string> id_to_value_;
 };
 
+// Holds the request for one object until |ReleaseDelayedObject()| is called.
+class DelayingFakeSyncDelegate : public FakeSyncDelegate {
+ public:
+  explicit DelayingFakeSyncDelegate(std::function<void()> on_delay)
+      : on_delay_(std::move(on_delay)) {}
+
+  void DelayObject(ObjectIdView object_id) {
+    delayed_object_id_ = object_id.ToString();
+  }
+
+  void GetObject(
+      ObjectIdView object_id,
+      std::function<void(Status status, uint64_t size, mx::socket data)>
+          callback) override {
+    if (object_id != delayed_object_id_) {
+      FakeSyncDelegate::GetObject(object_id, std::move(callback));
+      return;
+    }
+    delayed_request_ = [
+      this, object_id = object_id.ToString(), callback = std::move(callback)
+    ] { FakeSyncDelegate::GetObject(object_id, callback); };
+    on_delay_();
+  }
+
+  void ReleaseDelayedObject() {
+    auto request = std::move(delayed_request_);
+    request();
+  }
+
+ private:
+  std::function<void()> on_delay_;
+  ObjectId delayed_object_id_;
+  std::function<void()> delayed_request_;
+};
+
 // Implements |Init()|, |CreateJournal() and |CreateMergeJournal()| and
-// fails with a |NOT_IMPLEMENTED| error in all other cases.
+// fails with a |NOT_IMPLEMENTED| error in all other cases. Explicit journals
+// write their changes in the database immediately.
 class FakeDbImpl : public DbEmptyImpl {
  public:
   FakeDbImpl(coroutine::CoroutineService* coroutine_service,
@@ -120,7 +183,7 @@ class FakeDbImpl : public DbEmptyImpl {
                        std::unique_ptr<Journal>* journal) override {
     JournalId id = RandomId(10);
     *journal = JournalDBImpl::Simple(journal_type, coroutine_service_,
-                                     page_storage_, this, id, base);
+                                     page_storage_, this, id, base, 0);
     return Status::OK;
   }
 
@@ -128,7 +191,7 @@ class FakeDbImpl : public DbEmptyImpl {
                             const CommitId& other,
                             std::unique_ptr<Journal>* journal) override {
     *journal = JournalDBImpl::Merge(coroutine_service_, page_storage_, this,
-                                    RandomId(10), base, other);
+                                    RandomId(10), base, other, 0);
     return Status::OK;
   }
 
@@ -200,9 +263,10 @@ class PageStorageTest : public StorageTest {
   }
 
   void TearDown() override {
-    std::string staging_directory = tmp_dir_.path() + "/staging";
-    EXPECT_TRUE(files::IsDirectory(staging_directory));
-    EXPECT_TRUE(IsDirectoryEmpty(staging_directory));
+    // Objects are only stored in the pack segments.
+    EXPECT_TRUE(files::IsDirectory(tmp_dir_.path() + "/packs"));
+    EXPECT_FALSE(files::IsDirectory(tmp_dir_.path() + "/objects"));
+    EXPECT_FALSE(files::IsDirectory(tmp_dir_.path() + "/staging"));
 
     io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
     io_thread_.join();
@@ -213,8 +277,56 @@ class PageStorageTest : public StorageTest {
  protected:
   PageStorage* GetStorage() override { return storage_.get(); }
 
-  std::string GetFilePath(ObjectIdView object_id) {
-    return PageStorageImplAccessorForTest::GetFilePath(*storage_, object_id);
+  bool IsObjectStoredInDb(ObjectIdView object_id) {
+    return IsObjectStoredUncompressedInDb(object_id) ||
+           IsObjectStoredCompressedInDb(object_id);
+  }
+
+  bool IsObjectStoredUncompressedInDb(ObjectIdView object_id) {
+    std::string content;
+    Status status = PageStorageImplAccessorForTest::GetObjectContent(
+        storage_.get(), object_id, &content);
+    EXPECT_TRUE(status == Status::OK || status == Status::NOT_FOUND);
+    return status == Status::OK;
+  }
+
+  bool IsObjectStoredCompressedInDb(ObjectIdView object_id) {
+    std::string content;
+    Status status = PageStorageImplAccessorForTest::GetCompressedObjectContent(
+        storage_.get(), object_id, &content);
+    EXPECT_TRUE(status == Status::OK || status == Status::NOT_FOUND);
+    return status == Status::OK;
+  }
+
+  bool IsObjectStoredInPack(ObjectIdView object_id) {
+    PackLocation location;
+    Status status = PageStorageImplAccessorForTest::GetObjectLocation(
+        storage_.get(), object_id, &location);
+    EXPECT_TRUE(status == Status::OK || status == Status::NOT_FOUND);
+    return status == Status::OK;
+  }
+
+  bool IsObjectStoredLocally(ObjectIdView object_id) {
+    return IsObjectStoredInDb(object_id) || IsObjectStoredInPack(object_id);
+  }
+
+  void RemoveObjectFromLocalStorage(ObjectIdView object_id) {
+    PageStorageImplAccessorForTest::RemoveUnwrittenObject(storage_.get(),
+                                                          object_id);
+    if (IsObjectStoredUncompressedInDb(object_id)) {
+      EXPECT_EQ(Status::OK, PageStorageImplAccessorForTest::RemoveObjectContent(
+                                storage_.get(), object_id));
+    }
+    if (IsObjectStoredCompressedInDb(object_id)) {
+      EXPECT_EQ(Status::OK,
+                PageStorageImplAccessorForTest::RemoveCompressedObjectContent(
+                    storage_.get(), object_id));
+    }
+    if (IsObjectStoredInPack(object_id)) {
+      EXPECT_EQ(Status::OK,
+                PageStorageImplAccessorForTest::RemoveObjectLocation(
+                    storage_.get(), object_id));
+    }
   }
 
   std::unique_ptr<const Commit> GetFirstHead() {
@@ -254,6 +366,31 @@ class PageStorageTest : public StorageTest {
     return id;
   }
 
+  // Puts the given objects in a new implicit journal: the content of the
+  // objects created locally is written with the journal entries.
+  void TryPutInJournal(const std::vector<ObjectId>& object_ids) {
+    std::unique_ptr<Journal> journal;
+    EXPECT_EQ(Status::OK, storage_->StartCommit(GetFirstHead()->GetId(),
+                                                JournalType::IMPLICIT,
+                                                &journal));
+    for (size_t i = 0; i < object_ids.size(); ++i) {
+      EXPECT_EQ(Status::OK, journal->Put("key" + std::to_string(i),
+                                         object_ids[i], KeyPriority::EAGER));
+    }
+    EXPECT_EQ(Status::OK, journal->Rollback());
+    WaitForIoThread();
+  }
+
+  // Waits until the tasks posted on the io thread so far, and their replies,
+  // have run.
+  void WaitForIoThread() {
+    io_runner_->PostTask([main_runner = message_loop_.task_runner()] {
+      main_runner->PostTask(
+          [] { mtl::MessageLoop::GetCurrent()->PostQuitTask(); });
+    });
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+
   std::unique_ptr<const Commit> TryCommitJournal(
       std::unique_ptr<Journal>* journal,
       Status expected_status) {
@@ -424,8 +561,7 @@ TEST_F(PageStorageTest, AddGetSyncedCommits) {
   sync.AddObject(root_id, root_data.ToString());
 
   // Remove the root from the local storage. The two values were never added.
-  std::string file_path = GetFilePath(root_id);
-  files::DeletePath(file_path, false);
+  RemoveObjectFromLocalStorage(root_id);
 
   std::vector<std::unique_ptr<const Commit>> parent;
   parent.emplace_back(GetFirstHead());
@@ -504,13 +640,134 @@ TEST_F(PageStorageTest, HeadCommits) {
       storage_.get(), RandomId(kObjectIdSize), std::move(parent));
   CommitId id = commit->GetId();
 
+  Status status;
   storage_->AddCommitFromLocal(
-      std::move(commit), [](Status status) { EXPECT_EQ(Status::OK, status); });
+      std::move(commit),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
   EXPECT_EQ(Status::OK, storage_->GetHeadCommitIds(&heads));
   EXPECT_EQ(1u, heads.size());
   EXPECT_EQ(id, heads[0]);
 }
 
+TEST_F(PageStorageTest, HeadsAndRecentCommitsInMemory) {
+  std::vector<std::unique_ptr<const Commit>> parent;
+  parent.emplace_back(GetFirstHead());
+  std::unique_ptr<Commit> commit = CommitImpl::FromContentAndParents(
+      storage_.get(), RandomId(kObjectIdSize), std::move(parent));
+  CommitId id = commit->GetId();
+  std::string storage_bytes = commit->GetStorageBytes().ToString();
+
+  Status status;
+  storage_->AddCommitFromLocal(
+      std::move(commit),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  // Once the row of the commit is removed, it must still be served from
+  // memory.
+  EXPECT_EQ(Status::OK,
+            PageStorageImplAccessorForTest::RemoveCommit(storage_.get(), id));
+  std::vector<CommitId> heads;
+  EXPECT_EQ(Status::OK, storage_->GetHeadCommitIds(&heads));
+  ASSERT_EQ(1u, heads.size());
+  EXPECT_EQ(id, heads[0]);
+  std::unique_ptr<const Commit> found = GetCommit(id);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(storage_bytes, found->GetStorageBytes());
+}
+
+TEST_F(PageStorageTest, AddCommitsWhileParentIsWritten) {
+  FakeCommitWatcher watcher;
+  storage_->AddCommitWatcher(&watcher);
+
+  std::vector<std::unique_ptr<const Commit>> parent;
+  parent.emplace_back(GetFirstHead());
+  std::unique_ptr<Commit> commit = CommitImpl::FromContentAndParents(
+      storage_.get(), RandomId(kObjectIdSize), std::move(parent));
+  parent.clear();
+  parent.emplace_back(commit->Clone());
+  std::unique_ptr<Commit> child = CommitImpl::FromContentAndParents(
+      storage_.get(), RandomId(kObjectIdSize), std::move(parent));
+  CommitId child_id = child->GetId();
+  std::vector<PageStorage::CommitIdAndBytes> commit_id_and_bytes =
+      CommitAndBytesFromCommit(*commit);
+
+  // Until the commit is written in the database, receiving it again from sync
+  // does not add it twice, and its child can already be added.
+  Status status;
+  Status sync_status;
+  Status child_status;
+  storage_->AddCommitFromLocal(std::move(commit),
+                               callback::Capture([] {}, &status));
+  storage_->AddCommitsFromSync(std::move(commit_id_and_bytes),
+                               callback::Capture([] {}, &sync_status));
+  storage_->AddCommitFromLocal(
+      std::move(child),
+      callback::Capture([this] { message_loop_.PostQuitTask(); },
+                        &child_status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(Status::OK, sync_status);
+  EXPECT_EQ(Status::OK, child_status);
+  EXPECT_EQ(2, watcher.commit_count);
+  EXPECT_EQ(child_id, watcher.last_commit_id);
+
+  std::vector<CommitId> heads;
+  EXPECT_EQ(Status::OK, storage_->GetHeadCommitIds(&heads));
+  ASSERT_EQ(1u, heads.size());
+  EXPECT_EQ(child_id, heads[0]);
+}
+
+TEST_F(PageStorageTest, SkipAncestorIds) {
+  std::vector<CommitId> ids;
+  std::unique_ptr<const Commit> parent = GetFirstHead();
+  for (int i = 0; i < 5; ++i) {
+    std::vector<std::unique_ptr<const Commit>> parents;
+    parents.push_back(std::move(parent));
+    std::unique_ptr<Commit> commit = CommitImpl::FromContentAndParents(
+        storage_.get(), RandomId(kObjectIdSize), std::move(parents));
+    ids.push_back(commit->GetId());
+    parent = commit->Clone();
+
+    Status status;
+    storage_->AddCommitFromLocal(
+        std::move(commit),
+        callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+  }
+
+  Status status;
+  std::vector<CommitId> skip_ids;
+  storage_->GetSkipAncestorIds(
+      ids[4], callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                &status, &skip_ids));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(std::vector<CommitId>({ids[3], ids[2], ids[0]}), skip_ids);
+
+  storage_->GetSkipAncestorIds(
+      ids[3], callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                &status, &skip_ids));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(
+      std::vector<CommitId>({ids[2], ids[1], kFirstPageCommitId.ToString()}),
+      skip_ids);
+
+  // The first commit of the page has no ancestor.
+  storage_->GetSkipAncestorIds(
+      kFirstPageCommitId,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &skip_ids));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(skip_ids.empty());
+}
+
 TEST_F(PageStorageTest, CreateJournals) {
   // Explicit journal.
   CommitId left_id = TryCommitFromLocal(JournalType::EXPLICIT, 5);
@@ -582,13 +839,144 @@ TEST_F(PageStorageTest, AddObjectFromLocal) {
 
   EXPECT_EQ(data.object_id, object_id);
 
-  std::string file_path = GetFilePath(object_id);
-  std::string file_content;
-  EXPECT_TRUE(files::ReadFileToString(file_path, &file_content));
-  EXPECT_EQ(data.value, file_content);
+  // The content is only written with the first journal entry or commit
+  // referencing the object, but can be read before.
+  EXPECT_FALSE(IsObjectStoredLocally(object_id));
+  std::unique_ptr<const Object> object =
+      TryGetObject(object_id, PageStorage::Location::LOCAL);
+  ftl::StringView object_data;
+  ASSERT_EQ(Status::OK, object->GetData(&object_data));
+  EXPECT_EQ(data.value, convert::ToString(object_data));
   EXPECT_TRUE(storage_->ObjectIsUntracked(object_id));
 }
 
+TEST_F(PageStorageTest, WriteObjectWithJournalEntry) {
+  ObjectData data("Some data", ObjectData::InlineBehavior::PREVENT);
+  TryAddFromLocal(data.value, data.object_id);
+  EXPECT_FALSE(IsObjectStoredInDb(data.object_id));
+
+  std::unique_ptr<Journal> journal;
+  EXPECT_EQ(Status::OK, storage_->StartCommit(GetFirstHead()->GetId(),
+                                              JournalType::IMPLICIT, &journal));
+  EXPECT_EQ(Status::OK,
+            journal->Put("key", data.object_id, KeyPriority::EAGER));
+  WaitForIoThread();
+  EXPECT_TRUE(IsObjectStoredInDb(data.object_id));
+
+  std::unique_ptr<const Commit> commit = TryCommitJournal(&journal, Status::OK);
+  EXPECT_TRUE(IsObjectStoredInDb(data.object_id));
+}
+
+TEST_F(PageStorageTest, WriteObjectWithCommit) {
+  ObjectData data("Some data", ObjectData::InlineBehavior::PREVENT);
+  TryAddFromLocal(data.value, data.object_id);
+
+  // Explicit journals are kept in memory: the value and the tree nodes are
+  // written with the commit.
+  std::unique_ptr<Journal> journal;
+  EXPECT_EQ(Status::OK, storage_->StartCommit(GetFirstHead()->GetId(),
+                                              JournalType::EXPLICIT, &journal));
+  EXPECT_EQ(Status::OK,
+            journal->Put("key", data.object_id, KeyPriority::EAGER));
+  EXPECT_FALSE(IsObjectStoredInDb(data.object_id));
+
+  std::unique_ptr<const Commit> commit = TryCommitJournal(&journal, Status::OK);
+  ASSERT_TRUE(commit);
+  EXPECT_TRUE(IsObjectStoredInDb(data.object_id));
+  EXPECT_TRUE(IsObjectStoredInDb(commit->GetRootId()));
+}
+
+TEST_F(PageStorageTest, AddObjectFromLocalTiers) {
+  ObjectData small_data("Some data", ObjectData::InlineBehavior::PREVENT);
+  ObjectData big_data(std::string(kDefaultMaxDbObjectSize, 'a'));
+
+  for (ObjectData* data : {&small_data, &big_data}) {
+    storage_->AddObjectFromLocal(
+        data->ToDataSource(),
+        [this](Status returned_status, ObjectId returned_object_id) {
+          EXPECT_EQ(Status::OK, returned_status);
+          message_loop_.PostQuitTask();
+        });
+    EXPECT_FALSE(RunLoopWithTimeout());
+
+    std::unique_ptr<const Object> object =
+        TryGetObject(data->object_id, PageStorage::Location::LOCAL);
+    ftl::StringView object_data;
+    ASSERT_EQ(Status::OK, object->GetData(&object_data));
+    EXPECT_EQ(data->value, convert::ToString(object_data));
+  }
+  TryPutInJournal({small_data.object_id, big_data.object_id});
+
+  // Objects smaller than the threshold are stored in the database, bigger ones
+  // in the pack segments.
+  EXPECT_TRUE(IsObjectStoredInDb(small_data.object_id));
+  EXPECT_FALSE(IsObjectStoredInPack(small_data.object_id));
+  EXPECT_FALSE(IsObjectStoredInDb(big_data.object_id));
+  EXPECT_TRUE(IsObjectStoredInPack(big_data.object_id));
+}
+
+TEST_F(PageStorageTest, CompressObjectsStoredInDb) {
+  std::string json;
+  while (json.size() < 1000) {
+    json.append("{\"key\": \"some key\", \"value\": \"some value\"}");
+  }
+  ObjectData compressible(json);
+  ObjectData incompressible(RandomId(1000));
+
+  for (ObjectData* data : {&compressible, &incompressible}) {
+    TryAddFromLocal(data->value, data->object_id);
+
+    std::unique_ptr<const Object> object =
+        TryGetObject(data->object_id, PageStorage::Location::LOCAL);
+    ftl::StringView object_data;
+    ASSERT_EQ(Status::OK, object->GetData(&object_data));
+    EXPECT_EQ(data->value, convert::ToString(object_data));
+  }
+
+  TryPutInJournal({compressible.object_id, incompressible.object_id});
+
+  // Only the content that compresses well is stored compressed. Ids are
+  // computed on the uncompressed content.
+  std::string content;
+  ASSERT_EQ(Status::OK,
+            PageStorageImplAccessorForTest::GetCompressedObjectContent(
+                storage_.get(), compressible.object_id, &content));
+  EXPECT_LT(content.size(), compressible.size / 2);
+  EXPECT_FALSE(IsObjectStoredUncompressedInDb(compressible.object_id));
+  EXPECT_TRUE(IsObjectStoredUncompressedInDb(incompressible.object_id));
+  EXPECT_FALSE(IsObjectStoredCompressedInDb(incompressible.object_id));
+}
+
+TEST_F(PageStorageTest, CompressObjectsStoredInPack) {
+  std::string json;
+  while (json.size() < 64 * 1024) {
+    json.append("{\"key\": \"some key\", \"value\": \"some value\"}");
+  }
+  ObjectData compressible(json);
+  ObjectData incompressible(RandomId(64 * 1024));
+
+  for (ObjectData* data : {&compressible, &incompressible}) {
+    TryAddFromLocal(data->value, data->object_id);
+
+    std::unique_ptr<const Object> object =
+        TryGetObject(data->object_id, PageStorage::Location::LOCAL);
+    ftl::StringView object_data;
+    ASSERT_EQ(Status::OK, object->GetData(&object_data));
+    EXPECT_EQ(data->value, convert::ToString(object_data));
+  }
+
+  PackLocation location;
+  ASSERT_EQ(Status::OK, PageStorageImplAccessorForTest::GetObjectLocation(
+                            storage_.get(), compressible.object_id, &location));
+  EXPECT_TRUE(location.compressed);
+  EXPECT_LT(location.size, compressible.size / 2);
+  ASSERT_EQ(Status::OK,
+            PageStorageImplAccessorForTest::GetObjectLocation(
+                storage_.get(), incompressible.object_id, &location));
+  EXPECT_FALSE(location.compressed);
+  EXPECT_EQ(incompressible.size, location.size);
+}
+
 TEST_F(PageStorageTest, AddSmallObjectFromLocal) {
   ObjectData data("Some data");
 
@@ -605,8 +993,7 @@ TEST_F(PageStorageTest, AddSmallObjectFromLocal) {
   EXPECT_EQ(data.object_id, object_id);
   EXPECT_EQ(data.value, object_id);
 
-  std::string file_path = GetFilePath(object_id);
-  EXPECT_FALSE(files::IsFile(file_path));
+  EXPECT_FALSE(IsObjectStoredLocally(object_id));
   EXPECT_TRUE(storage_->ObjectIsUntracked(object_id));
 }
 
@@ -646,13 +1033,46 @@ TEST_F(PageStorageTest, AddObjectFromSync) {
                               });
   EXPECT_FALSE(RunLoopWithTimeout());
 
-  std::string file_path = GetFilePath(data.object_id);
-  std::string file_content;
-  EXPECT_TRUE(files::ReadFileToString(file_path, &file_content));
-  EXPECT_EQ(data.value, file_content);
+  EXPECT_TRUE(IsObjectStoredLocally(data.object_id));
+  std::unique_ptr<const Object> object =
+      TryGetObject(data.object_id, PageStorage::Location::LOCAL);
+  ftl::StringView object_data;
+  ASSERT_EQ(Status::OK, object->GetData(&object_data));
+  EXPECT_EQ(data.value, convert::ToString(object_data));
   EXPECT_FALSE(storage_->ObjectIsUntracked(data.object_id));
 }
 
+TEST_F(PageStorageTest, AddObjectTwice) {
+  ObjectData data(RandomId(64 * 1024));
+  TryAddFromLocal(data.value, data.object_id);
+
+  PackLocation location;
+  ASSERT_EQ(Status::OK, PageStorageImplAccessorForTest::GetObjectLocation(
+                            storage_.get(), data.object_id, &location));
+  std::string segment_path = ftl::Concatenate(
+      {tmp_dir_.path(), "/packs/", ftl::NumberToString(location.segment)});
+  std::string segment_content;
+  ASSERT_TRUE(files::ReadFileToString(segment_path, &segment_content));
+  size_t segment_size = segment_content.size();
+
+  // Adding the same object again, from local or from sync, does not write its
+  // content a second time.
+  TryAddFromLocal(data.value, data.object_id);
+  storage_->AddObjectFromSync(data.object_id, data.ToDataSource(),
+                              [this](Status returned_status) {
+                                EXPECT_EQ(Status::OK, returned_status);
+                                message_loop_.PostQuitTask();
+                              });
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  ASSERT_TRUE(files::ReadFileToString(segment_path, &segment_content));
+  EXPECT_EQ(segment_size, segment_content.size());
+  PackLocation found_location;
+  ASSERT_EQ(Status::OK, PageStorageImplAccessorForTest::GetObjectLocation(
+                            storage_.get(), data.object_id, &found_location));
+  EXPECT_EQ(location.offset, found_location.offset);
+}
+
 TEST_F(PageStorageTest, AddObjectFromSyncWrongObjectId) {
   ObjectData data("Some data", ObjectData::InlineBehavior::PREVENT);
   ObjectId wrong_id = RandomId(kObjectIdSize);
@@ -664,6 +1084,8 @@ TEST_F(PageStorageTest, AddObjectFromSyncWrongObjectId) {
                                 message_loop_.PostQuitTask();
                               });
   EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_FALSE(IsObjectStoredLocally(wrong_id));
+  EXPECT_FALSE(IsObjectStoredLocally(data.object_id));
 }
 
 TEST_F(PageStorageTest, AddObjectFromSyncWrongSize) {
@@ -680,14 +1102,57 @@ TEST_F(PageStorageTest, AddObjectFromSyncWrongSize) {
 }
 
 TEST_F(PageStorageTest, GetObject) {
-  ObjectData data("Some data");
-  std::string file_path = GetFilePath(data.object_id);
+  ObjectData data("Some data", ObjectData::InlineBehavior::PREVENT);
+  TryAddFromLocal(data.value, data.object_id);
+
+  std::unique_ptr<const Object> object =
+      TryGetObject(data.object_id, PageStorage::Location::LOCAL);
+  EXPECT_EQ(data.object_id, object->GetId());
+  ftl::StringView object_data;
+  ASSERT_EQ(Status::OK, object->GetData(&object_data));
+  EXPECT_EQ(data.value, convert::ToString(object_data));
+}
+
+TEST_F(PageStorageTest, MigrateLegacyObjects) {
+  ObjectData data("Some data", ObjectData::InlineBehavior::PREVENT);
+  ObjectData corrupted_data("Some other data",
+                            ObjectData::InlineBehavior::PREVENT);
+
+  // Store the objects as previous versions of PageStorageImpl did, one file
+  // per object. The content of the second file does not match its name.
+  std::string objects_dir = tmp_dir_.path() + "/objects";
+  std::string hex_id = convert::ToHex(data.object_id);
+  std::string corrupted_hex_id = convert::ToHex(corrupted_data.object_id);
+  std::string file_path =
+      objects_dir + "/" + hex_id.substr(0, 2) + "/" + hex_id.substr(2);
+  std::string corrupted_file_path = objects_dir + "/" +
+                                    corrupted_hex_id.substr(0, 2) + "/" +
+                                    corrupted_hex_id.substr(2);
   ASSERT_TRUE(files::CreateDirectory(files::GetDirectoryName(file_path)));
+  ASSERT_TRUE(
+      files::CreateDirectory(files::GetDirectoryName(corrupted_file_path)));
   ASSERT_TRUE(files::WriteFile(file_path, data.value.data(), data.size));
+  ASSERT_TRUE(files::WriteFile(corrupted_file_path, data.value.data(),
+                               data.size));
+  ASSERT_TRUE(files::CreateDirectory(tmp_dir_.path() + "/staging"));
+
+  // Reopen the page.
+  PageId id = storage_->GetId();
+  storage_ = std::make_unique<PageStorageImpl>(message_loop_.task_runner(),
+                                               io_runner_, &coroutine_service_,
+                                               tmp_dir_.path(), id);
+  Status status;
+  storage_->Init(
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  EXPECT_FALSE(files::IsDirectory(objects_dir));
+  EXPECT_TRUE(IsObjectStoredLocally(data.object_id));
+  EXPECT_FALSE(IsObjectStoredLocally(corrupted_data.object_id));
 
   std::unique_ptr<const Object> object =
       TryGetObject(data.object_id, PageStorage::Location::LOCAL);
-  EXPECT_EQ(data.object_id, object->GetId());
   ftl::StringView object_data;
   ASSERT_EQ(Status::OK, object->GetData(&object_data));
   EXPECT_EQ(data.value, convert::ToString(object_data));
@@ -739,8 +1204,8 @@ TEST_F(PageStorageTest, UnsyncedObjects) {
   }
 
   // Without syncing anything, the unsynced objects of any of the commits should
-  // be the values added up to that point and also the root node of the given
-  // commit.
+  // be the objects it introduced: the value added by that commit and the root
+  // node of the commit.
   for (int i = 0; i < size; ++i) {
     Status status;
     std::vector<ObjectId> objects;
@@ -749,37 +1214,259 @@ TEST_F(PageStorageTest, UnsyncedObjects) {
                                       &status, &objects));
     EXPECT_FALSE(RunLoopWithTimeout());
     EXPECT_EQ(Status::OK, status);
-    EXPECT_EQ(static_cast<unsigned>(i + 2), objects.size());
+    EXPECT_EQ(2u, objects.size());
 
     std::unique_ptr<const Commit> commit = GetCommit(commits[i]);
     EXPECT_TRUE(std::find(objects.begin(), objects.end(),
                           commit->GetRootId()) != objects.end());
-    for (int j = 0; j <= i; ++j) {
-      EXPECT_TRUE(std::find(objects.begin(), objects.end(),
-                            data[j].object_id) != objects.end());
-    }
+    EXPECT_TRUE(std::find(objects.begin(), objects.end(), data[i].object_id) !=
+                objects.end());
+
+    std::vector<ObjectId> delta_objects;
+    EXPECT_EQ(Status::OK,
+              storage_->GetDeltaObjects(commits[i], &delta_objects));
+    std::sort(delta_objects.begin(), delta_objects.end());
+    EXPECT_EQ(objects, delta_objects);
   }
 
-  // Mark the 2nd object as synced. We now expect to find the 2 unsynced values
-  // and the (also unsynced) root node.
+  // Mark the 2nd object as synced. We now expect to find only the (also
+  // unsynced) root node of the 2nd commit.
   EXPECT_EQ(Status::OK, storage_->MarkObjectSynced(data[1].object_id));
   Status status;
   std::vector<ObjectId> objects;
   storage_->GetUnsyncedObjectIds(
-      commits[2], callback::Capture([this] { message_loop_.PostQuitTask(); },
+      commits[1], callback::Capture([this] { message_loop_.PostQuitTask(); },
                                     &status, &objects));
   EXPECT_FALSE(RunLoopWithTimeout());
   EXPECT_EQ(Status::OK, status);
-  EXPECT_EQ(3u, objects.size());
-  std::unique_ptr<const Commit> commit = GetCommit(commits[2]);
+  std::unique_ptr<const Commit> commit = GetCommit(commits[1]);
+  EXPECT_EQ(std::vector<ObjectId>({commit->GetRootId().ToString()}), objects);
+}
+
+TEST_F(PageStorageTest, UnsyncedObjectsWithoutDelta) {
+  ObjectData data("Some data");
+  TryAddFromLocal(data.value, data.object_id);
+  std::unique_ptr<Journal> journal;
+  EXPECT_EQ(Status::OK, storage_->StartCommit(GetFirstHead()->GetId(),
+                                              JournalType::IMPLICIT, &journal));
+  EXPECT_EQ(Status::OK, journal->Put("key", data.object_id, KeyPriority::LAZY));
+  TryCommitJournal(&journal, Status::OK);
+  std::unique_ptr<const Commit> commit = GetFirstHead();
+
+  // A commit on top of it that does not record its delta, like commits
+  // created by previous versions, falls back to listing its whole tree.
+  std::vector<std::unique_ptr<const Commit>> parents;
+  parents.push_back(commit->Clone());
+  std::unique_ptr<Commit> child = CommitImpl::FromContentAndParents(
+      storage_.get(), commit->GetRootId().ToString(), std::move(parents));
+  CommitId child_id = child->GetId();
+  Status status;
+  storage_->AddCommitFromLocal(
+      std::move(child),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  std::vector<ObjectId> delta_objects;
+  EXPECT_EQ(Status::NOT_FOUND,
+            storage_->GetDeltaObjects(child_id, &delta_objects));
+  std::vector<ObjectId> objects;
+  storage_->GetUnsyncedObjectIds(
+      child_id, callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                  &status, &objects));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(2u, objects.size());
   EXPECT_TRUE(std::find(objects.begin(), objects.end(), commit->GetRootId()) !=
               objects.end());
-  EXPECT_TRUE(std::find(objects.begin(), objects.end(), data[0].object_id) !=
-              objects.end());
-  EXPECT_TRUE(std::find(objects.begin(), objects.end(), data[2].object_id) !=
+  EXPECT_TRUE(std::find(objects.begin(), objects.end(), data.object_id) !=
               objects.end());
 }
 
+TEST_F(PageStorageTest, CollectGarbage) {
+  // Reopen the page so that collections run without delay between their
+  // steps, and with several steps per phase.
+  GarbageCollectorOptions gc_options;
+  gc_options.step_delay = ftl::TimeDelta::Zero();
+  gc_options.max_items_per_step = 2;
+  PageId id = storage_->GetId();
+  storage_ = std::make_unique<PageStorageImpl>(
+      message_loop_.task_runner(), io_runner_, &coroutine_service_,
+      tmp_dir_.path(), id, PackSyncOptions(), kDefaultMaxDbObjectSize, nullptr,
+      nullptr, nullptr, "", gc_options);
+  Status status;
+  storage_->Init(
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  ObjectData kept("Kept data", ObjectData::InlineBehavior::PREVENT);
+  ObjectData replaced("Replaced data", ObjectData::InlineBehavior::PREVENT);
+  ObjectData untracked("Untracked data", ObjectData::InlineBehavior::PREVENT);
+  TryAddFromLocal(kept.value, kept.object_id);
+  TryAddFromLocal(replaced.value, replaced.object_id);
+
+  // The first commit adds both values, the second one deletes one of them.
+  std::unique_ptr<Journal> journal;
+  EXPECT_EQ(Status::OK, storage_->StartCommit(GetFirstHead()->GetId(),
+                                              JournalType::IMPLICIT, &journal));
+  EXPECT_EQ(Status::OK,
+            journal->Put("key0", kept.object_id, KeyPriority::EAGER));
+  EXPECT_EQ(Status::OK,
+            journal->Put("key1", replaced.object_id, KeyPriority::EAGER));
+  std::unique_ptr<const Commit> commit = TryCommitJournal(&journal, Status::OK);
+  // The untracked value is written with the second commit, which does not
+  // reference it.
+  TryAddFromLocal(untracked.value, untracked.object_id);
+  EXPECT_EQ(Status::OK, storage_->StartCommit(commit->GetId(),
+                                              JournalType::IMPLICIT, &journal));
+  EXPECT_EQ(Status::OK, journal->Delete("key1"));
+  std::unique_ptr<const Commit> head = TryCommitJournal(&journal, Status::OK);
+  journal.reset();
+  ObjectId old_root_id = commit->GetRootId().ToString();
+  ObjectId root_id = head->GetRootId().ToString();
+
+  // Sync both commits.
+  for (const Commit* synced_commit : {commit.get(), head.get()}) {
+    std::vector<ObjectId> objects;
+    storage_->GetUnsyncedObjectIds(
+        synced_commit->GetId(),
+        callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                          &objects));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    for (const ObjectId& object_id : objects) {
+      EXPECT_EQ(Status::OK, storage_->MarkObjectSynced(object_id));
+    }
+    EXPECT_EQ(Status::OK, storage_->MarkCommitSynced(synced_commit->GetId()));
+  }
+  head.reset();
+
+  // The first commit is still in use: its objects are kept, but the deltas of
+  // the synced commits are deleted.
+  GarbageCollectionStats stats;
+  storage_->CollectGarbage(callback::Capture(
+      [this] { message_loop_.PostQuitTask(); }, &status, &stats));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(0u, stats.objects_deleted);
+  EXPECT_EQ(2u, stats.deltas_deleted);
+  EXPECT_TRUE(IsObjectStoredLocally(replaced.object_id));
+  EXPECT_TRUE(IsObjectStoredLocally(old_root_id));
+  std::vector<ObjectId> delta_objects;
+  EXPECT_EQ(Status::NOT_FOUND,
+            storage_->GetDeltaObjects(commit->GetId(), &delta_objects));
+
+  // Once it is released, the objects only reachable from it are deleted.
+  commit.reset();
+  storage_->CollectGarbage(callback::Capture(
+      [this] { message_loop_.PostQuitTask(); }, &status, &stats));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(2u, stats.objects_deleted);
+  EXPECT_EQ(0u, stats.deltas_deleted);
+  EXPECT_LT(0u, stats.bytes_reclaimed);
+  EXPECT_FALSE(IsObjectStoredLocally(replaced.object_id));
+  EXPECT_FALSE(IsObjectStoredLocally(old_root_id));
+  EXPECT_TRUE(IsObjectStoredLocally(kept.object_id));
+  EXPECT_TRUE(IsObjectStoredLocally(root_id));
+  EXPECT_TRUE(IsObjectStoredLocally(untracked.object_id));
+  EXPECT_TRUE(storage_->ObjectIsUntracked(untracked.object_id));
+
+  // A deleted object can be fetched again.
+  FakeSyncDelegate sync;
+  sync.AddObject(replaced.object_id, replaced.value);
+  storage_->SetSyncDelegate(&sync);
+  std::unique_ptr<const Object> object =
+      TryGetObject(replaced.object_id, PageStorage::Location::NETWORK);
+  ftl::StringView object_data;
+  ASSERT_EQ(Status::OK, object->GetData(&object_data));
+  EXPECT_EQ(replaced.value, convert::ToString(object_data));
+  storage_->SetSyncDelegate(nullptr);
+}
+
+TEST_F(PageStorageTest, CollectGarbageWhileAddingCommitsFromSync) {
+  GarbageCollectorOptions gc_options;
+  gc_options.step_delay = ftl::TimeDelta::Zero();
+  PageId id = storage_->GetId();
+  storage_ = std::make_unique<PageStorageImpl>(
+      message_loop_.task_runner(), io_runner_, &coroutine_service_,
+      tmp_dir_.path(), id, PackSyncOptions(), kDefaultMaxDbObjectSize, nullptr,
+      nullptr, nullptr, "", gc_options);
+  Status status;
+  storage_->Init(
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  DelayingFakeSyncDelegate sync([this] { message_loop_.PostQuitTask(); });
+  storage_->SetSyncDelegate(&sync);
+
+  ObjectData fetched_value("Fetched data", ObjectData::InlineBehavior::PREVENT);
+  ObjectData delayed_value("Delayed data", ObjectData::InlineBehavior::PREVENT);
+  std::vector<Entry> entries = {
+      Entry{"key0", fetched_value.object_id, storage::KeyPriority::EAGER},
+      Entry{"key1", delayed_value.object_id, storage::KeyPriority::EAGER},
+  };
+  std::unique_ptr<const TreeNode> node;
+  ASSERT_TRUE(CreateNodeFromEntries(
+      entries, std::vector<ObjectId>(entries.size() + 1), &node));
+  ObjectId root_id = node->GetId();
+  node.reset();
+
+  sync.AddObject(fetched_value.object_id, fetched_value.value);
+  sync.AddObject(delayed_value.object_id, delayed_value.value);
+  std::unique_ptr<const Object> root_object =
+      TryGetObject(root_id, PageStorage::Location::NETWORK);
+  ftl::StringView root_data;
+  ASSERT_EQ(Status::OK, root_object->GetData(&root_data));
+  sync.AddObject(root_id, root_data.ToString());
+  root_object.reset();
+  RemoveObjectFromLocalStorage(root_id);
+
+  std::vector<std::unique_ptr<const Commit>> parent;
+  parent.emplace_back(GetFirstHead());
+  std::unique_ptr<Commit> commit = CommitImpl::FromContentAndParents(
+      storage_.get(), root_id, std::move(parent));
+
+  // Stop once the root and the first value are fetched, before the commit is
+  // added.
+  sync.DelayObject(delayed_value.object_id);
+  bool commit_added = false;
+  Status add_status;
+  storage_->AddCommitsFromSync(
+      CommitAndBytesFromCommit(*commit),
+      callback::Capture([&commit_added] { commit_added = true; }, &add_status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_FALSE(commit_added);
+  EXPECT_TRUE(IsObjectStoredLocally(fetched_value.object_id));
+
+  // The collection does not delete the fetched value, which is not reachable
+  // from the heads yet.
+  bool collected = false;
+  GarbageCollectionStats stats;
+  storage_->CollectGarbage(callback::Capture(
+      [this, &collected] {
+        collected = true;
+        message_loop_.PostQuitTask();
+      },
+      &status, &stats));
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(100)));
+  EXPECT_FALSE(collected);
+  EXPECT_TRUE(IsObjectStoredLocally(fetched_value.object_id));
+
+  sync.ReleaseDelayedObject();
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_TRUE(collected);
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(commit_added);
+  EXPECT_EQ(Status::OK, add_status);
+  EXPECT_TRUE(IsObjectStoredLocally(fetched_value.object_id));
+  EXPECT_TRUE(IsObjectStoredLocally(delayed_value.object_id));
+  EXPECT_TRUE(IsObjectStoredLocally(root_id));
+  storage_->SetSyncDelegate(nullptr);
+}
+
 TEST_F(PageStorageTest, UntrackedObjectsSimple) {
   ObjectData data("Some data");
 
@@ -938,8 +1625,7 @@ TEST_F(PageStorageTest, AddMultipleCommitsFromSync) {
     sync.AddObject(object_ids[i], root_data.ToString());
 
     // Remove the root from the local storage. The value was never added.
-    std::string file_path = GetFilePath(object_ids[i]);
-    files::DeletePath(file_path, false);
+    RemoveObjectFromLocalStorage(object_ids[i]);
   }
 
   std::vector<std::unique_ptr<const Commit>> parent;
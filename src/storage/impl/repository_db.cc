@@ -0,0 +1,195 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/impl/repository_db.h"
+
+#include <vector>
+
+#include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/impl/directory_reader.h"
+#include "apps/ledger/src/storage/public/constants.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/path.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+
+#include "leveldb/write_batch.h"
+
+namespace storage {
+
+namespace {
+
+// Ledger and page directory names are base64 encoded: they never contain '-'.
+constexpr ftl::StringView kRepositoryDbDir = "repository-db";
+
+constexpr int kBloomFilterBitsPerKey = 10;
+
+// Number of rows written in each batch when importing a legacy page database.
+constexpr size_t kImportBatchSize = 1000;
+
+}  // namespace
+
+std::string GetRepositoryDbPath(ftl::StringView base_storage_dir) {
+  return ftl::Concatenate(
+      {base_storage_dir, "/", kSerializationVersion, "/", kRepositoryDbDir});
+}
+
+std::string GetPageKeyPrefix(ftl::StringView ledger_dir_name,
+                             ftl::StringView page_dir_name) {
+  return ftl::Concatenate({ledger_dir_name, "/", page_dir_name, "/"});
+}
+
+RepositoryDb::RepositoryDb(std::string db_path, size_t block_cache_size)
+    : db_path_(std::move(db_path)),
+      block_cache_(leveldb::NewLRUCache(block_cache_size)),
+      filter_policy_(leveldb::NewBloomFilterPolicy(kBloomFilterBitsPerKey)) {}
+
+RepositoryDb::~RepositoryDb() {}
+
+Status RepositoryDb::Init() {
+  FTL_DCHECK(!db_);
+  if (!files::CreateDirectory(db_path_)) {
+    FTL_LOG(ERROR) << "Failed to create directory under " << db_path_;
+    return Status::INTERNAL_IO_ERROR;
+  }
+  leveldb::DB* db = nullptr;
+  leveldb::Options options;
+  options.create_if_missing = true;
+  options.block_cache = block_cache_.get();
+  options.filter_policy = filter_policy_.get();
+  leveldb::Status status = leveldb::DB::Open(options, db_path_, &db);
+  if (!status.ok()) {
+    FTL_LOG(ERROR) << "Failed to open ledger at " << db_path_
+                   << " with status: " << status.ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+  db_.reset(db);
+  return Status::OK;
+}
+
+Status RepositoryDb::DeleteByPrefix(ftl::StringView prefix) {
+  FTL_DCHECK(db_);
+  leveldb::WriteBatch batch;
+  std::unique_ptr<leveldb::Iterator> it(
+      db_->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(convert::ToSlice(prefix));
+       it->Valid() && it->key().starts_with(convert::ToSlice(prefix));
+       it->Next()) {
+    batch.Delete(it->key());
+  }
+  if (!it->status().ok()) {
+    FTL_LOG(ERROR) << "Failed to read " << db_path_
+                   << " with status: " << it->status().ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+  leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
+  if (!status.ok()) {
+    FTL_LOG(ERROR) << "Failed to write " << db_path_
+                   << " with status: " << status.ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+Status RepositoryDb::ImportPageDb(const std::string& legacy_db_path,
+                                  const std::string& key_prefix) {
+  FTL_DCHECK(db_);
+  leveldb::DB* legacy_db_ptr = nullptr;
+  leveldb::Status status =
+      leveldb::DB::Open(leveldb::Options(), legacy_db_path, &legacy_db_ptr);
+  if (!status.ok()) {
+    FTL_LOG(ERROR) << "Failed to open legacy page database at "
+                   << legacy_db_path << " with status: " << status.ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+  std::unique_ptr<leveldb::DB> legacy_db(legacy_db_ptr);
+
+  // Only the last batch needs to be synced: the legacy database is deleted
+  // after it, and the previous ones are written in the same log.
+  leveldb::WriteOptions write_options;
+  leveldb::WriteOptions last_write_options;
+  last_write_options.sync = true;
+
+  leveldb::WriteBatch batch;
+  size_t batch_size = 0;
+  std::unique_ptr<leveldb::Iterator> it(
+      legacy_db->NewIterator(leveldb::ReadOptions()));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    batch.Put(key_prefix + it->key().ToString(), it->value());
+    if (++batch_size < kImportBatchSize) {
+      continue;
+    }
+    status = db_->Write(write_options, &batch);
+    if (!status.ok()) {
+      break;
+    }
+    batch.Clear();
+    batch_size = 0;
+  }
+  if (status.ok()) {
+    status = it->status();
+  }
+  if (status.ok()) {
+    status = db_->Write(last_write_options, &batch);
+  }
+  if (!status.ok()) {
+    FTL_LOG(ERROR) << "Failed to import legacy page database at "
+                   << legacy_db_path << " with status: " << status.ToString();
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  it.reset();
+  legacy_db.reset();
+  if (!files::DeletePath(legacy_db_path, true)) {
+    FTL_LOG(ERROR) << "Unable to delete legacy page database at "
+                   << legacy_db_path;
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+Status RepositoryDb::ImportLegacyPageDbs(ftl::StringView base_storage_dir) {
+  std::string storage_dir =
+      ftl::Concatenate({base_storage_dir, "/", kSerializationVersion});
+  std::vector<std::string> ledger_dir_names;
+  if (!DirectoryReader::GetDirectoryEntries(
+          storage_dir, [&ledger_dir_names](ftl::StringView entry) {
+            if (entry != kRepositoryDbDir) {
+              ledger_dir_names.push_back(entry.ToString());
+            }
+            return true;
+          })) {
+    FTL_LOG(ERROR) << "Unable to read directory " << storage_dir;
+    return Status::INTERNAL_IO_ERROR;
+  }
+
+  for (const std::string& ledger_dir_name : ledger_dir_names) {
+    std::string ledger_dir =
+        ftl::Concatenate({storage_dir, "/", ledger_dir_name});
+    std::vector<std::string> page_dir_names;
+    if (!DirectoryReader::GetDirectoryEntries(
+            ledger_dir, [&page_dir_names](ftl::StringView entry) {
+              page_dir_names.push_back(entry.ToString());
+              return true;
+            })) {
+      FTL_LOG(ERROR) << "Unable to read directory " << ledger_dir;
+      return Status::INTERNAL_IO_ERROR;
+    }
+    for (const std::string& page_dir_name : page_dir_names) {
+      std::string legacy_db_path =
+          ftl::Concatenate({ledger_dir, "/", page_dir_name, "/", kPageDbDir});
+      if (!files::IsDirectory(legacy_db_path)) {
+        continue;
+      }
+      Status status = ImportPageDb(
+          legacy_db_path, GetPageKeyPrefix(ledger_dir_name, page_dir_name));
+      if (status != Status::OK) {
+        return status;
+      }
+    }
+  }
+  return Status::OK;
+}
+
+}  // namespace storage
@@ -0,0 +1,80 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_STORAGE_IMPL_REPOSITORY_DB_H_
+#define APPS_LEDGER_SRC_STORAGE_IMPL_REPOSITORY_DB_H_
+
+#include <memory>
+#include <string>
+
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+#include "leveldb/cache.h"
+#include "leveldb/db.h"
+#include "leveldb/filter_policy.h"
+
+namespace storage {
+
+// Directory of the database of a page that does not use the database of its
+// repository, inside the directory of the page. Previous versions of the Ledger
+// used one such database for each page.
+constexpr ftl::StringView kPageDbDir = "leveldb";
+
+// Size of the block cache shared by all the pages of a repository, by default.
+constexpr size_t kDefaultBlockCacheSize = 8 * 1024 * 1024;
+
+// Returns the path of the database shared by the pages of the repository
+// stored in |base_storage_dir|.
+std::string GetRepositoryDbPath(ftl::StringView base_storage_dir);
+
+// Returns the prefix of the keys of the page stored in the directory
+// |page_dir_name|, inside the directory |ledger_dir_name| of its ledger.
+std::string GetPageKeyPrefix(ftl::StringView ledger_dir_name,
+                             ftl::StringView page_dir_name);
+
+// LevelDB database shared by all the pages of a repository. Each page stores
+// its rows under its own key prefix, so that opening a page does not open a
+// new database, and all the pages share the same log, memtable, block cache
+// and bloom filter.
+class RepositoryDb {
+ public:
+  explicit RepositoryDb(std::string db_path,
+                        size_t block_cache_size = kDefaultBlockCacheSize);
+  ~RepositoryDb();
+
+  // Opens the database, creating it if needed.
+  Status Init();
+
+  // Returns the underlying database, or null if it is not initialized. The
+  // database can be accessed from any thread.
+  leveldb::DB* db() { return db_.get(); }
+
+  // Deletes all the rows whose key starts with |prefix|.
+  Status DeleteByPrefix(ftl::StringView prefix);
+
+  // Moves the rows of the database used by previous versions of the Ledger for
+  // a single page, at |legacy_db_path|, to this database, prefixing their keys
+  // with |key_prefix|. The legacy database is deleted once all its rows are
+  // written: if interrupted, the migration can be safely restarted.
+  Status ImportPageDb(const std::string& legacy_db_path,
+                      const std::string& key_prefix);
+
+  // Imports the legacy databases of all the pages of all the ledgers of the
+  // repository stored in |base_storage_dir|.
+  Status ImportLegacyPageDbs(ftl::StringView base_storage_dir);
+
+ private:
+  const std::string db_path_;
+  std::unique_ptr<leveldb::Cache> block_cache_;
+  std::unique_ptr<const leveldb::FilterPolicy> filter_policy_;
+  std::unique_ptr<leveldb::DB> db_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RepositoryDb);
+};
+
+}  // namespace storage
+
+#endif  // APPS_LEDGER_SRC_STORAGE_IMPL_REPOSITORY_DB_H_
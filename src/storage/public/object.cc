@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/storage/public/object.h"
+
+#include "lib/mtl/vmo/strings.h"
+
+namespace storage {
+
+Status Object::GetVmo(mx::vmo* vmo) const {
+  ftl::StringView data;
+  Status status = GetData(&data);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (!mtl::VmoFromString(data, vmo)) {
+    return Status::INTERNAL_IO_ERROR;
+  }
+  return Status::OK;
+}
+
+Status Object::GetSize(uint64_t* size) const {
+  ftl::StringView data;
+  Status status = GetData(&data);
+  if (status != Status::OK) {
+    return status;
+  }
+  *size = data.size();
+  return Status::OK;
+}
+
+Status Object::ReadData(uint64_t offset,
+                        uint64_t max_size,
+                        std::string* data) const {
+  ftl::StringView all_data;
+  Status status = GetData(&all_data);
+  if (status != Status::OK) {
+    return status;
+  }
+  if (offset >= all_data.size()) {
+    data->clear();
+    return Status::OK;
+  }
+  *data = all_data.substr(offset, max_size).ToString();
+  return Status::OK;
+}
+
+}  // namespace storage
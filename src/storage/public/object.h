@@ -5,11 +5,13 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_PUBLIC_OBJECT_H_
 #define APPS_LEDGER_SRC_STORAGE_PUBLIC_OBJECT_H_
 
+#include <string>
 #include <vector>
 
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_view.h"
+#include "mx/vmo.h"
 
 namespace storage {
 
@@ -24,6 +26,21 @@ class Object {
   // Returns the data of this object.
   virtual Status GetData(ftl::StringView* data) const = 0;
 
+  // Returns a vmo containing the data of this object. The default
+  // implementation copies the result of |GetData()| in a new vmo.
+  virtual Status GetVmo(mx::vmo* vmo) const;
+
+  // Returns the size of the data of this object, without necessarily loading
+  // the data. The default implementation uses |GetData()|.
+  virtual Status GetSize(uint64_t* size) const;
+
+  // Reads at most |max_size| bytes of the data of this object, starting at
+  // |offset|, in |data|. Implementations should only load the requested range.
+  // The default implementation uses |GetData()|.
+  virtual Status ReadData(uint64_t offset,
+                          uint64_t max_size,
+                          std::string* data) const;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(Object);
 };
@@ -19,6 +19,10 @@
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_view.h"
 
+namespace callback {
+class WorkerPool;
+}  // namespace callback
+
 namespace storage {
 
 // |PageStorage| manages the local storage of a single page.
@@ -40,6 +44,17 @@ class PageStorage {
   // Location where to search an object. See |GetObject| call for usage.
   enum Location { LOCAL, NETWORK };
 
+  // An opaque position in the contents of a commit, used to resume an
+  // iteration. See |GetCommitContentsFromCursor| call for usage.
+  class ContentsCursor {
+   public:
+    ContentsCursor() {}
+    virtual ~ContentsCursor() {}
+
+   private:
+    FTL_DISALLOW_COPY_AND_ASSIGN(ContentsCursor);
+  };
+
   PageStorage() {}
   virtual ~PageStorage() {}
 
@@ -59,6 +74,14 @@ class PageStorage {
   virtual void GetCommit(
       CommitIdView commit_id,
       std::function<void(Status, std::unique_ptr<const Commit>)> callback) = 0;
+  // Finds the ids of the ancestors of the commit with the given |commit_id| at
+  // 1, 2, 4, ..., 2^k generations of distance, following a linear history:
+  // every commit from |commit_id| to the parent of the last ancestor has a
+  // single parent. The result can be shorter than the linear history of the
+  // commit, and is empty for merge commits and commits not in the index.
+  virtual void GetSkipAncestorIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) = 0;
 
   // Adds a list of commits with the given ids and bytes to storage. The
   // callback is called when the storage has finished processing the commits. If
@@ -99,11 +122,15 @@ class PageStorage {
   // Finds all objects introduced by the commit with the given |commit_id| and
   // adds them in the given |objects| vector. This includes all objects present
   // in the storage tree of the commit that were not in storage tree of its
-  // parent(s).
+  // parent(s), and can include values written by the commit that were already
+  // present. Returns |NOT_FOUND| if the commit was not created locally.
   virtual Status GetDeltaObjects(const CommitId& commit_id,
                                  std::vector<ObjectId>* objects) = 0;
-  // Finds all objects in the storage tree of the commit with the given
-  // |commit_id| that are not yet synced and adds them in the |objectus| vector.
+  // Finds all objects introduced by the commit with the given |commit_id| that
+  // are not yet synced and adds them in the |objects| vector. Objects
+  // introduced by its ancestors are not included: commits are expected to be
+  // uploaded in order. If the delta of the commit is not known, all unsynced
+  // objects in its storage tree are returned.
   virtual void GetUnsyncedObjectIds(
       const CommitId& commit_id,
       std::function<void(Status, std::vector<ObjectId>)> callback) = 0;
@@ -153,6 +180,34 @@ class PageStorage {
                                  std::function<bool(Entry)> on_next,
                                  std::function<void(Status)> on_done) = 0;
 
+  // Iterates over the entries of the given |commit| with a key in
+  // [|min_key|, |max_key|), in decreasing order of keys, and calls |on_next|
+  // on them. An empty |max_key| means that the range has no upper bound.
+  // Returning false from |on_next| will immediately stop the iteration.
+  // |on_done| is called once, upon successfull completion, i.e. when there are
+  // no more elements or iteration was interrupted, or if an error occurs.
+  virtual void GetCommitContentsReverse(
+      const Commit& commit,
+      std::string min_key,
+      std::string max_key,
+      std::function<bool(Entry)> on_next,
+      std::function<void(Status)> on_done) = 0;
+
+  // Same as |GetCommitContents|, but allows to resume the iteration later
+  // without searching for its position from the root of the commit. If
+  // |cursor| is not null, it must have been returned by a previous call on the
+  // same |commit|, and the iteration starts from it instead of |min_key|. If
+  // |on_next| interrupts the iteration, |on_done| receives a cursor positioned
+  // on the entry for which |on_next| returned false. Otherwise, the cursor is
+  // null.
+  virtual void GetCommitContentsFromCursor(
+      const Commit& commit,
+      std::string min_key,
+      std::unique_ptr<ContentsCursor> cursor,
+      std::function<bool(Entry)> on_next,
+      std::function<void(Status, std::unique_ptr<ContentsCursor>)>
+          on_done) = 0;
+
   // Retrieves the entry with the given |key| and calls |on_done| with the
   // result. The status of |on_done| will be |OK| on success, |NOT_FOUND| if
   // there is no such key in the given commit or an error status on failure.
@@ -161,6 +216,33 @@ class PageStorage {
       std::string key,
       std::function<void(Status, Entry)> on_done) = 0;
 
+  // Retrieves the entries with the given |keys| and calls |on_done| with the
+  // result. |keys| must be sorted and must not contain duplicates. On success,
+  // the status of |on_done| will be |OK| and the entries found will be returned
+  // in the order of |keys|: keys that are not in the given commit are skipped.
+  virtual void GetEntriesFromCommit(
+      const Commit& commit,
+      std::vector<std::string> keys,
+      std::function<void(Status, std::vector<Entry>)> on_done) = 0;
+
+  // Counts the entries of the given commit whose key is in [|min_key|,
+  // |max_key|) and calls |on_done| with the result. An empty |max_key| means
+  // that the range has no upper bound.
+  virtual void CountCommitContents(
+      const Commit& commit,
+      std::string min_key,
+      std::string max_key,
+      std::function<void(Status, uint64_t)> on_done) = 0;
+
+  // Retrieves the entry at position |index|, in key order, in the given commit
+  // and calls |on_done| with the result. The status of |on_done| will be |OK|
+  // on success, |NOT_FOUND| if the commit has |index| entries or less, or an
+  // error status on failure.
+  virtual void GetEntryAtIndexFromCommit(
+      const Commit& commit,
+      uint64_t index,
+      std::function<void(Status, Entry)> on_done) = 0;
+
   // Iterates over the difference between the contents of two commits and calls
   // |on_next_diff| on found changed entries. Returning false from
   // |on_next_diff| will immediately stop the iteration. |on_done| is called
@@ -173,6 +255,11 @@ class PageStorage {
       std::function<bool(EntryChange)> on_next_diff,
       std::function<void(Status)> on_done) = 0;
 
+  // Returns the pool of threads on which CPU-bound work of this page, such as
+  // encoding tree nodes, can be run, or nullptr if all the work must be done
+  // on the calling thread.
+  virtual callback::WorkerPool* GetWorkerPool() = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(PageStorage);
 };
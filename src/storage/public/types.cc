@@ -15,6 +15,20 @@ bool operator!=(const Entry& lhs, const Entry& rhs) {
   return !(lhs == rhs);
 }
 
+bool operator==(const EntryView& lhs, const EntryView& rhs) {
+  return lhs.key == rhs.key && lhs.object_id == rhs.object_id &&
+         lhs.priority == rhs.priority;
+}
+
+bool operator!=(const EntryView& lhs, const EntryView& rhs) {
+  return !(lhs == rhs);
+}
+
+Entry ToEntry(const EntryView& entry_view) {
+  return Entry{entry_view.key.ToString(), entry_view.object_id.ToString(),
+               entry_view.priority};
+}
+
 bool operator==(const EntryChange& lhs, const EntryChange& rhs) {
   return lhs.deleted == rhs.deleted &&
          (lhs.deleted ? lhs.entry.key == rhs.entry.key
@@ -38,6 +38,20 @@ struct Entry {
 bool operator==(const Entry& lhs, const Entry& rhs);
 bool operator!=(const Entry& lhs, const Entry& rhs);
 
+// A view on an entry whose key and object id are owned by another object, such
+// as the encoding of a tree node. It must not outlive the owner of its data.
+struct EntryView {
+  convert::ExtendedStringView key;
+  ObjectIdView object_id;
+  KeyPriority priority;
+};
+
+bool operator==(const EntryView& lhs, const EntryView& rhs);
+bool operator!=(const EntryView& lhs, const EntryView& rhs);
+
+// Returns a copy of the entry viewed by |entry_view|.
+Entry ToEntry(const EntryView& entry_view);
+
 // A change between two commit contents.
 struct EntryChange {
   Entry entry;
@@ -31,6 +31,13 @@ void PageStorageEmptyImpl::GetCommit(
   callback(Status::NOT_IMPLEMENTED, nullptr);
 }
 
+void PageStorageEmptyImpl::GetSkipAncestorIds(
+    CommitIdView commit_id,
+    std::function<void(Status, std::vector<CommitId>)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, std::vector<CommitId>());
+}
+
 void PageStorageEmptyImpl::AddCommitsFromSync(
     std::vector<CommitIdAndBytes> ids_and_bytes,
     std::function<void(Status)> callback) {
@@ -136,6 +143,26 @@ void PageStorageEmptyImpl::GetCommitContents(
   on_done(Status::NOT_IMPLEMENTED);
 }
 
+void PageStorageEmptyImpl::GetCommitContentsReverse(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status)> on_done) {
+  FTL_NOTIMPLEMENTED();
+  on_done(Status::NOT_IMPLEMENTED);
+}
+
+void PageStorageEmptyImpl::GetCommitContentsFromCursor(
+    const Commit& commit,
+    std::string min_key,
+    std::unique_ptr<ContentsCursor> cursor,
+    std::function<bool(Entry)> on_next,
+    std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done) {
+  FTL_NOTIMPLEMENTED();
+  on_done(Status::NOT_IMPLEMENTED, nullptr);
+}
+
 void PageStorageEmptyImpl::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
@@ -144,6 +171,31 @@ void PageStorageEmptyImpl::GetEntryFromCommit(
   callback(Status::NOT_IMPLEMENTED, Entry());
 }
 
+void PageStorageEmptyImpl::GetEntriesFromCommit(
+    const Commit& commit,
+    std::vector<std::string> keys,
+    std::function<void(Status, std::vector<Entry>)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, std::vector<Entry>());
+}
+
+void PageStorageEmptyImpl::CountCommitContents(
+    const Commit& commit,
+    std::string min_key,
+    std::string max_key,
+    std::function<void(Status, uint64_t)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, 0);
+}
+
+void PageStorageEmptyImpl::GetEntryAtIndexFromCommit(
+    const Commit& commit,
+    uint64_t index,
+    std::function<void(Status, Entry)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, Entry());
+}
+
 void PageStorageEmptyImpl::GetCommitContentsDiff(
     const Commit& base_commit,
     const Commit& other_commit,
@@ -154,5 +206,9 @@ void PageStorageEmptyImpl::GetCommitContentsDiff(
   on_done(Status::NOT_IMPLEMENTED);
 }
 
+callback::WorkerPool* PageStorageEmptyImpl::GetWorkerPool() {
+  return nullptr;
+}
+
 }  // namespace test
 }  // namespace storage
@@ -31,6 +31,9 @@ class PageStorageEmptyImpl : public PageStorage {
   void GetCommit(CommitIdView commit_id,
                  std::function<void(Status, std::unique_ptr<const Commit>)>
                      callback) override;
+  void GetSkipAncestorIds(
+      CommitIdView commit_id,
+      std::function<void(Status, std::vector<CommitId>)> callback) override;
 
   void AddCommitsFromSync(std::vector<CommitIdAndBytes> ids_and_bytes,
                           std::function<void(Status)> callback) override;
@@ -85,15 +88,47 @@ class PageStorageEmptyImpl : public PageStorage {
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
 
+  void GetCommitContentsReverse(const Commit& commit,
+                                std::string min_key,
+                                std::string max_key,
+                                std::function<bool(Entry)> on_next,
+                                std::function<void(Status)> on_done) override;
+
+  void GetCommitContentsFromCursor(
+      const Commit& commit,
+      std::string min_key,
+      std::unique_ptr<ContentsCursor> cursor,
+      std::function<bool(Entry)> on_next,
+      std::function<void(Status, std::unique_ptr<ContentsCursor>)> on_done)
+      override;
+
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
 
+  void GetEntriesFromCommit(
+      const Commit& commit,
+      std::vector<std::string> keys,
+      std::function<void(Status, std::vector<Entry>)> callback) override;
+
+  void CountCommitContents(
+      const Commit& commit,
+      std::string min_key,
+      std::string max_key,
+      std::function<void(Status, uint64_t)> callback) override;
+
+  void GetEntryAtIndexFromCommit(
+      const Commit& commit,
+      uint64_t index,
+      std::function<void(Status, Entry)> callback) override;
+
   void GetCommitContentsDiff(const Commit& base_commit,
                              const Commit& other_commit,
                              std::string min_key,
                              std::function<bool(EntryChange)> on_next_diff,
                              std::function<void(Status)> on_done) override;
+
+  callback::WorkerPool* GetWorkerPool() override;
 };
 
 }  // namespace test
@@ -166,7 +166,7 @@ StorageTest::~StorageTest(){};
     std::unique_ptr<const TreeNode>* node) {
   Status status;
   std::unique_ptr<const TreeNode> result;
-  TreeNode::FromId(GetStorage(), id,
+  TreeNode::FromId(GetStorage(), nullptr, id,
                    callback::Capture([this] { message_loop_.PostQuitTask(); },
                                      &status, &result));
   if (RunLoopWithTimeout()) {
@@ -188,7 +188,7 @@ StorageTest::~StorageTest(){};
   Status status;
   ObjectId id;
   TreeNode::FromEntries(
-      GetStorage(), 0u, entries, children,
+      GetStorage(), nullptr, 0u, entries, children, std::vector<uint64_t>(),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &id));
 
@@ -15,6 +15,7 @@
 #include "apps/ledger/src/tool/convert.h"
 #include "apps/ledger/src/tool/doctor_command.h"
 #include "apps/ledger/src/tool/inspect_command.h"
+#include "apps/ledger/src/tool/migrate_command.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "lib/ftl/files/file.h"
 #include "lib/ftl/strings/concatenate.h"
@@ -52,6 +53,9 @@ void ClientApp::PrintUsage() {
       << " - `clean` - wipes remote and local data of the most recent user"
       << std::endl;
   std::cout << " - `inspect` - inspects the state of a ledger" << std::endl;
+  std::cout << " - `migrate` - moves the page databases of previous versions "
+               "to the database of the repository"
+            << std::endl;
 }
 
 std::unique_ptr<Command> ClientApp::CommandFromArgs(
@@ -87,6 +91,14 @@ std::unique_ptr<Command> ClientApp::CommandFromArgs(
                                             user_repository_path_);
   }
 
+  if (args[0] == "migrate") {
+    if (args.size() > 1) {
+      FTL_LOG(ERROR) << "Too many arguments for the " << args[0] << " command";
+      return nullptr;
+    }
+    return std::make_unique<MigrateCommand>(user_repository_path_);
+  }
+
   return nullptr;
 }
 
@@ -108,7 +120,7 @@ bool ClientApp::Initialize() {
   }
 
   std::unordered_set<std::string> valid_commands = {"doctor", "clean",
-                                                    "inspect"};
+                                                    "inspect", "migrate"};
   const std::vector<std::string>& args = command_line_.positional_args();
   if (args.size() && valid_commands.count(args[0]) == 0) {
     FTL_LOG(ERROR) << "Unknown command: " << args[0];
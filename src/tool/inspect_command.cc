@@ -74,13 +74,19 @@ class FileStreamWriter {
 InspectCommand::InspectCommand(const std::vector<std::string>& args,
                                const cloud_sync::UserConfig& user_config,
                                ftl::StringView user_repository_path)
-    : args_(args),
+    : repository_db_(storage::GetRepositoryDbPath(user_repository_path)),
+      args_(args),
       app_id_(args_[1]),
       user_repository_path_(user_repository_path.ToString()) {
   FTL_DCHECK(!user_repository_path_.empty());
 }
 
 void InspectCommand::Start(ftl::Closure on_done) {
+  if (repository_db_.Init() != storage::Status::OK) {
+    FTL_LOG(ERROR) << "Unable to open the database of the repository.";
+    on_done();
+    return;
+  }
   if (args_.size() == 3 && args_[2] == "pages") {
     ListPages(std::move(on_done));
   } else if (args_.size() == 5 && args_[2] == "commit") {
@@ -344,7 +350,7 @@ std::unique_ptr<storage::LedgerStorageImpl> InspectCommand::GetLedgerStorage() {
   return std::make_unique<storage::LedgerStorageImpl>(
       mtl::MessageLoop::GetCurrent()->task_runner(),
       mtl::MessageLoop::GetCurrent()->task_runner(), &coroutine_service_,
-      user_repository_path_, app_id_);
+      &repository_db_, user_repository_path_, app_id_);
 }
 
 }  // namespace tool
@@ -10,6 +10,7 @@
 #include "apps/ledger/src/cloud_sync/public/user_config.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "apps/ledger/src/storage/impl/ledger_storage_impl.h"
+#include "apps/ledger/src/storage/impl/repository_db.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/tool/command.h"
 #include "lib/ftl/strings/string_view.h"
@@ -43,6 +44,8 @@ class InspectCommand : public Command {
 
   std::unique_ptr<storage::LedgerStorageImpl> GetLedgerStorage();
 
+  // This must be declared before |storage_|, so that it outlives it.
+  storage::RepositoryDb repository_db_;
   std::unique_ptr<storage::PageStorage> storage_;
   const std::vector<std::string> args_;
   const std::string app_id_;
@@ -0,0 +1,32 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/tool/migrate_command.h"
+
+#include <iostream>
+
+#include "apps/ledger/src/storage/impl/repository_db.h"
+#include "lib/ftl/logging.h"
+
+namespace tool {
+
+MigrateCommand::MigrateCommand(ftl::StringView user_repository_path)
+    : user_repository_path_(user_repository_path.ToString()) {
+  FTL_DCHECK(!user_repository_path_.empty());
+}
+
+void MigrateCommand::Start(ftl::Closure on_done) {
+  std::cout << "> Migrating page databases of " << user_repository_path_
+            << " ";
+  storage::RepositoryDb repository_db(
+      storage::GetRepositoryDbPath(user_repository_path_));
+  storage::Status status = repository_db.Init();
+  if (status == storage::Status::OK) {
+    status = repository_db.ImportLegacyPageDbs(user_repository_path_);
+  }
+  std::cout << status << std::endl;
+  on_done();
+}
+
+}  // namespace tool
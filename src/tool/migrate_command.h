@@ -0,0 +1,34 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TOOL_MIGRATE_COMMAND_H_
+#define APPS_LEDGER_SRC_TOOL_MIGRATE_COMMAND_H_
+
+#include <string>
+
+#include "apps/ledger/src/tool/command.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace tool {
+
+// Command that moves the databases of all the pages of the local repository,
+// as written by previous versions of Ledger, to the database of the
+// repository.
+class MigrateCommand : public Command {
+ public:
+  explicit MigrateCommand(ftl::StringView user_repository_path);
+  ~MigrateCommand() {}
+
+  // Command:
+  void Start(ftl::Closure on_done) override;
+
+ private:
+  const std::string user_repository_path_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MigrateCommand);
+};
+
+}  // namespace tool
+
+#endif  // APPS_LEDGER_SRC_TOOL_MIGRATE_COMMAND_H_